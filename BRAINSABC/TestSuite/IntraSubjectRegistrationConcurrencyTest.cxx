@@ -0,0 +1,231 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+//
+// Runs two small rigid registrations concurrently through
+// AtlasRegistrationMethod::RunIntraSubjectRegistrations(), with a thread
+// budget of four (two registrations of two threads each), and checks that
+// the transforms are bit for bit the ones of the same registrations run one
+// after the other with two threads each. As in BRAINSABC, the registrations
+// share a fixed mask, so their samples are drawn inside the mask.
+//
+#include "AtlasRegistrationMethod.h"
+#include "BRAINSThreadControl.h"
+#include "itkEuler3DTransform.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkImageMaskSpatialObject.h"
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+typedef AtlasRegistrationMethod<float, float> AtlasRegistrationMethodType;
+typedef itk::Image<float, 3>                  ImageType;
+typedef itk::Euler3DTransform<double>         EulerTransformType;
+typedef itk::ImageMaskSpatialObject<3>        MaskSpatialObjectType;
+
+/** Gives access to the concurrent registration runner. */
+class IntraSubjectRegistrationTester : public AtlasRegistrationMethodType
+{
+public:
+  typedef IntraSubjectRegistrationTester Self;
+  typedef itk::SmartPointer<Self>        Pointer;
+  typedef AtlasRegistrationMethodType::IntraSubjectRegistrationTask TaskType;
+
+  itkNewMacro(Self);
+
+  void Run(std::vector<TaskType> & tasks)
+  {
+    this->RunIntraSubjectRegistrations(tasks);
+  }
+};
+
+/** An anisotropic blob, sampled at the points mapped by the inverse of
+ * transform, so that transform registers the result to the untransformed
+ * blob. */
+ImageType::Pointer
+MakeBlob(const EulerTransformType *transform)
+{
+  ImageType::SizeType size;
+  size.Fill(40);
+  ImageType::SpacingType spacing;
+  spacing.Fill(2.0);
+  ImageType::PointType origin;
+  origin.Fill(-39.0);
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions(size);
+  image->SetSpacing(spacing);
+  image->SetOrigin(origin);
+  image->Allocate();
+
+  EulerTransformType::Pointer inverse = EulerTransformType::New();
+  transform->GetInverse(inverse);
+
+  for( itk::ImageRegionIteratorWithIndex<ImageType> it(image, image->GetLargestPossibleRegion() );
+       !it.IsAtEnd(); ++it )
+    {
+    ImageType::PointType point;
+    image->TransformIndexToPhysicalPoint(it.GetIndex(), point);
+    point = inverse->TransformPoint(point);
+    const double r2 = point[0] * point[0] / 400.0 + point[1] * point[1] / 150.0 + point[2] * point[2] / 60.0;
+    it.Set( static_cast<float>( 100.0 * std::exp(-r2) + 20.0 * std::exp(-4.0 * ( r2 - 1.0 ) * ( r2 - 1.0 ) ) ) );
+    }
+  return image;
+}
+
+/** The voxels of image brighter than threshold. */
+MaskSpatialObjectType::Pointer
+MakeMask(const ImageType *image, float threshold)
+{
+  MaskSpatialObjectType::ImageType::Pointer maskImage = MaskSpatialObjectType::ImageType::New();
+  maskImage->CopyInformation(image);
+  maskImage->SetRegions(image->GetLargestPossibleRegion() );
+  maskImage->Allocate();
+
+  itk::ImageRegionIteratorWithIndex<MaskSpatialObjectType::ImageType> mit(maskImage,
+                                                                          maskImage->GetLargestPossibleRegion() );
+  for( ; !mit.IsAtEnd(); ++mit )
+    {
+    mit.Set( image->GetPixel(mit.GetIndex() ) > threshold ? 1 : 0 );
+    }
+
+  MaskSpatialObjectType::Pointer mask = MaskSpatialObjectType::New();
+  mask->SetImage(maskImage);
+  mask->ComputeObjectToWorldTransform();
+  return mask;
+}
+
+itk::BRAINSFitHelper::Pointer
+MakeHelper(ImageType *fixedVolume, ImageType *movingVolume, MaskSpatialObjectType *fixedMask)
+{
+  itk::BRAINSFitHelper::Pointer helper = itk::BRAINSFitHelper::New();
+  helper->SetFixedVolume(fixedVolume);
+  helper->SetMovingVolume(movingVolume);
+  helper->SetFixedBinaryVolume(fixedMask);
+  helper->SetSamplingPercentage(0.5);
+  helper->SetNumberOfHistogramBins(50);
+  std::vector<int> numberOfIterations(1);
+  numberOfIterations[0] = 200;
+  helper->SetNumberOfIterations(numberOfIterations);
+  std::vector<double> minimumStepSize(1);
+  minimumStepSize[0] = 0.0001;
+  helper->SetMinimumStepLength(minimumStepSize);
+  std::vector<std::string> transformType(1);
+  transformType[0] = "Rigid";
+  helper->SetTransformType(transformType);
+  helper->SetTranslationScale(1000);
+  helper->SetInitializeTransformMode("Off");
+  helper->SetCurrentGenericTransform(ITK_NULLPTR);
+  return helper;
+}
+} // end anonymous namespace
+
+int main(int, char * *)
+{
+  const unsigned int numberOfRegistrations = 2;
+  const unsigned int threadsPerRegistration = 2;
+
+  EulerTransformType::Pointer    identity = EulerTransformType::New();
+  ImageType::Pointer             fixedVolume = MakeBlob(identity);
+  MaskSpatialObjectType::Pointer fixedMask = MakeMask(fixedVolume, 10.0F);
+
+  std::vector<ImageType::Pointer> movingVolumes;
+  for( unsigned int r = 0; r < numberOfRegistrations; ++r )
+    {
+    EulerTransformType::Pointer transform = EulerTransformType::New();
+    transform->SetRotation(0.05 * ( r + 1 ), -0.03, 0.02 * r);
+    EulerTransformType::OutputVectorType translation;
+    translation[0] = 2.0 + r;
+    translation[1] = -1.5;
+    translation[2] = 1.0 - r;
+    transform->SetTranslation(translation);
+    movingVolumes.push_back(MakeBlob(transform) );
+    }
+
+  //
+  // Serial reference, two threads per registration
+  //
+  std::vector<itk::BRAINSFitHelper::Pointer> serialHelpers;
+  {
+  const BRAINSUtils::StackPushITKDefaultNumberOfThreads TempDefaultNumberOfThreadsHolder(threadsPerRegistration);
+  for( unsigned int r = 0; r < numberOfRegistrations; ++r )
+    {
+    ImageType::Pointer fixedCopy = ImageType::New();
+    fixedCopy->Graft(fixedVolume);
+    serialHelpers.push_back(MakeHelper(fixedCopy, movingVolumes[r], fixedMask) );
+    serialHelpers.back()->Update();
+    }
+  }
+
+  //
+  // Concurrent registrations, sharing a budget of four threads
+  //
+  IntraSubjectRegistrationTester::Pointer          tester = IntraSubjectRegistrationTester::New();
+  std::vector<IntraSubjectRegistrationTester::TaskType> tasks;
+  for( unsigned int r = 0; r < numberOfRegistrations; ++r )
+    {
+    ImageType::Pointer fixedCopy = ImageType::New();
+    fixedCopy->Graft(fixedVolume);
+
+    IntraSubjectRegistrationTester::TaskType task;
+    task.Helper = MakeHelper(fixedCopy, movingVolumes[r], fixedMask);
+    task.Modality = "T1";
+    task.TransformIndex = r;
+    tasks.push_back(task);
+    }
+  {
+  const BRAINSUtils::StackPushITKDefaultNumberOfThreads TempDefaultNumberOfThreadsHolder(
+    numberOfRegistrations * threadsPerRegistration);
+  tester->Run(tasks);
+  }
+
+  int failures = 0;
+  for( unsigned int r = 0; r < numberOfRegistrations; ++r )
+    {
+    const itk::BRAINSFitHelper::CompositeTransformType::ParametersType & serialParameters =
+      serialHelpers[r]->GetCurrentGenericTransform()->GetNthTransform(0)->GetParameters();
+    const itk::BRAINSFitHelper::CompositeTransformType::ParametersType & concurrentParameters =
+      tasks[r].Helper->GetCurrentGenericTransform()->GetNthTransform(0)->GetParameters();
+
+    std::cout << "Registration " << r << ": serial " << serialParameters
+              << ", concurrent " << concurrentParameters << std::endl;
+    if( serialParameters.Size() != concurrentParameters.Size() )
+      {
+      ++failures;
+      continue;
+      }
+    for( unsigned int p = 0; p < serialParameters.Size(); ++p )
+      {
+      if( serialParameters[p] != concurrentParameters[p] )
+        {
+        ++failures;
+        }
+      }
+    }
+
+  if( failures != 0 )
+    {
+    std::cerr << failures << " transform parameters differ between the serial and the concurrent runs" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "Test PASSED" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -43,6 +43,8 @@
 #include "itkImage.h"
 #include "itkObject.h"
 #include "itkNaryAddImageFilter.h"
+#include "itkMultiThreader.h"
+#include "itkSimpleFastMutexLock.h"
 
 #include <vector>
 
@@ -279,7 +281,41 @@ public:
   void Update();
 
 protected:
+  /** One registration of an intra subject image to the key image. The
+   * resulting transform goes to
+   * m_IntraSubjectTransforms[Modality][TransformIndex]. */
+  struct IntraSubjectRegistrationTask
+    {
+    itk::BRAINSFitHelper::Pointer Helper;
+    std::string                   Modality;
+    size_t                        TransformIndex;
+    std::string                   TransformFileName;
+    };
+
+  struct IntraSubjectRegistrationThreadStruct
+    {
+    std::vector<IntraSubjectRegistrationTask> * Tasks;
+    size_t                                      NextTask;
+    bool                                        ExceptionCaught;
+    itk::ExceptionObject                        Exception;
+    std::string                                 FailedModality;
+    itk::SimpleFastMutexLock                    Lock;
+    };
+
   void RegisterIntraSubjectImages(void);
+
+  /** Run the registrations concurrently, sharing the default number of
+   * threads between them. */
+  void RunIntraSubjectRegistrations(std::vector<IntraSubjectRegistrationTask> & registrationTasks);
+
+  static ITK_THREAD_RETURN_TYPE IntraSubjectRegistrationThreaderCallback(void *arg);
+
+  /** Keeps a copy of the first exception thrown by a registration, as a plain
+   * itk::ExceptionObject, for RunIntraSubjectRegistrations() to report. */
+  static void KeepFirstIntraSubjectRegistrationException(IntraSubjectRegistrationThreadStruct *str,
+                                                         size_t taskIndex,
+                                                         const itk::ExceptionObject & exception);
+
   void AverageIntraSubjectRegisteredImages(void);
   void RegisterAtlasToSubjectImages(void);
 
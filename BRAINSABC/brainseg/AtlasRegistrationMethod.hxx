@@ -40,8 +40,10 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 
 #include "itkBRAINSROIAutoImageFilter.h"
+#include "BRAINSThreadControl.h"
 
 itk::Transform<double, 3, 3>::Pointer MakeRigidIdentity(void)
 {
@@ -145,6 +147,14 @@ AtlasRegistrationMethod<TOutputPixel, TProbabilityPixel>
 
   muLogMacro(<< "Register Intra subject images" << std::endl);
 
+  //
+  // The registrations are configured here, in the order of the input lists,
+  // and run concurrently by RunIntraSubjectRegistrations(). Each one only
+  // leaves a placeholder in m_IntraSubjectTransforms, which is filled in the
+  // same order once all of them are done.
+  //
+  std::vector<IntraSubjectRegistrationTask> registrationTasks;
+
   int i = 0;
   for(MapOfFloatImageVectors::iterator mapOfModalImageListsIt = this->m_IntraSubjectOriginalImageList.begin();
       mapOfModalImageListsIt != this->m_IntraSubjectOriginalImageList.end();
@@ -196,8 +206,12 @@ AtlasRegistrationMethod<TOutputPixel, TProbabilityPixel>
         intraSubjectRegistrationHelper->SetTranslationScale(1000);
         intraSubjectRegistrationHelper->SetReproportionScale(1.0);
         intraSubjectRegistrationHelper->SetSkewScale(1.0);
-        // Register each intrasubject image mode to first image
-        intraSubjectRegistrationHelper->SetFixedVolume(this->GetModifiableKeySubjectImage() );
+        // Register each intrasubject image mode to first image. Every
+        // registration gets its own image object sharing the pixels of the key
+        // image, so that concurrent pipelines do not update the same one.
+        InternalImagePointer fixedVolume = InternalImageType::New();
+        fixedVolume->Graft( this->GetModifiableKeySubjectImage() );
+        intraSubjectRegistrationHelper->SetFixedVolume( fixedVolume );
         // TODO: Find way to turn on histogram equalization for same mode images
         const int dilateSize = 15;
         intraSubjectRegistrationHelper->SetMovingVolume((*intraImIt).GetPointer());
@@ -345,15 +359,14 @@ AtlasRegistrationMethod<TOutputPixel, TProbabilityPixel>
           muLogMacro( << __FILE__ << " " << __LINE__ << " "  <<  std::endl );
           IntraSubjectRegistration++;
           }
-        intraSubjectRegistrationHelper->Update();
-        const unsigned int actualIterations = intraSubjectRegistrationHelper->GetActualNumberOfIterations();
-        muLogMacro( << "Registration tool " << actualIterations << " iterations." << std::endl );
-        GenericTransformType::Pointer p =
-          intraSubjectRegistrationHelper->GetCurrentGenericTransform()->GetNthTransform(0);
-        this->m_IntraSubjectTransforms[mapOfModalImageListsIt->first].push_back(p);
-        // Write out intermodal matricies
-        muLogMacro(<< "Writing " << (*isNamesIt) << "." << std::endl);
-        itk::WriteTransformToDisk<double, float>(p, (*isNamesIt));
+
+        IntraSubjectRegistrationTask task;
+        task.Helper = intraSubjectRegistrationHelper;
+        task.Modality = mapOfModalImageListsIt->first;
+        task.TransformIndex = this->m_IntraSubjectTransforms[mapOfModalImageListsIt->first].size();
+        task.TransformFileName = (*isNamesIt);
+        registrationTasks.push_back(task);
+        this->m_IntraSubjectTransforms[mapOfModalImageListsIt->first].push_back(ITK_NULLPTR);
         }
       ++currModeImageListIt;
       ++isNamesIt;
@@ -361,6 +374,149 @@ AtlasRegistrationMethod<TOutputPixel, TProbabilityPixel>
       }
     i++;
     }
+
+  this->RunIntraSubjectRegistrations(registrationTasks);
+
+  for( typename std::vector<IntraSubjectRegistrationTask>::const_iterator taskIt = registrationTasks.begin();
+       taskIt != registrationTasks.end();
+       ++taskIt )
+    {
+    const unsigned int actualIterations = taskIt->Helper->GetActualNumberOfIterations();
+    muLogMacro( << "Registration tool " << actualIterations << " iterations." << std::endl );
+    GenericTransformType::Pointer p =
+      taskIt->Helper->GetCurrentGenericTransform()->GetNthTransform(0);
+    this->m_IntraSubjectTransforms[taskIt->Modality][taskIt->TransformIndex] = p;
+    // Write out intermodal matricies
+    muLogMacro(<< "Writing " << taskIt->TransformFileName << "." << std::endl);
+    itk::WriteTransformToDisk<double, float>(p, taskIt->TransformFileName);
+    }
+}
+
+template <class TOutputPixel, class TProbabilityPixel>
+void
+AtlasRegistrationMethod<TOutputPixel, TProbabilityPixel>
+::RunIntraSubjectRegistrations(std::vector<IntraSubjectRegistrationTask> & registrationTasks)
+{
+  if( registrationTasks.empty() )
+    {
+    return;
+    }
+
+  //
+  // The registrations are independent, and each one does not scale much past
+  // a few threads. The thread budget, as set by
+  // StackPushITKDefaultNumberOfThreads from the command line or NSLOTS, is
+  // shared between as many concurrent registrations as it can feed.
+  //
+  // The transforms can differ numerically from a run with the whole budget
+  // per registration: the threaded metric sums partial sums per thread, and
+  // their rounding depends on the number of threads of each registration.
+  // With the same number of threads per registration, running them
+  // concurrently gives the same transforms as running them one after the
+  // other.
+  //
+  const unsigned int threadBudget =
+    std::max( itk::MultiThreader::GetGlobalDefaultNumberOfThreads(), static_cast<itk::ThreadIdType>( 1 ) );
+  const unsigned int numberOfConcurrentRegistrations =
+    std::min( static_cast<unsigned int>( registrationTasks.size() ), threadBudget );
+  const unsigned int threadsPerRegistration = threadBudget / numberOfConcurrentRegistrations;
+
+  muLogMacro(<< "Running " << registrationTasks.size() << " intra subject registrations, "
+             << numberOfConcurrentRegistrations << " at a time with "
+             << threadsPerRegistration << " threads each." << std::endl);
+
+  IntraSubjectRegistrationThreadStruct str;
+  str.Tasks = &registrationTasks;
+  str.NextTask = 0;
+  str.ExceptionCaught = false;
+
+  {
+  // The filters and metrics created by each registration take their number
+  // of threads from the global default, until the registrations are done.
+  const BRAINSUtils::StackPushITKDefaultNumberOfThreads TempDefaultNumberOfThreadsHolder(threadsPerRegistration);
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads( numberOfConcurrentRegistrations );
+  threader->SetSingleMethod( IntraSubjectRegistrationThreaderCallback, &str );
+  threader->SingleMethodExecute();
+  }
+
+  if( str.ExceptionCaught )
+    {
+    itkExceptionMacro(<< "Intra subject registration of a " << str.FailedModality << " image failed: "
+                      << str.Exception.GetDescription() << " (" << str.Exception.GetFile()
+                      << ":" << str.Exception.GetLine() << ")");
+    }
+}
+
+template <class TOutputPixel, class TProbabilityPixel>
+void
+AtlasRegistrationMethod<TOutputPixel, TProbabilityPixel>
+::KeepFirstIntraSubjectRegistrationException(IntraSubjectRegistrationThreadStruct *str, size_t taskIndex,
+                                             const itk::ExceptionObject & exception)
+{
+  str->Lock.Lock();
+  if( !str->ExceptionCaught )
+    {
+    str->ExceptionCaught = true;
+    str->Exception = exception;
+    str->FailedModality = ( *str->Tasks )[taskIndex].Modality;
+    }
+  str->Lock.Unlock();
+}
+
+template <class TOutputPixel, class TProbabilityPixel>
+ITK_THREAD_RETURN_TYPE
+AtlasRegistrationMethod<TOutputPixel, TProbabilityPixel>
+::IntraSubjectRegistrationThreaderCallback(void *arg)
+{
+  IntraSubjectRegistrationThreadStruct * str =
+    (IntraSubjectRegistrationThreadStruct *)( ( (itk::MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+  //
+  // Each thread takes the next registration that has not been started, until
+  // none is left. Exceptions can not cross the thread boundary; the first one
+  // is kept and reported by RunIntraSubjectRegistrations(), and no new
+  // registration is started after it.
+  //
+  while( true )
+    {
+    str->Lock.Lock();
+    const size_t taskIndex = str->NextTask++;
+    const bool   stop = str->ExceptionCaught || ( taskIndex >= str->Tasks->size() );
+    str->Lock.Unlock();
+
+    if( stop )
+      {
+      break;
+      }
+
+    try
+      {
+      ( *str->Tasks )[taskIndex].Helper->Update();
+      }
+    catch( itk::ExceptionObject & excp )
+      {
+      KeepFirstIntraSubjectRegistrationException( str, taskIndex,
+                                                  itk::ExceptionObject( excp.GetFile(), excp.GetLine(),
+                                                                        excp.GetDescription(),
+                                                                        excp.GetLocation() ) );
+      }
+    catch( std::exception & excp )
+      {
+      KeepFirstIntraSubjectRegistrationException( str, taskIndex,
+                                                  itk::ExceptionObject(__FILE__, __LINE__, excp.what(),
+                                                                       ITK_LOCATION) );
+      }
+    catch( ... )
+      {
+      KeepFirstIntraSubjectRegistrationException( str, taskIndex,
+                                                  itk::ExceptionObject(__FILE__, __LINE__, "Unknown exception",
+                                                                       ITK_LOCATION) );
+      }
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
 }
 
 template <class TOutputPixel, class TProbabilityPixel>
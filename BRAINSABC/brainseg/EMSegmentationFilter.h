@@ -34,6 +34,7 @@
 #define __EMSegmentationFilter_h
 
 #include "BRAINSABCUtilities.h"
+#include "KNNClassifier.h"
 #include <map>
 #include <list>
 class AtlasDefinition;
@@ -113,9 +114,6 @@ public:
 
   typedef itk::Transform<double, 3, 3>  GenericTransformType;
 
-  typedef std::vector< FloatingPrecision >                      MeasurementVectorType;
-  typedef itk::Statistics::ListSample< MeasurementVectorType >  SampleType;
-
   itkSetMacro(UseKNN, bool);
   itkGetMacro(UseKNN, bool);
 
@@ -278,6 +276,56 @@ private:
 
   void WriteDebugBlendClippedPriors(const unsigned int CurrentEMIteration) const;
 
+  /** Everything the fused E-step kernel needs, laid out as flat arrays.
+   * The modality averages are stored one contiguous buffer per modality
+   * (structure of arrays), and the class parameters are stored class major. */
+  struct EMPosteriorThreadStruct
+    {
+    const Self *                                   Filter;
+    size_t                                         NumberOfVoxels;
+    unsigned int                                   NumberOfModalities;
+    std::vector<std::vector<float> >               ModalityAverages;
+    std::vector<const ProbabilityImagePixelType *> Priors;
+    std::vector<ProbabilityImagePixelType *>       Posteriors;
+    std::vector<FloatingPrecision>                 Means;
+    std::vector<FloatingPrecision>                 InverseCovariances;
+    std::vector<FloatingPrecision>                 PosteriorScales;
+    };
+
+  /** Computes the Gaussian weighted posterior of every class in one pass
+   * over the intensity data, threaded with the itk::MultiThreader. */
+  void ComputeGaussianPosteriors(const vnl_vector<FloatingPrecision> & PriorScales,
+                                 const ProbabilityImageVectorType & Priors,
+                                 std::vector<RegionStats> & ListOfClassStatistics,
+                                 const MapOfInputImageVectors & IntensityImages,
+                                 ProbabilityImageVectorType & Posteriors);
+
+  static ITK_THREAD_RETURN_TYPE ComputeGaussianPosteriorsThreaderCallback(void *arg);
+
+  /** Flat buffers shared by the kNN posterior threads.  Each thread streams
+   * its own voxel range, queries the classifier for the voxels inside the
+   * non-air mask, and writes the class likelihoods straight into the
+   * posterior images. */
+  struct KNNPosteriorThreadStruct
+    {
+    const Self *                                   Filter;
+    const KNNClassifier *                          Classifier;
+    unsigned int                                   K;
+    size_t                                         NumberOfVoxels;
+    const ByteImagePixelType *                     Mask;
+    std::vector<const InputImagePixelType *>       Intensities;
+    std::vector<const ProbabilityImagePixelType *> Priors;
+    std::vector<ProbabilityImagePixelType *>       Posteriors;
+    };
+
+  static ITK_THREAD_RETURN_TYPE ComputekNNPosteriorsThreaderCallback(void *arg);
+
+  void ThreadedComputekNNPosteriors(const KNNPosteriorThreadStruct & str,
+                                    const size_t firstVoxel, const size_t lastVoxel) const;
+
+  void ThreadedComputeGaussianPosteriors(const EMPosteriorThreadStruct & str,
+                                         const size_t firstVoxel, const size_t lastVoxel) const;
+
   void WriteDebugWarpedAtlasPriors(const unsigned int CurrentEMIteration) const;
 
   void WriteDebugWarpedAtlasImages(const unsigned int CurrentEMIteration) const;
@@ -295,22 +343,12 @@ private:
   typename TInputImage::Pointer
   NormalizeInputIntensityImage(const typename TInputImage::Pointer inputImage);
 
-  void
-  kNNCore( SampleType * trainMatrix,
-           const vnl_vector<FloatingPrecision> & labelVector,
-           const vnl_matrix<FloatingPrecision> & testMatrix,
-           vnl_matrix<FloatingPrecision> & liklihoodMatrix,
-           unsigned int K );
-
-  typename TProbabilityImage::Pointer
-  assignVectorToImage(const typename TProbabilityImage::Pointer prior,
-                      const vnl_vector<FloatingPrecision> & vector);
-
   std::vector<typename TProbabilityImage::Pointer>
   ComputekNNPosteriors(const ProbabilityImageVectorType & Priors,
                         const MapOfInputImageVectors & IntensityImages,
                         ByteImagePointer & CleanedLabels,
-                        const IntVectorType & labelClasses);
+                        const IntVectorType & labelClasses,
+                        const ByteImagePointer & nonAirRegion);
 
   typename TProbabilityImage::Pointer
   ComputeOnePosterior(const FloatingPrecision priorScale,
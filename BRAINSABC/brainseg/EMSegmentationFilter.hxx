@@ -24,6 +24,7 @@
 #include <sstream>
 #include <iomanip>
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 
@@ -69,9 +70,6 @@
 
 #include "vnl_index_sort.h"
 #include "itkVector.h"
-#include "itkListSample.h"
-#include "itkKdTree.h"
-#include "itkKdTreeGenerator.h"
 #include "itkImageRandomNonRepeatingConstIteratorWithIndex.h"
 
 static const FloatingPrecision KNN_InclusionThreshold = 0.85F;
@@ -122,124 +120,19 @@ EMSegmentationFilter<TInputImage, TProbabilityImage>
   return outputImage;
 }
 
-template <class TInputImage, class TProbabilityImage>
-void
-EMSegmentationFilter<TInputImage, TProbabilityImage>
-::kNNCore( SampleType * trainSampleSet,
-          const vnl_vector<FloatingPrecision> & labelVector,
-          const vnl_matrix<FloatingPrecision> & testMatrix,
-          vnl_matrix<FloatingPrecision> & liklihoodMatrix,
-          unsigned int K )
-{
-  unsigned int numClasses = labelVector.max_value() + 1; // index starts from zero
-  unsigned int numTraining = trainSampleSet->Size(); // number of training data
-  unsigned int numTest = testMatrix.rows(); // number of test data
-  unsigned int numFeatures = testMatrix.columns(); // number of features
-
-    // represent each class label as an array
-  vnl_matrix<FloatingPrecision> localLabels(numTraining, numClasses, 0);
-  for( unsigned int iTrain = 0; iTrain < numTraining; ++iTrain )
-    {
-    localLabels( iTrain, labelVector(iTrain) ) = 1;
-    }
-
-  // Create KdTree for train samples
-  typedef itk::Statistics::KdTreeGenerator< SampleType > TreeGeneratorType;
-  typedef TreeGeneratorType::KdTreeType                  TreeType;
-  TreeGeneratorType::Pointer treeGenerator = TreeGeneratorType::New();
-  treeGenerator->SetSample( trainSampleSet );
-  treeGenerator->SetBucketSize( 16 );
-  treeGenerator->Update();
-
-  TreeType::Pointer tree = treeGenerator->GetOutput();
-
-  // Compute Likelihood matrix
-  for( unsigned int iTest = 0; iTest < numTest; ++iTest ) ///////
-    {
-    // each test case is a query point
-    MeasurementVectorType queryPoint;
-    for(unsigned int i=0; i<numFeatures; ++i)
-       {
-       queryPoint.push_back( testMatrix(iTest,i) );
-       }
-
-    // compute the distances
-    typename TreeType::InstanceIdentifierVectorType neighbors;
-    std::vector<double> distances;
-    tree->Search( queryPoint, K, neighbors, distances );
-
-    // Now we should find K labels correspondence to K neighbors
-    vnl_matrix<FloatingPrecision> neighborLabels( K, numClasses);
-    // Weight vector
-    vnl_matrix<FloatingPrecision> weights(1,K,0);
-    FloatingPrecision sumOfWeights = 0;
-
-    for( unsigned int n = 0; n < K; ++n )
-      {
-      // Labels of the K neighbors
-      neighborLabels.set_row( n, localLabels.get_row( neighbors[n] ) );
-      //  Compute Weights and sum of weights
-      FloatingPrecision distSqr = pow( distances[n], 2);
-      if( distSqr == 0 )
-        {
-        weights(0,n) = 1; // avoids inf weights
-        }
-      else
-        {
-        weights(0,n) = 1/distSqr;
-        }
-      sumOfWeights += weights(0,n);
-      }
-    weights = weights / sumOfWeights;
-
-    vnl_matrix<FloatingPrecision> likelihoodRow = weights * neighborLabels; // a 1xC vector
-    liklihoodMatrix.set_row(iTest, likelihoodRow.get_row(0) );
-    } // end of main loop
-  muLogMacro(<< "\n--------------------------------" << std::endl);
-  muLogMacro(<< "LiklihoodMatrix is calculated: [ " << liklihoodMatrix.rows() << " x " << liklihoodMatrix.cols() << " ]" << std::endl);
-  muLogMacro(<< "--------------------------------" << std::endl);
-}
-
-template <class TInputImage, class TProbabilityImage>
-typename TProbabilityImage::Pointer
-EMSegmentationFilter<TInputImage, TProbabilityImage>
-::assignVectorToImage(const typename TProbabilityImage::Pointer prior,
-                      const vnl_vector<FloatingPrecision> & vector)
-{
-  typename TProbabilityImage::Pointer post = TProbabilityImage::New();
-  post->CopyInformation(prior);
-  post->SetRegions(prior->GetLargestPossibleRegion() );
-  post->Allocate();
-
-  const typename TProbabilityImage::SizeType size = post->GetLargestPossibleRegion().GetSize();
-
-  unsigned int vindex = 0;
-  for( LOOPITERTYPE kk = 0; kk < (LOOPITERTYPE)size[2]; kk++ )
-    {
-    for( LOOPITERTYPE jj = 0; jj < (LOOPITERTYPE)size[1]; jj++ )
-      {
-      for( LOOPITERTYPE ii = 0; ii < (LOOPITERTYPE)size[0]; ii++ )
-        {
-        const typename TProbabilityImage::IndexType currIndex = {{ii, jj, kk}};
-        post->SetPixel(currIndex, vector(vindex) );
-        ++vindex;
-        }
-      }
-    }
-  return post;
-}
-
 template <class TInputImage, class TProbabilityImage>
 typename EMSegmentationFilter<TInputImage, TProbabilityImage>::ProbabilityImageVectorType
 EMSegmentationFilter<TInputImage, TProbabilityImage>
 ::ComputekNNPosteriors(const ProbabilityImageVectorType & Priors,
                        const MapOfInputImageVectors & intensityImages, // input corrected images
                        ByteImagePointer & labelsImage,
-                       const IntVectorType & labelClasses)
+                       const IntVectorType & labelClasses,
+                       const ByteImagePointer & nonAirRegion)
 
 {
-  // Phase 1: create train sample set, label vector, and the test matrix
-  // Phase 2: pass the above vectors to the "dokNNClassification" function
+  // Phase 1: create the train sample set by sampling the label image
+  // Phase 2: classify every non-air voxel with a threaded search of the
+  //          training set, writing the likelihoods into the posteriors
 
   const unsigned int numClasses = Priors.size();
   muLogMacro(<< "Number of posteriors classes (label codes): " << numClasses << "(" << labelClasses.size() << ")" << std::endl);
@@ -313,175 +206,191 @@ EMSegmentationFilter<TInputImage, TProbabilityImage>
       }
     }
 
-  vnl_vector<FloatingPrecision> labelVector(numberOfSamples);
-  muLogMacro(<< "\n* Computing the label vector with " << numberOfSamples << " samples..." << std::endl);
-
   // set kNN train sample set. it has #numberOfSamples training cases with (#numOfInputImages + #numClasses) features
-  muLogMacro(<< "\n* Computing train matrix as a list of samples" << std::endl);
-  SampleType::Pointer trainSampleSet = SampleType::New();
-  trainSampleSet->SetMeasurementVectorSize( numOfInputImages + labelClasses.size() ); // Feature space has 2+15 elements
-
-   // NOW PROCESS ALL ELEMENTS OF THE std::Map SampledLabelsMap
-   unsigned int rowIndx = 0;
-   for( typename LabelMapSamplesType::const_iterator it = SampledLabelsMap.begin(); it != SampledLabelsMap.end(); ++it )
-     {
-     for( typename IndexVectorType::const_iterator vit = it->second.begin(); vit != it->second.end(); ++vit )
-       {
-       // Fill label vector with the (index corresponding to) label code of the sampled voxel
-       const unsigned int currLabelIndex = reverseLabelToIndex[it->first];
-       labelVector(rowIndx) = currLabelIndex;
-       ++rowIndx;
-       if( rowIndx > numberOfSamples )
-         {
-         itkGenericExceptionMacro( << "Error: label vector size cannot be bigger than the number of samples: "
-                                   << numberOfSamples << std::endl );
-         }
-
-       // Fill the corresponding row of the train matrix with the values of feature space in the sampled voxel
-       MeasurementVectorType mv;
-       for( typename InputImageVectorType::const_iterator inIt = inputImagesVector.begin();
-            inIt != inputImagesVector.end();
-            ++inIt ) // First features are from input images (usually two T1 and T2 images)
-         {
-         mv.push_back( inIt->GetPointer()->GetPixel( *vit ) );
-         }
-       for( unsigned int c_indx = 0; c_indx<labelClasses.size() ; ++c_indx) // Add 15 more features from posteriors
-         {
-         //mv.push_back( Priors[c_indx]->GetPixel( *vit ) );
-         mv.push_back( (  Priors[c_indx]->GetPixel( *vit ) > 0.01 ) ? 1 : 0 );
-         }
-       trainSampleSet->PushBack( mv );
-       }
-     }
-
-  if( rowIndx != numberOfSamples )
-    {
-    muLogMacro(<<"\nNumber of valid samples found: " << rowIndx << std::endl);
-    muLogMacro(<<"\nResize the labeling vector:" << std::endl);
-
-    labelVector = labelVector.extract(rowIndx,0);
-    muLogMacro(<<"New size of label vector: " << labelVector.size() << std::endl);
-    }
-  else
-    {
-    muLogMacro(<<"Size of created label vector: " << labelVector.size() << std::endl);
-    }
-  muLogMacro(<< "\nTrain matrix is created using " << trainSampleSet->Size() << " samples, ");
-  muLogMacro(<< "having feature space size of: " << trainSampleSet->GetMeasurementVectorSize() << std::endl);
+  muLogMacro(<< "\n* Computing the training set with " << numberOfSamples << " samples..." << std::endl);
+  const unsigned int numFeatures = numOfInputImages + labelClasses.size(); // Feature space has 2+15 elements
+  KNNClassifier      classifier(numFeatures, numClasses);
+  std::vector<float> features(numFeatures);
 
-  // DEBUGGING: Write csv file
-  {
-  const bool generateLogScript = true; //HACK:  SHOULD BE FALSE EVENTUALLY
-  if( generateLogScript )
+  // NOW PROCESS ALL ELEMENTS OF THE std::Map SampledLabelsMap
+  for( typename LabelMapSamplesType::const_iterator it = SampledLabelsMap.begin(); it != SampledLabelsMap.end(); ++it )
     {
-    muLogMacro(<< "\nWrite training labels csv file ..." << std::endl);
-    std::stringstream csvFileOfSampleLabels;
-    csvFileOfSampleLabels << "#T1_value, T2_value, ";
-    for (unsigned int cln_i = 0; cln_i < labelClasses.size(); ++cln_i)
+    // The training label is the (index corresponding to) label code of the sampled voxel
+    const unsigned int currLabelIndex = reverseLabelToIndex[it->first];
+    for( typename IndexVectorType::const_iterator vit = it->second.begin(); vit != it->second.end(); ++vit )
       {
-      csvFileOfSampleLabels << this->m_PriorNames[ cln_i ] << "_value, ";
-      }
-    csvFileOfSampleLabels << "LableCode, ClassName" << std::endl;
-    for( SampleType::InstanceIdentifier i = 0; i < rowIndx; ++i )
-      {
-      SampleType::MeasurementVectorType smv = trainSampleSet->GetMeasurementVector(i);
-      copy( smv.begin(), smv.end(), std::ostream_iterator<double>(csvFileOfSampleLabels, ",") );
-      csvFileOfSampleLabels << labelClasses( labelVector(i) ) << ",";
-      csvFileOfSampleLabels << this->m_PriorNames[ labelVector(i) ] << std::endl;
+      // First features are from input images (usually two T1 and T2 images)
+      unsigned int colIndex = 0;
+      for( typename InputImageVectorType::const_iterator inIt = inputImagesVector.begin();
+           inIt != inputImagesVector.end();
+           ++inIt, ++colIndex )
+        {
+        features[colIndex] = inIt->GetPointer()->GetPixel( *vit );
+        }
+      for( unsigned int c_indx = 0; c_indx < labelClasses.size(); ++c_indx, ++colIndex ) // Add 15 more features
+                                                                                          // from posteriors
+        {
+        features[colIndex] = ( Priors[c_indx]->GetPixel( *vit ) > 0.01 ) ? 1 : 0;
+        }
+      classifier.AddTrainingSample( &( features[0] ), currLabelIndex );
       }
+    }
+
+  const size_t numTraining = classifier.GetNumberOfTrainingSamples();
+  if( numTraining != numberOfSamples )
+    {
+    muLogMacro(<<"\nNumber of valid samples found: " << numTraining << std::endl);
+    }
+  muLogMacro(<< "\nTrain set is created using " << numTraining << " samples, ");
+  muLogMacro(<< "having feature space size of: " << numFeatures << std::endl);
+
+  // DEBUGGING: Write csv file
+  if( this->m_DebugLevel > 6 )
+    {
+    const std::string fn = this->m_OutputDebugDir + "/trainingLabels.csv";
+    muLogMacro(<< "\nWrite training labels csv file " << fn << " ..." << std::endl);
     std::ofstream csvFile;
-    csvFile.open( "trainingLabels.csv" );
+    csvFile.open( fn.c_str() );
     if( !csvFile.is_open() )
       {
       itkGenericExceptionMacro( << "Error: Can't write label csv file!" << std::endl );
       }
-    csvFile << csvFileOfSampleLabels.str();
-    csvFile.close();
-    }
-  }
-  //////
-
-  // set kNN input test matrix of size : #OfVoxels x #OfInputImages
-  const typename InputImageType::SizeType size = inputImagesVector[0]->GetLargestPossibleRegion().GetSize();
-  unsigned int numOfVoxels = inputImagesVector[0]->GetLargestPossibleRegion().GetNumberOfPixels();
-
-  muLogMacro(<< "\n* Computing test matrix ( " << numOfVoxels << " x " << numOfInputImages + labelClasses.size() << " )" << std::endl);
-  vnl_matrix<FloatingPrecision> testMatrix( numOfVoxels, numOfInputImages+labelClasses.size() );
-
-  unsigned int rowIndex = 0;
-  for( LOOPITERTYPE kk = 0; kk < (LOOPITERTYPE)size[2]; kk++ )
-    {
-    for( LOOPITERTYPE jj = 0; jj < (LOOPITERTYPE)size[1]; jj++ )
+    csvFile << "#T1_value, T2_value, ";
+    for (unsigned int cln_i = 0; cln_i < labelClasses.size(); ++cln_i)
       {
-      for( LOOPITERTYPE ii = 0; ii < (LOOPITERTYPE)size[0]; ii++ )
+      csvFile << this->m_PriorNames[ cln_i ] << "_value, ";
+      }
+    csvFile << "LableCode, ClassName" << std::endl;
+    for( size_t i = 0; i < numTraining; ++i )
+      {
+      for( unsigned int f = 0; f < numFeatures; ++f )
         {
-        const typename InputImageType::IndexType currIndex = {{ii, jj, kk}};
-        unsigned int colIndex = 0;
-        typename ProbabilityImageVectorType::const_iterator inIt = inputImagesVector.begin();
-        while( ( inIt != inputImagesVector.end() ) && ( colIndex < numOfInputImages ) )
-          {
-          testMatrix(rowIndex,colIndex) = inIt->GetPointer()->GetPixel( currIndex ); // set first two cols from T1 and T2
-          ++colIndex;
-          ++inIt;
-          }
-        while( colIndex-numOfInputImages < labelClasses.size() ) // Add 15 more features from posteriors
-          {
-          testMatrix(rowIndex,colIndex) = ( Priors[colIndex-numOfInputImages]->GetPixel( currIndex ) > 0.01 ) ? 1 : 0 ;
-          ++colIndex;
-          }
-        ++rowIndex;
+        csvFile << classifier.GetTrainingFeature(i, f) << ",";
         }
+      const unsigned int currLabelIndex = classifier.GetTrainingLabel(i);
+      csvFile << labelClasses( currLabelIndex ) << ",";
+      csvFile << this->m_PriorNames[ currLabelIndex ] << std::endl;
       }
+    csvFile.close();
     }
+  //////
 
   const unsigned int K = std::min<size_t>(KNN_SamplesPerLabel*0.80, 100); // Number of neighbours
-  // each column of the memberShip matrix contains the voxel values of a posterior image.
-  vnl_matrix<FloatingPrecision> liklihoodMatrix(numOfVoxels, numClasses, 1000);
+  const size_t       numOfVoxels = inputImagesVector[0]->GetLargestPossibleRegion().GetNumberOfPixels();
 
-  muLogMacro(<< "\n* Computing Liklihood Matrix ( " << numOfVoxels << " x " << numClasses << " )" << std::endl);
+  muLogMacro(<< "\n* Computing kNN posteriors ( " << numOfVoxels << " x " << numClasses << " )" << std::endl);
   muLogMacro(<< "Run k-NN algorithm on test data...with the value of \"k\" as: " << K << std::endl);
 
-  this->kNNCore( trainSampleSet, labelVector, testMatrix, liklihoodMatrix, K );
-
-  // For validation
-  if( liklihoodMatrix.max_value() == 1000 )
+  // create posteriors, which the threads fill in directly
+  KNNPosteriorThreadStruct str;
+  str.Filter = this;
+  str.Classifier = &classifier;
+  str.K = K;
+  str.NumberOfVoxels = numOfVoxels;
+  str.Mask = ITK_NULLPTR;
+  if( nonAirRegion.IsNotNull() )
+    {
+    if( nonAirRegion->GetBufferedRegion().GetNumberOfPixels() != numOfVoxels )
+      {
+      itkExceptionMacro(<< "The non-air region does not have the same number of voxels as the input images");
+      }
+    str.Mask = nonAirRegion->GetBufferPointer();
+    }
+  for( typename InputImageVectorType::const_iterator inIt = inputImagesVector.begin();
+       inIt != inputImagesVector.end(); ++inIt )
     {
-    itkGenericExceptionMacro( << "The liklihood matrix is not valid." << std::endl );
+    str.Intensities.push_back( ( *inIt )->GetBufferPointer() );
     }
 
-  // create posteriors
-  muLogMacro(<< "Create posteriors from likelihood matrix..." << std::endl);
   ProbabilityImageVectorType Posteriors;
   Posteriors.resize(numClasses);
-
   for( unsigned int iclass = 0; iclass < numClasses; iclass++ )
     {
-    Posteriors[iclass] = this->assignVectorToImage( Priors[iclass],
-                                                    liklihoodMatrix.get_column(iclass) );
-    /*
-    // Smoothing filter
-    typename SmoothingFilterType::Pointer smoothingFilter = SmoothingFilterType::New();
-    smoothingFilter->SetUseImageSpacingOn();
-    smoothingFilter->SetVariance( vnl_math_sqr( 1 ) );
-    smoothingFilter->SetMaximumError( 0.01 );
-    smoothingFilter->SetInput( Posteriors[iclass] );
-    smoothingFilter->Update();
-
-    Posteriors[iclass] = smoothingFilter->GetOutput();
-    */
+    Posteriors[iclass] = TProbabilityImage::New();
+    Posteriors[iclass]->CopyInformation(Priors[iclass]);
+    Posteriors[iclass]->SetRegions(Priors[iclass]->GetLargestPossibleRegion() );
+    Posteriors[iclass]->Allocate();
+    str.Priors.push_back( Priors[iclass]->GetBufferPointer() );
+    str.Posteriors.push_back( Posteriors[iclass]->GetBufferPointer() );
     }
 
+  this->GetMultiThreader()->SetNumberOfThreads(this->GetNumberOfThreads() );
+  this->GetMultiThreader()->SetSingleMethod(this->ComputekNNPosteriorsThreaderCallback, &str);
+  this->GetMultiThreader()->SingleMethodExecute();
+
   const typename InputImageType::SizeType finalPosteriorSize = Posteriors[0]->GetLargestPossibleRegion().GetSize();
   muLogMacro(<< "Size of return posteriors: " << finalPosteriorSize  << std::endl);
 
-  typedef itk::ImageFileWriter<TProbabilityImage> PostImageWriterType;
-  typename PostImageWriterType::Pointer posetriorwriter = PostImageWriterType::New();
-  posetriorwriter->SetInput(Posteriors[14]);
-  posetriorwriter->SetFileName("DEBUG_WHITE_MATTER.nii.gz");
-  posetriorwriter->Update();
-
   return Posteriors;
 }
+
+template <class TInputImage, class TProbabilityImage>
+ITK_THREAD_RETURN_TYPE
+EMSegmentationFilter<TInputImage, TProbabilityImage>
+::ComputekNNPosteriorsThreaderCallback(void *arg)
+{
+  const itk::ThreadIdType threadId = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->ThreadID;
+  const itk::ThreadIdType threadCount = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->NumberOfThreads;
+
+  const KNNPosteriorThreadStruct *str =
+    (KNNPosteriorThreadStruct *)( ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->UserData);
+
+  // Contiguous, equally sized voxel ranges, one per thread.
+  const size_t voxelsPerThread = ( str->NumberOfVoxels + threadCount - 1 ) / threadCount;
+  const size_t firstVoxel = threadId * voxelsPerThread;
+  const size_t lastVoxel = std::min(firstVoxel + voxelsPerThread, str->NumberOfVoxels);
+  if( firstVoxel < lastVoxel )
+    {
+    str->Filter->ThreadedComputekNNPosteriors(*str, firstVoxel, lastVoxel);
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TInputImage, class TProbabilityImage>
+void
+EMSegmentationFilter<TInputImage, TProbabilityImage>
+::ThreadedComputekNNPosteriors(const KNNPosteriorThreadStruct & str,
+                               const size_t firstVoxel, const size_t lastVoxel) const
+{
+  const unsigned int numOfInputImages = str.Intensities.size();
+  const unsigned int numClasses = str.Posteriors.size();
+  const unsigned int numFeatures = str.Classifier->GetNumberOfFeatures();
+
+  // Voxels outside of the head carry no kNN information, so they get an
+  // uninformative likelihood and are not searched at all.
+  const ProbabilityImagePixelType uniform = 1.0 / numClasses;
+
+  KNNClassifier::NeighborBuffer buffer;
+  std::vector<float>            query(numFeatures);
+  std::vector<double>           likelihoods(numClasses);
+  for( size_t vv = firstVoxel; vv < lastVoxel; ++vv )
+    {
+    if( str.Mask != ITK_NULLPTR && str.Mask[vv] == 0 )
+      {
+      for( unsigned int iclass = 0; iclass < numClasses; ++iclass )
+        {
+        str.Posteriors[iclass][vv] = uniform;
+        }
+      continue;
+      }
+
+    unsigned int colIndex = 0;
+    for( unsigned int m = 0; m < numOfInputImages; ++m, ++colIndex ) // set first two cols from T1 and T2
+      {
+      query[colIndex] = str.Intensities[m][vv];
+      }
+    for( unsigned int c = 0; colIndex < numFeatures; ++c, ++colIndex ) // Add 15 more features from posteriors
+      {
+      query[colIndex] = ( str.Priors[c][vv] > 0.01 ) ? 1 : 0;
+      }
+
+    str.Classifier->Classify( &( query[0] ), str.K, buffer, &( likelihoods[0] ) );
+    for( unsigned int iclass = 0; iclass < numClasses; ++iclass )
+      {
+      str.Posteriors[iclass][vv] = static_cast<ProbabilityImagePixelType>( likelihoods[iclass] );
+      }
+    }
+}
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 template <class TInputImage, class TProbabilityImage>
@@ -1059,108 +968,218 @@ EMSegmentationFilter<TInputImage, TProbabilityImage>
   typename RegionStats::MeanMapType &currMeans,
   const MapOfInputImageVectors & intensityImages)
 {
-  // FOR IPEK & GARY -- this is a stopgap -- even though we use a map
-  // of image lists instead of an image list, we're still computing
-  // ImageList.size() * ImageList.size() covariance.
-  unsigned          numModalities = currMeans.size();
+  std::vector<RegionStats> oneClassStatistics(1);
+  oneClassStatistics[0].m_Covariance = currCovariance;
+  oneClassStatistics[0].m_Means = currMeans;
 
-  const FloatingPrecision detcov = ComputeCovarianceDeterminant(currCovariance);
+  ProbabilityImageVectorType onePrior(1, prior);
+  ProbabilityImageVectorType onePosterior(1);
+  vnl_vector<FloatingPrecision> onePriorScale(1, priorScale);
 
-  // Normalizing constant for the Gaussian
-  const FloatingPrecision denom =
-    vcl_pow(2 * vnl_math::pi, numModalities / 2.0) * vcl_sqrt(detcov) + vnl_math::eps;
-  const FloatingPrecision invdenom = 1.0 / denom;
-  CHECK_NAN(invdenom, __FILE__, __LINE__, "\n  denom:" << denom );
-  const MatrixType invcov = MatrixInverseType(currCovariance);
+  this->ComputeGaussianPosteriors(onePriorScale, onePrior, oneClassStatistics,
+                                  intensityImages, onePosterior);
+  return onePosterior[0];
+}
 
-  typename TProbabilityImage::Pointer post = TProbabilityImage::New();
-  post->CopyInformation(prior);
-  post->SetRegions(prior->GetLargestPossibleRegion() );
-  post->Allocate();
+template <class TInputImage, class TProbabilityImage>
+void
+EMSegmentationFilter<TInputImage, TProbabilityImage>
+::ComputeGaussianPosteriors(const vnl_vector<FloatingPrecision> & PriorScales,
+                            const ProbabilityImageVectorType & Priors,
+                            std::vector<RegionStats> & ListOfClassStatistics,
+                            const MapOfInputImageVectors & IntensityImages,
+                            ProbabilityImageVectorType & Posteriors)
+{
+  const unsigned int numClasses = Priors.size();
+  const unsigned int numModalities = IntensityImages.size();
 
-  const typename TProbabilityImage::SizeType size = post->GetLargestPossibleRegion().GetSize();
+  EMPosteriorThreadStruct str;
+  str.Filter = this;
+  str.NumberOfModalities = numModalities;
+  str.NumberOfVoxels = Priors[0]->GetLargestPossibleRegion().GetNumberOfPixels();
 
-#if defined(LOCAL_USE_OPEN_MP)
-#pragma omp parallel for
-#endif
-  for( LOOPITERTYPE kk = 0; kk < (LOOPITERTYPE)size[2]; kk++ )
+  // Average the images of each modality once, into one contiguous buffer per
+  // modality.  Every class then reuses the same buffers.
+  str.ModalityAverages.resize(numModalities);
+  {
+  unsigned int zz = 0;
+  for( typename MapOfInputImageVectors::const_iterator mapIt = IntensityImages.begin();
+       mapIt != IntensityImages.end(); ++mapIt, ++zz )
+    {
+    std::vector<float> & average = str.ModalityAverages[zz];
+    average.assign(str.NumberOfVoxels, 0.0F);
+    const size_t numCurModality = mapIt->second.size();
+    for( size_t xx = 0; xx < numCurModality; ++xx )
+      {
+      if( mapIt->second[xx]->GetBufferedRegion().GetNumberOfPixels() != str.NumberOfVoxels )
+        {
+        itkExceptionMacro(<< "Intensity image " << mapIt->first << " " << xx
+                          << " does not have the same number of voxels as the priors");
+        }
+      const typename TInputImage::PixelType *intensity = mapIt->second[xx]->GetBufferPointer();
+      for( size_t vv = 0; vv < str.NumberOfVoxels; ++vv )
+        {
+        average[vv] += intensity[vv];
+        }
+      }
+    const float invNumCurModality = 1.0F / static_cast<float>(numCurModality);
+    for( size_t vv = 0; vv < str.NumberOfVoxels; ++vv )
+      {
+      average[vv] *= invNumCurModality;
+      }
+    }
+  }
+
+  // Precompute the inverse covariance and Gaussian normalization of each class
+  str.Priors.resize(numClasses);
+  str.Posteriors.resize(numClasses);
+  str.Means.resize(numClasses * numModalities);
+  str.InverseCovariances.resize(numClasses * numModalities * numModalities);
+  str.PosteriorScales.resize(numClasses);
+  Posteriors.resize(numClasses);
+  for( unsigned int iclass = 0; iclass < numClasses; ++iclass )
     {
-    for( LOOPITERTYPE jj = 0; jj < (LOOPITERTYPE)size[1]; jj++ )
+    const MatrixType & currCovariance = ListOfClassStatistics[iclass].m_Covariance;
+    if( currCovariance.rows() != numModalities || currCovariance.cols() != numModalities )
       {
-      for( LOOPITERTYPE ii = 0; ii < (LOOPITERTYPE)size[0]; ii++ )
+      itkExceptionMacro(<< "Covariance of class " << iclass << " is " << currCovariance.rows()
+                        << "x" << currCovariance.cols() << " but there are "
+                        << numModalities << " modalities");
+      }
+    const FloatingPrecision detcov = ComputeCovarianceDeterminant(currCovariance);
+
+    // Normalizing constant for the Gaussian
+    const FloatingPrecision denom =
+      vcl_pow(2 * vnl_math::pi, numModalities / 2.0) * vcl_sqrt(detcov) + vnl_math::eps;
+    const FloatingPrecision invdenom = 1.0 / denom;
+    CHECK_NAN(invdenom, __FILE__, __LINE__, "\n  denom:" << denom );
+    str.PosteriorScales[iclass] = PriorScales[iclass] * invdenom;
+
+    const MatrixType invcov = MatrixInverseType(currCovariance);
+    std::copy(invcov.begin(), invcov.end(),
+              str.InverseCovariances.begin() + iclass * numModalities * numModalities);
+
+    unsigned int zz = 0;
+    for( typename MapOfInputImageVectors::const_iterator mapIt = IntensityImages.begin();
+         mapIt != IntensityImages.end(); ++mapIt, ++zz )
+      {
+      str.Means[iclass * numModalities + zz] = ListOfClassStatistics[iclass].m_Means[mapIt->first];
+      }
+
+    typename TProbabilityImage::Pointer post = TProbabilityImage::New();
+    post->CopyInformation(Priors[iclass]);
+    post->SetRegions(Priors[iclass]->GetLargestPossibleRegion() );
+    post->Allocate();
+    Posteriors[iclass] = post;
+
+    str.Priors[iclass] = Priors[iclass]->GetBufferPointer();
+    str.Posteriors[iclass] = post->GetBufferPointer();
+    }
+
+  this->GetMultiThreader()->SetNumberOfThreads(this->GetNumberOfThreads() );
+  this->GetMultiThreader()->SetSingleMethod(this->ComputeGaussianPosteriorsThreaderCallback, &str);
+  this->GetMultiThreader()->SingleMethodExecute();
+}
+
+template <class TInputImage, class TProbabilityImage>
+ITK_THREAD_RETURN_TYPE
+EMSegmentationFilter<TInputImage, TProbabilityImage>
+::ComputeGaussianPosteriorsThreaderCallback(void *arg)
+{
+  const itk::ThreadIdType threadId = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->ThreadID;
+  const itk::ThreadIdType threadCount = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->NumberOfThreads;
+
+  const EMPosteriorThreadStruct *str =
+    (EMPosteriorThreadStruct *)( ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->UserData);
+
+  // Contiguous, equally sized voxel ranges, one per thread.
+  const size_t voxelsPerThread = ( str->NumberOfVoxels + threadCount - 1 ) / threadCount;
+  const size_t firstVoxel = threadId * voxelsPerThread;
+  const size_t lastVoxel = std::min(firstVoxel + voxelsPerThread, str->NumberOfVoxels);
+  if( firstVoxel < lastVoxel )
+    {
+    str->Filter->ThreadedComputeGaussianPosteriors(*str, firstVoxel, lastVoxel);
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TInputImage, class TProbabilityImage>
+void
+EMSegmentationFilter<TInputImage, TProbabilityImage>
+::ThreadedComputeGaussianPosteriors(const EMPosteriorThreadStruct & str,
+                                    const size_t firstVoxel, const size_t lastVoxel) const
+{
+  // Voxels are processed in small blocks so that the per class work is a set
+  // of unit stride loops over the block, which the compiler can vectorize,
+  // and so that the modality data of a block stays in cache for all classes.
+  const size_t       blockSize = 256;
+  const unsigned int numModalities = str.NumberOfModalities;
+  const size_t       numClasses = str.Priors.size();
+
+  std::vector<FloatingPrecision> diffBuffer(numModalities * blockSize);
+  std::vector<FloatingPrecision> mahaloBuffer(blockSize);
+  FloatingPrecision *            mahalo = &( mahaloBuffer[0] );
+
+  for( size_t blockStart = firstVoxel; blockStart < lastVoxel; blockStart += blockSize )
+    {
+    const size_t blockLength = std::min(blockSize, lastVoxel - blockStart);
+    for( size_t iclass = 0; iclass < numClasses; ++iclass )
+      {
+      const FloatingPrecision *mean = &( str.Means[iclass * numModalities] );
+      const FloatingPrecision *invcov = &( str.InverseCovariances[iclass * numModalities * numModalities] );
+      for( unsigned int ichan = 0; ichan < numModalities; ++ichan )
         {
-        const typename TProbabilityImage::IndexType currIndex = {{ii, jj, kk}};
-        // At a minimum, every class has at least a 0.001% chance of being
-        // true no matter what.
-        // I realize that this small value makes the priors equal slightly
-        // larger than 100%, but everything
-        // is renormalized anyway, so it is not really that big of a deal as
-        // long as the main priors for
-        // the desired class is significantly higher than 1%.
-        const typename TProbabilityImage::PixelType minPriorValue = 0.0;
-        const typename TProbabilityImage::PixelType priorValue = (prior->GetPixel(currIndex) + minPriorValue);
-        // MatrixType X(numModalities, 1);
-        // {
-        // for(typename RegionStats::MeanMapType::const_iterator mapIt = currMeans.begin();
-        //     mapIt != currMeans.end(); ++mapIt)
-        //   {
-        //   for(typename RegionStats::VectorType::const_iterator vecIt = mapIt->second.begin();
-        //       vecIt != mapIt->second.end(); ++vecIt, ++ichan)
-        //     {
-        //     X(ichan, 0) =
-        //       tmpIntensityImages[ichan]->GetPixel(currIndex) - (*vecIt);
-        //     }
-        //   }
-        // }
-
-        MatrixType X(numModalities, 1);
-        unsigned long zz = 0;
-        for(typename MapOfInputImageVectors::const_iterator mapIt = intensityImages.begin();
-            mapIt != intensityImages.end(); ++mapIt, ++zz)
+        const float *           x = &( str.ModalityAverages[ichan][blockStart] );
+        FloatingPrecision *     diff = &( diffBuffer[ichan * blockSize] );
+        const FloatingPrecision currMean = mean[ichan];
+        for( size_t vv = 0; vv < blockLength; ++vv )
           {
-          double curAvg(0.0);
-          const double curMean = currMeans[mapIt->first];
-          const double numCurModality = static_cast<double>(mapIt->second.size());
-          for(unsigned xx = 0; xx < numCurModality; ++xx)
-            {
-            curAvg += (mapIt->second[xx]->GetPixel(currIndex) - curMean);
-            }
-          X(zz,0) = curAvg / numCurModality;
+          diff[vv] = x[vv] - currMean;
           }
+        }
 
-        const MatrixType  Y = invcov * X;
-        FloatingPrecision mahalo = 0.0;
-        for(unsigned int ichan = 0; ichan < numModalities; ichan++ )
+      // mahalo = X^T * invcov * X, accumulated one matrix element at a time
+      std::fill(mahalo, mahalo + blockLength, 0.0);
+      for( unsigned int ichan = 0; ichan < numModalities; ++ichan )
+        {
+        const FloatingPrecision *diffI = &( diffBuffer[ichan * blockSize] );
+        const FloatingPrecision  diagonal = invcov[ichan * numModalities + ichan];
+        for( size_t vv = 0; vv < blockLength; ++vv )
           {
-          const FloatingPrecision & currVal = X(ichan, 0) * Y(ichan, 0);
-          CHECK_NAN(currVal, __FILE__, __LINE__, "\n  currIndex: " << currIndex
-                    << "\n  mahalo: " << mahalo
-                    << "\n  ichan: " << ichan
-                    << "\n  invcov: " << invcov
-                    << "\n  X:  " << X
-                    << "\n  Y:  " << Y );
-          mahalo += currVal;
+          mahalo[vv] += diagonal * diffI[vv] * diffI[vv];
           }
+        for( unsigned int jchan = ichan + 1; jchan < numModalities; ++jchan )
+          {
+          const FloatingPrecision *diffJ = &( diffBuffer[jchan * blockSize] );
+          const FloatingPrecision  offDiagonal =
+            invcov[ichan * numModalities + jchan] + invcov[jchan * numModalities + ichan];
+          for( size_t vv = 0; vv < blockLength; ++vv )
+            {
+            mahalo[vv] += offDiagonal * diffI[vv] * diffJ[vv];
+            }
+          }
+        }
 
-        // Note:  This is the maximum likelyhood estimate as described in
-        // formula at bottom of
-        //       http://en.wikipedia.org/wiki/Maximum_likelihood_estimation
-        const FloatingPrecision likelihood = vcl_exp(-0.5 * mahalo) * invdenom;
-
-        const typename TProbabilityImage::PixelType currentPosterior =
-          static_cast<typename TProbabilityImage::PixelType>( (priorScale * priorValue * likelihood) );
-        CHECK_NAN(currentPosterior, __FILE__, __LINE__, "\n  currIndex: " << currIndex
-                  << "\n  priorScale: " << priorScale << "\n  priorValue: " << priorValue
-                  << "\n  likelihood: " << likelihood
-                  << "\n  mahalo: " << mahalo
-                  << "\n  invcov: " << invcov
-                  << "\n  X:  " << X
-                  << "\n  Y:  " << Y );
-        post->SetPixel(currIndex, currentPosterior);
+      // Note:  This is the maximum likelyhood estimate as described in
+      // formula at bottom of
+      //       http://en.wikipedia.org/wiki/Maximum_likelihood_estimation
+      const FloatingPrecision          posteriorScale = str.PosteriorScales[iclass];
+      const ProbabilityImagePixelType *prior = str.Priors[iclass] + blockStart;
+      ProbabilityImagePixelType *      post = str.Posteriors[iclass] + blockStart;
+      for( size_t vv = 0; vv < blockLength; ++vv )
+        {
+        post[vv] = static_cast<ProbabilityImagePixelType>( posteriorScale * prior[vv]
+                                                           * vcl_exp(-0.5 * mahalo[vv]) );
+        }
+      for( size_t vv = 0; vv < blockLength; ++vv )
+        {
+        CHECK_NAN(post[vv], __FILE__, __LINE__, "\n  voxel: " << blockStart + vv
+                  << "\n  iclass: " << iclass
+                  << "\n  posteriorScale: " << posteriorScale << "\n  priorValue: " << prior[vv]
+                  << "\n  mahalo: " << mahalo[vv] );
         }
       }
     }
-  return post;
 }
 
 template <class TInputImage, class TProbabilityImage>
@@ -1179,19 +1198,19 @@ EMSegmentationFilter<TInputImage, TProbabilityImage>
   const unsigned int numClasses = Priors.size();
   muLogMacro(<< "Computing EM posteriors at full resolution" << std::endl);
 
-  ProbabilityImageVectorType Posteriors;
-  Posteriors.resize(numClasses);
   for( unsigned int iclass = 0; iclass < numClasses; iclass++ )
     {
     const FloatingPrecision priorScale = PriorWeights[iclass];
     CHECK_NAN(priorScale, __FILE__, __LINE__, "\n  iclass: " << iclass );
+    }
 
-    Posteriors[iclass] = ComputeOnePosterior(priorScale,
-                                             Priors[iclass],
-                                             ListOfClassStatistics[iclass].m_Covariance,
-                                             ListOfClassStatistics[iclass].m_Means,
-                                             IntensityImages);
-    } // end class loop
+  // All classes are computed together in a single pass over the intensities
+  ProbabilityImageVectorType Posteriors;
+  this->ComputeGaussianPosteriors(PriorWeights,
+                                  Priors,
+                                  ListOfClassStatistics,
+                                  IntensityImages,
+                                  Posteriors);
 
   ComputeEMPosteriorsTimer.Stop();
   itk::RealTimeClock::TimeStampType emElapsedTime =
@@ -1258,7 +1277,8 @@ EMSegmentationFilter<TInputImage, TProbabilityImage>
     KNNPosteriors = this->ComputekNNPosteriors(EMPosteriors,
                                             IntensityImages,
                                             dirtyThresholdedLabels,
-                                            priorLabelCodeVector);
+                                            priorLabelCodeVector,
+                                            nonAirRegion);
     ComputeKNNPosteriorsTimer.Stop();
     itk::RealTimeClock::TimeStampType knnElapsedTime = ComputeKNNPosteriorsTimer.GetTotal();
     muLogMacro(<< "Computing KNN posteriors took " << knnElapsedTime << " " << ComputeKNNPosteriorsTimer.GetUnit() << std::endl);
@@ -0,0 +1,96 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "KNNClassifier.h"
+#include <algorithm>
+#include <stdexcept>
+
+KNNClassifier::KNNClassifier(const unsigned int numberOfFeatures, const unsigned int numberOfClasses) :
+  m_NumberOfFeatures(numberOfFeatures),
+  m_NumberOfClasses(numberOfClasses),
+  m_Features(numberOfFeatures),
+  m_Labels()
+{
+}
+
+void
+KNNClassifier::AddTrainingSample(const float *features, const unsigned int classIndex)
+{
+  if( classIndex >= m_NumberOfClasses )
+    {
+    throw std::out_of_range("KNNClassifier: training class index out of range");
+    }
+  for( unsigned int f = 0; f < m_NumberOfFeatures; ++f )
+    {
+    m_Features[f].push_back(features[f]);
+    }
+  m_Labels.push_back(classIndex);
+}
+
+void
+KNNClassifier::Classify(const float *query, const unsigned int K,
+                        NeighborBuffer & buffer, double *likelihoods) const
+{
+  const size_t numTraining = m_Labels.size();
+
+  std::fill(likelihoods, likelihoods + m_NumberOfClasses, 0.0);
+  if( numTraining == 0 || K == 0 )
+    {
+    return;
+    }
+
+  // Squared distances to all training samples, one feature at a time so
+  // that the inner loop is unit stride over the samples.
+  buffer.m_SquaredDistances.assign(numTraining, 0.0F);
+  float *distances = &( buffer.m_SquaredDistances[0] );
+  for( unsigned int f = 0; f < m_NumberOfFeatures; ++f )
+    {
+    const float  q = query[f];
+    const float *train = &( m_Features[f][0] );
+    for( size_t s = 0; s < numTraining; ++s )
+      {
+      const float diff = train[s] - q;
+      distances[s] += diff * diff;
+      }
+    }
+
+  buffer.m_Neighbors.resize(numTraining);
+  for( size_t s = 0; s < numTraining; ++s )
+    {
+    buffer.m_Neighbors[s] = std::make_pair(distances[s], static_cast<unsigned int>( s ) );
+    }
+  const size_t numNeighbors = std::min<size_t>(K, numTraining);
+  if( numNeighbors < numTraining )
+    {
+    std::nth_element(buffer.m_Neighbors.begin(), buffer.m_Neighbors.begin() + numNeighbors,
+                     buffer.m_Neighbors.end() );
+    }
+
+  double sumOfWeights = 0.0;
+  for( size_t n = 0; n < numNeighbors; ++n )
+    {
+    const float  distSqr = buffer.m_Neighbors[n].first;
+    const double weight = ( distSqr == 0.0F ) ? 1.0 : 1.0 / distSqr; // avoids inf weights
+    likelihoods[m_Labels[buffer.m_Neighbors[n].second]] += weight;
+    sumOfWeights += weight;
+    }
+  for( unsigned int c = 0; c < m_NumberOfClasses; ++c )
+    {
+    likelihoods[c] /= sumOfWeights;
+    }
+}
@@ -0,0 +1,92 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __KNNClassifier_h
+#define __KNNClassifier_h
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+/** \class KNNClassifier
+ * \brief Distance weighted k nearest neighbor classifier for the small
+ * training sets sampled by EMSegmentationFilter::ComputekNNPosteriors.
+ *
+ * The training features are stored feature major in flat float arrays, and
+ * every query is answered by an exhaustive search.  For a few thousand
+ * training samples this fits in cache, vectorizes, and is faster than a
+ * kd-tree search in the 17 or so dimensions of the BRAINSABC feature space.
+ * Classify is const, so any number of threads can query one classifier as
+ * long as each thread uses its own NeighborBuffer.
+ */
+class KNNClassifier
+{
+public:
+  /** Per query scratch space.  Reusing one buffer per thread avoids any
+   * allocation once it has grown to the size of the training set. */
+  class NeighborBuffer
+  {
+public:
+    std::vector<float>                           m_SquaredDistances;
+    std::vector<std::pair<float, unsigned int> > m_Neighbors;
+  };
+
+  KNNClassifier(const unsigned int numberOfFeatures, const unsigned int numberOfClasses);
+
+  /** Append one training sample of GetNumberOfFeatures() values */
+  void AddTrainingSample(const float *features, const unsigned int classIndex);
+
+  size_t GetNumberOfTrainingSamples() const
+  {
+    return m_Labels.size();
+  }
+
+  unsigned int GetNumberOfFeatures() const
+  {
+    return m_NumberOfFeatures;
+  }
+
+  unsigned int GetNumberOfClasses() const
+  {
+    return m_NumberOfClasses;
+  }
+
+  float GetTrainingFeature(const size_t sample, const unsigned int feature) const
+  {
+    return m_Features[feature][sample];
+  }
+
+  unsigned int GetTrainingLabel(const size_t sample) const
+  {
+    return m_Labels[sample];
+  }
+
+  /** Find the K nearest training samples of query and write the inverse
+   * squared distance weighted class membership into likelihoods, which must
+   * hold GetNumberOfClasses() values.  Exact matches get a weight of 1. */
+  void Classify(const float *query, const unsigned int K,
+                NeighborBuffer & buffer, double *likelihoods) const;
+
+private:
+  unsigned int                     m_NumberOfFeatures;
+  unsigned int                     m_NumberOfClasses;
+  std::vector<std::vector<float> > m_Features; // [feature][sample]
+  std::vector<unsigned int>        m_Labels;   // [sample]
+};
+
+#endif // __KNNClassifier_h
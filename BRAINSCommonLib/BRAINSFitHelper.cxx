@@ -86,6 +86,14 @@ ConvertMaskImageToSpatialMask( itk::Image<unsigned char,3>::ConstPointer inputIm
 
 namespace itk
 {
+static SimpleFastMutexLock FixedMaskSamplingLock;
+
+SimpleFastMutexLock &
+GetFixedMaskSamplingLock()
+{
+  return FixedMaskSamplingLock;
+}
+
 BRAINSFitHelper::BRAINSFitHelper() :
   m_FixedVolume(ITK_NULLPTR),
   m_FixedVolume2(ITK_NULLPTR), // For multi-modal SyN
@@ -115,6 +123,7 @@ BRAINSFitHelper::BRAINSFitHelper() :
   m_TransformType(1, "Rigid"),
   m_InitializeTransformMode("Off"),
   m_MaskInferiorCutOffFromCenter(1000),
+  m_CenterOfHeadAlignSearchGrid(DefaultCenterOfHeadAlignSearchGrid()),
   m_SplineGridSize(3, 10),
   m_CostFunctionConvergenceFactor(1e+9),
   m_ProjectedGradientTolerance(1e-5),
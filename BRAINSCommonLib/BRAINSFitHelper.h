@@ -51,12 +51,20 @@
 #include "itkFindCenterOfBrainFilter.h"
 #include "itkImageRandomNonRepeatingConstIteratorWithIndex.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkMutexLockHolder.h"
 
 namespace itk
 {
 /** Method for verifying that the ordering of the transformTypes is consistent
   * with converting routines. */
 extern void ValidateTransformRankOrdering(const std::vector<std::string> & transformType);
+
+/** Lock held while the samples inside the fixed mask are drawn.  The random
+  * permutation of ImageRandomNonRepeatingConstIteratorWithIndex comes from
+  * the global random number generator, which is shared by every helper
+  * that runs concurrently. */
+extern SimpleFastMutexLock & GetFixedMaskSamplingLock();
 }
 
 namespace itk
@@ -179,6 +187,19 @@ public:
   itkGetConstMacro(InitializeTransformMode, std::string);
   itkSetMacro(MaskInferiorCutOffFromCenter, double);
   itkGetConstMacro(MaskInferiorCutOffFromCenter, double);
+
+  /** Coarse pose search grid of the useCenterOfHeadAlign initialization. */
+  void SetCenterOfHeadAlignSearchGrid( const InitializerSearchGridType & grid )
+  {
+    this->m_CenterOfHeadAlignSearchGrid = grid;
+    this->Modified();
+  }
+
+  const InitializerSearchGridType & GetCenterOfHeadAlignSearchGrid() const
+  {
+    return this->m_CenterOfHeadAlignSearchGrid;
+  }
+
   itkSetMacro(MaximumNumberOfEvaluations, int);
   itkGetConstMacro(MaximumNumberOfEvaluations, int);
   itkSetMacro(MaximumNumberOfCorrections, int);
@@ -300,6 +321,7 @@ private:
   std::vector<std::string> m_TransformType;
   std::string              m_InitializeTransformMode;
   double                   m_MaskInferiorCutOffFromCenter;
+  InitializerSearchGridType m_CenterOfHeadAlignSearchGrid;
   std::vector<int>         m_SplineGridSize;
   double                   m_CostFunctionConvergenceFactor;
   double                   m_ProjectedGradientTolerance;
@@ -370,6 +392,10 @@ BRAINSFitHelper::SetupRegistration(GenericMetricType *costMetric)
 
     const unsigned long sampleCount = static_cast<unsigned long>(vcl_ceil( numberOfAllSamples * this->m_SamplingPercentage ) );
 
+    // The permutation is reseeded under the lock, so that the same samples
+    // are drawn whatever the other registrations running at the same time.
+    MutexLockHolder<SimpleFastMutexLock> samplingLockHolder( GetFixedMaskSamplingLock() );
+
     typedef typename Statistics::MersenneTwisterRandomVariateGenerator RandomizerType;
     typename RandomizerType::Pointer randomizer = RandomizerType::New();
     randomizer->SetSeed( 1234 );
@@ -379,6 +405,7 @@ BRAINSFitHelper::SetupRegistration(GenericMetricType *costMetric)
 
     const typename FixedImageType::SpacingType oneThirdVirtualSpacing = this->m_FixedVolume->GetSpacing() / 3.0;
     NRit.SetNumberOfSamples( numberOfAllSamples ); //Take random samples from entire image.
+    NRit.ReinitializeSeed( 1234 );
     NRit.GoToBegin();
     unsigned long samplesInsideMask = 0;
     while( !NRit.IsAtEnd()  && ( samplesInsideMask < sampleCount ) )
@@ -448,6 +475,7 @@ BRAINSFitHelper::SetupRegistration(GenericMetricType *costMetric)
   myHelper->SetBackgroundFillValue(this->m_BackgroundFillValue);
   myHelper->SetInitializeTransformMode(this->m_InitializeTransformMode);
   myHelper->SetMaskInferiorCutOffFromCenter(this->m_MaskInferiorCutOffFromCenter);
+  myHelper->SetCenterOfHeadAlignSearchGrid(this->m_CenterOfHeadAlignSearchGrid);
   myHelper->SetCurrentGenericTransform(this->m_CurrentGenericTransform);
   myHelper->SetRestoreState(this->m_RestoreState);
   myHelper->SetSplineGridSize(this->m_SplineGridSize);
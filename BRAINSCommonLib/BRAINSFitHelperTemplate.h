@@ -59,6 +59,7 @@
 #include "BRAINSFitSyN.h"
 #endif
 #include "BRAINSFitUtils.h"
+#include "BRAINSFitInitializerSearch.h"
 
 #include "ConvertToRigidAffine.h"
 #include "genericRegistrationHelper.h"
@@ -202,6 +203,19 @@ public:
   itkGetConstMacro(InitializeTransformMode, std::string);
   itkSetMacro(MaskInferiorCutOffFromCenter, double);
   itkGetConstMacro(MaskInferiorCutOffFromCenter, double);
+
+  /** Coarse pose search grid of the useCenterOfHeadAlign initialization. */
+  void SetCenterOfHeadAlignSearchGrid( const InitializerSearchGridType & grid )
+  {
+    this->m_CenterOfHeadAlignSearchGrid = grid;
+    this->Modified();
+  }
+
+  const InitializerSearchGridType & GetCenterOfHeadAlignSearchGrid() const
+  {
+    return this->m_CenterOfHeadAlignSearchGrid;
+  }
+
   itkSetMacro(CurrentGenericTransform,  CompositeTransformPointer);
   itkGetConstMacro(CurrentGenericTransform,  CompositeTransformPointer);
   itkSetMacro(RestoreState,  CompositeTransformPointer);
@@ -314,6 +328,7 @@ private:
   std::vector<std::string> m_TransformType;
   std::string              m_InitializeTransformMode;
   double                   m_MaskInferiorCutOffFromCenter;
+  InitializerSearchGridType m_CenterOfHeadAlignSearchGrid;
   std::vector<int>         m_SplineGridSize;
   double                   m_CostFunctionConvergenceFactor;
   double                   m_ProjectedGradientTolerance;
@@ -150,7 +150,8 @@ DoCenteredInitialization( typename FixedImageType::Pointer & orientedFixedVolume
                                                                     // variable,  the Mask is updated by
                                                                     // this function
                           std::string & initializeTransformMode,
-                          typename MetricType::Pointer & CostMetricObject )
+                          typename MetricType::Pointer & CostMetricObject,
+                          const InitializerSearchGridType & searchGrid = DefaultCenterOfHeadAlignSearchGrid() )
 {
   typedef itk::Image<unsigned char, 3>                               MaskImageType;
   typedef itk::ImageMaskSpatialObject<MaskImageType::ImageDimension> ImageMaskSpatialObjectType;
@@ -302,107 +303,15 @@ DoCenteredInitialization( typename FixedImageType::Pointer & orientedFixedVolume
     typename EulerAngle3DTransformType::Pointer bestEulerAngles3D = EulerAngle3DTransformType::New();
     bestEulerAngles3D->SetCenter(rotationCenter);
     bestEulerAngles3D->SetTranslation(translationVector);
-
-    typedef itk::Euler3DTransform<double> EulerAngle3DTransformType;
-    typename EulerAngle3DTransformType::Pointer currentEulerAngles3D = EulerAngle3DTransformType::New();
-    currentEulerAngles3D->SetCenter(rotationCenter);
-    currentEulerAngles3D->SetTranslation(translationVector);
-
-    CostMetricObject->SetMovingTransform(currentEulerAngles3D);
-    CostMetricObject->Initialize();
-    {
-    currentEulerAngles3D->SetRotation(0, 0, 0);
-    // Initialize with current guess;
-    //double max_cc = CostMetricObject->GetValue( currentEulerAngles3D->GetParameters() );
-    double max_cc = CostMetricObject->GetValue();
+    bestEulerAngles3D->SetRotation(0, 0, 0);
 
     // rough search in neighborhood.
-    const double one_degree = 1.0F * vnl_math::pi / 180.0F;
-    const double HAStepSize = 3.0 * one_degree;
-    const double PAStepSize = 3.0 * one_degree;
     // Quick search just needs to get an approximate angle correct.
-    {
-    const double HARange = 12.0;
-    for( double HA = -HARange * one_degree; HA <= HARange * one_degree; HA += HAStepSize )
-      {
-      const double PARange = 12.0;
-      for( double PA = -PARange * one_degree; PA <= PARange * one_degree; PA += PAStepSize )
-        {
-        currentEulerAngles3D->SetRotation(PA, 0, HA);
-        //const double current_cc = CostMetricObject->GetValue( currentEulerAngles3D->GetParameters() );
-        const double current_cc = CostMetricObject->GetValue();
-        if( current_cc < max_cc )
-          {
-          max_cc = current_cc;
-          bestEulerAngles3D->SetFixedParameters( currentEulerAngles3D->GetFixedParameters() );
-          bestEulerAngles3D->SetParameters( currentEulerAngles3D->GetParameters() );
-          }
-        // #define DEBUGGING_PRINT_IMAGES
-#ifdef DEBUGGING_PRINT_IMAGES
-        {
-        std::cout << "quick search "
-                  << " HA= " << ( currentEulerAngles3D->GetParameters()[2] ) * 180.0 / vnl_math::pi
-                  << " PA= " << ( currentEulerAngles3D->GetParameters()[0] ) * 180.0 / vnl_math::pi
-                  << " cc="  <<  current_cc
-                  << std::endl;
-        }
-        if( 0 )
-          {
-          typedef itk::ResampleImageFilter<FixedImageType, MovingImageType, double> ResampleFilterType;
-          typename ResampleFilterType::Pointer resampler = ResampleFilterType::New();
-
-          resampler->SetTransform(currentEulerAngles3D);
-          resampler->SetInput(orientedMovingVolume);
-          // Remember:  the Data is Moving's, the shape is Fixed's.
-          resampler->SetOutputParametersFromImage(orientedFixedVolume);
-          resampler->Update();            //  Explicit Update() required
-          // here.
-          typename FixedImageType::Pointer ResampledImage = resampler->GetOutput();
-
-          typedef itk::CheckerBoardImageFilter<FixedImageType> Checkerfilter;
-          typename Checkerfilter::Pointer checker = Checkerfilter::New();
-          unsigned int array[3] = { 36, 36, 36 };
-
-          checker->SetInput1(orientedFixedVolume);
-          checker->SetInput2(ResampledImage);
-          checker->SetCheckerPattern(array);
-          try
-            {
-            checker->Update();
-            }
-          catch( itk::ExceptionObject & err )
-            {
-            std::cout << "Caught an ITK exception: " << std::endl;
-            std::cout << err << " " << __FILE__ << " " << __LINE__ << std::endl;
-            throw;
-            }
-          char filename[300];
-          sprintf(filename, "%05.2f_%05.2f_%05.2f.nii.gz",
-                  ( currentEulerAngles3D->GetParameters()[2] ) * 180 / vnl_math::pi,
-                  ( currentEulerAngles3D->GetParameters()[0] ) * 180 / vnl_math::pi, current_cc);
-
-          {
-          typedef typename itk::ImageFileWriter<FixedImageType> WriterType;
-          typename WriterType::Pointer writer = WriterType::New();
-          writer->UseCompressionOn();
-          writer->SetFileName(filename);
-          writer->SetInput( checker->GetOutput() );
-          try
-            {
-            writer->Update();
-            }
-          catch( itk::ExceptionObject & err )
-            {
-            std::cout << "Exception Object caught: " << std::endl;
-            std::cout << err << std::endl;
-            throw;
-            }
-          }
-          }
-#endif
-        }
-      }
-    }
+    typedef itk::ImageToImageMetricv4<FixedImageType, MovingImageType, FixedImageType, double> ImageMetricType;
+    const double max_cc =
+      EulerGridSearchForInitialization<MetricType, ImageMetricType>( CostMetricObject.GetPointer(),
+                                                                     bestEulerAngles3D.GetPointer(),
+                                                                     searchGrid );
     // DEBUGGING_PRINT_IMAGES INFORMATION
 #ifdef DEBUGGING_PRINT_IMAGES
     {
@@ -412,8 +321,9 @@ DoCenteredInitialization( typename FixedImageType::Pointer & orientedFixedVolume
               << " cc="  <<  max_cc
               << std::endl;
     }
+#else
+    (void)max_cc;
 #endif
-    }
     typedef itk::VersorRigid3DTransform<double>              VersorRigid3DTransformType;
     typename VersorRigid3DTransformType::Pointer quickSetVersor = VersorRigid3DTransformType::New();
     quickSetVersor->SetCenter( bestEulerAngles3D->GetCenter() );
@@ -530,6 +440,7 @@ BRAINSFitHelperTemplate<FixedImageType, MovingImageType>::BRAINSFitHelperTemplat
   m_TransformType(1, "Rigid"),
   m_InitializeTransformMode("Off"),
   m_MaskInferiorCutOffFromCenter(1000),
+  m_CenterOfHeadAlignSearchGrid(DefaultCenterOfHeadAlignSearchGrid()),
   m_SplineGridSize(3, 10),
   m_CostFunctionConvergenceFactor(1e+9),
   m_ProjectedGradientTolerance(1e-5),
@@ -753,7 +664,8 @@ BRAINSFitHelperTemplate<FixedImageType, MovingImageType>::Update(void)
                                             m_FixedBinaryVolume,
                                             m_MovingBinaryVolume,
                                             localInitializeTransformMode,
-                                            multiMetric );
+                                            multiMetric,
+                                            this->m_CenterOfHeadAlignSearchGrid );
 
   // The currentGenericTransform will be initialized by estimated initial transform.
   this->m_CurrentGenericTransform = CompositeTransformType::New();
@@ -0,0 +1,380 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __BRAINSFitInitializerSearch_h
+#define __BRAINSFitInitializerSearch_h
+
+#include "itkEuler3DTransform.h"
+#include "itkMultiThreader.h"
+#include "itkObjectToObjectMultiMetricv4.h"
+#include "itkMattesMutualInformationImageToImageMetricv4.h"
+#include "itkJointHistogramMutualInformationImageToImageMetricv4.h"
+#include "itkMeanSquaresImageToImageMetricv4.h"
+#include "itkCorrelationImageToImageMetricv4.h"
+#include "itkNumericTraits.h"
+#include "vnl/vnl_math.h"
+#include <vcl_cmath.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+/**
+ * One level of the coarse pose search used by the useCenterOfHeadAlign
+ * initialization.  Offsets are searched symmetrically around the best pose
+ * of the previous level, from -range to +range in steps of step, for the
+ * three Euler angles (degrees, in Euler3DTransform parameter order) and the
+ * three translations (millimeters).  A zero range or step keeps that
+ * parameter fixed.
+ */
+struct InitializerSearchLevel
+  {
+  double AngleRange[3];
+  double AngleStep[3];
+  double TranslationRange[3];
+  double TranslationStep[3];
+  };
+
+typedef std::vector<InitializerSearchLevel> InitializerSearchGridType;
+
+/** The historical 9x9 search over the angles about the x (PA) and z (HA)
+ *  axes, +/- 12 degrees in 3 degree steps. */
+inline
+InitializerSearchGridType
+DefaultCenterOfHeadAlignSearchGrid()
+{
+  InitializerSearchLevel level;
+
+  for( unsigned int i = 0; i < 3; ++i )
+    {
+    level.AngleRange[i] = 0.0;
+    level.AngleStep[i] = 0.0;
+    level.TranslationRange[i] = 0.0;
+    level.TranslationStep[i] = 0.0;
+    }
+  level.AngleRange[0] = 12.0;
+  level.AngleStep[0] = 3.0;
+  level.AngleRange[2] = 12.0;
+  level.AngleStep[2] = 3.0;
+  return InitializerSearchGridType( 1, level );
+}
+
+/** offsets -range, -range + step, ..., +range */
+inline
+std::vector<double>
+InitializerSearchOffsets( const double range, const double step )
+{
+  std::vector<double> offsets;
+  if( range <= 0.0 || step <= 0.0 )
+    {
+    offsets.push_back( 0.0 );
+    return offsets;
+    }
+  const unsigned int numberOfSteps = static_cast<unsigned int>( vcl_floor( 2.0 * range / step + 1e-6 ) );
+  for( unsigned int k = 0; k <= numberOfSteps; ++k )
+    {
+    offsets.push_back( -range + k * step );
+    }
+  return offsets;
+}
+
+/**
+ * A single threaded copy of an image metric of one of the types BRAINSFit
+ * creates, sharing the images, masks and sample points of the original.
+ * Returns a null pointer for any other metric type.
+ */
+template <class TImageMetric>
+typename TImageMetric::Pointer
+CloneImageMetricForInitializerSearch( const TImageMetric * source )
+{
+  typedef typename TImageMetric::FixedImageType   FixedImageType;
+  typedef typename TImageMetric::MovingImageType  MovingImageType;
+  typedef typename TImageMetric::VirtualImageType VirtualImageType;
+  typedef typename TImageMetric::InternalComputationValueType RealType;
+
+  typedef MattesMutualInformationImageToImageMetricv4<FixedImageType, MovingImageType, VirtualImageType, RealType>
+    MIMetricType;
+  typedef JointHistogramMutualInformationImageToImageMetricv4<FixedImageType, MovingImageType, VirtualImageType,
+                                                              RealType> MIHMetricType;
+  typedef MeanSquaresImageToImageMetricv4<FixedImageType, MovingImageType, VirtualImageType, RealType>
+    MSEMetricType;
+  typedef CorrelationImageToImageMetricv4<FixedImageType, MovingImageType, VirtualImageType, RealType>
+    NCMetricType;
+
+  typename TImageMetric::Pointer clone;
+  if( const MIMetricType * mi = dynamic_cast<const MIMetricType *>( source ) )
+    {
+    typename MIMetricType::Pointer localMetric = MIMetricType::New();
+    localMetric->SetNumberOfHistogramBins( mi->GetNumberOfHistogramBins() );
+    clone = localMetric.GetPointer();
+    }
+  else if( const MIHMetricType * mih = dynamic_cast<const MIHMetricType *>( source ) )
+    {
+    typename MIHMetricType::Pointer localMetric = MIHMetricType::New();
+    localMetric->SetNumberOfHistogramBins( mih->GetNumberOfHistogramBins() );
+    localMetric->SetVarianceForJointPDFSmoothing( mih->GetVarianceForJointPDFSmoothing() );
+    clone = localMetric.GetPointer();
+    }
+  else if( dynamic_cast<const MSEMetricType *>( source ) != ITK_NULLPTR )
+    {
+    clone = MSEMetricType::New().GetPointer();
+    }
+  else if( dynamic_cast<const NCMetricType *>( source ) != ITK_NULLPTR )
+    {
+    clone = NCMetricType::New().GetPointer();
+    }
+  else
+    {
+    return clone;
+    }
+
+  if( source->GetVirtualImage() != ITK_NULLPTR )
+    {
+    clone->SetVirtualDomainFromImage( source->GetVirtualImage() );
+    }
+  clone->SetFixedImage( source->GetFixedImage() );
+  clone->SetMovingImage( source->GetMovingImage() );
+  clone->SetFixedImageMask( source->GetFixedImageMask() );
+  clone->SetMovingImageMask( source->GetMovingImageMask() );
+  clone->SetUseFixedImageGradientFilter( source->GetUseFixedImageGradientFilter() );
+  clone->SetUseMovingImageGradientFilter( source->GetUseMovingImageGradientFilter() );
+  clone->SetUseFixedSampledPointSet( source->GetUseFixedSampledPointSet() );
+  if( source->GetFixedSampledPointSet() != ITK_NULLPTR )
+    {
+    clone->SetFixedSampledPointSet( source->GetFixedSampledPointSet() );
+    }
+  // The search runs one candidate per thread, so a value does not depend
+  // on how many threads the search uses.
+  clone->SetMaximumNumberOfThreads( 1 );
+  return clone;
+}
+
+/** Clones every component of a multi metric, keeping the weights and any
+ *  component that is added more than once shared.  Null if any component
+ *  cannot be cloned. */
+template <class TMultiMetric, class TImageMetric>
+typename TMultiMetric::Pointer
+CloneMultiMetricForInitializerSearch( const TMultiMetric * source )
+{
+  typedef typename TMultiMetric::MetricQueueType MetricQueueType;
+
+  typename TMultiMetric::Pointer clone = TMultiMetric::New();
+  const MetricQueueType &        queue = source->GetMetricQueue();
+
+  std::vector<const TImageMetric *>            originals;
+  std::vector<typename TImageMetric::Pointer> copies;
+  for( size_t i = 0; i < queue.size(); ++i )
+    {
+    const TImageMetric * original = dynamic_cast<const TImageMetric *>( queue[i].GetPointer() );
+    if( original == ITK_NULLPTR )
+      {
+      return ITK_NULLPTR;
+      }
+    const typename std::vector<const TImageMetric *>::const_iterator found =
+      std::find( originals.begin(), originals.end(), original );
+    if( found == originals.end() )
+      {
+      typename TImageMetric::Pointer copy = CloneImageMetricForInitializerSearch<TImageMetric>( original );
+      if( copy.IsNull() )
+        {
+        return ITK_NULLPTR;
+        }
+      originals.push_back( original );
+      copies.push_back( copy );
+      clone->AddMetric( copy );
+      }
+    else
+      {
+      clone->AddMetric( copies[found - originals.begin()] );
+      }
+    }
+  clone->SetMetricWeights( source->GetMetricWeights() );
+  return clone;
+}
+
+template <class TMultiMetric>
+struct InitializerSearchThreadStruct
+  {
+  typedef Euler3DTransform<double> EulerTransformType;
+
+  std::vector<typename TMultiMetric::Pointer>      metrics;
+  std::vector<EulerTransformType::Pointer>        transforms;
+  const std::vector<EulerTransformType::ParametersType> * candidates;
+  std::vector<double>                             values;
+  std::vector<std::string>                        errors;
+  };
+
+template <class TMultiMetric>
+ITK_THREAD_RETURN_TYPE
+InitializerSearchThreaderCallback( void *arg )
+{
+  const ThreadIdType threadId = ( (MultiThreader::ThreadInfoStruct *)(arg) )->ThreadID;
+  const ThreadIdType threadCount = ( (MultiThreader::ThreadInfoStruct *)(arg) )->NumberOfThreads;
+
+  InitializerSearchThreadStruct<TMultiMetric> * str =
+    (InitializerSearchThreadStruct<TMultiMetric> *)( ( (MultiThreader::ThreadInfoStruct *)(arg) )->UserData);
+
+  const size_t numberOfCandidates = str->candidates->size();
+  const size_t candidatesPerThread = ( numberOfCandidates + threadCount - 1 ) / threadCount;
+  const size_t first = std::min( threadId * candidatesPerThread, numberOfCandidates );
+  const size_t last = std::min( first + candidatesPerThread, numberOfCandidates );
+
+  try
+    {
+    for( size_t c = first; c < last; ++c )
+      {
+      str->transforms[threadId]->SetParameters( ( *str->candidates )[c] );
+      str->values[c] = str->metrics[threadId]->GetValue();
+      }
+    }
+  catch( ExceptionObject & err )
+    {
+    str->errors[threadId] = err.GetDescription();
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+/**
+ * Coarse-to-fine grid search for the Euler pose minimizing costMetric.
+ * bestTransform holds the starting pose on input (its center is kept) and
+ * the best pose found on output; the best metric value is returned.
+ *
+ * Candidates are evaluated concurrently on single threaded copies of the
+ * metric.  Ties are resolved in enumeration order (z angle, x angle, y angle,
+ * then z, y, x translation) against the incumbent, so the result does not
+ * depend on the number of threads.  Metric types that cannot be copied
+ * are searched serially on costMetric itself.
+ */
+template <class TMultiMetric, class TImageMetric>
+double
+EulerGridSearchForInitialization( TMultiMetric * costMetric,
+                                  Euler3DTransform<double> * bestTransform,
+                                  const InitializerSearchGridType & grid )
+{
+  typedef InitializerSearchThreadStruct<TMultiMetric>    ThreadStructType;
+  typedef typename ThreadStructType::EulerTransformType EulerTransformType;
+  typedef typename EulerTransformType::ParametersType   ParametersType;
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+  const ThreadIdType     numberOfThreads = threader->GetNumberOfThreads();
+
+  ThreadStructType str;
+  for( ThreadIdType t = 0; t < numberOfThreads; ++t )
+    {
+    typename TMultiMetric::Pointer metric =
+      CloneMultiMetricForInitializerSearch<TMultiMetric, TImageMetric>( costMetric );
+    if( metric.IsNull() )
+      {
+      str.metrics.clear();
+      str.transforms.clear();
+      break;
+      }
+    str.metrics.push_back( metric );
+    }
+  if( str.metrics.empty() )
+    {
+    str.metrics.push_back( costMetric );
+    }
+  for( size_t t = 0; t < str.metrics.size(); ++t )
+    {
+    typename EulerTransformType::Pointer transform = EulerTransformType::New();
+    transform->SetFixedParameters( bestTransform->GetFixedParameters() );
+    transform->SetParameters( bestTransform->GetParameters() );
+    str.metrics[t]->SetMovingTransform( transform );
+    str.metrics[t]->Initialize();
+    str.transforms.push_back( transform );
+    }
+  str.errors.resize( str.metrics.size() );
+
+  // Initialize with current guess
+  ParametersType bestParameters = bestTransform->GetParameters();
+  double         bestValue = str.metrics[0]->GetValue();
+
+  const double one_degree = vnl_math::pi / 180.0;
+  for( size_t l = 0; l < grid.size(); ++l )
+    {
+    const InitializerSearchLevel & level = grid[l];
+    std::vector<double>            angleOffsets[3];
+    std::vector<double>            translationOffsets[3];
+    for( unsigned int i = 0; i < 3; ++i )
+      {
+      angleOffsets[i] = InitializerSearchOffsets( level.AngleRange[i], level.AngleStep[i] );
+      translationOffsets[i] = InitializerSearchOffsets( level.TranslationRange[i], level.TranslationStep[i] );
+      }
+
+    const ParametersType           levelCenter = bestParameters;
+    std::vector<ParametersType>    candidates;
+    for( size_t az = 0; az < angleOffsets[2].size(); ++az )
+      {
+      for( size_t ax = 0; ax < angleOffsets[0].size(); ++ax )
+        {
+        for( size_t ay = 0; ay < angleOffsets[1].size(); ++ay )
+          {
+          for( size_t tz = 0; tz < translationOffsets[2].size(); ++tz )
+            {
+            for( size_t ty = 0; ty < translationOffsets[1].size(); ++ty )
+              {
+              for( size_t tx = 0; tx < translationOffsets[0].size(); ++tx )
+                {
+                ParametersType candidate = levelCenter;
+                candidate[0] += angleOffsets[0][ax] * one_degree;
+                candidate[1] += angleOffsets[1][ay] * one_degree;
+                candidate[2] += angleOffsets[2][az] * one_degree;
+                candidate[3] += translationOffsets[0][tx];
+                candidate[4] += translationOffsets[1][ty];
+                candidate[5] += translationOffsets[2][tz];
+                candidates.push_back( candidate );
+                }
+              }
+            }
+          }
+        }
+      }
+
+    str.candidates = &candidates;
+    str.values.assign( candidates.size(), NumericTraits<double>::max() );
+    threader->SetNumberOfThreads(
+      static_cast<ThreadIdType>( std::min<size_t>( str.metrics.size(), candidates.size() ) ) );
+    threader->SetSingleMethod( InitializerSearchThreaderCallback<TMultiMetric>, &str );
+    threader->SingleMethodExecute();
+    for( size_t t = 0; t < str.errors.size(); ++t )
+      {
+      if( !str.errors[t].empty() )
+        {
+        itkGenericExceptionMacro(<< "Initializer search failed: " << str.errors[t]);
+        }
+      }
+
+    for( size_t c = 0; c < candidates.size(); ++c )
+      {
+      if( str.values[c] < bestValue )
+        {
+        bestValue = str.values[c];
+        bestParameters = candidates[c];
+        }
+      }
+    }
+
+  bestTransform->SetParameters( bestParameters );
+  return bestValue;
+}
+} // end namespace itk
+
+#endif // __BRAINSFitInitializerSearch_h
@@ -0,0 +1,123 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "BRAINSFitInitializerSearch.h"
+#include "itkImage.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include <iostream>
+
+typedef itk::Image<float, 3> ImageType;
+typedef itk::ImageToImageMetricv4<ImageType, ImageType, ImageType, double>             ImageMetricType;
+typedef itk::MeanSquaresImageToImageMetricv4<ImageType, ImageType, ImageType, double>  MSEMetricType;
+typedef itk::ObjectToObjectMultiMetricv4<3, 3, ImageType, double>                     MultiMetricType;
+typedef itk::Euler3DTransform<double>                                                  EulerTransformType;
+
+// An off-center ellipsoidal blob, rotated by angleZ about the image center.
+static ImageType::Pointer
+MakeBlob( const double angleZ )
+{
+  ImageType::SizeType size;
+  size.Fill( 32 );
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( size );
+  image->Allocate();
+
+  const double c = vcl_cos( angleZ );
+  const double s = vcl_sin( angleZ );
+  itk::ImageRegionIteratorWithIndex<ImageType> it( image, image->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it )
+    {
+    const double x = it.GetIndex()[0] - 15.5;
+    const double y = it.GetIndex()[1] - 15.5;
+    const double z = it.GetIndex()[2] - 15.5;
+    const double u = c * x + s * y - 2.0;
+    const double v = -s * x + c * y + 1.0;
+    it.Set( 100.0 * vcl_exp( -( u * u / 64.0 + v * v / 16.0 + z * z / 36.0 ) ) );
+    }
+  return image;
+}
+
+static double
+Search( const ImageType * fixed, const ImageType * moving, const itk::InitializerSearchGridType & grid,
+        const unsigned int numberOfThreads, EulerTransformType::ParametersType & parameters )
+{
+  itk::MultiThreader::SetGlobalDefaultNumberOfThreads( numberOfThreads );
+
+  MSEMetricType::Pointer metric = MSEMetricType::New();
+  metric->SetVirtualDomainFromImage( fixed );
+  metric->SetFixedImage( fixed );
+  metric->SetMovingImage( moving );
+  MultiMetricType::Pointer multiMetric = MultiMetricType::New();
+  multiMetric->AddMetric( metric );
+
+  EulerTransformType::Pointer transform = EulerTransformType::New();
+  EulerTransformType::InputPointType center;
+  center.Fill( 15.5 );
+  transform->SetCenter( center );
+
+  const double value = itk::EulerGridSearchForInitialization<MultiMetricType, ImageMetricType>( multiMetric,
+                                                                                               transform,
+                                                                                               grid );
+  parameters = transform->GetParameters();
+  return value;
+}
+
+int main(int, char * *)
+{
+  const double one_degree = vnl_math::pi / 180.0;
+
+  ImageType::Pointer fixed = MakeBlob( 0.0 );
+  ImageType::Pointer moving = MakeBlob( 6.0 * one_degree );
+
+  // the default grid, refined by a second level over all angles and translations
+  itk::InitializerSearchGridType grid = itk::DefaultCenterOfHeadAlignSearchGrid();
+  itk::InitializerSearchLevel    fine;
+  for( unsigned int i = 0; i < 3; ++i )
+    {
+    fine.AngleRange[i] = 1.0;
+    fine.AngleStep[i] = 1.0;
+    fine.TranslationRange[i] = 1.0;
+    fine.TranslationStep[i] = 1.0;
+    }
+  grid.push_back( fine );
+
+  EulerTransformType::ParametersType serialParameters;
+  const double serialValue = Search( fixed, moving, grid, 1, serialParameters );
+
+  int status = EXIT_SUCCESS;
+  const unsigned int threadCounts[] = { 2, 3, 8 };
+  for( unsigned int t = 0; t < 3; ++t )
+    {
+    EulerTransformType::ParametersType parameters;
+    const double value = Search( fixed, moving, grid, threadCounts[t], parameters );
+    if( value != serialValue || parameters != serialParameters )
+      {
+      std::cerr << threadCounts[t] << " threads found " << parameters << " (" << value
+                << "), 1 thread found " << serialParameters << " (" << serialValue << ")" << std::endl;
+      status = EXIT_FAILURE;
+      }
+    }
+
+  // the moving blob is rotated by +6 degrees about z
+  if( vcl_abs( serialParameters[2] / one_degree - 6.0 ) > 1.5 )
+    {
+    std::cerr << "Unexpected rotation about z: " << serialParameters[2] / one_degree << " degrees" << std::endl;
+    status = EXIT_FAILURE;
+    }
+  return status;
+}
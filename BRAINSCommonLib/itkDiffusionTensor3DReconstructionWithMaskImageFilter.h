@@ -89,14 +89,22 @@ namespace itk
  * \li<a href="splweb.bwh.harvard.edu:8000/pages/papers/westin/ISMRM2002.pdf">[2]</a>
  * <em>A Dual Tensor Basis Solution to the Stejskal-Tanner Equations for DT-MRI</em>
  *
+ * \par Estimation methods
+ * \li LinearLeastSquares (default) - The pseudo-inverse of the tensor basis is
+ * computed once in BeforeThreadedGenerateData, so the per-voxel solve is a
+ * 6 x n matrix-vector product.  This method is fully multi-threaded.
+ * \li WeightedLeastSquares - Starts from the linear solution and re-solves the
+ * 6 x 6 weighted normal equations NumberOfWeightedLeastSquaresIterations times,
+ * weighting each measurement by its squared predicted signal.
+ * \li PerVoxelSVD - The original behavior, which builds a vnl_svd of the
+ * tensor basis for every voxel.
+ *
  * \par WARNING:
- * Although this filter has been written to support multiple threads, please
- * set the number of threads to 1.
- * \code
- *         filter->SetNumberOfThreads(1);
- * \endcode
+ * The PerVoxelSVD method always runs on a single thread, without changing
+ * the number of threads of the filter.
  * This is due to buggy code in netlib/dsvdc, that is called by vnl_svd.
  * (used to compute the psudo-inverse to find the dual tensor basis).
+ * The other methods only call vnl_svd once, from a single thread.
  *
  * \author Thanks to Xiaodong Tao, GE, for contributing parts of this class. Also
  * thanks to Casey Goodlet, UNC for patches to support multiple baseline images
@@ -174,6 +182,9 @@ public:
   /** Holds the tensor basis coefficients G_k */
   typedef vnl_matrix_fixed<double, 6, 6> TensorBasisMatrixType;
 
+  /** Holds the 6 unique tensor coefficients solved for at each voxel */
+  typedef vnl_vector_fixed<double, 6> TensorCoefficientVectorType;
+
   typedef vnl_matrix<double> CoefficientMatrixType;
 
   /** Holds each magnetic field gradient used to acquire one DWImage */
@@ -248,6 +259,24 @@ public:
 #endif
   itkGetConstReferenceMacro( BValue, TTensorPixelType);
 
+  /** Method used to solve the Stejskal-Tanner equations at each voxel. */
+  typedef enum
+    {
+    LinearLeastSquares = 0,
+    WeightedLeastSquares,
+    PerVoxelSVD
+    } EstimationMethodType;
+
+  /** Set the estimation method.  PerVoxelSVD always runs on a single
+   * thread, whatever the number of threads of the filter. */
+  itkSetMacro( EstimationMethod, EstimationMethodType );
+
+  itkGetConstMacro( EstimationMethod, EstimationMethodType );
+
+  /** Number of re-weighting passes used by the WeightedLeastSquares method */
+  itkSetMacro( NumberOfWeightedLeastSquaresIterations, unsigned int );
+  itkGetConstMacro( NumberOfWeightedLeastSquaresIterations, unsigned int );
+
 #ifdef ITK_USE_CONCEPT_CHECKING
   /** Begin concept checking */
   itkConceptMacro(ReferenceEqualityComparableCheck,
@@ -276,6 +305,13 @@ protected:
 
   void ComputeTensorBasis();
 
+  /** Solve for the tensor given the n normalized log signal attenuations */
+  void EstimateTensor( const vnl_vector<double> & B, TensorPixelType & tensor ) const;
+
+  /** Runs ThreadedGenerateData directly, on the calling thread, for the
+   * PerVoxelSVD method, and the threaded pipeline otherwise. */
+  void GenerateData() ITK_OVERRIDE;
+
   void BeforeThreadedGenerateData() ITK_OVERRIDE;
 
   void ThreadedGenerateData( const
@@ -296,6 +332,16 @@ private:
 
   CoefficientMatrixType m_BMatrix;
 
+  /** 6 x n pseudo-inverse of the design matrix, computed once per update */
+  CoefficientMatrixType m_PseudoInverse;
+
+  /** n x 6 design matrix, row major, used by the weighted solver */
+  CoefficientMatrixType m_DesignMatrix;
+
+  EstimationMethodType m_EstimationMethod;
+
+  unsigned int m_NumberOfWeightedLeastSquaresIterations;
+
   /** container to hold gradient directions */
   GradientDirectionContainerType::Pointer m_GradientDirectionContainer;
 
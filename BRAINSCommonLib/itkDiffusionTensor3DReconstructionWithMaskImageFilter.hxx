@@ -33,6 +33,8 @@ template <class TReferenceImagePixelType,
 DiffusionTensor3DReconstructionWithMaskImageFilter<TReferenceImagePixelType,
                                                    TGradientImagePixelType, TTensorPixelType>
 ::DiffusionTensor3DReconstructionWithMaskImageFilter() :
+  m_EstimationMethod(LinearLeastSquares),
+  m_NumberOfWeightedLeastSquaresIterations(2),
   m_GradientDirectionContainer(ITK_NULLPTR),
   m_NumberOfGradientDirections(0),
   m_NumberOfBaselineImages(1),
@@ -44,10 +46,27 @@ DiffusionTensor3DReconstructionWithMaskImageFilter<TReferenceImagePixelType,
   // For images added one at a time we need at least six
   this->SetNumberOfRequiredInputs( 1 );
   m_TensorBasis.set_identity();
+}
+
+template <class TReferenceImagePixelType,
+          class TGradientImagePixelType, class TTensorPixelType>
+void DiffusionTensor3DReconstructionWithMaskImageFilter<TReferenceImagePixelType,
+                                                        TGradientImagePixelType, TTensorPixelType>
+::GenerateData()
+{
+  if( this->m_EstimationMethod != PerVoxelSVD )
+    {
+    Superclass::GenerateData();
+    return;
+    }
 
-  // This is due to buggy code in netlib/dsvdc, that is called by vnl_svd.
-  // (used to compute the psudo-inverse to find the dual tensor basis).
-  this->SetNumberOfThreads(1);
+  // Same steps as ImageSource::GenerateData, with the whole requested
+  // region processed on this thread, so that the number of threads set by
+  // the user is left alone.
+  this->AllocateOutputs();
+  this->BeforeThreadedGenerateData();
+  this->ThreadedGenerateData( this->GetOutput()->GetRequestedRegion(), 0 );
+  this->AfterThreadedGenerateData();
 }
 
 template <class TReferenceImagePixelType,
@@ -119,8 +138,10 @@ void DiffusionTensor3DReconstructionWithMaskImageFilter<TReferenceImagePixelType
 
 // POTENTIAL WARNING:
 //
-// Until we fix netlib svd routines, we will need to set the number of thread
-// to 1.
+// Until we fix netlib svd routines, the PerVoxelSVD estimation method
+// must run on a single thread, which GenerateData takes care of.  The other
+// estimation methods only use the pseudo-inverse computed in
+// ComputeTensorBasis.
 template <class TReferenceImagePixelType,
           class TGradientImagePixelType, class TTensorPixelType>
 void DiffusionTensor3DReconstructionWithMaskImageFilter<TReferenceImagePixelType,
@@ -135,7 +156,6 @@ void DiffusionTensor3DReconstructionWithMaskImageFilter<TReferenceImagePixelType
   oit.GoToBegin();
 
   vnl_vector<double> B(m_NumberOfGradientDirections);
-  vnl_vector<double> D(6);
 
   // if a mask is present, iterate through mask image and skip zero voxels
   bool useMask(this->m_MaskImage.IsNotNull() );
@@ -226,22 +246,7 @@ void DiffusionTensor3DReconstructionWithMaskImageFilter<TReferenceImagePixelType
           ++(*gradientItContainer[i]);
           }
 
-        vnl_svd<double> pseudoInverseSolver( m_TensorBasis );
-        if( m_NumberOfGradientDirections > 6 )
-          {
-          D = pseudoInverseSolver.solve( m_BMatrix * B );
-          }
-        else
-          {
-          D = pseudoInverseSolver.solve( B );
-          }
-
-        tensor(0, 0) = D[0];
-        tensor(0, 1) = D[1];
-        tensor(0, 2) = D[2];
-        tensor(1, 1) = D[3];
-        tensor(1, 2) = D[4];
-        tensor(2, 2) = D[5];
+        this->EstimateTensor( B, tensor );
         }
       else
         {
@@ -335,22 +340,7 @@ void DiffusionTensor3DReconstructionWithMaskImageFilter<TReferenceImagePixelType
             }
           }
 
-        vnl_svd<double> pseudoInverseSolver( m_TensorBasis );
-        if( m_NumberOfGradientDirections > 6 )
-          {
-          D = pseudoInverseSolver.solve( m_BMatrix * B );
-          }
-        else
-          {
-          D = pseudoInverseSolver.solve( B );
-          }
-
-        tensor(0, 0) = D[0];
-        tensor(0, 1) = D[1];
-        tensor(0, 2) = D[2];
-        tensor(1, 1) = D[3];
-        tensor(1, 2) = D[4];
-        tensor(2, 2) = D[5];
+        this->EstimateTensor( B, tensor );
         }
 
       oit.Set( tensor );
@@ -400,6 +390,8 @@ void DiffusionTensor3DReconstructionWithMaskImageFilter<TReferenceImagePixelType
       * m_GradientDirectionContainer->ElementAt(gradientind[m])[2];
     }
 
+  m_DesignMatrix = m_BMatrix;
+
   if( m_NumberOfGradientDirections > 6 )
     {
     m_TensorBasis = m_BMatrix.transpose() * m_BMatrix;
@@ -410,6 +402,149 @@ void DiffusionTensor3DReconstructionWithMaskImageFilter<TReferenceImagePixelType
     }
 
   m_BMatrix.inplace_transpose();
+
+  // The tensor basis is the same for every voxel, so its pseudo-inverse
+  // only needs to be computed once.  This is the only call to vnl_svd for
+  // the non PerVoxelSVD methods, and it happens before threading starts.
+  vnl_svd<double> pseudoInverseSolver( m_TensorBasis );
+  if( m_NumberOfGradientDirections > 6 )
+    {
+    m_PseudoInverse = pseudoInverseSolver.pinverse() * m_BMatrix;
+    }
+  else
+    {
+    m_PseudoInverse = pseudoInverseSolver.pinverse();
+    }
+}
+
+template <class TReferenceImagePixelType,
+          class TGradientImagePixelType, class TTensorPixelType>
+void DiffusionTensor3DReconstructionWithMaskImageFilter<TReferenceImagePixelType,
+                                                        TGradientImagePixelType, TTensorPixelType>
+::EstimateTensor( const vnl_vector<double> & B, TensorPixelType & tensor ) const
+{
+  const unsigned int          numberOfGradients = this->m_NumberOfGradientDirections;
+  TensorCoefficientVectorType D;
+
+  if( this->m_EstimationMethod == PerVoxelSVD )
+    {
+    vnl_svd<double>    pseudoInverseSolver( m_TensorBasis );
+    vnl_vector<double> solution;
+    if( numberOfGradients > 6 )
+      {
+      solution = pseudoInverseSolver.solve( m_BMatrix * B );
+      }
+    else
+      {
+      solution = pseudoInverseSolver.solve( B );
+      }
+    D.copy_in( solution.data_block() );
+    }
+  else
+    {
+    // D = pinv(G) * B, with the pseudo-inverse stored row major.
+    const double *pinvRow = this->m_PseudoInverse.data_block();
+    const double *b = B.data_block();
+    for( unsigned int r = 0; r < 6; ++r, pinvRow += numberOfGradients )
+      {
+      double sum = 0.0;
+      for( unsigned int i = 0; i < numberOfGradients; ++i )
+        {
+        sum += pinvRow[i] * b[i];
+        }
+      D[r] = sum;
+      }
+
+    if( this->m_EstimationMethod == WeightedLeastSquares )
+      {
+      const double bValue = static_cast<double>( this->m_BValue );
+      for( unsigned int iter = 0; iter < this->m_NumberOfWeightedLeastSquaresIterations; ++iter )
+        {
+        // Accumulate the lower triangle of G^T W G and G^T W B, where the
+        // weights are the squared signals predicted by the current fit.
+        TensorBasisMatrixType       normal(0.0);
+        TensorCoefficientVectorType rhs(0.0);
+        const double *              row = this->m_DesignMatrix.data_block();
+        for( unsigned int i = 0; i < numberOfGradients; ++i, row += 6 )
+          {
+          double fit = 0.0;
+          for( unsigned int c = 0; c < 6; ++c )
+            {
+            fit += row[c] * D[c];
+            }
+          const double weight = vcl_exp( -2.0 * bValue * fit );
+          for( unsigned int r = 0; r < 6; ++r )
+            {
+            const double weightedRow = weight * row[r];
+            rhs[r] += weightedRow * b[i];
+            for( unsigned int c = 0; c <= r; ++c )
+              {
+              normal(r, c) += weightedRow * row[c];
+              }
+            }
+          }
+
+        // In place Cholesky factorization of the 6x6 normal equations.
+        bool positiveDefinite = true;
+        for( unsigned int c = 0; c < 6 && positiveDefinite; ++c )
+          {
+          double diagonal = normal(c, c);
+          for( unsigned int k = 0; k < c; ++k )
+            {
+            diagonal -= normal(c, k) * normal(c, k);
+            }
+          if( diagonal <= 0.0 )
+            {
+            positiveDefinite = false;
+            break;
+            }
+          normal(c, c) = vcl_sqrt( diagonal );
+          for( unsigned int r = c + 1; r < 6; ++r )
+            {
+            double value = normal(r, c);
+            for( unsigned int k = 0; k < c; ++k )
+              {
+              value -= normal(r, k) * normal(c, k);
+              }
+            normal(r, c) = value / normal(c, c);
+            }
+          }
+        if( !positiveDefinite )
+          {
+          // Keep the last valid estimate
+          break;
+          }
+
+        // Forward then backward substitution
+        TensorCoefficientVectorType y;
+        for( unsigned int r = 0; r < 6; ++r )
+          {
+          double value = rhs[r];
+          for( unsigned int k = 0; k < r; ++k )
+            {
+            value -= normal(r, k) * y[k];
+            }
+          y[r] = value / normal(r, r);
+          }
+        for( int r = 5; r >= 0; --r )
+          {
+          double value = y[r];
+          for( unsigned int k = r + 1; k < 6; ++k )
+            {
+            value -= normal(k, r) * D[k];
+            }
+          D[r] = value / normal(r, r);
+          }
+        }
+      }
+    }
+
+  tensor(0, 0) = D[0];
+  tensor(0, 1) = D[1];
+  tensor(0, 2) = D[2];
+  tensor(1, 1) = D[3];
+  tensor(1, 2) = D[4];
+  tensor(2, 2) = D[5];
 }
 
 template <class TReferenceImagePixelType,
@@ -517,6 +652,9 @@ void DiffusionTensor3DReconstructionWithMaskImageFilter<TReferenceImagePixelType
      << m_NumberOfBaselineImages << std::endl;
   os << indent << "Threshold for reference B0 image: " << m_Threshold << std::endl;
   os << indent << "BValue: " << m_BValue << std::endl;
+  os << indent << "EstimationMethod: " << m_EstimationMethod << std::endl;
+  os << indent << "NumberOfWeightedLeastSquaresIterations: "
+     << m_NumberOfWeightedLeastSquaresIterations << std::endl;
   if( this->m_GradientImageTypeEnumeration == GradientIsInManyImages )
     {
     os << indent << "Gradient images have been supplied " << std::endl;
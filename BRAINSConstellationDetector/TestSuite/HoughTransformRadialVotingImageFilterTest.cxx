@@ -0,0 +1,119 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "../src/itkHoughTransformRadialVotingImageFilter.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include <cstring>
+
+typedef itk::Image<float, 3>                                             ImageType;
+typedef itk::HoughTransformRadialVotingImageFilter<ImageType, ImageType> HoughFilterType;
+
+template <class TImage>
+static bool
+SameBuffers( const TImage * a, const TImage * b, const char * name )
+{
+  const size_t numberOfPixels = a->GetBufferedRegion().GetNumberOfPixels();
+  if( b->GetBufferedRegion() != a->GetBufferedRegion()
+      || std::memcmp( a->GetBufferPointer(), b->GetBufferPointer(),
+                      numberOfPixels * sizeof( typename TImage::PixelType ) ) != 0 )
+    {
+    std::cerr << name << " differs" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+static HoughFilterType::Pointer
+RunHough( const ImageType * image, const unsigned int numberOfThreads, const double samplingRatio )
+{
+  HoughFilterType::Pointer houghFilter = HoughFilterType::New();
+  houghFilter->SetInput( image );
+  houghFilter->SetNumberOfThreads( numberOfThreads );
+  houghFilter->SetNumberOfSpheres( 2 );
+  houghFilter->SetMinimumRadius( 5 );
+  houghFilter->SetMaximumRadius( 7 );
+  houghFilter->SetSigmaGradient( 1 );
+  houghFilter->SetVariance( 1 );
+  houghFilter->SetSphereRadiusRatio( 1 );
+  houghFilter->SetVotingRadiusRatio( 0.5 );
+  houghFilter->SetThreshold( 10 );
+  houghFilter->SetOutputThreshold( 0.8 );
+  houghFilter->SetGradientThreshold( 0 );
+  houghFilter->SetSamplingRatio( samplingRatio );
+  houghFilter->SetHoughEyeDetectorMode( 1 );
+  houghFilter->Update();
+  return houghFilter;
+}
+
+// The accumulator, radius and output images must not depend on the number
+// of threads.
+int main(int, char * *)
+{
+  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomType;
+  RandomType::Pointer random = RandomType::New();
+  random->SetSeed( 27183 );
+
+  ImageType::SizeType size;
+  size.Fill( 48 );
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( size );
+  image->Allocate();
+
+  // two dark spheres in a bright, noisy background
+  itk::ImageRegionIteratorWithIndex<ImageType> it( image, image->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it )
+    {
+    const ImageType::IndexType & idx = it.GetIndex();
+    double                       value = 100.0 + 10.0 * random->GetVariateWithClosedRange( 1.0 );
+    for( int sphere = -1; sphere <= 1; sphere += 2 )
+      {
+      const double dx = idx[0] - ( 24.0 + sphere * 10.0 );
+      const double dy = idx[1] - 20.0;
+      const double dz = idx[2] - 26.0;
+      if( dx * dx + dy * dy + dz * dz < 36.0 )
+        {
+        value = 20.0;
+        }
+      }
+    it.Set( value );
+    }
+
+  int status = EXIT_SUCCESS;
+  const double samplingRatios[] = { 1.0, 0.2 };
+  for( unsigned int s = 0; s < 2; ++s )
+    {
+    HoughFilterType::Pointer reference = RunHough( image, 1, samplingRatios[s] );
+    const unsigned int threadCounts[] = { 2, 3, 7 };
+    for( unsigned int t = 0; t < 3; ++t )
+      {
+      HoughFilterType::Pointer threaded = RunHough( image, threadCounts[t], samplingRatios[s] );
+      if( !SameBuffers<HoughFilterType::InternalImageType>( reference->GetAccumulatorImage(),
+                                                            threaded->GetAccumulatorImage(), "Accumulator" )
+          || !SameBuffers<HoughFilterType::InternalImageType>( reference->GetRadiusImage(),
+                                                               threaded->GetRadiusImage(), "Radius image" )
+          || !SameBuffers<ImageType>( reference->GetOutput(), threaded->GetOutput(), "Output" ) )
+        {
+        std::cerr << "  with " << threadCounts[t] << " threads and sampling ratio "
+                  << samplingRatios[s] << std::endl;
+        status = EXIT_FAILURE;
+        }
+      }
+    }
+  return status;
+}
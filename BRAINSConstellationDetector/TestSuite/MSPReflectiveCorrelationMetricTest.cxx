@@ -0,0 +1,210 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "../src/MSPReflectiveCorrelationMetric.h"
+#include "itkResampleImageFilter.h"
+#include "itkLinearInterpolateImageFunction.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include <vcl_cmath.h>
+#include <algorithm>
+
+typedef MSPReflectiveCorrelationMetric::ImageType     ImageType;
+typedef MSPReflectiveCorrelationMetric::TransformType TransformType;
+
+// Reflective correlation as computed before, from the fully resampled lattice
+static double
+ResampledReflectiveCorrelation( const ImageType * image, const ImageType::PointType & centerOfHeadMass,
+                                const TransformType * transform, const double backgroundValue )
+{
+  const ImageType::SpacingType & inputSpacing = image->GetSpacing();
+  const double                   minSpacing = std::min( inputSpacing[0], std::min( inputSpacing[1], inputSpacing[2] ) );
+
+  ImageType::SpacingType spacing;
+  spacing.Fill( minSpacing );
+  ImageType::SizeType size;
+  size[0] = static_cast<unsigned long int>( 2.0 * vcl_ceil( 95.0 / minSpacing ) );
+  size[1] = static_cast<unsigned long int>( 2.0 * vcl_ceil( 130.0 / minSpacing ) );
+  size[2] = static_cast<unsigned long int>( 2.0 * vcl_ceil( 160.0 / minSpacing ) );
+  ImageType::PointType origin;
+  for( unsigned int i = 0; i < 3; ++i )
+    {
+    origin[i] = centerOfHeadMass[i] - .5 * ( size[i] - 1 ) * spacing[i];
+    }
+  ImageType::DirectionType direction;
+  direction.SetIdentity();
+
+  typedef itk::ResampleImageFilter<ImageType, ImageType> ResampleFilterType;
+  ResampleFilterType::Pointer resampler = ResampleFilterType::New();
+  resampler->SetInterpolator( itk::LinearInterpolateImageFunction<ImageType, double>::New() );
+  resampler->SetDefaultPixelValue( 0 );
+  resampler->SetOutputSpacing( spacing );
+  resampler->SetOutputOrigin( origin );
+  resampler->SetSize( size );
+  resampler->SetOutputDirection( direction );
+  resampler->SetInput( image );
+  resampler->SetTransform( transform );
+  resampler->Update();
+  const ImageType * resampled = resampler->GetOutput();
+
+  double sumVoxelValuesQR = 0.0;
+  double sumSquaredVoxelValuesReflected = 0.0;
+  double sumVoxelValuesReflected = 0.0;
+  double sumSquaredVoxelValues = 0.0;
+  double sumVoxelValues = 0.0;
+  double N = 0;
+  ImageType::IndexType index;
+  for( index[2] = 0; index[2] < static_cast<long>( size[2] ); ++index[2] )
+    {
+    for( index[1] = 0; index[1] < static_cast<long>( size[1] ); ++index[1] )
+      {
+      for( index[0] = 0; index[0] < static_cast<long>( size[0] / 2 ); ++index[0] )
+        {
+        const double f = resampled->GetPixel( index );
+        ImageType::IndexType reflectedIndex = index;
+        reflectedIndex[0] = size[0] - 1 - index[0];
+        const double g = resampled->GetPixel( reflectedIndex );
+        if( f < backgroundValue || g < backgroundValue )
+          {
+          continue;
+          }
+        sumVoxelValuesQR += f * g;
+        sumSquaredVoxelValuesReflected += g * g;
+        sumVoxelValuesReflected += g;
+        sumSquaredVoxelValues += f * f;
+        sumVoxelValues += f;
+        N++;
+        }
+      }
+    }
+  return ( sumVoxelValuesQR - sumVoxelValuesReflected * sumVoxelValues / N )
+         / vcl_sqrt( ( sumSquaredVoxelValues - sumVoxelValues * sumVoxelValues / N )
+                     * ( sumSquaredVoxelValuesReflected - sumVoxelValuesReflected * sumVoxelValuesReflected / N ) );
+}
+
+// Compares the metric against resampling followed by the correlation of the
+// two halves, and checks that threading does not change any value.
+int main(int, char * *)
+{
+  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomType;
+  RandomType::Pointer random = RandomType::New();
+  random->SetSeed( 31415 );
+
+  // an anisotropic, slightly asymmetric "head"
+  ImageType::SizeType size;
+  size[0] = 48;
+  size[1] = 60;
+  size[2] = 36;
+  ImageType::SpacingType spacing;
+  spacing[0] = 4.0;
+  spacing[1] = 4.0;
+  spacing[2] = 5.5;
+  ImageType::PointType origin;
+  origin[0] = -90.0;
+  origin[1] = -120.0;
+  origin[2] = -95.0;
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( size );
+  image->SetSpacing( spacing );
+  image->SetOrigin( origin );
+  image->Allocate();
+
+  itk::ImageRegionIteratorWithIndex<ImageType> it( image, image->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it )
+    {
+    ImageType::PointType p;
+    image->TransformIndexToPhysicalPoint( it.GetIndex(), p );
+    const double r = ( p[0] - 3.0 ) * ( p[0] - 3.0 ) / ( 70.0 * 70.0 ) + p[1] * p[1] / ( 95.0 * 95.0 )
+      + p[2] * p[2] / ( 80.0 * 80.0 );
+    const double value = ( r < 1.0 ) ? 500.0 + 300.0 * vcl_cos( 0.05 * p[1] ) + 2.0 * p[0]
+      + random->GetVariateWithClosedRange( 40.0 ) : random->GetVariateWithClosedRange( 10.0 );
+    it.Set( static_cast<ImageType::PixelType>( value ) );
+    }
+
+  ImageType::PointType centerOfHeadMass;
+  centerOfHeadMass[0] = 2.0;
+  centerOfHeadMass[1] = -3.0;
+  centerOfHeadMass[2] = 1.5;
+  const ImageType::PixelType backgroundValue = 20;
+
+  std::vector<TransformType::Pointer> transforms;
+  for( unsigned int t = 0; t < 6; ++t )
+    {
+    TransformType::Pointer transform = TransformType::New();
+    transform->SetCenter( centerOfHeadMass );
+    transform->SetRotation( 0, 0.03 * t - 0.07, 0.05 * t - 0.1 );
+    TransformType::OutputVectorType translation;
+    translation[0] = 1.5 * t - 4.0;
+    translation[1] = 0.5;
+    translation[2] = -0.25;
+    transform->SetTranslation( translation );
+    transforms.push_back( transform );
+    }
+
+  MSPReflectiveCorrelationMetric singleThreaded;
+  singleThreaded.SetCenterOfHeadMass( centerOfHeadMass );
+  singleThreaded.SetBackgroundValue( backgroundValue );
+  singleThreaded.SetNumberOfThreads( 1 );
+  singleThreaded.SetImage( image );
+
+  MSPReflectiveCorrelationMetric multiThreaded;
+  multiThreaded.SetCenterOfHeadMass( centerOfHeadMass );
+  multiThreaded.SetBackgroundValue( backgroundValue );
+  multiThreaded.SetNumberOfThreads( 7 );
+  multiThreaded.SetImage( image );
+
+  std::vector<double> correlations;
+  multiThreaded.Evaluate( transforms, correlations );
+
+  int status = EXIT_SUCCESS;
+  for( unsigned int t = 0; t < transforms.size(); ++t )
+    {
+    const double expected = ResampledReflectiveCorrelation( image, centerOfHeadMass, transforms[t], backgroundValue );
+    const double single = singleThreaded.Evaluate( transforms[t] );
+    const double multi = multiThreaded.Evaluate( transforms[t] );
+    if( vcl_abs( single - expected ) > 1e-9 )
+      {
+      std::cerr << "Transform " << t << ": correlation " << single << " expected " << expected << std::endl;
+      status = EXIT_FAILURE;
+      }
+    if( single != multi || single != correlations[t] )
+      {
+      std::cerr << "Transform " << t << ": threading changed the correlation " << single << " " << multi
+                << " " << correlations[t] << std::endl;
+      status = EXIT_FAILURE;
+      }
+    }
+
+  // a sampled subset must give the same value with any number of threads too
+  singleThreaded.SetSamplingFraction( 0.25 );
+  singleThreaded.SetImage( image );
+  multiThreaded.SetSamplingFraction( 0.25 );
+  multiThreaded.SetImage( image );
+  for( unsigned int t = 0; t < transforms.size(); ++t )
+    {
+    const double single = singleThreaded.Evaluate( transforms[t] );
+    const double multi = multiThreaded.Evaluate( transforms[t] );
+    if( single != multi || vcl_abs( single - correlations[t] ) > 0.05 )
+      {
+      std::cerr << "Transform " << t << ": sampled correlation " << single << " " << multi
+                << " full " << correlations[t] << std::endl;
+      status = EXIT_FAILURE;
+      }
+    }
+  return status;
+}
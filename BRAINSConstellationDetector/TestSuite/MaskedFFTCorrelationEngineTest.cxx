@@ -0,0 +1,143 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "../src/MaskedFFTCorrelationEngine.h"
+#include "itkMaskedFFTNormalizedCorrelationImageFilter.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include <vcl_cmath.h>
+
+typedef MaskedFFTCorrelationEngine::ImageType     ImageType;
+typedef MaskedFFTCorrelationEngine::MaskImageType MaskImageType;
+
+template <class TImage>
+static typename TImage::Pointer
+MakeImage( const unsigned int sx, const unsigned int sy, const unsigned int sz )
+{
+  typename TImage::SizeType size;
+  size[0] = sx;
+  size[1] = sy;
+  size[2] = sz;
+  typename TImage::Pointer image = TImage::New();
+  image->SetRegions( size );
+  image->Allocate();
+  image->FillBuffer( 0 );
+  return image;
+}
+
+// Compares the engine against itk::MaskedFFTNormalizedCorrelationImageFilter
+// for several moving images sharing one moving mask.
+int main(int, char * *)
+{
+  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomType;
+  RandomType::Pointer random = RandomType::New();
+  random->SetSeed( 5381 );
+
+  ImageType::Pointer     fixedImage = MakeImage<ImageType>( 17, 13, 11 );
+  MaskImageType::Pointer fixedMask = MakeImage<MaskImageType>( 17, 13, 11 );
+  itk::ImageRegionConstIteratorWithIndex<ImageType> fit( fixedImage, fixedImage->GetLargestPossibleRegion() );
+  for( ; !fit.IsAtEnd(); ++fit )
+    {
+    const ImageType::IndexType & idx = fit.GetIndex();
+    fixedImage->SetPixel( idx, random->GetVariateWithClosedRange( 1.0 ) );
+    // a spherical fixed mask, as produced by the ROI extraction
+    const double dx = idx[0] - 8.0;
+    const double dy = idx[1] - 6.0;
+    const double dz = idx[2] - 5.0;
+    fixedMask->SetPixel( idx, ( dx * dx + dy * dy + dz * dz < 40.0 ) ? 1 : 0 );
+    }
+
+  // a cylindrical moving mask, as used for the landmark templates
+  MaskImageType::Pointer movingMask = MakeImage<MaskImageType>( 5, 5, 5 );
+  itk::ImageRegionConstIteratorWithIndex<MaskImageType> mit( movingMask, movingMask->GetLargestPossibleRegion() );
+  for( ; !mit.IsAtEnd(); ++mit )
+    {
+    const MaskImageType::IndexType & idx = mit.GetIndex();
+    const double dy = idx[1] - 2.0;
+    const double dz = idx[2] - 2.0;
+    movingMask->SetPixel( idx, ( dy * dy + dz * dz <= 4.0 ) ? 1 : 0 );
+    }
+
+  MaskedFFTCorrelationEngine engine;
+  engine.Initialize( fixedImage, fixedMask, movingMask, 1 );
+
+  int status = EXIT_SUCCESS;
+  for( unsigned int trial = 0; trial < 4; ++trial )
+    {
+    ImageType::Pointer movingImage = MakeImage<ImageType>( 5, 5, 5 );
+    for( mit.GoToBegin(); !mit.IsAtEnd(); ++mit )
+      {
+      if( mit.Get() != 0 )
+        {
+        movingImage->SetPixel( mit.GetIndex(), random->GetVariateWithClosedRange( 1.0 ) );
+        }
+      }
+
+    typedef itk::MaskedFFTNormalizedCorrelationImageFilter<ImageType, ImageType, MaskImageType> CorrelationFilterType;
+    CorrelationFilterType::Pointer correlationFilter = CorrelationFilterType::New();
+    correlationFilter->SetFixedImage( fixedImage );
+    correlationFilter->SetFixedImageMask( fixedMask );
+    correlationFilter->SetMovingImage( movingImage );
+    correlationFilter->SetMovingImageMask( movingMask );
+    correlationFilter->SetRequiredFractionOfOverlappingPixels( 1 );
+    correlationFilter->Update();
+    ImageType::Pointer reference = correlationFilter->GetOutput();
+
+    if( reference->GetLargestPossibleRegion().GetSize() != engine.GetCorrelationSize() )
+      {
+      std::cerr << "Correlation size mismatch: " << engine.GetCorrelationSize() << " vs "
+                << reference->GetLargestPossibleRegion().GetSize() << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    ImageType::Pointer correlationImage = ImageType::New();
+    correlationImage->SetRegions( engine.GetCorrelationSize() );
+    correlationImage->Allocate();
+
+    double               maximum;
+    ImageType::IndexType indexOfMaximum;
+    engine.ComputeMaximumCorrelation( movingImage, maximum, indexOfMaximum, correlationImage );
+
+    double referenceMaximum = itk::NumericTraits<double>::NonpositiveMin();
+    ImageType::IndexType referenceIndexOfMaximum;
+    referenceIndexOfMaximum.Fill( 0 );
+    itk::ImageRegionConstIteratorWithIndex<ImageType> rit( reference, reference->GetLargestPossibleRegion() );
+    for( ; !rit.IsAtEnd(); ++rit )
+      {
+      const double difference = vcl_abs( rit.Get() - correlationImage->GetPixel( rit.GetIndex() ) );
+      if( difference > 1e-4 )
+        {
+        std::cerr << "Trial " << trial << ": correlation differs at " << rit.GetIndex()
+                  << " by " << difference << std::endl;
+        status = EXIT_FAILURE;
+        }
+      if( rit.Get() > referenceMaximum )
+        {
+        referenceMaximum = rit.Get();
+        referenceIndexOfMaximum = rit.GetIndex();
+        }
+      }
+    if( indexOfMaximum != referenceIndexOfMaximum || vcl_abs( maximum - referenceMaximum ) > 1e-4 )
+      {
+      std::cerr << "Trial " << trial << ": maximum " << maximum << " at " << indexOfMaximum
+                << " expected " << referenceMaximum << " at " << referenceIndexOfMaximum << std::endl;
+      status = EXIT_FAILURE;
+      }
+    }
+  return status;
+}
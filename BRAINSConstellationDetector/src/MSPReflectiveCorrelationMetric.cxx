@@ -0,0 +1,392 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "MSPReflectiveCorrelationMetric.h"
+
+#include "itkNumericTraits.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "vcl_cmath.h"
+
+#include <algorithm>
+
+MSPReflectiveCorrelationMetric::MSPReflectiveCorrelationMetric() :
+  m_Image(ITK_NULLPTR),
+  m_Buffer(ITK_NULLPTR),
+  m_CenterOfHeadMass(),
+  m_BackgroundValue(0),
+  m_SamplingFraction(1.0),
+  m_NumberOfThreads(0)
+{
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    m_BufferStart[d] = 0;
+    m_BufferEnd[d] = -1;
+    m_BufferSize[d] = 0;
+    }
+  m_CenterOfHeadMass.Fill(0.0);
+  m_LatticeSpacing.Fill(1.0);
+  m_LatticeSize.Fill(0);
+  m_LatticeOrigin.Fill(0.0);
+}
+
+void
+MSPReflectiveCorrelationMetric::SetImage( const ImageType * image )
+{
+  m_Image = image;
+  m_Buffer = image->GetBufferPointer();
+  const ImageType::RegionType bufferedRegion = image->GetBufferedRegion();
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    m_BufferStart[d] = bufferedRegion.GetIndex()[d];
+    m_BufferSize[d] = bufferedRegion.GetSize()[d];
+    m_BufferEnd[d] = m_BufferStart[d] + static_cast<long>( m_BufferSize[d] ) - 1;
+    }
+
+  // Isotropic lattice at the smallest image spacing
+  const ImageType::SpacingType & inputImageSpacing = image->GetSpacing();
+  double                         minSpacing = inputImageSpacing[0];
+  for( unsigned int i = 1; i < 3; ++i )
+    {
+    minSpacing = std::min(minSpacing, inputImageSpacing[i]);
+    }
+  m_LatticeSpacing.Fill( minSpacing );
+
+  // Desire a 95*2 x 130*2 x 160x2 mm voxel lattice that will fit a brain
+  m_LatticeSize[0] = static_cast<unsigned long int>( 2.0 * vcl_ceil(95.0  / m_LatticeSpacing[0]) );
+  m_LatticeSize[1] = static_cast<unsigned long int>( 2.0 * vcl_ceil(130.0 / m_LatticeSpacing[1]) );
+  m_LatticeSize[2] = static_cast<unsigned long int>( 2.0 * vcl_ceil(160.0 / m_LatticeSpacing[2]) );
+
+  // The physical center of MSP plane is not determined yet. At the
+  // optimizing stage we take COM as physical center
+  for( unsigned int i = 0; i < 3; ++i )
+    {
+    m_LatticeOrigin[i] = m_CenterOfHeadMass[i] - .5 * ( m_LatticeSize[i] - 1 ) * m_LatticeSpacing[i];
+    }
+
+  m_SampledVoxels.clear();
+  if( m_SamplingFraction < 1.0 )
+    {
+    typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomizerType;
+    RandomizerType::Pointer randomizer = RandomizerType::New();
+    randomizer->SetSeed( 1234 );
+
+    const unsigned int halfSizeX = m_LatticeSize[0] / 2;
+    m_SampledVoxels.resize( m_LatticeSize[2] );
+    for( unsigned int z = 0; z < m_LatticeSize[2]; ++z )
+      {
+      for( unsigned int y = 0; y < m_LatticeSize[1]; ++y )
+        {
+        for( unsigned int x = 0; x < halfSizeX; ++x )
+          {
+          if( randomizer->GetUniformVariate( 0.0, 1.0 ) < m_SamplingFraction )
+            {
+            m_SampledVoxels[z].push_back( x + y * m_LatticeSize[0] );
+            }
+          }
+        }
+      }
+    }
+}
+
+MSPReflectiveCorrelationMetric::PointType
+MSPReflectiveCorrelationMetric::GetLatticeCenter() const
+{
+  PointType center;
+  for( unsigned int i = 0; i < 3; ++i )
+    {
+    center[i] = m_LatticeOrigin[i] + 0.5 * ( m_LatticeSize[i] - 1 ) * m_LatticeSpacing[i];
+    }
+  return center;
+}
+
+MSPReflectiveCorrelationMetric::LatticeMapping
+MSPReflectiveCorrelationMetric::ComputeLatticeMapping( const TransformType * transform ) const
+{
+  // The lattice direction is the identity, and the transform is linear, so
+  // the input continuous index is an affine function of the lattice index.
+  typedef itk::ContinuousIndex<double, 3> ContinuousIndexType;
+
+  ContinuousIndexType corners[4];
+  for( unsigned int c = 0; c < 4; ++c )
+    {
+    PointType latticePoint = m_LatticeOrigin;
+    if( c > 0 )
+      {
+      latticePoint[c - 1] += m_LatticeSpacing[c - 1];
+      }
+    m_Image->TransformPhysicalPointToContinuousIndex( transform->TransformPoint( latticePoint ), corners[c] );
+    }
+
+  LatticeMapping mapping;
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    mapping.start[d] = corners[0][d];
+    mapping.stepX[d] = corners[1][d] - corners[0][d];
+    mapping.stepY[d] = corners[2][d] - corners[0][d];
+    mapping.stepZ[d] = corners[3][d] - corners[0][d];
+    }
+  return mapping;
+}
+
+double
+MSPReflectiveCorrelationMetric::InterpolatedResampledValue( const double continuousIndex[3] ) const
+{
+  long   lower[3];
+  long   upper[3];
+  double distance[3];
+
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    // outside the buffer the resampler writes the default value 0
+    if( continuousIndex[d] < m_BufferStart[d] - 0.5 || continuousIndex[d] >= m_BufferEnd[d] + 0.5 )
+      {
+      return 0.0;
+      }
+    lower[d] = std::max( static_cast<long>( vcl_floor( continuousIndex[d] ) ), m_BufferStart[d] );
+    distance[d] = continuousIndex[d] - lower[d];
+    upper[d] = ( distance[d] > 0.0 && lower[d] < m_BufferEnd[d] ) ? lower[d] + 1 : lower[d];
+    lower[d] -= m_BufferStart[d];
+    upper[d] -= m_BufferStart[d];
+    }
+
+  const unsigned long strideY = m_BufferSize[0];
+  const unsigned long strideZ = m_BufferSize[0] * m_BufferSize[1];
+  double              valueZ[2];
+  for( unsigned int k = 0; k < 2; ++k )
+    {
+    const unsigned long offsetZ = ( k == 0 ? lower[2] : upper[2] ) * strideZ;
+    double              valueY[2];
+    for( unsigned int j = 0; j < 2; ++j )
+      {
+      const ImageType::PixelType * row = m_Buffer + offsetZ + ( j == 0 ? lower[1] : upper[1] ) * strideY;
+      const double                 value0 = row[lower[0]];
+      valueY[j] = value0 + ( row[upper[0]] - value0 ) * distance[0];
+      }
+    valueZ[k] = valueY[0] + ( valueY[1] - valueY[0] ) * distance[1];
+    }
+  const double value = valueZ[0] + ( valueZ[1] - valueZ[0] ) * distance[2];
+
+  // the resampled image had the input pixel type
+  if( value <= itk::NumericTraits<ImageType::PixelType>::NonpositiveMin() )
+    {
+    return itk::NumericTraits<ImageType::PixelType>::NonpositiveMin();
+    }
+  if( value >= itk::NumericTraits<ImageType::PixelType>::max() )
+    {
+    return itk::NumericTraits<ImageType::PixelType>::max();
+    }
+  return static_cast<ImageType::PixelType>( value );
+}
+
+void
+MSPReflectiveCorrelationMetric::ComputeSliceSums( const LatticeMapping & mapping,
+                                                  const unsigned int slice,
+                                                  SliceSums & sums ) const
+{
+  sums = SliceSums();
+  sums.numberOfVoxels = 0;
+
+  const unsigned int xMaxIndex = m_LatticeSize[0] - 1;
+  const unsigned int halfSizeX = m_LatticeSize[0] / 2; // Only need to do 1/2 in the x direction;
+
+  double sliceStart[3];
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    sliceStart[d] = mapping.start[d] + slice * mapping.stepZ[d];
+    }
+
+  const bool                         useSubset = !m_SampledVoxels.empty();
+  const std::vector<unsigned int> *  subset = useSubset ? &( m_SampledVoxels[slice] ) : ITK_NULLPTR;
+  const size_t                       numberOfVoxels = useSubset ? subset->size()
+    : static_cast<size_t>( halfSizeX ) * m_LatticeSize[1];
+  for( size_t v = 0; v < numberOfVoxels; ++v )
+    {
+    const unsigned int offset = useSubset ? ( *subset )[v]
+      : static_cast<unsigned int>( ( v / halfSizeX ) * m_LatticeSize[0] + v % halfSizeX );
+    const unsigned int x = offset % m_LatticeSize[0];
+    const unsigned int y = offset / m_LatticeSize[0];
+
+    double rowStart[3];
+    double index[3];
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      rowStart[d] = sliceStart[d] + y * mapping.stepY[d];
+      index[d] = rowStart[d] + x * mapping.stepX[d];
+      }
+    // NOTE:  Only need to compute left half of space because of reflection.
+    const double _f = this->InterpolatedResampledValue( index );
+    if( _f < this->m_BackgroundValue )  // don't worry about background
+                                        // voxels.
+      {
+      continue;
+      }
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      index[d] = rowStart[d] + ( xMaxIndex - x ) * mapping.stepX[d];
+      }
+    const double g = this->InterpolatedResampledValue( index );
+    if( g < this->m_BackgroundValue )  // don't worry about background voxels.
+      {
+      continue;
+      }
+    sums.sumVoxelValuesQR += _f * g;
+    sums.sumSquaredVoxelValuesReflected += g * g;
+    sums.sumVoxelValuesReflected += g;
+    sums.sumSquaredVoxelValues += _f * _f;
+    sums.sumVoxelValues += _f;
+    sums.numberOfVoxels++;
+    }
+}
+
+double
+MSPReflectiveCorrelationMetric::ReduceSliceSums( const std::vector<SliceSums> & sliceSums ) const
+{
+  CompensatedSummationType CS_sumVoxelValuesQR;
+  CompensatedSummationType CS_sumSquaredVoxelValuesReflected;
+  CompensatedSummationType CS_sumVoxelValuesReflected;
+  CompensatedSummationType CS_sumSquaredVoxelValues;
+  CompensatedSummationType CS_sumVoxelValues;
+  unsigned long            N = 0;
+  for( size_t s = 0; s < sliceSums.size(); ++s )
+    {
+    CS_sumVoxelValuesQR += sliceSums[s].sumVoxelValuesQR.GetSum();
+    CS_sumSquaredVoxelValuesReflected += sliceSums[s].sumSquaredVoxelValuesReflected.GetSum();
+    CS_sumVoxelValuesReflected += sliceSums[s].sumVoxelValuesReflected.GetSum();
+    CS_sumSquaredVoxelValues += sliceSums[s].sumSquaredVoxelValues.GetSum();
+    CS_sumVoxelValues += sliceSums[s].sumVoxelValues.GetSum();
+    N += sliceSums[s].numberOfVoxels;
+    }
+  const double sumVoxelValuesQR = CS_sumVoxelValuesQR.GetSum();
+  const double sumSquaredVoxelValuesReflected = CS_sumSquaredVoxelValuesReflected.GetSum();
+  const double sumVoxelValuesReflected = CS_sumVoxelValuesReflected.GetSum();
+  const double sumSquaredVoxelValues = CS_sumSquaredVoxelValues.GetSum();
+  const double sumVoxelValues = CS_sumVoxelValues.GetSum();
+
+  if( N == 0
+      || ( ( sumSquaredVoxelValues - sumVoxelValues * sumVoxelValues
+             / N ) * ( sumSquaredVoxelValuesReflected - sumVoxelValuesReflected * sumVoxelValuesReflected / N ) ) ==
+      0.0 )
+    {
+    return 0.0;
+    }
+  const double cc =
+    ( ( sumVoxelValuesQR - sumVoxelValuesReflected * sumVoxelValues
+        / N )
+      / vcl_sqrt( ( sumSquaredVoxelValues - sumVoxelValues * sumVoxelValues
+                    / N )
+                  * ( sumSquaredVoxelValuesReflected - sumVoxelValuesReflected * sumVoxelValuesReflected / N ) ) );
+  return cc;
+}
+
+unsigned int
+MSPReflectiveCorrelationMetric::GetNumberOfThreadsToUse( const size_t numberOfWorkItems ) const
+{
+  const unsigned int numberOfThreads = ( m_NumberOfThreads > 0 ) ? m_NumberOfThreads
+    : itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+
+  return static_cast<unsigned int>( std::max<size_t>( std::min<size_t>( numberOfThreads, numberOfWorkItems ), 1 ) );
+}
+
+ITK_THREAD_RETURN_TYPE
+MSPReflectiveCorrelationMetric::SlicesThreaderCallback( void *arg )
+{
+  const itk::ThreadIdType threadId = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->ThreadID;
+  const itk::ThreadIdType threadCount = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->NumberOfThreads;
+
+  EvaluationThreadStruct *str = (EvaluationThreadStruct *)( ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->UserData);
+
+  const unsigned int numberOfSlices = str->sliceSums->size();
+  const unsigned int slicesPerThread = ( numberOfSlices + threadCount - 1 ) / threadCount;
+  const unsigned int first = std::min( threadId * slicesPerThread, numberOfSlices );
+  const unsigned int last = std::min( first + slicesPerThread, numberOfSlices );
+  for( unsigned int s = first; s < last; ++s )
+    {
+    str->metric->ComputeSliceSums( *( str->mapping ), s, ( *str->sliceSums )[s] );
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+ITK_THREAD_RETURN_TYPE
+MSPReflectiveCorrelationMetric::TransformsThreaderCallback( void *arg )
+{
+  const itk::ThreadIdType threadId = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->ThreadID;
+  const itk::ThreadIdType threadCount = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->NumberOfThreads;
+
+  EvaluationThreadStruct *str = (EvaluationThreadStruct *)( ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->UserData);
+
+  const size_t numberOfTransforms = str->transforms->size();
+  const size_t transformsPerThread = ( numberOfTransforms + threadCount - 1 ) / threadCount;
+  const size_t first = std::min( threadId * transformsPerThread, numberOfTransforms );
+  const size_t last = std::min( first + transformsPerThread, numberOfTransforms );
+
+  std::vector<SliceSums> sliceSums( str->metric->m_LatticeSize[2] );
+  for( size_t t = first; t < last; ++t )
+    {
+    const LatticeMapping mapping = str->metric->ComputeLatticeMapping( ( *str->transforms )[t] );
+    for( unsigned int s = 0; s < sliceSums.size(); ++s )
+      {
+      str->metric->ComputeSliceSums( mapping, s, sliceSums[s] );
+      }
+    ( *str->correlations )[t] = str->metric->ReduceSliceSums( sliceSums );
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+double
+MSPReflectiveCorrelationMetric::Evaluate( const TransformType * transform ) const
+{
+  const LatticeMapping   mapping = this->ComputeLatticeMapping( transform );
+  std::vector<SliceSums> sliceSums( m_LatticeSize[2] );
+
+  EvaluationThreadStruct str;
+  str.metric = this;
+  str.transforms = ITK_NULLPTR;
+  str.correlations = ITK_NULLPTR;
+  str.mapping = &mapping;
+  str.sliceSums = &sliceSums;
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads( this->GetNumberOfThreadsToUse( sliceSums.size() ) );
+  threader->SetSingleMethod( SlicesThreaderCallback, &str );
+  threader->SingleMethodExecute();
+
+  return this->ReduceSliceSums( sliceSums );
+}
+
+void
+MSPReflectiveCorrelationMetric::Evaluate( const std::vector<TransformType::Pointer> & transforms,
+                                          std::vector<double> & correlations ) const
+{
+  correlations.assign( transforms.size(), 0.0 );
+  if( transforms.empty() )
+    {
+    return;
+    }
+
+  EvaluationThreadStruct str;
+  str.metric = this;
+  str.transforms = &transforms;
+  str.correlations = &correlations;
+  str.mapping = ITK_NULLPTR;
+  str.sliceSums = ITK_NULLPTR;
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads( this->GetNumberOfThreadsToUse( transforms.size() ) );
+  threader->SetSingleMethod( TransformsThreaderCallback, &str );
+  threader->SingleMethodExecute();
+}
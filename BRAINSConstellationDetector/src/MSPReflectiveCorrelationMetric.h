@@ -0,0 +1,157 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __MSPReflectiveCorrelationMetric_h
+#define __MSPReflectiveCorrelationMetric_h
+
+#include "itkImage.h"
+#include "itkEuler3DTransform.h"
+#include "itkCompensatedSummation.h"
+#include "itkMultiThreader.h"
+
+#include <vector>
+
+/**
+ * Reflective correlation of an image with its mirror image across the
+ * mid-sagittal plane of a candidate rigid transform.
+ *
+ * The image is sampled on a lattice of isotropic voxels centered on the
+ * center of head mass, the same lattice the resampled image used to have.
+ * Instead of resampling the whole lattice for each transform, every voxel
+ * of the left half and its mirrored voxel are interpolated directly from the
+ * input image, with the lattice to input index mapping reduced to a start
+ * point and three step vectors.
+ *
+ * Sums are kept per lattice slice and reduced in slice order, so the value
+ * does not depend on the number of threads.  A fixed random subset of the
+ * left half voxels can be used instead of all of them for coarse levels.
+ */
+class MSPReflectiveCorrelationMetric
+{
+public:
+  typedef itk::Image<short, 3>          ImageType;
+  typedef itk::Euler3DTransform<double> TransformType;
+  typedef ImageType::PointType          PointType;
+
+  MSPReflectiveCorrelationMetric();
+
+  /** Image to sample; the lattice spacing is the smallest image spacing.
+   *  centerOfHeadMass must be set before. */
+  void SetImage( const ImageType * image );
+
+  void SetCenterOfHeadMass( const PointType & centerOfHeadMass )
+  {
+    m_CenterOfHeadMass = centerOfHeadMass;
+  }
+
+  /** Voxels darker than this in either half are ignored */
+  void SetBackgroundValue( const ImageType::PixelType backgroundValue )
+  {
+    m_BackgroundValue = backgroundValue;
+  }
+
+  /** Fraction of the left half voxels used, 1 (the default) uses all. Takes
+   *  effect at the next SetImage(). */
+  void SetSamplingFraction( const double samplingFraction )
+  {
+    m_SamplingFraction = samplingFraction;
+  }
+
+  /** 0 (the default) uses the ITK default number of threads */
+  void SetNumberOfThreads( const unsigned int numberOfThreads )
+  {
+    m_NumberOfThreads = numberOfThreads;
+  }
+
+  /** Physical center of the sampling lattice */
+  PointType GetLatticeCenter() const;
+
+  /** Correlation for one transform, threaded over the lattice slices */
+  double Evaluate( const TransformType * transform ) const;
+
+  /** Correlations for many transforms, threaded over the transforms.  Each
+   *  value is identical to the one Evaluate() returns. */
+  void Evaluate( const std::vector<TransformType::Pointer> & transforms, std::vector<double> & correlations ) const;
+
+private:
+  typedef itk::CompensatedSummation<double> CompensatedSummationType;
+
+  struct SliceSums
+    {
+    CompensatedSummationType sumVoxelValuesQR;
+    CompensatedSummationType sumSquaredVoxelValuesReflected;
+    CompensatedSummationType sumVoxelValuesReflected;
+    CompensatedSummationType sumSquaredVoxelValues;
+    CompensatedSummationType sumVoxelValues;
+    unsigned long            numberOfVoxels;
+    };
+
+  /* input continuous index of lattice voxel (x,y,z) is start + x*stepX + y*stepY + z*stepZ */
+  struct LatticeMapping
+    {
+    double start[3];
+    double stepX[3];
+    double stepY[3];
+    double stepZ[3];
+    };
+
+  struct EvaluationThreadStruct
+    {
+    const MSPReflectiveCorrelationMetric *      metric;
+    const std::vector<TransformType::Pointer> * transforms;
+    std::vector<double> *                       correlations;
+    const LatticeMapping *                      mapping;
+    std::vector<SliceSums> *                    sliceSums;
+    };
+
+  LatticeMapping ComputeLatticeMapping( const TransformType * transform ) const;
+
+  void ComputeSliceSums( const LatticeMapping & mapping, const unsigned int slice, SliceSums & sums ) const;
+
+  double ReduceSliceSums( const std::vector<SliceSums> & sliceSums ) const;
+
+  /* value the linear resampler would have written for the continuous index */
+  double InterpolatedResampledValue( const double continuousIndex[3] ) const;
+
+  unsigned int GetNumberOfThreadsToUse( const size_t numberOfWorkItems ) const;
+
+  static ITK_THREAD_RETURN_TYPE SlicesThreaderCallback( void *arg );
+
+  static ITK_THREAD_RETURN_TYPE TransformsThreaderCallback( void *arg );
+
+  ImageType::ConstPointer      m_Image;
+  const ImageType::PixelType * m_Buffer;
+  long                         m_BufferStart[3];
+  long                         m_BufferEnd[3];
+  unsigned long                m_BufferSize[3];
+
+  PointType            m_CenterOfHeadMass;
+  ImageType::PixelType m_BackgroundValue;
+  double               m_SamplingFraction;
+  unsigned int         m_NumberOfThreads;
+
+  ImageType::SpacingType m_LatticeSpacing;
+  ImageType::SizeType    m_LatticeSize;
+  PointType              m_LatticeOrigin;
+
+  /* per slice, the x + y * size[0] offsets of the left half voxels in the
+   * random subset; empty when all voxels are used */
+  std::vector<std::vector<unsigned int> > m_SampledVoxels;
+};
+
+#endif
@@ -0,0 +1,306 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "MaskedFFTCorrelationEngine.h"
+
+#include "itkNumericTraits.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "vnl/algo/vnl_fft_3d.h"
+#include "vcl_cmath.h"
+
+#include <algorithm>
+
+MaskedFFTCorrelationEngine::MaskedFFTCorrelationEngine() :
+  m_NumberOfPaddedPixels(0)
+{
+  m_FixedSize.Fill(0);
+  m_MovingSize.Fill(0);
+  m_CorrelationSize.Fill(0);
+  m_PaddedSize[0] = m_PaddedSize[1] = m_PaddedSize[2] = 0;
+}
+
+unsigned int
+MaskedFFTCorrelationEngine::GetFFTFriendlySize( const unsigned int minimumSize )
+{
+  // vnl_fft only factors 2, 3 and 5
+  for( unsigned int size = minimumSize; ; ++size )
+    {
+    unsigned int remainder = size;
+    while( remainder % 2 == 0 )
+      {
+      remainder /= 2;
+      }
+    while( remainder % 3 == 0 )
+      {
+      remainder /= 3;
+      }
+    while( remainder % 5 == 0 )
+      {
+      remainder /= 5;
+      }
+    if( remainder == 1 )
+      {
+      return size;
+      }
+    }
+}
+
+void
+MaskedFFTCorrelationEngine::FillPaddedBuffer( const ImageType * image,
+                                              const MaskImageType * mask,
+                                              const bool squared,
+                                              const bool rotated,
+                                              ComplexBufferType & buffer ) const
+{
+  buffer.assign( m_NumberOfPaddedPixels, ComplexType( 0.0, 0.0 ) );
+
+  const MaskImageType::RegionType region = mask->GetLargestPossibleRegion();
+  const MaskImageType::IndexType  start = region.GetIndex();
+  const MaskImageType::SizeType   size = region.GetSize();
+
+  itk::ImageRegionConstIteratorWithIndex<MaskImageType> maskIt( mask, region );
+  for( maskIt.GoToBegin(); !maskIt.IsAtEnd(); ++maskIt )
+    {
+    if( maskIt.Get() <= 0 )
+      {
+      continue;
+      }
+    const MaskImageType::IndexType index = maskIt.GetIndex();
+
+    double value = 1.0;
+    if( image != ITK_NULLPTR )
+      {
+      value = image->GetPixel( index );
+      if( squared )
+        {
+        value *= value;
+        }
+      }
+
+    size_t offset = 0;
+    for( int d = 2; d >= 0; --d )
+      {
+      const itk::IndexValueType position = index[d] - start[d];
+      offset = offset * m_PaddedSize[d] + ( rotated ? ( size[d] - 1 - position ) : position );
+      }
+    buffer[offset] = ComplexType( value, 0.0 );
+    }
+}
+
+void
+MaskedFFTCorrelationEngine::ForwardFFT( ComplexBufferType & buffer ) const
+{
+  // slowest dimension first, as the image buffer is laid out
+  vnl_fft_3d<double> fft( m_PaddedSize[2], m_PaddedSize[1], m_PaddedSize[0] );
+
+  fft.transform( &( buffer[0] ), -1 );
+}
+
+void
+MaskedFFTCorrelationEngine::InverseFFTOfProduct( const ComplexBufferType & a,
+                                                 const ComplexBufferType & b,
+                                                 ComplexBufferType & result ) const
+{
+  result.resize( m_NumberOfPaddedPixels );
+  for( size_t i = 0; i < m_NumberOfPaddedPixels; ++i )
+    {
+    result[i] = a[i] * b[i];
+    }
+
+  vnl_fft_3d<double> fft( m_PaddedSize[2], m_PaddedSize[1], m_PaddedSize[0] );
+  fft.transform( &( result[0] ), +1 );
+
+  const double scale = 1.0 / static_cast<double>( m_NumberOfPaddedPixels );
+  for( size_t i = 0; i < m_NumberOfPaddedPixels; ++i )
+    {
+    result[i] *= scale;
+    }
+}
+
+void
+MaskedFFTCorrelationEngine::Initialize( const ImageType * fixedImage,
+                                        const MaskImageType * fixedMask,
+                                        const MaskImageType * movingMask,
+                                        const double requiredFractionOfOverlappingPixels )
+{
+  if( fixedImage->GetLargestPossibleRegion() != fixedMask->GetLargestPossibleRegion() )
+    {
+    itkGenericExceptionMacro(<< "The fixed image and its mask must have the same region.");
+    }
+
+  m_FixedSize = fixedImage->GetLargestPossibleRegion().GetSize();
+  m_MovingSize = movingMask->GetLargestPossibleRegion().GetSize();
+  m_NumberOfPaddedPixels = 1;
+  for( unsigned int d = 0; d < 3; ++d )
+    {
+    m_CorrelationSize[d] = m_FixedSize[d] + m_MovingSize[d] - 1;
+    m_PaddedSize[d] = GetFFTFriendlySize( m_CorrelationSize[d] );
+    m_NumberOfPaddedPixels *= m_PaddedSize[d];
+    }
+
+  FillPaddedBuffer( fixedImage, fixedMask, false, false, m_FixedSpectrum );
+  ForwardFFT( m_FixedSpectrum );
+  FillPaddedBuffer( ITK_NULLPTR, fixedMask, false, false, m_FixedMaskSpectrum );
+  ForwardFFT( m_FixedMaskSpectrum );
+
+  ComplexBufferType fixedSquaredSpectrum;
+  FillPaddedBuffer( fixedImage, fixedMask, true, false, fixedSquaredSpectrum );
+  ForwardFFT( fixedSquaredSpectrum );
+
+  ComplexBufferType rotatedMovingMaskSpectrum;
+  FillPaddedBuffer( ITK_NULLPTR, movingMask, false, true, rotatedMovingMaskSpectrum );
+  ForwardFFT( rotatedMovingMaskSpectrum );
+
+  // terms that do not depend on the moving image values
+  ComplexBufferType overlap;
+  InverseFFTOfProduct( m_FixedMaskSpectrum, rotatedMovingMaskSpectrum, overlap );
+  ComplexBufferType fixedCorrelatedWithMovingMask;
+  InverseFFTOfProduct( m_FixedSpectrum, rotatedMovingMaskSpectrum, fixedCorrelatedWithMovingMask );
+  ComplexBufferType fixedSquaredCorrelatedWithMovingMask;
+  InverseFFTOfProduct( fixedSquaredSpectrum, rotatedMovingMaskSpectrum, fixedSquaredCorrelatedWithMovingMask );
+
+  m_NumberOfOverlapPixels.resize( m_NumberOfPaddedPixels );
+  m_FixedCorrelatedWithMovingMask.resize( m_NumberOfPaddedPixels );
+  m_FixedDenominator.resize( m_NumberOfPaddedPixels );
+  double maximumNumberOfOverlapPixels = 0.0;
+  for( size_t i = 0; i < m_NumberOfPaddedPixels; ++i )
+    {
+    const double numberOfOverlapPixels = std::max( vcl_floor( overlap[i].real() + 0.5 ), 0.0 );
+    m_NumberOfOverlapPixels[i] = numberOfOverlapPixels;
+    maximumNumberOfOverlapPixels = std::max( maximumNumberOfOverlapPixels, numberOfOverlapPixels );
+
+    m_FixedCorrelatedWithMovingMask[i] = fixedCorrelatedWithMovingMask[i].real();
+    m_FixedDenominator[i] = 0.0;
+    if( numberOfOverlapPixels > 0.0 )
+      {
+      m_FixedDenominator[i] = std::max( fixedSquaredCorrelatedWithMovingMask[i].real()
+                                        - m_FixedCorrelatedWithMovingMask[i] * m_FixedCorrelatedWithMovingMask[i]
+                                        / numberOfOverlapPixels, 0.0 );
+      }
+    }
+
+  const double requiredNumberOfOverlappingPixels = requiredFractionOfOverlappingPixels * maximumNumberOfOverlapPixels;
+  m_EnoughOverlap.resize( m_NumberOfPaddedPixels );
+  for( size_t i = 0; i < m_NumberOfPaddedPixels; ++i )
+    {
+    m_EnoughOverlap[i] = ( m_NumberOfOverlapPixels[i] > 0.0
+                           && m_NumberOfOverlapPixels[i] >= requiredNumberOfOverlappingPixels );
+    }
+}
+
+void
+MaskedFFTCorrelationEngine::ComputeMaximumCorrelation( const ImageType * movingImage,
+                                                       double & maximum,
+                                                       IndexType & indexOfMaximum,
+                                                       ImageType * correlationImage ) const
+{
+  if( movingImage->GetLargestPossibleRegion().GetSize() != m_MovingSize )
+    {
+    itkGenericExceptionMacro(<< "The moving image must have the size of the moving mask.");
+    }
+
+  // the template is zero outside its mask, and zeros add nothing to the spectra
+  ComplexBufferType rotatedMovingSpectrum( m_NumberOfPaddedPixels, ComplexType( 0.0, 0.0 ) );
+  ComplexBufferType rotatedMovingSquaredSpectrum( m_NumberOfPaddedPixels, ComplexType( 0.0, 0.0 ) );
+  {
+  const ImageType::RegionType region = movingImage->GetLargestPossibleRegion();
+  const ImageType::IndexType  start = region.GetIndex();
+
+  itk::ImageRegionConstIteratorWithIndex<ImageType> movingIt( movingImage, region );
+  for( movingIt.GoToBegin(); !movingIt.IsAtEnd(); ++movingIt )
+    {
+    const double value = movingIt.Get();
+    if( value == 0.0 )
+      {
+      continue;
+      }
+    const ImageType::IndexType index = movingIt.GetIndex();
+    size_t                     offset = 0;
+    for( int d = 2; d >= 0; --d )
+      {
+      offset = offset * m_PaddedSize[d] + ( m_MovingSize[d] - 1 - ( index[d] - start[d] ) );
+      }
+    rotatedMovingSpectrum[offset] = ComplexType( value, 0.0 );
+    rotatedMovingSquaredSpectrum[offset] = ComplexType( value * value, 0.0 );
+    }
+  }
+  ForwardFFT( rotatedMovingSpectrum );
+  ForwardFFT( rotatedMovingSquaredSpectrum );
+
+  ComplexBufferType fixedCorrelatedWithMoving;
+  InverseFFTOfProduct( m_FixedSpectrum, rotatedMovingSpectrum, fixedCorrelatedWithMoving );
+  ComplexBufferType fixedMaskCorrelatedWithMoving;
+  InverseFFTOfProduct( m_FixedMaskSpectrum, rotatedMovingSpectrum, fixedMaskCorrelatedWithMoving );
+  ComplexBufferType fixedMaskCorrelatedWithMovingSquared;
+  InverseFFTOfProduct( m_FixedMaskSpectrum, rotatedMovingSquaredSpectrum, fixedMaskCorrelatedWithMovingSquared );
+
+  RealBufferType ncc( m_NumberOfPaddedPixels, 0.0 );
+  RealBufferType denominator( m_NumberOfPaddedPixels, 0.0 );
+  double         maximumDenominator = 0.0;
+  for( size_t i = 0; i < m_NumberOfPaddedPixels; ++i )
+    {
+    const double overlap = m_NumberOfOverlapPixels[i];
+    if( overlap <= 0.0 )
+      {
+      continue;
+      }
+    const double movingMean = fixedMaskCorrelatedWithMoving[i].real();
+    const double movingDenominator = std::max( fixedMaskCorrelatedWithMovingSquared[i].real()
+                                               - movingMean * movingMean / overlap, 0.0 );
+    denominator[i] = vcl_sqrt( m_FixedDenominator[i] * movingDenominator );
+    ncc[i] = fixedCorrelatedWithMoving[i].real() - m_FixedCorrelatedWithMovingMask[i] * movingMean / overlap;
+    maximumDenominator = std::max( maximumDenominator, denominator[i] );
+    }
+
+  // same tolerance on the denominator as the ITK filter
+  double precisionTolerance = 0.0;
+  if( maximumDenominator > 0.0 )
+    {
+    precisionTolerance = 1000.0 * vcl_pow( 2.0, -52 )
+      * vcl_pow( 2.0, vcl_floor( vcl_log( maximumDenominator ) / vcl_log( 2.0 ) ) );
+    }
+
+  // scan the correlation region in buffer order, like MinimumMaximumImageCalculator
+  maximum = itk::NumericTraits<ImageType::PixelType>::NonpositiveMin();
+  indexOfMaximum.Fill( 0 );
+  IndexType index;
+  for( index[2] = 0; index[2] < static_cast<itk::IndexValueType>( m_CorrelationSize[2] ); ++index[2] )
+    {
+    for( index[1] = 0; index[1] < static_cast<itk::IndexValueType>( m_CorrelationSize[1] ); ++index[1] )
+      {
+      size_t offset = ( static_cast<size_t>( index[2] ) * m_PaddedSize[1] + index[1] ) * m_PaddedSize[0];
+      for( index[0] = 0; index[0] < static_cast<itk::IndexValueType>( m_CorrelationSize[0] ); ++index[0], ++offset )
+        {
+        ImageType::PixelType value = 0.0F;
+        if( m_EnoughOverlap[offset] && denominator[offset] >= precisionTolerance && denominator[offset] > 0.0 )
+          {
+          value = static_cast<ImageType::PixelType>( ncc[offset] / denominator[offset] );
+          }
+        if( correlationImage != ITK_NULLPTR )
+          {
+          correlationImage->SetPixel( index, value );
+          }
+        if( value > maximum )
+          {
+          maximum = value;
+          indexOfMaximum = index;
+          }
+        }
+      }
+    }
+}
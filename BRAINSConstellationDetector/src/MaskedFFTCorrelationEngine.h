@@ -0,0 +1,106 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __MaskedFFTCorrelationEngine_h
+#define __MaskedFFTCorrelationEngine_h
+
+#include "itkImage.h"
+
+#include <complex>
+#include <vector>
+
+/**
+ * Masked normalized cross correlation of one fixed image against many
+ * moving images that share the same moving mask, computed in the frequency
+ * domain the same way itk::MaskedFFTNormalizedCorrelationImageFilter does
+ * (Padfield, "Masked Object Registration in the Fourier Domain").
+ *
+ * Initialize() transforms the fixed image, the fixed mask and the moving
+ * mask once and keeps everything that does not depend on the moving image.
+ * Each ComputeMaximumCorrelation() call then needs two forward and three
+ * inverse FFTs, and is safe to call from several threads at once.
+ *
+ * The correlation index layout is the one of the filter output: index j
+ * along a dimension means the moving image covers fixed indices
+ * [j - movingSize + 1, j].
+ */
+class MaskedFFTCorrelationEngine
+{
+public:
+  typedef itk::Image<float, 3> ImageType;
+  typedef itk::Image<short, 3> MaskImageType;
+  typedef ImageType::SizeType  SizeType;
+  typedef ImageType::IndexType IndexType;
+
+  typedef std::complex<double>     ComplexType;
+  typedef std::vector<ComplexType> ComplexBufferType;
+  typedef std::vector<double>      RealBufferType;
+
+  MaskedFFTCorrelationEngine();
+
+  /** requiredFractionOfOverlappingPixels has the meaning of the filter parameter
+   *  of the same name. Moving images passed later must have the size of movingMask. */
+  void Initialize( const ImageType * fixedImage, const MaskImageType * fixedMask,
+                   const MaskImageType * movingMask, const double requiredFractionOfOverlappingPixels );
+
+  /** Maximum correlation and its (first, in buffer order) index. If
+   *  correlationImage is not null it is filled with the full correlation
+   *  and must have the region of GetCorrelationSize(). The moving image is
+   *  expected to be zero outside the moving mask. */
+  void ComputeMaximumCorrelation( const ImageType * movingImage, double & maximum, IndexType & indexOfMaximum,
+                                  ImageType * correlationImage = ITK_NULLPTR ) const;
+
+  /** fixed size + moving size - 1 */
+  SizeType GetCorrelationSize() const
+  {
+    return m_CorrelationSize;
+  }
+
+private:
+  /* zero padded copy of image * mask (or of the mask alone when image is null),
+   * optionally squared, optionally rotated by 180 degrees */
+  void FillPaddedBuffer( const ImageType * image, const MaskImageType * mask, const bool squared,
+                         const bool rotated, ComplexBufferType & buffer ) const;
+
+  void ForwardFFT( ComplexBufferType & buffer ) const;
+
+  /* inverse FFT of a .* b, written into result */
+  void InverseFFTOfProduct( const ComplexBufferType & a, const ComplexBufferType & b,
+                            ComplexBufferType & result ) const;
+
+  static unsigned int GetFFTFriendlySize( const unsigned int minimumSize );
+
+  SizeType     m_FixedSize;
+  SizeType     m_MovingSize;
+  SizeType     m_CorrelationSize;
+  unsigned int m_PaddedSize[3];
+  size_t       m_NumberOfPaddedPixels;
+
+  /* spectra of the masked fixed image and of the fixed mask */
+  ComplexBufferType m_FixedSpectrum;
+  ComplexBufferType m_FixedMaskSpectrum;
+
+  /* everything that only depends on the fixed side and the moving mask,
+   * stored over the padded grid */
+  RealBufferType     m_NumberOfOverlapPixels;
+  RealBufferType     m_FixedCorrelatedWithMovingMask;
+  RealBufferType     m_FixedDenominator;
+  std::vector<char>  m_EnoughOverlap;
+};
+
+#endif
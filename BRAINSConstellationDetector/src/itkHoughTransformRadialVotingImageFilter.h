@@ -69,6 +69,9 @@
 #include <itkGaussianDistribution.h>
 #include "itkAddImageFilter.h"
 #include "itkImageRegionIterator.h"
+#include "itkMultiThreader.h"
+#include <algorithm>
+#include <vector>
 
 namespace itk
 {
@@ -88,6 +91,11 @@ namespace itk
  * point and votes on a small region defined using the minimum and maximum
  * radius given by the user, and fill in the array of radii.
  *
+ * The voting points are collected by the threads in scan order, and every
+ * voting thread then owns a slab of the accumulator and applies the votes
+ * falling into it in that same order.  The outputs are therefore identical
+ * for any number of threads.
+ *
  * \ingroup ImageFeatureExtraction
  * \todo Update the doxygen documentation!!!
  * */
@@ -313,6 +321,28 @@ protected:
 
   void ComputeMeanRadiusImage();
 
+  /** A point that passed the thresholds, and the center it votes for */
+  struct VotingPoint
+    {
+    InternalIndexType index;
+    InternalIndexType center;
+    };
+  typedef std::vector<VotingPoint> VotingPointListType;
+
+  struct VotingThreadStruct
+    {
+    Self *                      filter;
+    const VotingPointListType * votingPoints;
+    };
+
+  /** Apply all votes that fall into the slab of the accumulator owned by threadId */
+  void ThreadedVote(const VotingPointListType & votingPoints, ThreadIdType threadId, ThreadIdType threadCount);
+
+  static ITK_THREAD_RETURN_TYPE VotingThreaderCallback(void *arg);
+
+  /** Points that passed the thresholds, one list per thread, in scan order */
+  std::vector<VotingPointListType> m_ThreadVotingPoints;
+
 private:
   HoughTransformRadialVotingImageFilter(const Self &)
   {
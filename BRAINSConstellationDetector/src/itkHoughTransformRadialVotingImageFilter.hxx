@@ -85,10 +85,6 @@ HoughTransformRadialVotingImageFilter<TInputImage, TOutputImage>
   m_AllSeedsProcessed(false),
   m_HoughEyeDetectorMode(0)
 {
-  // Limiting the Hough Filter to run with single thread.
-  // In a single threaded status, the increment of run time for this filter is not tremendous in compare with
-  // the total run time of the BCD
-  this->SetNumberOfThreads(1);
 }
 
 template <class TInputImage, class TOutputImage>
@@ -151,6 +147,9 @@ HoughTransformRadialVotingImageFilter<TInputImage, TOutputImage>
   m_RadiusImage->SetRegions( inputImage->GetLargestPossibleRegion() );
   m_RadiusImage->Allocate();
   m_RadiusImage->FillBuffer(0);
+
+  m_ThreadVotingPoints.clear();
+  m_ThreadVotingPoints.resize( this->GetNumberOfThreads() );
 }
 
 template <class TInputImage, class TOutputImage>
@@ -158,6 +157,33 @@ void
 HoughTransformRadialVotingImageFilter<TInputImage, TOutputImage>
 ::AfterThreadedGenerateData()
 {
+  // Keep every sampling-th point in scan order. The thread regions are
+  // consecutive slabs, so concatenating the lists by thread id restores the
+  // scan order of the whole image.
+  const unsigned int  sampling = static_cast<unsigned int>( 1. / m_SamplingRatio );
+  unsigned int        counter = 1;
+  VotingPointListType votingPoints;
+  for( size_t t = 0; t < m_ThreadVotingPoints.size(); ++t )
+    {
+    for( size_t p = 0; p < m_ThreadVotingPoints[t].size(); ++p )
+      {
+      if( counter % sampling == 0 )
+        {
+        votingPoints.push_back( m_ThreadVotingPoints[t][p] );
+        }
+      counter++;
+      }
+    }
+  m_ThreadVotingPoints.clear();
+
+  VotingThreadStruct str;
+  str.filter = this;
+  str.votingPoints = &votingPoints;
+
+  this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+  this->GetMultiThreader()->SetSingleMethod( Self::VotingThreaderCallback, &str );
+  this->GetMultiThreader()->SingleMethodExecute();
+
   ComputeMeanRadiusImage();
 
   // Copy the typecast m_AccumulatorImage to Output image
@@ -179,7 +205,7 @@ template <class TInputImage, class TOutputImage>
 void
 HoughTransformRadialVotingImageFilter<TInputImage, TOutputImage>::ThreadedGenerateData(
   const OutputImageRegionType & windowRegion,
-  ThreadIdType /* threadId -- Not used */)
+  ThreadIdType threadId)
 
 {
   // Get the input and output pointers
@@ -191,19 +217,13 @@ HoughTransformRadialVotingImageFilter<TInputImage, TOutputImage>::ThreadedGenera
   DoGFunction->SetInputImage(inputImage);
   DoGFunction->SetSigma(m_SigmaGradient);
 
-  GaussianFunctionPointer GaussianFunction = GaussianFunctionType::New();
-
   const InputCoordType averageRadius = 0.5 * ( m_MinimumRadius + m_MaximumRadius );
-  const InputCoordType averageRadius2 = averageRadius * averageRadius;
 
   ImageRegionConstIteratorWithIndex<InputImageType>
   image_it(inputImage, windowRegion);
   image_it.GoToBegin();
 
-  const unsigned int sampling = static_cast<unsigned int>( 1. / m_SamplingRatio );
-  unsigned int       counter = 1;
-
-  InternalRegionType region;
+  VotingPointListType & votingPoints = m_ThreadVotingPoints[threadId];
   while( !image_it.IsAtEnd() )
     {
     if( image_it.Get() > m_Threshold )
@@ -216,87 +236,143 @@ HoughTransformRadialVotingImageFilter<TInputImage, TOutputImage>::ThreadedGenera
 
       if( norm2 > m_GradientThreshold )
         {
-        if( counter % sampling == 0 )
+        // Normalization
+        if( norm2 != 0 )
           {
-          // Normalization
-          if( norm2 != 0 )
+          const typename DoGVectorType::ValueType inv_norm = 1.0 / vcl_sqrt(norm2);
+          for( unsigned int i = 0; i < ImageDimension; i++ )
             {
-            const typename DoGVectorType::ValueType inv_norm = 1.0 / vcl_sqrt(norm2);
-            for( unsigned int i = 0; i < ImageDimension; i++ )
-              {
-              grad[i] *= inv_norm;
-              }
+            grad[i] *= inv_norm;
             }
-          Index<ImageDimension> center;
+          }
+        VotingPoint point;
+        point.index = index;
+        for( unsigned int i = 0; i < ImageDimension; i++ )
+          {
+          // for T1, T2 images
+          if( m_HoughEyeDetectorMode == 1 )
             {
-            InternalIndexType start;
-            InternalSizeType  size;
-            for( unsigned int i = 0; i < ImageDimension; i++ )
-              {
-              // for T1, T2 images
-              if( m_HoughEyeDetectorMode == 1 )
-                {
-                center[i] = index[i] + static_cast
-                  <InternalIndexValueType>( averageRadius * grad[i] / spacing[i] );
-                }
-              else
-                { // for PD image
-                center[i] = index[i] - static_cast
-                  <InternalIndexValueType>( averageRadius * grad[i] / spacing[i] );
-                }
-
-              const InputCoordType rad = m_VotingRadiusRatio * m_MinimumRadius / spacing[i];
-              start[i] = center[i] - static_cast<InternalIndexValueType>( rad );
-              size[i] = 1 + 2 * static_cast<InternalSizeValueType>( rad );
-              }
-            region.SetSize(size);
-            region.SetIndex(start);
+            point.center[i] = index[i] + static_cast
+              <InternalIndexValueType>( averageRadius * grad[i] / spacing[i] );
             }
-
-          if( inputImage->GetRequestedRegion().IsInside(region) )
-            {
-            ImageRegionIteratorWithIndex<InternalImageType>
-            It1(m_AccumulatorImage, region);
-
-            ImageRegionIterator<InternalImageType> It2(m_RadiusImage, region);
-
-            It1.GoToBegin();
-            It2.GoToBegin();
-            while( !It1.IsAtEnd() )
-              {
-              assert( !It2.IsAtEnd() );
-              const Index<ImageDimension> indexAtVote = It1.GetIndex();
-              InputCoordType              distance = 0;
-              double                      d = 0;
-              for( unsigned int i = 0; i < ImageDimension; i++ )
-                {
-                d += vnl_math_sqr(
-                    static_cast<double>( indexAtVote[i] - center[i] ) * spacing[i]);
-                distance += vnl_math_sqr(
-                    static_cast<InputCoordType>( indexAtVote[i] - index[i] ) * spacing[i]);
-                }
-              d = vcl_sqrt(d);
-              distance = vcl_sqrt(distance);
-
-              // Apply a normal distribution weight;
-              const double weight = GaussianFunction->EvaluatePDF(d, 0, averageRadius2);
-              double       distweight(distance * weight);
-
-              It1.Set(It1.Get() + weight);
-              It2.Set(It2.Get() + distweight);
-
-              ++It1;
-              ++It2;
-              }
+          else
+            { // for PD image
+            point.center[i] = index[i] - static_cast
+              <InternalIndexValueType>( averageRadius * grad[i] / spacing[i] );
             }
-          } // end counter
-        counter++;
+          }
+        votingPoints.push_back( point );
         } // end gradient threshold
       }   // end intensity threshold
     ++image_it;
     }
 }
 
+template <class TInputImage, class TOutputImage>
+ITK_THREAD_RETURN_TYPE
+HoughTransformRadialVotingImageFilter<TInputImage, TOutputImage>::VotingThreaderCallback(void *arg)
+{
+  const ThreadIdType threadId = ( (MultiThreader::ThreadInfoStruct *)(arg) )->ThreadID;
+  const ThreadIdType threadCount = ( (MultiThreader::ThreadInfoStruct *)(arg) )->NumberOfThreads;
+
+  VotingThreadStruct *str = (VotingThreadStruct *)( ( (MultiThreader::ThreadInfoStruct *)(arg) )->UserData);
+
+  str->filter->ThreadedVote( *( str->votingPoints ), threadId, threadCount );
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+HoughTransformRadialVotingImageFilter<TInputImage, TOutputImage>::ThreadedVote(
+  const VotingPointListType & votingPoints,
+  ThreadIdType threadId,
+  ThreadIdType threadCount)
+{
+  const InputImageConstPointer inputImage = this->GetInput();
+  const InputSpacingType       spacing = inputImage->GetSpacing();
+  const InputRegionType        requestedRegion = inputImage->GetRequestedRegion();
+
+  // This thread owns the slab [first, last) along the slowest dimension
+  const unsigned int            slowDimension = ImageDimension - 1;
+  const InternalSizeValueType   slowSize = requestedRegion.GetSize()[slowDimension];
+  const InternalSizeValueType   slicesPerThread = ( slowSize + threadCount - 1 ) / threadCount;
+  const InternalSizeValueType   first = std::min<InternalSizeValueType>( threadId * slicesPerThread, slowSize );
+  const InternalSizeValueType   last = std::min<InternalSizeValueType>( first + slicesPerThread, slowSize );
+  if( first == last )
+    {
+    return;
+    }
+  InternalRegionType slab = requestedRegion;
+  slab.SetIndex( slowDimension, requestedRegion.GetIndex()[slowDimension] + first );
+  slab.SetSize( slowDimension, last - first );
+
+  GaussianFunctionPointer GaussianFunction = GaussianFunctionType::New();
+
+  const InputCoordType averageRadius = 0.5 * ( m_MinimumRadius + m_MaximumRadius );
+  const InputCoordType averageRadius2 = averageRadius * averageRadius;
+
+  InternalRegionType region;
+  for( typename VotingPointListType::const_iterator pointIt = votingPoints.begin();
+       pointIt != votingPoints.end(); ++pointIt )
+    {
+    const InternalIndexType & index = pointIt->index;
+    const InternalIndexType & center = pointIt->center;
+      {
+      InternalIndexType start;
+      InternalSizeType  size;
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        const InputCoordType rad = m_VotingRadiusRatio * m_MinimumRadius / spacing[i];
+        start[i] = center[i] - static_cast<InternalIndexValueType>( rad );
+        size[i] = 1 + 2 * static_cast<InternalSizeValueType>( rad );
+        }
+      region.SetSize(size);
+      region.SetIndex(start);
+      }
+
+    // Only votes for regions fully inside the image count, and this thread
+    // only applies the part of them that falls into its slab.
+    if( !requestedRegion.IsInside(region) || !region.Crop(slab) )
+      {
+      continue;
+      }
+
+    ImageRegionIteratorWithIndex<InternalImageType>
+    It1(m_AccumulatorImage, region);
+
+    ImageRegionIterator<InternalImageType> It2(m_RadiusImage, region);
+
+    It1.GoToBegin();
+    It2.GoToBegin();
+    while( !It1.IsAtEnd() )
+      {
+      assert( !It2.IsAtEnd() );
+      const Index<ImageDimension> indexAtVote = It1.GetIndex();
+      InputCoordType              distance = 0;
+      double                      d = 0;
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        d += vnl_math_sqr(
+            static_cast<double>( indexAtVote[i] - center[i] ) * spacing[i]);
+        distance += vnl_math_sqr(
+            static_cast<InputCoordType>( indexAtVote[i] - index[i] ) * spacing[i]);
+        }
+      d = vcl_sqrt(d);
+      distance = vcl_sqrt(distance);
+
+      // Apply a normal distribution weight;
+      const double weight = GaussianFunction->EvaluatePDF(d, 0, averageRadius2);
+      double       distweight(distance * weight);
+
+      It1.Set(It1.Get() + weight);
+      It2.Set(It2.Get() + distweight);
+
+      ++It1;
+      ++It2;
+      }
+    }
+}
+
 template <class TInputImage, class TOutputImage>
 void
 HoughTransformRadialVotingImageFilter<TInputImage, TOutputImage>::ComputeMeanRadiusImage()
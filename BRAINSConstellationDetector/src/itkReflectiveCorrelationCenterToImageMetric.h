@@ -34,7 +34,7 @@
 #include "GenericTransformImage.h"
 #include "itkStatisticsImageFilter.h"
 #include "itkNumberToString.h"
-#include "itkCompensatedSummation.h"
+#include "MSPReflectiveCorrelationMetric.h"
 
 // Optimize the A,B,C vector
 class Rigid3DCenterReflectorFunctor : public vnl_cost_function
@@ -42,11 +42,17 @@ class Rigid3DCenterReflectorFunctor : public vnl_cost_function
 public:
   static const int UNKNOWNS_TO_ESTIMATE = 3;
 
-  typedef itk::CompensatedSummation< double >   CompensatedSummationType;
-
   void SetCenterOfHeadMass(SImageType::PointType centerOfHeadMass)
   {
     m_CenterOfHeadMass = centerOfHeadMass;
+    m_ReflectionMetricIsCurrent = false;
+  }
+
+  /** Fraction of the voxels used by the reflective correlation, 1 uses all */
+  void SetSamplingFraction(const double samplingFraction)
+  {
+    m_ReflectionMetric.SetSamplingFraction(samplingFraction);
+    m_ReflectionMetricIsCurrent = false;
   }
 
   void QuickSampleParameterSpace(void)
@@ -54,12 +60,12 @@ public:
     vnl_vector<double> params;
     params.set_size(3);
 
+    // Initialize with current guess, followed by the grid
     params[0] = 0;
     params[1] = 0;
     params[2] = 0;
-    // Initialize with current guess;
-    double max_cc = this->f(params);
-    this->m_params = params;
+    std::vector<vnl_vector<double> > candidates(1, params);
+
     const double HARange = 25.0;
     const double BARange = 15.0;
 
@@ -70,22 +76,39 @@ public:
     // Let the powell optimizer do all the work for determining the proper
     // offset
     // Quick search just needs to get an approximate angle correct.
+    for( double HA = -HARange * one_degree; HA <= HARange * one_degree; HA += HAStepSize )
       {
-      for( double HA = -HARange * one_degree; HA <= HARange * one_degree; HA += HAStepSize )
+      for( double BA = -BARange * one_degree; BA <= BARange * one_degree; BA += BAStepSize )
         {
-        for( double BA = -BARange * one_degree; BA <= BARange * one_degree; BA += BAStepSize )
-          {
-          const double Offset = 0.0;
-          params[0] = HA;
-          params[1] = BA;
-          params[2] = Offset;
-          const double current_cc = this->f(params);
-          if( current_cc < max_cc )
-            {
-            this->m_params = params;
-            max_cc = current_cc;
-            }
-          }
+        const double Offset = 0.0;
+        params[0] = HA;
+        params[1] = BA;
+        params[2] = Offset;
+        candidates.push_back(params);
+        }
+      }
+
+    // All candidates are correlated concurrently
+    std::vector<RigidTransformType::Pointer> transforms;
+    for( size_t c = 0; c < candidates.size(); ++c )
+      {
+      transforms.push_back( this->GetTransformFromParams(candidates[c]) );
+      }
+    this->UpdateReflectionMetric();
+    std::vector<double> correlations;
+    this->m_ReflectionMetric.Evaluate(transforms, correlations);
+    m_Iterations += candidates.size();
+
+    // Keep the first best in the order the serial search used
+    double max_cc = this->CostFromCorrelation(candidates[0], correlations[0]);
+    this->m_params = candidates[0];
+    for( size_t c = 1; c < candidates.size(); ++c )
+      {
+      const double current_cc = this->CostFromCorrelation(candidates[c], correlations[c]);
+      if( current_cc < max_cc )
+        {
+        this->m_params = candidates[c];
+        max_cc = current_cc;
         }
       }
     // DEBUGGING INFORMATION
@@ -106,14 +129,9 @@ public:
     vnl_cost_function(UNKNOWNS_TO_ESTIMATE),
     m_params(),
     m_OriginalImage(ITK_NULLPTR),
-    m_OutputImageSpacing(),
-    m_OutputImageDirection(),
-    m_OutputImageStartIndex(),
-    m_OutputImageSize(),
-    m_OutputImageOrigin(),
     m_CenterOfHeadMass(),
-    m_InternalResampledForReflectiveComputationImage(ITK_NULLPTR),
-    m_ResampleFilter(ITK_NULLPTR),
+    m_ReflectionMetric(),
+    m_ReflectionMetricIsCurrent(false),
     m_BackgroundValue(0),
     m_CenterOfImagePoint(),
     m_Translation(),
@@ -144,22 +162,32 @@ public:
 
   double f(vnl_vector<double> const & params) ITK_OVERRIDE
   {
-    const double        MaxUnpenalizedAllowedDistance = 8.0;
-    const double        DistanceFromCenterOfMass = vcl_abs(params[2]);
     static const double FortyFiveDegreesAsRadians = 45.0 * vnl_math::pi / 180.0;
-    const double        cost_of_HeadingAngle = ( vcl_abs(params[0]) < FortyFiveDegreesAsRadians ) ? 0 :
-      ( ( vcl_abs(params[0]) - FortyFiveDegreesAsRadians ) * 2 );
-    const double cost_of_BankAngle = ( vcl_abs(params[1]) < FortyFiveDegreesAsRadians ) ? 0 :
-      ( ( vcl_abs(params[1]) - FortyFiveDegreesAsRadians ) * 2 );
 
     if( ( vcl_abs(params[0]) > FortyFiveDegreesAsRadians ) || ( vcl_abs(params[1]) > FortyFiveDegreesAsRadians ) )
       {
       std::cout << "WARNING: ESTIMATED ROTATIONS ARE WAY TOO BIG SO GIVING A HIGH COST" << std::endl;
       return 1;
       }
-    const double cc = -CenterImageReflection_crossCorrelation(params);
+    const double cc = CenterImageReflection_crossCorrelation(params);
     m_Iterations++;
 
+    return this->CostFromCorrelation(params, cc);
+  }
+
+  /** Cost of params given their reflective correlation */
+  double CostFromCorrelation(vnl_vector<double> const & params, const double correlation) const
+  {
+    const double        MaxUnpenalizedAllowedDistance = 8.0;
+    const double        DistanceFromCenterOfMass = vcl_abs(params[2]);
+    static const double FortyFiveDegreesAsRadians = 45.0 * vnl_math::pi / 180.0;
+    const double        cost_of_HeadingAngle = ( vcl_abs(params[0]) < FortyFiveDegreesAsRadians ) ? 0 :
+      ( ( vcl_abs(params[0]) - FortyFiveDegreesAsRadians ) * 2 );
+    const double cost_of_BankAngle = ( vcl_abs(params[1]) < FortyFiveDegreesAsRadians ) ? 0 :
+      ( ( vcl_abs(params[1]) - FortyFiveDegreesAsRadians ) * 2 );
+
+    const double cc = -correlation;
+
     const double cost_of_motion = ( vcl_abs(DistanceFromCenterOfMass) < MaxUnpenalizedAllowedDistance ) ? 0 :
       ( vcl_abs(DistanceFromCenterOfMass - MaxUnpenalizedAllowedDistance) * .1 );
     const double raw_finalcos_gamma = cc + cost_of_motion + cost_of_BankAngle + cost_of_HeadingAngle;
@@ -178,13 +206,8 @@ public:
 
   RigidTransformType::Pointer GetTransformToMSP(void) const
   {
-    // Compute and store the new output image origin
-    m_ResampleFilter->SetTransform( this->GetTransformFromParams(this->m_params) );
-    m_ResampleFilter->Update();
-    SImageType::Pointer image = m_ResampleFilter->GetOutput();
-
-    // it is also the msp location
-    SImageType::PointType physCenter = GetImageCenterPhysicalPoint(image);
+    // The center of the sampling lattice is also the msp location
+    const SImageType::PointType physCenter = m_ReflectionMetric.GetLatticeCenter();
 
     // Move the physical origin to the center of the image
     RigidTransformType::Pointer tempEulerAngles3DT = RigidTransformType::New();
@@ -216,6 +239,7 @@ public:
 #endif
 
     this->m_OriginalImage = RefImage;
+    this->m_ReflectionMetricIsCurrent = false;
     this->m_Translation = this->m_CenterOfHeadMass.GetVectorFromOrigin() - m_CenterOfImagePoint.GetVectorFromOrigin();
     if( LMC::globalverboseFlag == true )
       {
@@ -229,6 +253,7 @@ public:
   void SetDownSampledReferenceImage(SImageType::Pointer & NewImage)
   {
     m_OriginalImage = NewImage;
+    m_ReflectionMetricIsCurrent = false;
   }
 
   /* -- */
@@ -259,121 +284,8 @@ public:
   /* -- */
   double CenterImageReflection_crossCorrelation(vnl_vector<double> const & params)
   {
-      {
-      // Define the output image direction identical
-      m_OutputImageDirection.SetIdentity();
-
-      // Get output spacing
-      const SImageType::SpacingType &inputImageSpacing = m_OriginalImage->GetSpacing();
-      SImageType::SpacingType::ValueType minSpacing=inputImageSpacing[0];
-      for( unsigned int i = 1; i < 3; ++i )
-        {
-          minSpacing = std::min(minSpacing,inputImageSpacing[i]);
-        }
-      for( unsigned int i = 0; i < 3; ++i )
-        {
-          m_OutputImageSpacing[i]=minSpacing;
-        }
-
-      // Define start index
-      m_OutputImageStartIndex.Fill(0);
-
-      // Desire a 95*2 x 130*2 x 160x2 mm voxel lattice that will fit a brain
-      m_OutputImageSize[0] = static_cast<unsigned long int>( 2.0 * vcl_ceil(95.0  / m_OutputImageSpacing[0]) );
-      m_OutputImageSize[1] = static_cast<unsigned long int>( 2.0 * vcl_ceil(130.0 / m_OutputImageSpacing[1]) );
-      m_OutputImageSize[2] = static_cast<unsigned long int>( 2.0 * vcl_ceil(160.0 / m_OutputImageSpacing[2]) );
-
-      // The physical center of MSP plane is not determined yet. At the
-      // optimizing stage we take COM as physical center
-      m_OutputImageOrigin[0] = m_CenterOfHeadMass[0] - .5 * ( m_OutputImageSize[0] - 1 ) * m_OutputImageSpacing[0];
-      m_OutputImageOrigin[1] = m_CenterOfHeadMass[1] - .5 * ( m_OutputImageSize[1] - 1 ) * m_OutputImageSpacing[1];
-      m_OutputImageOrigin[2] = m_CenterOfHeadMass[2] - .5 * ( m_OutputImageSize[2] - 1 ) * m_OutputImageSpacing[2];
-      }
-    /*
-     * Resample the image
-     */
-    m_ResampleFilter = ResampleFilterType::New();
-    LinearInterpolatorType::Pointer interpolator = LinearInterpolatorType::New();
-    m_ResampleFilter->SetInterpolator(interpolator);
-    m_ResampleFilter->SetDefaultPixelValue(0);
-    m_ResampleFilter->SetOutputSpacing(m_OutputImageSpacing);
-    m_ResampleFilter->SetOutputOrigin(m_OutputImageOrigin);
-    m_ResampleFilter->SetSize(m_OutputImageSize);
-    m_ResampleFilter->SetOutputDirection(m_OutputImageDirection);
-    m_ResampleFilter->SetOutputStartIndex(m_OutputImageStartIndex);
-    m_ResampleFilter->SetInput(this->m_OriginalImage);
-    m_ResampleFilter->SetTransform( this->GetTransformFromParams(params) );
-    m_ResampleFilter->Update();
-    m_InternalResampledForReflectiveComputationImage = m_ResampleFilter->GetOutput();
-
-    /*
-     * Compute the reflective correlation
-     */
-    double               sumVoxelValues = 0.0F;
-    double               sumSquaredVoxelValues = 0.0F;
-    double               sumVoxelValuesQR = 0.0F;
-    double               sumVoxelValuesReflected = 0.0F;
-    double               sumSquaredVoxelValuesReflected = 0.0F;
-    int                  N = 0;
-    SImageType::SizeType rasterResampleSize = m_InternalResampledForReflectiveComputationImage->GetLargestPossibleRegion().GetSize();
-    const SImageType::SizeType::SizeValueType xMaxIndexResampleSize = rasterResampleSize[0] - 1;
-    rasterResampleSize[0] /= 2; // Only need to do 1/2 in the x direction;
-    SImageType::RegionType rasterRegion;
-    rasterRegion.SetSize(rasterResampleSize);
-    rasterRegion.SetIndex( m_InternalResampledForReflectiveComputationImage->GetLargestPossibleRegion().GetIndex() );
-    itk::ImageRegionConstIteratorWithIndex<SImageType> halfIt(m_InternalResampledForReflectiveComputationImage,
-                                                              rasterRegion);
-
-    CompensatedSummationType  CS_sumVoxelValuesQR;
-    CompensatedSummationType  CS_sumSquaredVoxelValuesReflected;
-    CompensatedSummationType  CS_sumVoxelValuesReflected;
-    CompensatedSummationType  CS_sumSquaredVoxelValues;
-    CompensatedSummationType  CS_sumVoxelValues;
-
-    for( halfIt.GoToBegin(); !halfIt.IsAtEnd(); ++halfIt )
-      {
-      // NOTE:  Only need to compute left half of space because of reflection.
-      const double _f = halfIt.Get();
-      if( _f < this->m_BackgroundValue )  // don't worry about background
-                                          // voxels.
-        {
-        continue;
-        }
-      SImageType::IndexType ReflectedIndex = halfIt.GetIndex();
-      ReflectedIndex[0] = xMaxIndexResampleSize - ReflectedIndex[0];
-      const double g = m_InternalResampledForReflectiveComputationImage->GetPixel(ReflectedIndex);
-      if( g < this->m_BackgroundValue )  // don't worry about background voxels.
-        {
-        continue;
-        }
-      CS_sumVoxelValuesQR += _f * g;
-      CS_sumSquaredVoxelValuesReflected += g * g;
-      CS_sumVoxelValuesReflected += g;
-      CS_sumSquaredVoxelValues += _f * _f;
-      CS_sumVoxelValues += _f;
-      N++;
-      }
-    sumVoxelValuesQR = CS_sumVoxelValuesQR.GetSum();
-    sumSquaredVoxelValuesReflected = CS_sumSquaredVoxelValuesReflected.GetSum();
-    sumVoxelValuesReflected = CS_sumVoxelValuesReflected.GetSum();
-    sumSquaredVoxelValues = CS_sumSquaredVoxelValues.GetSum();
-    sumVoxelValues = CS_sumVoxelValues.GetSum();
-
-    // ///////////////////////////////////////////////
-    if( N == 0
-        || ( ( sumSquaredVoxelValues - sumVoxelValues * sumVoxelValues
-               / N ) * ( sumSquaredVoxelValuesReflected - sumVoxelValuesReflected * sumVoxelValuesReflected / N ) ) ==
-        0.0 )
-      {
-      return 0.0;
-      }
-    const double cc =
-      ( ( sumVoxelValuesQR - sumVoxelValuesReflected * sumVoxelValues
-          / N )
-        / vcl_sqrt( ( sumSquaredVoxelValues - sumVoxelValues * sumVoxelValues
-                      / N )
-                    * ( sumSquaredVoxelValuesReflected - sumVoxelValuesReflected * sumVoxelValuesReflected / N ) ) );
-    return cc;
+    this->UpdateReflectionMetric();
+    return this->m_ReflectionMetric.Evaluate( this->GetTransformFromParams(params) );
   }
 
   SImageType::Pointer GetMSPCenteredImage(void)
@@ -428,45 +340,26 @@ public:
   }
 
 private:
-  typedef vnl_powell                                       OptimizerType;
-  typedef itk::ResampleImageFilter<SImageType, SImageType> ResampleFilterType;
+  typedef vnl_powell OptimizerType;
 
-  SImageType::Pointer SimpleResampleImage(SImageType::Pointer image, RigidTransformType::Pointer EulerAngles3DT)
+  /** Samples the current reference image for the following evaluations */
+  void UpdateReflectionMetric(void)
   {
-    m_ResampleFilter = ResampleFilterType::New();
-    LinearInterpolatorType::Pointer interpolator = LinearInterpolatorType::New();
-    m_ResampleFilter->SetInterpolator(interpolator);
-    m_ResampleFilter->SetDefaultPixelValue(0);
-    m_ResampleFilter->SetOutputSpacing(m_OutputImageSpacing);
-    m_ResampleFilter->SetSize(m_OutputImageSize);
-    m_ResampleFilter->SetOutputDirection(m_OutputImageDirection);
-    m_ResampleFilter->SetOutputStartIndex(m_OutputImageStartIndex);
-    m_ResampleFilter->SetInput(image);
-    m_ResampleFilter->SetTransform(EulerAngles3DT);
-
-    // Move the physical center of image to the physical origin
-    m_OutputImageOrigin[0] = -0.5 * ( m_OutputImageSize[0] - 1 ) * m_OutputImageSpacing[0];
-    m_OutputImageOrigin[1] = -0.5 * ( m_OutputImageSize[1] - 1 ) * m_OutputImageSpacing[1];
-    m_OutputImageOrigin[2] = -0.5 * ( m_OutputImageSize[2] - 1 ) * m_OutputImageSpacing[2];
-    m_ResampleFilter->SetOutputOrigin(m_OutputImageOrigin);
-
-    m_ResampleFilter->Update();
-
-    SImageType::Pointer returnImage = m_ResampleFilter->GetOutput();
-    returnImage->DisconnectPipeline();
-    return returnImage;
+    if( this->m_ReflectionMetricIsCurrent )
+      {
+      return;
+      }
+    this->m_ReflectionMetric.SetCenterOfHeadMass(this->m_CenterOfHeadMass);
+    this->m_ReflectionMetric.SetBackgroundValue(this->m_BackgroundValue);
+    this->m_ReflectionMetric.SetImage(this->m_OriginalImage);
+    this->m_ReflectionMetricIsCurrent = true;
   }
 
   vnl_vector<double>                m_params;
   SImageType::Pointer               m_OriginalImage;
-  SImageType::SpacingType           m_OutputImageSpacing;
-  SImageType::DirectionType         m_OutputImageDirection;
-  SImageType::IndexType             m_OutputImageStartIndex;
-  SImageType::SizeType              m_OutputImageSize;
-  SImageType::PointType             m_OutputImageOrigin;
   SImageType::PointType             m_CenterOfHeadMass;
-  SImageType::Pointer               m_InternalResampledForReflectiveComputationImage;
-  ResampleFilterType::Pointer       m_ResampleFilter;
+  MSPReflectiveCorrelationMetric    m_ReflectionMetric;
+  bool                              m_ReflectionMetricIsCurrent;
   SImageType::PixelType             m_BackgroundValue;
   SImageType::PointType             m_CenterOfImagePoint;
   SImageType::PointType::VectorType m_Translation;
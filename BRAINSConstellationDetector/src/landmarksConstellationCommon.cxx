@@ -57,7 +57,8 @@ void ComputeMSP(SImageType::Pointer image,
                 SImageType::Pointer & transformedImage,
                 const SImageType::PointType & centerOfHeadMass,
                 const int qualityLevel,
-                double & cc)
+                double & cc,
+                const double coarseSamplingFraction)
 {
   if( qualityLevel == -1 )  // Assume image was pre-aligned outside of the
                             // program
@@ -84,6 +85,7 @@ void ComputeMSP(SImageType::Pointer image,
     if( qualityLevel >= 0 )
       {
       std::cout << "Level 0 Quality Estimates" << std::endl;
+      reflectionFunctor.SetSamplingFraction(coarseSamplingFraction);
       reflectionFunctor.SetDownSampledReferenceImage(EigthImage);
       reflectionFunctor.QuickSampleParameterSpace();
       reflectionFunctor.Update();
@@ -97,6 +99,7 @@ void ComputeMSP(SImageType::Pointer image,
     if( qualityLevel >= 2 )
       {
       std::cout << "Level 2 Quality Estimates" << std::endl;
+      reflectionFunctor.SetSamplingFraction(1.0);
       reflectionFunctor.SetDownSampledReferenceImage(HalfImage);
       reflectionFunctor.Update();
       }
@@ -106,6 +109,7 @@ void ComputeMSP(SImageType::Pointer image,
       reflectionFunctor.SetDownSampledReferenceImage(image);
       reflectionFunctor.Update();
       }
+    reflectionFunctor.SetSamplingFraction(1.0);
     reflectionFunctor.SetDownSampledReferenceImage(image);
     Tmsp = reflectionFunctor.GetTransformToMSP();
     transformedImage = reflectionFunctor.GetMSPCenteredImage();
@@ -113,7 +117,8 @@ void ComputeMSP(SImageType::Pointer image,
     }
 }
 
-void ComputeMSP(SImageType::Pointer image, RigidTransformType::Pointer & Tmsp, const int qualityLevel)
+void ComputeMSP(SImageType::Pointer image, RigidTransformType::Pointer & Tmsp, const int qualityLevel,
+                const double coarseSamplingFraction)
 {
   // itkUtil::WriteImage<SImageType>(image,"PRE_PYRAMID.nii.gz");
   PyramidFilterType::Pointer    MyPyramid = MakeThreeLevelPyramid(image);
@@ -126,6 +131,7 @@ void ComputeMSP(SImageType::Pointer image, RigidTransformType::Pointer & Tmsp, c
   if( qualityLevel >= 0 )
     {
     std::cout << "Level 0 Quality Estimates" << std::endl;
+    reflectionFunctor.SetSamplingFraction(coarseSamplingFraction);
     reflectionFunctor.SetDownSampledReferenceImage(EigthImage);
     reflectionFunctor.QuickSampleParameterSpace();
     reflectionFunctor.Update();
@@ -139,6 +145,7 @@ void ComputeMSP(SImageType::Pointer image, RigidTransformType::Pointer & Tmsp, c
   if( qualityLevel >= 2 )
     {
     std::cout << "Level 2 Quality Estimates" << std::endl;
+    reflectionFunctor.SetSamplingFraction(1.0);
     reflectionFunctor.SetDownSampledReferenceImage(HalfImage);
     reflectionFunctor.Update();
     }
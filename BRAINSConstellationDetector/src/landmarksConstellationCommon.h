@@ -179,11 +179,15 @@ extern double GetRandomZeroOneDouble(void);
 
 extern void InitializeRandomZeroOneDouble(RandomGeneratorType::IntegerType rseed);
 
+/** coarseSamplingFraction is the fraction of the voxels used by the
+ * reflective correlation on the two coarsest pyramid levels.  The finer
+ * levels always use all of them. */
 extern void ComputeMSP(SImageType::Pointer image, RigidTransformType::Pointer & Tmsp,
                        SImageType::Pointer & transformedImage, const SImageType::PointType & centerOfHeadMass,
-                       const int qualityLevel, double & cc);
+                       const int qualityLevel, double & cc, const double coarseSamplingFraction = 1.0);
 
-extern void ComputeMSP(SImageType::Pointer image, RigidTransformType::Pointer & Tmsp, const int qualityLevel);
+extern void ComputeMSP(SImageType::Pointer image, RigidTransformType::Pointer & Tmsp, const int qualityLevel,
+                       const double coarseSamplingFraction = 1.0);
 
 extern SImageType::Pointer CreatedebugPlaneImage(SImageType::Pointer referenceImage,
                                                  const RigidTransformType::Pointer MSPTransform,
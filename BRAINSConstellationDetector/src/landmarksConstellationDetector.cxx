@@ -32,7 +32,10 @@
 
 #include <BRAINSFitHelper.h>
 #include "itkLandmarkBasedTransformInitializer.h"
+#include "itkMultiThreader.h"
+#include "MaskedFFTCorrelationEngine.h"
 
+#include <algorithm>
 #include <sstream>
 
 std::string local_to_string(unsigned int i)
@@ -42,6 +45,89 @@ std::string local_to_string(unsigned int i)
   return localStream.str();
 }
 
+namespace
+{
+/** shared by the threads that correlate the rotated landmark templates */
+struct TemplateCorrelationThreadStruct
+  {
+  const MaskedFFTCorrelationEngine *                     engine;
+  const std::vector<std::vector<float> > *               templateMean;
+  const landmarksConstellationModelIO::IndexLocationVectorType * model;
+  FImageType3D::ConstPointer                             templateGeometry;
+  FImageType3D::ConstPointer                             correlationGeometry;
+  double                                                 height;
+  double                                                 radii;
+  std::string                                            debugDirectory;
+  std::string                                            debugLandmarkName;
+  std::vector<double>                                    maximumCorrelation;
+  std::vector<FImageType3D::IndexType>                   indexOfMaximum;
+  };
+
+ITK_THREAD_RETURN_TYPE
+TemplateCorrelationThreaderCallback( void * arg )
+{
+  const itk::ThreadIdType threadId = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->ThreadID;
+  const itk::ThreadIdType threadCount = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->NumberOfThreads;
+
+  TemplateCorrelationThreadStruct * str =
+    (TemplateCorrelationThreadStruct *)( ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->UserData);
+
+  // every thread fills its own template image
+  FImageType3D::Pointer lmkTemplateImage = FImageType3D::New();
+  lmkTemplateImage->CopyInformation( str->templateGeometry );
+  lmkTemplateImage->SetRegions( str->templateGeometry->GetLargestPossibleRegion() );
+  lmkTemplateImage->Allocate();
+
+  FImageType3D::Pointer correlationImage;
+  const bool writeDebugImages = !str->debugDirectory.empty();
+  if( writeDebugImages )
+    {
+    correlationImage = FImageType3D::New();
+    correlationImage->CopyInformation( str->correlationGeometry );
+    correlationImage->SetRegions( str->correlationGeometry->GetLargestPossibleRegion() );
+    correlationImage->Allocate();
+    }
+
+  for( size_t curr_rotationAngle = threadId; curr_rotationAngle < str->templateMean->size();
+       curr_rotationAngle += threadCount )
+    {
+    lmkTemplateImage->FillBuffer(0);
+    // iterate over mean values for the current rotation angle
+    std::vector<float>::const_iterator mean_iter = ( *str->templateMean )[curr_rotationAngle].begin();
+    // Fill the lmk template image using the mean values
+    for( landmarksConstellationModelIO::IndexLocationVectorType::const_iterator it = str->model->begin();
+         it != str->model->end();
+         ++it, ++mean_iter )
+      {
+      FImageType3D::IndexType pixelIndex;
+      pixelIndex[0] = (*it)[0] + str->height;
+      pixelIndex[1] = (*it)[1] + str->radii;
+      pixelIndex[2] = (*it)[2] + str->radii;
+      lmkTemplateImage->SetPixel( pixelIndex, *mean_iter );
+      }
+
+    str->engine->ComputeMaximumCorrelation( lmkTemplateImage,
+                                            str->maximumCorrelation[curr_rotationAngle],
+                                            str->indexOfMaximum[curr_rotationAngle],
+                                            correlationImage.GetPointer() );
+
+    if( writeDebugImages )
+      {
+      std::string tmpImageName( str->debugDirectory + "/lmkTemplateImage_"
+                                + str->debugLandmarkName + "_"
+                                + local_to_string(curr_rotationAngle) + ".nii.gz" );
+      itkUtil::WriteImage<FImageType3D>( lmkTemplateImage, tmpImageName );
+
+      std::string ncc_output_name( str->debugDirectory + "/NCCOutput_"
+                                   + str->debugLandmarkName + "_"
+                                   + local_to_string(curr_rotationAngle) + ".nii.gz" );
+      itkUtil::WriteImage<FImageType3D>( correlationImage, ncc_output_name );
+      }
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+}
+
 //NOTE: LandmarkTransforms are inverse of ImageTransforms, (You pull images, you push landmarks)
 static
 VersorTransformType::Pointer
@@ -431,14 +517,14 @@ landmarksConstellationDetector::FindCandidatePoints
         {
         currentPointLocation[2] = InferiorToSuperior;
 
-          // Is current point within the input mask
-        if( maskInterp->Evaluate( currentPointLocation ) > 0.5 )
+        // Is current point inside the boundary box, checked before any interpolation
+        const SImageType::PointType::VectorType temp =
+                                        currentPointLocation.GetVectorFromOrigin() - CenterOfSearchArea;
+        const double inclusionDistance = temp.GetNorm();
+        if( ( inclusionDistance < (SI_restrictions+radii) ) && ( vcl_abs( temp[1] ) < (PA_restrictions+radii) ) )
           {
-            // Is current point inside the boundary box
-          const SImageType::PointType::VectorType temp =
-                                          currentPointLocation.GetVectorFromOrigin() - CenterOfSearchArea;
-          const double inclusionDistance = temp.GetNorm();
-          if( ( inclusionDistance < (SI_restrictions+radii) ) && ( vcl_abs( temp[1] ) < (PA_restrictions+radii) ) )
+          // Is current point within the input mask
+          if( maskInterp->Evaluate( currentPointLocation ) > 0.5 )
             {
             SImageType::IndexType index3D;
             roiImage->TransformPhysicalPointToIndex( currentPointLocation, index3D );
@@ -497,6 +583,7 @@ landmarksConstellationDetector::FindCandidatePoints
   MultiplyImageFilterType::Pointer multiplyImageFilter = MultiplyImageFilterType::New();
   multiplyImageFilter->SetInput( subtractConstantFromImageFilter->GetOutput() );
   multiplyImageFilter->SetConstant( normInv );
+  multiplyImageFilter->Update();
 
   FImageType3D::Pointer normalizedRoiImage = multiplyImageFilter->GetOutput();
   /////////////// End of normalization of roiImage //////////////
@@ -531,80 +618,85 @@ landmarksConstellationDetector::FindCandidatePoints
   lmkTemplateImage->Allocate();
 
   // Since each landmark template is a cylinder, a template mask is needed.
+  // It is the same for every rotation angle, only the mean values change.
   //
   SImageType::Pointer templateMask = SImageType::New();
   templateMask->CopyInformation( lmkTemplateImage );
   templateMask->SetRegions( lmkTemplateImage->GetLargestPossibleRegion() );
   templateMask->Allocate();
+  templateMask->FillBuffer( 0 );
+  for( landmarksConstellationModelIO::IndexLocationVectorType::const_iterator it = model.begin();
+      it != model.end();
+      ++it )
+    {
+    SImageType::IndexType pixelIndex;
+    pixelIndex[0] = (*it)[0]+height;
+    pixelIndex[1] = (*it)[1]+radii;
+    pixelIndex[2] = (*it)[2]+radii;
+    templateMask->SetPixel( pixelIndex, 1 );
+    }
+  if( globalImagedebugLevel > 8 )
+    {
+    std::string tmpMaskName( this->m_ResultsDir + "/templateMask_"
+                        + itksys::SystemTools::GetFilenameName( mapID ) + ".nii.gz" );
+    itkUtil::WriteImage<SImageType>( templateMask, tmpMaskName );
+    }
 
-  // Fill the template moving image based on the vector index locations
-  //  and template mean values for different angle rotations
+  // Finally NCC is calculated in frequency domain. The fixed side is
+  // transformed once and shared by all rotation angles; the filter is only
+  // used for the geometry of its output.
   //
+  typedef itk::MaskedFFTNormalizedCorrelationImageFilter<FImageType3D, FImageType3D, SImageType> CorrelationFilterType;
+  CorrelationFilterType::Pointer correlationFilter = CorrelationFilterType::New();
+  correlationFilter->SetFixedImage( normalizedRoiImage );
+  correlationFilter->SetFixedImageMask( roiMask );
+  correlationFilter->SetMovingImage( lmkTemplateImage );
+  correlationFilter->SetMovingImageMask( templateMask );
+  correlationFilter->SetRequiredFractionOfOverlappingPixels( 1 );
+  correlationFilter->UpdateOutputInformation();
+
+  MaskedFFTCorrelationEngine correlationEngine;
+  correlationEngine.Initialize( normalizedRoiImage, roiMask, templateMask, 1 );
+
+  TemplateCorrelationThreadStruct str;
+  str.engine = &correlationEngine;
+  str.templateMean = &TemplateMean;
+  str.model = &model;
+  str.templateGeometry = lmkTemplateImage.GetPointer();
+  str.correlationGeometry = correlationFilter->GetOutput();
+  str.height = height;
+  str.radii = radii;
+  str.maximumCorrelation.resize( TemplateMean.size() );
+  str.indexOfMaximum.resize( TemplateMean.size() );
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  if( globalImagedebugLevel > 8 )
+    {
+    // debug images are written from the worker
+    str.debugDirectory = this->m_ResultsDir;
+    str.debugLandmarkName = itksys::SystemTools::GetFilenameName( mapID );
+    threader->SetNumberOfThreads( 1 );
+    }
+  else
+    {
+    threader->SetNumberOfThreads( std::min<unsigned int>( threader->GetNumberOfThreads(),
+                                                          std::max<size_t>( TemplateMean.size(), 1 ) ) );
+    }
+  threader->SetSingleMethod( TemplateCorrelationThreaderCallback, &str );
+  threader->SingleMethodExecute();
+
+  // Maximum NCC over the rotation angles, in angle order
   double cc_rotation_max = 0.0;
   for( unsigned int curr_rotationAngle = 0;
       curr_rotationAngle < TemplateMean.size(); curr_rotationAngle++ )
     {
-    lmkTemplateImage->FillBuffer(0);
-    templateMask->FillBuffer( 0 );
-    // iterate over mean values for the current rotation angle
-    std::vector<float>::const_iterator mean_iter = TemplateMean[curr_rotationAngle].begin();
-    // Fill the lmk template image using the mean values
-    for( landmarksConstellationModelIO::IndexLocationVectorType::const_iterator it = model.begin();
-        it != model.end();
-        ++it, ++mean_iter )
-      {
-      FImageType3D::IndexType pixelIndex;
-      pixelIndex[0] = (*it)[0]+height;
-      pixelIndex[1] = (*it)[1]+radii;
-      pixelIndex[2] = (*it)[2]+radii;
-      lmkTemplateImage->SetPixel( pixelIndex, *mean_iter );
-      templateMask->SetPixel( pixelIndex, 1 );
-      }
-    if( globalImagedebugLevel > 8 )
-      {
-      std::string tmpImageName( this->m_ResultsDir + "/lmkTemplateImage_"
-                          + itksys::SystemTools::GetFilenameName( mapID ) + "_"
-                          + local_to_string(curr_rotationAngle) + ".nii.gz" );
-      itkUtil::WriteImage<FImageType3D>( lmkTemplateImage, tmpImageName );
-
-      std::string tmpMaskName( this->m_ResultsDir + "/templateMask_"
-                          + itksys::SystemTools::GetFilenameName( mapID ) + "_"
-                          + local_to_string(curr_rotationAngle) + ".nii.gz" );
-      itkUtil::WriteImage<SImageType>( templateMask, tmpMaskName );
-      }
-
-    // Finally NCC is calculated in frequency domain
-    //
-    typedef itk::MaskedFFTNormalizedCorrelationImageFilter<FImageType3D, FImageType3D, SImageType> CorrelationFilterType;
-    CorrelationFilterType::Pointer correlationFilter = CorrelationFilterType::New();
-    correlationFilter->SetFixedImage( normalizedRoiImage );
-    correlationFilter->SetFixedImageMask( roiMask );
-    correlationFilter->SetMovingImage( lmkTemplateImage );
-    correlationFilter->SetMovingImageMask( templateMask );
-    correlationFilter->SetRequiredFractionOfOverlappingPixels( 1 );
-    correlationFilter->Update();
-    if( globalImagedebugLevel > 8 )
-      {
-      std::string ncc_output_name( this->m_ResultsDir + "/NCCOutput_"
-                          + itksys::SystemTools::GetFilenameName( mapID ) + "_"
-                          + local_to_string(curr_rotationAngle) + ".nii.gz" );
-      itkUtil::WriteImage<FImageType3D>( correlationFilter->GetOutput(), ncc_output_name );
-      }
-
-    // Maximum NCC for current rotation angle
-    typedef itk::MinimumMaximumImageCalculator<FImageType3D> MinimumMaximumImageCalculatorType;
-    MinimumMaximumImageCalculatorType::Pointer minimumMaximumImageCalculatorFilter =
-    MinimumMaximumImageCalculatorType::New ();
-    minimumMaximumImageCalculatorFilter->SetImage( correlationFilter->GetOutput() );
-    minimumMaximumImageCalculatorFilter->Compute();
-    double cc = minimumMaximumImageCalculatorFilter->GetMaximum();
+    const double cc = str.maximumCorrelation[curr_rotationAngle];
     if( cc > cc_rotation_max )
       {
       cc_rotation_max = cc;
       // Where maximum happens
-      FImageType3D::IndexType maximumCorrelationPatchCenter =
-                                      minimumMaximumImageCalculatorFilter->GetIndexOfMaximum();
-      correlationFilter->GetOutput()->TransformIndexToPhysicalPoint( maximumCorrelationPatchCenter, GuessPoint );
+      correlationFilter->GetOutput()->TransformIndexToPhysicalPoint( str.indexOfMaximum[curr_rotationAngle],
+                                                                     GuessPoint );
       }
     }
   cc_Max = cc_rotation_max;
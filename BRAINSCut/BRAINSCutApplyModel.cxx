@@ -32,6 +32,9 @@
 #include <itkBinaryFillholeImageFilter.h>
 #include <itkMultiplyImageFilter.h>
 #include "itkNumberToString.h"
+#include <itkMultiThreader.h>
+
+#include <algorithm>
 
 // TODO: consider using itk::LabelMap Hole filling process in ITK4
 BRAINSCutApplyModel
@@ -243,14 +246,13 @@ BRAINSCutApplyModel
                                                                                   currentROIName.c_str() );
     if( roiDataSet->GetAttribute<StringValue>("GenerateVector") == "true" )
       {
-      InputVectorMapType  roiInputVector = inputVectorGenerator.ComputeAndGetFeatureInputOfROI( currentROIName );
-      PredictValueMapType predictedOutputVector;
+      FeatureMatrix          roiInputVector;
+      PredictValueVectorType predictedOutputVector;
+      inputVectorGenerator.ComputeFeatureMatrixOfROI( currentROIName, roiInputVector );
 
       if( !m_computeSSE )
         {
-        PredictROI( roiInputVector, predictedOutputVector,
-                    roiIDsOrderNumber, inputVectorGenerator.GetInputVectorSize() );
-        roiInputVector.clear();
+        PredictROI( roiInputVector, predictedOutputVector, roiIDsOrderNumber );
         const std::string & ANNContinuousOutputFilename = GetContinuousPredictionFilename( subject, currentROIName );
 
         /* post processing
@@ -261,7 +263,8 @@ BRAINSCutApplyModel
         std::string           roiOutputFilename = GetROIVolumeName( subject, currentROIName );
         if( m_method == "ANN" )
           {
-          WritePredictROIProbabilityBasedOnReferenceImage( predictedOutputVector,
+          WritePredictROIProbabilityBasedOnReferenceImage( roiInputVector,
+                                                           predictedOutputVector,
                                                            imagesOfInterest.front(),
                                                            deformedROIs.find( currentROIName )->second,
                                                            ANNContinuousOutputFilename,
@@ -280,7 +283,8 @@ BRAINSCutApplyModel
           }
         else if( m_method == "RandomForest" )
           {
-          WritePredictROIProbabilityBasedOnReferenceImage( predictedOutputVector,
+          WritePredictROIProbabilityBasedOnReferenceImage( roiInputVector,
+                                                           predictedOutputVector,
                                                            imagesOfInterest.front(),
                                                            deformedROIs.find( currentROIName )->second,
                                                            ANNContinuousOutputFilename,
@@ -319,11 +323,9 @@ BRAINSCutApplyModel
         for( int currentIteration = 1; currentIteration <= m_trainIteration; ++currentIteration )
           {
           this->m_myDataHandler->SetANNModelFilenameAtIteration( currentIteration );
-          PredictROI( roiInputVector, predictedOutputVector,
-                      roiIDsOrderNumber, inputVectorGenerator.GetInputVectorSize() );
-          roiInputVector.clear();
+          PredictROI( roiInputVector, predictedOutputVector, roiIDsOrderNumber );
           const std::string roiReferenceFilename = GetROIVolumeName( subject, currentROIName );
-          const float       SSE = ComputeSSE( predictedOutputVector, roiReferenceFilename );
+          const float       SSE = ComputeSSE( roiInputVector, predictedOutputVector, roiReferenceFilename );
 
           m_ANNTestingSSEFileStream << currentROIName
                                     << ", subjectID, " << subjectID
@@ -353,7 +355,8 @@ BRAINSCutApplyModel
 
 float
 BRAINSCutApplyModel
-::ComputeSSE( const PredictValueMapType& predictedOutputVector,
+::ComputeSSE( const FeatureMatrix& roiInputFeatureMatrix,
+              const PredictValueVectorType& predictedOutputVector,
               const std::string & roiReferenceFilename )
 {
   WorkingImagePointer ReferenceVolume = ReadImageByFilename( roiReferenceFilename );
@@ -361,13 +364,12 @@ BRAINSCutApplyModel
   WorkingImageType::PixelType referenceValue = 0.0F;
   double                      SSE = 0.0F;
 
-  for( PredictValueMapType::const_iterator it = predictedOutputVector.begin();
-       it != predictedOutputVector.end();
-       ++it )
+  for( size_t row = 0; row < predictedOutputVector.size(); ++row )
     {
-    WorkingImageType::IndexType indexFromKey = FeatureInputVector::HashIndexFromKey( it->first );
+    WorkingImageType::IndexType indexFromKey =
+      FeatureInputVector::HashIndexFromKey( roiInputFeatureMatrix.GetKey( row ) );
     referenceValue = ReferenceVolume->GetPixel( indexFromKey );
-    SSE += (referenceValue - it->second) * (referenceValue - it->second);
+    SSE += (referenceValue - predictedOutputVector[row]) * (referenceValue - predictedOutputVector[row]);
     }
   double totalSize = predictedOutputVector.size();
   SSE = SSE / totalSize;
@@ -725,56 +727,105 @@ BRAINSCutApplyModel
   return closingFilter->GetOutput();
 }
 
-inline void
+void
 BRAINSCutApplyModel
-::PredictROI( InputVectorMapType&  roiInputFeatureVector,
-              PredictValueMapType& resultOutputVector,
-              const unsigned int         roiNumber,
-              const unsigned int         inputVectorSize) const
+::PredictROI( const FeatureMatrix&    roiInputFeatureMatrix,
+              PredictValueVectorType& resultOutputVector,
+              const unsigned int      roiNumber ) const
 {
-  const unsigned int NumberOfROIS = this->m_myDataHandler->GetROIIDsInOrder().size();
+  const size_t numberOfRows = roiInputFeatureMatrix.GetNumberOfRows();
 
-  // The openCVOutput is unnecessary of RandomForest, but it is really cheap to do once.
-  // even if it is wasted effort.
-  // CvMat * openCVOutput = cvCreateMat( 1, NumberOfROIS, CV_32FC1);
+  resultOutputVector.resize( numberOfRows );
+  if( numberOfRows == 0 )
+    {
+    return;
+    }
 
-  /* initialize container of output vector*/
-  resultOutputVector.clear();
-  for( InputVectorMapType::iterator it = roiInputFeatureVector.begin();
-       it != roiInputFeatureVector.end();
-       ++it )
+  PredictionThreadStruct str;
+  str.applyModel = this;
+  str.roiInputFeatureMatrix = &roiInputFeatureMatrix;
+  str.roiNumber = roiNumber;
+  str.numberOfROIs = this->m_myDataHandler->GetROIIDsInOrder().size();
+  str.resultOutputVector = &resultOutputVector;
+
+  /* the ANN writes every ROI output of every row, so allocate that once for the whole ROI */
+  std::vector<scalarType> annOutput;
+  str.annOutput = ITK_NULLPTR;
+  if( m_method == "ANN" )
+    {
+    annOutput.resize( numberOfRows * str.numberOfROIs );
+    str.annOutput = &( annOutput[0] );
+    }
+  else if( m_method != "RandomForest" )
     {
-    /* get open cv type matrix from array for prediction */
+    std::string errorMsg = " No prediction method of " + m_method;
+    throw BRAINSCutExceptionStringHandler( errorMsg );
+    }
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetSingleMethod( PredictROIThreaderCallback, &str );
+  threader->SingleMethodExecute();
+}
+
+ITK_THREAD_RETURN_TYPE
+BRAINSCutApplyModel
+::PredictROIThreaderCallback( void * arg )
+{
+  const itk::ThreadIdType threadId = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->ThreadID;
+  const itk::ThreadIdType threadCount = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->NumberOfThreads;
+
+  const PredictionThreadStruct * str =
+    (PredictionThreadStruct *)( ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->UserData);
+
+  const size_t numberOfRows = str->roiInputFeatureMatrix->GetNumberOfRows();
+  const size_t rowsPerThread = ( numberOfRows + threadCount - 1 ) / threadCount;
+  const size_t firstRow = std::min( threadId * rowsPerThread, numberOfRows );
+  const size_t lastRow = std::min( firstRow + rowsPerThread, numberOfRows );
 
+  if( firstRow < lastRow )
+    {
+    str->applyModel->ThreadedPredictROI( *str, firstRow, lastRow );
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+void
+BRAINSCutApplyModel
+::ThreadedPredictROI( const PredictionThreadStruct & str,
+                      const size_t firstRow,
+                      const size_t lastRow ) const
+{
+  const FeatureMatrix & featureMatrix = *( str.roiInputFeatureMatrix );
+  const int             inputVectorSize = featureMatrix.GetNumberOfColumns();
+  const int             numberOfRows = lastRow - firstRow;
+
+  /* matrix headers over the rows of this block, nothing is copied */
+  if( m_method == "ANN" )
+    {
     CvMat openCVInputFeature;
-    cvInitMatHeader( &openCVInputFeature, 1, inputVectorSize, CV_32FC1,
-                     &(it->second[0]) ); //
-                                         // http://stackoverflow.com/questions/6701816/how-to-use-a-stdvector-in-a-c-function
-    // std::cout<<FeatureInputVector::HashIndexFromKey( it->first );
+    cvInitMatHeader( &openCVInputFeature, numberOfRows, inputVectorSize, CV_32FC1,
+                     const_cast<scalarType *>( featureMatrix.GetRow( firstRow ) ) );
+    CvMat openCVOutput;
+    cvInitMatHeader( &openCVOutput, numberOfRows, str.numberOfROIs, CV_32FC1,
+                     str.annOutput + firstRow * str.numberOfROIs );
 
-    /* predict */
-    if( m_method == "ANN" )
+    this->m_openCVANN->predict( &openCVInputFeature, &openCVOutput );
+
+    for( size_t row = firstRow; row < lastRow; ++row )
       {
-      CvMat * openCVOutput = cvCreateMat( 1, NumberOfROIS, CV_32FC1 );
-      this->m_openCVANN->predict( &openCVInputFeature, openCVOutput );
-
-      /* insert result to the result output vector */
-      resultOutputVector.insert( std::pair<hashKeyType, scalarType>(
-                                   ( it->first ),
-                                   cvmGet( openCVOutput,  0, roiNumber) ) );
-      // CV_MAT_ELEM( *openCVOutput, scalarType, 0, roiNumber) ) );
+      ( *str.resultOutputVector )[row] = str.annOutput[row * str.numberOfROIs + str.roiNumber];
       }
-    else if( m_method == "RandomForest" )
-      {
-      const scalarType response = m_openCVRandomForest->predict( &openCVInputFeature );
-      // make binary input
-      /*if( response > 0.5F )
+    }
+  else
+    {
+    /* random trees only predict one sample at a time */
+    CvMat openCVInputFeature;
+    for( size_t row = firstRow; row < lastRow; ++row )
       {
-        response = 1.0F;
-      }*/
-      resultOutputVector.insert( std::pair<hashKeyType, scalarType>(  ( it->first ),
-                                                                      response ) );
-      // std::cout<<"--> "<<response<<std::endl;
+      cvInitMatHeader( &openCVInputFeature, 1, inputVectorSize, CV_32FC1,
+                       const_cast<scalarType *>( featureMatrix.GetRow( row ) ) );
+      ( *str.resultOutputVector )[row] = m_openCVRandomForest->predict( &openCVInputFeature );
       }
     }
 }
@@ -834,7 +885,8 @@ BRAINSCutApplyModel
 
 inline void
 BRAINSCutApplyModel
-::WritePredictROIProbabilityBasedOnReferenceImage( const PredictValueMapType& predictedOutput,
+::WritePredictROIProbabilityBasedOnReferenceImage( const FeatureMatrix& roiInputFeatureMatrix,
+                                                   const PredictValueVectorType& predictedOutput,
                                                    const WorkingImagePointer& referenceImage,
                                                    const WorkingImagePointer& roi,
                                                    const std::string & imageFilename,
@@ -846,13 +898,12 @@ BRAINSCutApplyModel
   ANNContinuousOutputImage->SetRegions( referenceImage->GetLargestPossibleRegion() );
   ANNContinuousOutputImage->Allocate();
   ANNContinuousOutputImage->FillBuffer( 0.0F );
-  for( PredictValueMapType::const_iterator it = predictedOutput.begin();
-       it != predictedOutput.end();
-       ++it )
+  for( size_t row = 0; row < predictedOutput.size(); ++row )
     {
-    WorkingImageType::IndexType indexFromKey = FeatureInputVector::HashIndexFromKey( it->first );
+    WorkingImageType::IndexType indexFromKey =
+      FeatureInputVector::HashIndexFromKey( roiInputFeatureMatrix.GetKey( row ) );
 
-    ANNContinuousOutputImage->SetPixel( indexFromKey, it->second );
+    ANNContinuousOutputImage->SetPixel( indexFromKey, predictedOutput[row] );
     }
 
   itk::ImageRegionIterator<WorkingImageType> imgIt( roi, roi->GetLargestPossibleRegion() );
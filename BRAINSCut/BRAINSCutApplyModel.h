@@ -104,14 +104,31 @@ private:
   /* private functions  */
   std::string GetANNModelBaseName();
 
-  float ComputeSSE(const PredictValueMapType& predictedOutputVector, const std::string & roiReferenceFilename );
+  float ComputeSSE( const FeatureMatrix& roiInputFeatureMatrix, const PredictValueVectorType& predictedOutputVector,
+                    const std::string & roiReferenceFilename );
 
   /* inline functions */
 
-  void PredictROI( InputVectorMapType& roiInputFeatureVector, PredictValueMapType& resultOutputVector,
-                   const unsigned int roiNumber, const unsigned int inputVectorSize) const;
+  /** everything the prediction threads share */
+  struct PredictionThreadStruct
+    {
+    const BRAINSCutApplyModel * applyModel;
+    const FeatureMatrix *       roiInputFeatureMatrix;
+    unsigned int                roiNumber;
+    unsigned int                numberOfROIs;
+    scalarType *                annOutput; // numberOfRows x numberOfROIs, ANN only
+    PredictValueVectorType *    resultOutputVector;
+    };
 
-  inline void WritePredictROIProbabilityBasedOnReferenceImage( const PredictValueMapType& predictedOutput,
+  void PredictROI( const FeatureMatrix& roiInputFeatureMatrix, PredictValueVectorType& resultOutputVector,
+                   const unsigned int roiNumber ) const;
+
+  static ITK_THREAD_RETURN_TYPE PredictROIThreaderCallback( void * arg );
+
+  void ThreadedPredictROI( const PredictionThreadStruct & str, const size_t firstRow, const size_t lastRow ) const;
+
+  inline void WritePredictROIProbabilityBasedOnReferenceImage( const FeatureMatrix& roiInputFeatureMatrix,
+                                                               const PredictValueVectorType& predictedOutput,
                                                                const WorkingImagePointer& referenceImage,
                                                                const WorkingImagePointer& roi,
                                                                const std::string & imageFilename, const WorkingPixelType & labelValue =
@@ -18,6 +18,8 @@
  *=========================================================================*/
 #include "BRAINSCutCreateVector.h"
 
+#include <algorithm>
+
 BRAINSCutCreateVector
 ::BRAINSCutCreateVector( BRAINSCutDataHandler dataHandler ) :
   m_inputVectorSize(0),
@@ -137,7 +139,8 @@ BRAINSCutCreateVector
     if( roiDataSet->GetAttribute<StringValue>("GenerateVector") == "true" )
       {
       /* get input vector */
-      InputVectorMapType roiInputVector = inputVectorGenerator.ComputeAndGetFeatureInputOfROI( currentROI );
+      FeatureMatrix roiInputVector;
+      inputVectorGenerator.ComputeFeatureMatrixOfROI( currentROI, roiInputVector );
 
       /*
        * get paired output vector
@@ -148,7 +151,7 @@ BRAINSCutCreateVector
       OutputVectorMapType roiOutputVector = GetPairedOutput( deformedROIs, currentROI,
                                                              subjectROIBinaryName, roiIDsOrderNumber );
       WriteCurrentVectors( roiInputVector, roiOutputVector, outputStream );
-      numberOfVectors += roiInputVector.size();
+      numberOfVectors += roiInputVector.GetNumberOfRows();
       }
 
     ++roiIDsOrderNumber;
@@ -213,37 +216,42 @@ BRAINSCutCreateVector
 
 void
 BRAINSCutCreateVector
-::WriteCurrentVectors( InputVectorMapType& pairedInput,
+::WriteCurrentVectors( const FeatureMatrix& pairedInput,
                        OutputVectorMapType& pairedOutput,
                        std::ofstream& outputStream )
 {
-  int bufferSize       = (m_inputVectorSize + m_outputVectorSize + 1);
+  const int bufferSize = (m_inputVectorSize + m_outputVectorSize + 1);
+
+  /* records are written in ascending hash key order, as they always have been */
+  std::vector<std::pair<hashKeyType, size_t> > rowsInKeyOrder( pairedInput.GetNumberOfRows() );
+  for( size_t row = 0; row < rowsInKeyOrder.size(); ++row )
+    {
+    rowsInKeyOrder[row] = std::make_pair( pairedInput.GetKey( row ), row );
+    }
+  std::sort( rowsInKeyOrder.begin(), rowsInKeyOrder.end() );
 
-  for( InputVectorMapType::iterator it = pairedInput.begin();
-       it != pairedInput.end();
+  std::vector<scalarType> bufferToWrite( bufferSize );
+  bufferToWrite[bufferSize - 1] = LineGuard;
+  for( std::vector<std::pair<hashKeyType, size_t> >::const_iterator it = rowsInKeyOrder.begin();
+       it != rowsInKeyOrder.end();
        ++it )
     {
-    scalarType *bufferToWrite = new scalarType[bufferSize];
-    bufferToWrite[bufferSize - 1] = LineGuard;
-    for( int i = 0; i < m_outputVectorSize; ++i )
+    OutputVectorMapType::const_iterator outputVector = pairedOutput.find( it->first );
+    if( outputVector == pairedOutput.end() )
       {
-      if( pairedOutput.find( it->first) == pairedOutput.end() )
-        {
-        std::cout << "No output compute for this "
-                  << it->first << " at " << FeatureInputVector::HashIndexFromKey( it->first )
-                  << std::endl;
-        }
-      InputVectorType inputVector = (pairedOutput.find( it->first) )->second;
-
-      bufferToWrite[i] = inputVector[i];
-      }
-    for( int j = 0; j < m_inputVectorSize; ++j )
-      {
-      bufferToWrite[m_outputVectorSize + j] = (it->second)[j];
+      std::cout << "No output compute for this "
+                << it->first << " at " << FeatureInputVector::HashIndexFromKey( it->first )
+                << std::endl;
+      std::string errorMsg = " Missing paired output of the input vector.";
+      throw BRAINSCutExceptionStringHandler( errorMsg );
       }
+    std::copy( outputVector->second.begin(), outputVector->second.begin() + m_outputVectorSize,
+               bufferToWrite.begin() );
+
+    const scalarType * inputVector = pairedInput.GetRow( it->second );
+    std::copy( inputVector, inputVector + m_inputVectorSize, bufferToWrite.begin() + m_outputVectorSize );
 
-    outputStream.write( (const char *) bufferToWrite, bufferSize * sizeof(scalarType) );
-    delete[] bufferToWrite;
+    outputStream.write( (const char *) &( bufferToWrite[0] ), bufferSize * sizeof(scalarType) );
     }
 }
 
@@ -35,7 +35,7 @@ public:
 
   int  CreateSubjectVectors( DataSet& subject, std::ofstream& outputStream);
 
-  void WriteCurrentVectors( InputVectorMapType& pairedInput, OutputVectorMapType& pairedOutput,
+  void WriteCurrentVectors( const FeatureMatrix& pairedInput, OutputVectorMapType& pairedOutput,
                             std::ofstream& outputStream );
 
   void WriteHeaderFile( std::string vectorFilename, int m_inputVectorSize, int m_outputVectorSize,
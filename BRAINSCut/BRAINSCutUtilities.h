@@ -96,7 +96,7 @@ typedef std::vector<WorkingPixelType> OutputVectorType;
 // HACK TODO:  Regina int below should be unsigned int to avoid negative index numbers
 typedef std::map<int, InputVectorType>  InputVectorMapType; // < index ,feature vector > pair
 typedef std::map<int, OutputVectorType> OutputVectorMapType;
-typedef std::map<int, scalarType>       PredictValueMapType;
+typedef std::vector<scalarType>         PredictValueVectorType; // one prediction per feature matrix row
 
 std::string GetAtlasToSubjectRegistrationFilename( DataSet& subject);
 
@@ -23,7 +23,10 @@
 #include <fstream>
 // #include <vnl/vnl_random.h>
 
-// #include <fcntl.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // ---------------------------//
 BRAINSCutVectorTrainingSet
@@ -37,8 +40,11 @@ BRAINSCutVectorTrainingSet
   recordSize(0),
   bufferRecordSize(0),
   numberOfSubSet(1),
-  currentTrainingSubSet(ITK_NULLPTR)
-
+  currentTrainingSubSet(ITK_NULLPTR),
+  currentSubSetID(0),
+  mappedVectorFile(ITK_NULLPTR),
+  mappedVectorFileSize(0),
+  pairedOutputBufferRF()
 {
   // trainingVectorFilename = vectorFilename;
   // trainingHeaderFilename += ".hdr";
@@ -47,9 +53,11 @@ BRAINSCutVectorTrainingSet
 BRAINSCutVectorTrainingSet
 ::~BRAINSCutVectorTrainingSet()
 {
-  cvReleaseMat( &(currentTrainingSubSet->pairedInput) );
-  cvReleaseMat( &(currentTrainingSubSet->pairedOutput) );
-  cvReleaseMat( &(currentTrainingSubSet->pairedOutputRF) );
+  ReleaseTrainingSubSet();
+  if( mappedVectorFile != ITK_NULLPTR )
+    {
+    munmap( mappedVectorFile, mappedVectorFileSize );
+    }
 }
 
 // ---------------------------//
@@ -291,6 +299,72 @@ BRAINSCutVectorTrainingSet
     }
 }
 
+// ---------------------------//
+void
+BRAINSCutVectorTrainingSet
+::MapVectorFile()
+{
+  if( mappedVectorFile != ITK_NULLPTR )
+    {
+    return;
+    }
+  if( !itksys::SystemTools::FileExists( trainingVectorFilename.c_str() ) )
+    {
+    std::string msg( "Vector File has not been created. " + trainingVectorFilename );
+    throw BRAINSCutExceptionStringHandler( msg);
+    }
+
+  const int vectorFile = open( trainingVectorFilename.c_str(), O_RDONLY );
+  if( vectorFile == -1 )
+    {
+    std::string msg( "Cannot Open FileStream of " );
+    msg += trainingVectorFilename;
+    throw BRAINSCutExceptionStringHandler( msg );
+    }
+  struct stat vectorFileStatus;
+  if( fstat( vectorFile, &vectorFileStatus ) != 0 || vectorFileStatus.st_size == 0 )
+    {
+    close( vectorFile );
+    throw (  BRAINSCutExceptionStringHandler( "Vector File is Empty!! ") );
+    }
+  const size_t expectedSize = static_cast<size_t>( recordSize ) * totalVectorSize;
+  if( static_cast<size_t>( vectorFileStatus.st_size ) < expectedSize )
+    {
+    close( vectorFile );
+    std::string msg( "Vector File is shorter than its header says. " + trainingVectorFilename );
+    throw BRAINSCutExceptionStringHandler( msg );
+    }
+
+  /* private and writable, so nothing OpenCV might touch goes back to the file */
+  void * mapped = mmap( ITK_NULLPTR, expectedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, vectorFile, 0 );
+  close( vectorFile );
+  if( mapped == MAP_FAILED )
+    {
+    std::string msg( "Cannot memory map " );
+    msg += trainingVectorFilename;
+    throw BRAINSCutExceptionStringHandler( msg );
+    }
+  mappedVectorFile = static_cast<scalarType *>( mapped );
+  mappedVectorFileSize = expectedSize;
+}
+
+// ---------------------------//
+void
+BRAINSCutVectorTrainingSet
+::ReleaseTrainingSubSet()
+{
+  if( currentTrainingSubSet == ITK_NULLPTR )
+    {
+    return;
+    }
+  /* headers only, the data belongs to the mapped file */
+  cvReleaseMat( &(currentTrainingSubSet->pairedInput) );
+  cvReleaseMat( &(currentTrainingSubSet->pairedOutput) );
+  cvReleaseMat( &(currentTrainingSubSet->pairedOutputRF) );
+  delete currentTrainingSubSet;
+  currentTrainingSubSet = ITK_NULLPTR;
+}
+
 // ---------------------------//
 void
 BRAINSCutVectorTrainingSet
@@ -300,67 +374,71 @@ BRAINSCutVectorTrainingSet
   unsigned int subSetSize = totalVectorSize / numberOfSubSet;
   std::cout << totalVectorSize << "/" << numberOfSubSet << " = " << subSetSize << std::endl;
 
-  std::ifstream readInFile;
-  GetFileStreamToRead( trainingVectorFilename, readInFile );
+  if( subSetSize == 0 )
+    {
+    throw (  BRAINSCutExceptionStringHandler( "Vector File is Empty!! ") );
+    }
+
+  ReleaseTrainingSubSet();
+  MapVectorFile();
 
   /* set to the location of this subset */
-  std::ios::off_type seekval = static_cast<std::ios::off_type>( recordSize * subSetSize * count );
-  readInFile.seekg( seekval, std::ios::beg);
+  scalarType * const subSetBegin = mappedVectorFile + static_cast<size_t>( bufferRecordSize ) * subSetSize * count;
 
-  scalarType * currentBuffer = new scalarType[bufferRecordSize];
+  /* check every sentinel in one strided pass */
+  const scalarType * lineGuard = subSetBegin + bufferRecordSize - 1;
+  for( unsigned int i = 0; i < subSetSize; i++, lineGuard += bufferRecordSize )
+    {
+    if( *lineGuard != LineGuard )
+      {
+      throw ( BRAINSCutExceptionStringHandler( "Record not properly terminated by sentinel value") );
+      }
+    }
 
-  scalarType * pairedInputBuffer = new scalarType[subSetSize * inputVectorSize];
-  scalarType * pairedOutputBuffer = new scalarType[subSetSize * outputVectorSize];
-  scalarType * pairedOutputBufferRF = new scalarType[subSetSize];  // RandomForest
-  for( unsigned int i = 0; i < subSetSize  && !readInFile.eof(); i++ )
+  /* random forest wants the label number, the only thing not already in the file */
+  pairedOutputBufferRF.resize( subSetSize );
+  const scalarType * currentRecord = subSetBegin;
+  for( unsigned int i = 0; i < subSetSize; i++, currentRecord += bufferRecordSize )
     {
-    currentBuffer = ReadBufferFromFileStream( readInFile );
-    /* move this to one line buffer for open cv matrix type */
     scalarType tempOutput = 0;
     for( int j = 0; j < outputVectorSize; j++ )
       {
-      pairedOutputBuffer[i * outputVectorSize + j] = currentBuffer[j];
-      if( currentBuffer[j] > 0.5F && tempOutput == 0 )
+      if( currentRecord[j] > 0.5F && tempOutput == 0 )
         {
         tempOutput = j + 1;
         }
-      else if(  currentBuffer[j] > 0.5F && tempOutput != 0 )
+      else if(  currentRecord[j] > 0.5F && tempOutput != 0 )
         {
         std::cout << "A voxel belongs to more than a structure" << std::endl;
         exit(EXIT_FAILURE);
         }
       }
     pairedOutputBufferRF[i] = tempOutput;
-    for( int j = 0; j < inputVectorSize; j++ )
-      {
-      pairedInputBuffer[i * inputVectorSize + j] = currentBuffer[j + outputVectorSize];
-      }
     }
-  delete[] currentBuffer;
 
+  /* records are [ output | input | LineGuard ], so input and output are
+   * row views with the record as row step */
   currentTrainingSubSet = new pairedTrainingSetType;
-  currentTrainingSubSet->pairedInput = cvCreateMat( subSetSize, inputVectorSize, CV_32FC1 );
+  currentTrainingSubSet->size = subSetSize;
+  currentTrainingSubSet->pairedInput = cvCreateMatHeader( subSetSize, inputVectorSize, CV_32FC1 );
   cvInitMatHeader( currentTrainingSubSet->pairedInput,
                    subSetSize,
                    inputVectorSize,
                    CV_32FC1,
-                   pairedInputBuffer);
-  currentTrainingSubSet->pairedOutput = cvCreateMat( subSetSize, outputVectorSize, CV_32FC1);
+                   subSetBegin + outputVectorSize,
+                   static_cast<int>( recordSize ) );
+  currentTrainingSubSet->pairedOutput = cvCreateMatHeader( subSetSize, outputVectorSize, CV_32FC1);
   cvInitMatHeader( currentTrainingSubSet->pairedOutput,
                    subSetSize,
                    outputVectorSize,
                    CV_32FC1,
-                   pairedOutputBuffer);
+                   subSetBegin,
+                   static_cast<int>( recordSize ) );
 
-  currentTrainingSubSet->pairedOutputRF = cvCreateMat( subSetSize, 1, CV_32FC1);
+  currentTrainingSubSet->pairedOutputRF = cvCreateMatHeader( subSetSize, 1, CV_32FC1);
   cvInitMatHeader( currentTrainingSubSet->pairedOutputRF,
                    subSetSize,
                    1,
                    CV_32FC1,
-                   pairedOutputBufferRF);
-
-  if( currentTrainingSubSet->pairedInput->rows == 0 )
-    {
-    throw (  BRAINSCutExceptionStringHandler( "Vector File is Empty!! ") );
-    }
+                   &( pairedOutputBufferRF[0] ) );
 }
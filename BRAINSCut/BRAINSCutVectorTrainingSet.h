@@ -81,6 +81,10 @@ public:
 
   pairedTrainingSetType * GetTrainingSubSet( unsigned int count );
 
+  void                    MapVectorFile();
+
+  void                    ReleaseTrainingSubSet();
+
   pairedTrainingSetType * DownSampleTrainingDataSet( const unsigned int subSampleSize );
 
   void                    WriteVectorFile();
@@ -114,5 +118,11 @@ private:
   pairedTrainingSetType * currentTrainingSubSet;
 
   unsigned int currentSubSetID;   // goes from 0,1,..
+
+  /* the vector file is memory mapped, and the paired input/output matrices
+   * are strided views into the mapped records */
+  scalarType *            mappedVectorFile;
+  size_t                  mappedVectorFileSize;
+  std::vector<scalarType> pairedOutputBufferRF;
 };
 #endif
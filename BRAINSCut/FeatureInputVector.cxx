@@ -20,6 +20,8 @@
 #include "BRAINSCutExceptionStringHandler.h"
 #include "itkLabelStatisticsImageFilter.h"
 
+#include <algorithm>
+
 const unsigned int                MAX_IMAGE_SIZE = 1024;
 const WorkingImageType::IndexType ConstantHashIndexSize = {{1024, 1024, 1024}};
 
@@ -101,6 +103,7 @@ FeatureInputVector
   m_gradientSize(-1),
   m_inputVectorSize(0),
   m_normalizationMethod("None"),
+  m_numberOfThreads(0),
   m_imageInterpolator(ITK_NULLPTR),
   m_imagesOfInterestInOrder(),
   m_roiIDsInOrder(),
@@ -260,6 +263,13 @@ FeatureInputVector
     }
   return;
 };
+
+void
+FeatureInputVector
+::SetNumberOfThreads( const unsigned int numberOfThreads )
+{
+  m_numberOfThreads = numberOfThreads;
+}
 /*
 InputVectorMapType
 FeatureInputVector
@@ -325,6 +335,204 @@ FeatureInputVector
   return InputVectorMapType(featureInputOfROI.find( ROIName )->second);
 }
 
+void
+FeatureInputVector
+::ComputeFeatureMatrixOfROI( const std::string & ROIName, FeatureMatrix & featureMatrix )
+{
+  std::cout << "****************************************************" << std::endl;
+  std::cout << "***********ComputeFeatureMatrixOfROI****************" << std::endl;
+  std::cout << "****************************************************" << std::endl;
+
+  if( m_candidateROIs.find( ROIName ) == m_candidateROIs.end() )
+    {
+    std::string errorMsg = " No candidate ROI of " + ROIName + " to compute feature matrix.";
+    throw BRAINSCutExceptionStringHandler( errorMsg );
+    }
+
+  SetGradientImage( ROIName );
+
+  FeatureExtractionThreadStruct str;
+  str.featureInputVector = this;
+  str.roiImage = m_candidateROIs.find( ROIName )->second;
+
+  /* every image is read straight from its buffer with the offset of the ROI
+   * voxel, so all of them have to share the buffered region of the ROI */
+  const WorkingImageType::RegionType roiRegion = str.roiImage->GetLargestPossibleRegion();
+  if( str.roiImage->GetBufferedRegion() != roiRegion )
+    {
+    std::string errorMsg = " Candidate ROI of " + ROIName + " is not fully buffered.";
+    throw BRAINSCutExceptionStringHandler( errorMsg );
+    }
+  for( DataSet::StringVectorType::const_iterator roiStringIt = m_roiIDsInOrder.begin();
+       roiStringIt != m_roiIDsInOrder.end();
+       ++roiStringIt )
+    {
+    const WorkingImagePointer & currentROI = m_candidateROIs.find( *roiStringIt )->second;
+    if( currentROI->GetBufferedRegion() != roiRegion )
+      {
+      std::string errorMsg = " Candidate ROI of " + *roiStringIt + " does not share the region of " + ROIName;
+      throw BRAINSCutExceptionStringHandler( errorMsg );
+      }
+    str.candidateROIBuffers.push_back( currentROI->GetBufferPointer() );
+    }
+  const char * const spatialLocationNames[3] = { "rho", "phi", "theta" };
+  for( unsigned int s = 0; s < 3; ++s )
+    {
+    const WorkingImagePointer & currentLocation = m_spatialLocations.find( spatialLocationNames[s] )->second;
+    if( currentLocation->GetBufferedRegion() != roiRegion )
+      {
+      std::string errorMsg = " Spatial location image does not share the region of " + ROIName;
+      throw BRAINSCutExceptionStringHandler( errorMsg );
+      }
+    str.spatialLocationBuffers.push_back( currentLocation->GetBufferPointer() );
+    }
+  const GradientImageType & gradientImage = m_gradientOfROI.find( ROIName )->second;
+  if( gradientImage->GetBufferedRegion() != roiRegion )
+    {
+    std::string errorMsg = " Gradient image does not share the region of " + ROIName;
+    throw BRAINSCutExceptionStringHandler( errorMsg );
+    }
+  str.gradientBuffer = gradientImage->GetBufferPointer();
+
+  const unsigned int rowSize = m_roiIDsInOrder.size() + 3
+    + m_imagesOfInterestInOrder.size() * ( 2 * m_gradientSize + 1 );
+  if( rowSize > m_inputVectorSize )
+    {
+    std::string errorMsg = " Features along the gradient do not fit the input vector size.";
+    throw BRAINSCutExceptionStringHandler( errorMsg );
+    }
+
+  /* collect the candidate voxels once */
+  std::vector<hashKeyType> keys;
+  const WorkingPixelType * roiBuffer = str.roiImage->GetBufferPointer();
+  const size_t             numberOfPixels = roiRegion.GetNumberOfPixels();
+  for( size_t offset = 0; offset < numberOfPixels; ++offset )
+    {
+    if( (roiBuffer[offset] > (0.0F + FLOAT_TOLERANCE) ) &&
+        (roiBuffer[offset] < (1.0F - FLOAT_TOLERANCE) ) )
+      {
+      str.offsets.push_back( offset );
+      keys.push_back( HashKeyFromIndex( str.roiImage->ComputeIndex( offset ) ) );
+      }
+    }
+
+  featureMatrix.Resize( keys.size(), m_inputVectorSize );
+  for( size_t row = 0; row < keys.size(); ++row )
+    {
+    featureMatrix.SetKey( row, keys[row] );
+    }
+  str.featureMatrix = &featureMatrix;
+
+  /* m_normalization */
+  SetNormalizationParameters( ROIName );
+  str.scalingParameters = GetFeatureScalingParameters( ROIName, str.normalizationMethod );
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  if( m_numberOfThreads > 0 )
+    {
+    threader->SetNumberOfThreads( m_numberOfThreads );
+    }
+  threader->SetSingleMethod( ComputeFeatureMatrixThreaderCallback, &str );
+  threader->SingleMethodExecute();
+}
+
+ITK_THREAD_RETURN_TYPE
+FeatureInputVector
+::ComputeFeatureMatrixThreaderCallback( void * arg )
+{
+  const itk::ThreadIdType threadId = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->ThreadID;
+  const itk::ThreadIdType threadCount = ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->NumberOfThreads;
+
+  const FeatureExtractionThreadStruct * str =
+    (FeatureExtractionThreadStruct *)( ( (itk::MultiThreader::ThreadInfoStruct *)(arg) )->UserData);
+
+  const size_t numberOfRows = str->offsets.size();
+  const size_t rowsPerThread = ( numberOfRows + threadCount - 1 ) / threadCount;
+  const size_t firstRow = std::min( threadId * rowsPerThread, numberOfRows );
+  const size_t lastRow = std::min( firstRow + rowsPerThread, numberOfRows );
+
+  str->featureInputVector->ThreadedComputeFeatureRows( *str, firstRow, lastRow );
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+void
+FeatureInputVector
+::ThreadedComputeFeatureRows( const FeatureExtractionThreadStruct & str,
+                              const size_t firstRow, const size_t lastRow ) const
+{
+  /* interpolators are not shared between threads */
+  std::vector<ImageLinearInterpolatorType::Pointer> interpolators;
+  for( WorkingImageVectorType::const_iterator wit = m_imagesOfInterestInOrder.begin();
+       wit != m_imagesOfInterestInOrder.end();
+       ++wit )
+    {
+    ImageLinearInterpolatorType::Pointer interpolator = ImageLinearInterpolatorType::New();
+    interpolator->SetInputImage( *wit );
+    interpolators.push_back( interpolator );
+    }
+
+  const unsigned int numberOfColumns = str.featureMatrix->GetNumberOfColumns();
+  const float        gradientUnitSize = 1.0F;
+  for( size_t row = firstRow; row < lastRow; ++row )
+    {
+    const itk::OffsetValueType        offset = str.offsets[row];
+    const WorkingImageType::IndexType currentPixelIndex = str.roiImage->ComputeIndex( offset );
+
+    scalarType * const rowBegin = str.featureMatrix->GetRow( row );
+    scalarType *       element = rowBegin;
+
+    /* candidate ROIs */
+    for( size_t r = 0; r < str.candidateROIBuffers.size(); ++r )
+      {
+      *element++ = ( str.candidateROIBuffers[r][offset] > 0.0F + FLOAT_TOLERANCE ) ?
+        HundredPercentValue : ZeroPercentValue;
+      }
+
+    /* rho, phi, theta */
+    for( size_t s = 0; s < str.spatialLocationBuffers.size(); ++s )
+      {
+      *element++ = str.spatialLocationBuffers[s][offset];
+      }
+
+    /* unit delta along the gradient, same arithmetic as CalculateUnitDeltaAlongTheGradient */
+    const WorkingPixelType deltaX = str.gradientBuffer[offset][0];
+    const WorkingPixelType deltaY = str.gradientBuffer[offset][1];
+    const WorkingPixelType deltaZ = str.gradientBuffer[offset][2];
+
+    const scalarType Length = vcl_sqrt(deltaX * deltaX + deltaY * deltaY + deltaZ * deltaZ);
+    const scalarType inverseLength =  ( Length > 0.0F ) ? 1.0 / Length : 1;
+    const scalarType unitDeltaX = deltaX * inverseLength;
+    const scalarType unitDeltaY = deltaY * inverseLength;
+    const scalarType unitDeltaZ = deltaZ * inverseLength;
+
+    /* images of interest */
+    for( size_t j = 0; j < m_imagesOfInterestInOrder.size(); ++j )
+      {
+      const WorkingImagePointer &             featureImage = m_imagesOfInterestInOrder[j];
+      itk::Point<WorkingPixelType, DIMENSION> CenterPhysicalPoint;
+      featureImage->TransformIndexToPhysicalPoint( currentPixelIndex, CenterPhysicalPoint );
+      for( float i = -m_gradientSize; i <= m_gradientSize; i = i + gradientUnitSize )
+        {
+        itk::Point<WorkingPixelType, 3> gradientLocation;
+
+        gradientLocation[0] = CenterPhysicalPoint[0] + i * unitDeltaX;
+        gradientLocation[1] = CenterPhysicalPoint[1] + i * unitDeltaY;
+        gradientLocation[2] = CenterPhysicalPoint[2] + i * unitDeltaZ;
+
+        itk::ContinuousIndex<WorkingPixelType, DIMENSION> ContinuousIndexOfGradientLocation;
+        featureImage->TransformPhysicalPointToContinuousIndex( gradientLocation, ContinuousIndexOfGradientLocation );
+
+        *element++ = static_cast<scalarType>( interpolators[j]->
+                                              EvaluateAtContinuousIndex( ContinuousIndexOfGradientLocation ) );
+        }
+      }
+    std::fill( element, rowBegin + numberOfColumns, 0.0F );
+
+    NormalizeFeatureRow( rowBegin, str.normalizationMethod, str.scalingParameters );
+    }
+}
+
 /* set m_normalization parameters */
 void
 FeatureInputVector
@@ -589,103 +797,114 @@ void
 FeatureInputVector
 ::NormalizationOfVector( InputVectorMapType& currentFeatureVector, std::string ROIName )
 {
+  FeatureNormalizationMethodEnum          method;
+  const FeatureScalingParameterVectorType scalingParameters = GetFeatureScalingParameters( ROIName, method );
   for( InputVectorMapType::iterator eachInputVector = currentFeatureVector.begin();
        eachInputVector != currentFeatureVector.end();
        ++eachInputVector )
     {
-    InputVectorType::iterator featureElementIterator = (eachInputVector->second).begin();
-    featureElementIterator += (m_roiIDsInOrder.size() + m_spatialLocations.size() );
-    /*
-    minmaxPairVectorType currentMinmaxPairVector = m_minmax.find(ROIName)->second;
-      for( minmaxPairVectorType::const_iterator m_minmaxIt = currentMinmaxPairVector.begin();
-         m_minmaxIt != currentMinmaxPairVector.end();
-         ++m_minmaxIt )
+    NormalizeFeatureRow( &( (eachInputVector->second)[0] ), method, scalingParameters );
+    }
+}
+
+/* the statistics each normalization method needs, per image of interest */
+FeatureInputVector::FeatureScalingParameterVectorType
+FeatureInputVector
+::GetFeatureScalingParameters( const std::string & ROIName, FeatureNormalizationMethodEnum & method )
+{
+  std::map<std::string, FeatureNormalizationMethodEnum>::const_iterator methodIt =
+    m_featureNormalizationMap.find( m_normalizationMethod );
+  if( methodIt == m_featureNormalizationMap.end() )
+    {
+    std::cout << "In valid normalization type of " << m_normalizationMethod << std::endl;
+    std::exit( EXIT_FAILURE);
+    }
+  method = methodIt->second;
+
+  FeatureScalingParameterVectorType scalingParameters( m_imagesOfInterestInOrder.size() );
+  for( ImageTypeNo currentImgType = 0; currentImgType < scalingParameters.size(); ++currentImgType )
+    {
+    std::map<StatisticsString, scalarType> & statistics = m_statistics[ROIName][currentImgType];
+    FeatureScalingParameters &               parameters = scalingParameters[currentImgType];
+    parameters.first = 0.0F;
+    parameters.second = 0.0F;
+    parameters.third = 0.0F;
+    switch( method )
       {
-      for(  float i = -m_gradientSize; i <= m_gradientSize; i = i + 1.0F )
-        {
-        if( m_normalizationMethod == "Linear" )
-            {
-            scalarType normalizedValue = ( *featureElementIterator - m_minmaxIt->first );
-            normalizedValue = normalizedValue / ( m_minmaxIt->second - m_minmaxIt->first );
-            *featureElementIterator = normalizedValue;
-            }
-        ++featureElementIterator;
-        }
+      case Linear:
+        parameters.first = statistics["Minimum"];
+        parameters.second = statistics["Maximum"];
+        break;
+      case Sigmoid_Q05:
+        parameters.first = statistics["Median"];
+        parameters.second = statistics["Q_95"] - statistics["Q_05"];
+        break;
+      case Sigmoid_Q01:
+        parameters.first = statistics["Median"];
+        parameters.second = statistics["Q_99"] - statistics["Q_01"];
+        break;
+      case DoubleSigmoid_Q05:
+        parameters.first = statistics["Median"];
+        parameters.second = statistics["Median"] - statistics["Q_05"];
+        parameters.third = statistics["Q_95"] - statistics["Median"];
+        break;
+      case DoubleSigmoid_Q01:
+        parameters.first = statistics["Median"];
+        parameters.second = statistics["Median"] - statistics["Q_01"];
+        parameters.third = statistics["Q_99"] - statistics["Median"];
+        break;
+      case zScore:
+        parameters.first = statistics["Mean"];
+        parameters.second = statistics["Sigma"];
+        break;
+      case IQR:
+        parameters.first = statistics["Median"];
+        parameters.second = statistics["Q_75"] - statistics["Q_25"];
+        break;
+      case None:
+        // do nothing
+        break;
       }
-    */
-    ImageTypeNo currentImgType = 0;
-    for( WorkingImageVectorType::const_iterator eachTypeOfImage = m_imagesOfInterestInOrder.begin();
-         eachTypeOfImage != m_imagesOfInterestInOrder.end();
-         ++eachTypeOfImage )
+    }
+  return scalingParameters;
+}
+
+void
+FeatureInputVector
+::NormalizeFeatureRow( scalarType * row, const FeatureNormalizationMethodEnum method,
+                       const FeatureScalingParameterVectorType & scalingParameters ) const
+{
+  scalarType * featureElement = row + m_roiIDsInOrder.size() + m_spatialLocations.size();
+
+  for( FeatureScalingParameterVectorType::const_iterator parameters = scalingParameters.begin();
+       parameters != scalingParameters.end();
+       ++parameters )
+    {
+    for(  float i = -m_gradientSize; i <= m_gradientSize; i = i + 1.0F )
       {
-      for(  float i = -m_gradientSize; i <= m_gradientSize; i = i + 1.0F )
+      switch( method )
         {
-        if( m_normalizationMethod == "Linear" )
-          {
-          *featureElementIterator = LinearScaling( *featureElementIterator,
-                                                   m_statistics[ROIName][currentImgType]["Minimum"],
-                                                   m_statistics[ROIName][currentImgType]["Maximum"] );
-          }
-        else if( m_normalizationMethod == "Sigmoid_Q05" )
-          {
-          // Sigmoid
-          *featureElementIterator = Sigmoid( *featureElementIterator,
-                                             m_statistics[ROIName][currentImgType]["Median"],
-                                             m_statistics[ROIName][currentImgType]["Q_95"]
-                                             - m_statistics[ROIName][currentImgType]["Q_05"] );
-          }
-        else if( m_normalizationMethod == "Sigmoid_Q01" )
-          {
-          // Sigmoid
-          *featureElementIterator = Sigmoid( *featureElementIterator,
-                                             m_statistics[ROIName][currentImgType]["Median"],
-                                             m_statistics[ROIName][currentImgType]["Q_99"]
-                                             - m_statistics[ROIName][currentImgType]["Q_01"] );
-          }
-        else if( m_normalizationMethod == "DoubleSigmoid_Q05" )
-          {
-          *featureElementIterator = doubleSigmoid( *featureElementIterator,
-                                                   m_statistics[ROIName][currentImgType]["Median"],
-                                                   m_statistics[ROIName][currentImgType]["Median"]
-                                                   - m_statistics[ROIName][currentImgType]["Q_05"],
-                                                   m_statistics[ROIName][currentImgType]["Q_95"]
-                                                   - m_statistics[ROIName][currentImgType]["Median"] );
-          }
-        else if( m_normalizationMethod == "DoubleSigmoid_Q01" )
-          {
-          *featureElementIterator = doubleSigmoid( *featureElementIterator,
-                                                   m_statistics[ROIName][currentImgType]["Median"],
-                                                   m_statistics[ROIName][currentImgType]["Median"]
-                                                   - m_statistics[ROIName][currentImgType]["Q_01"],
-                                                   m_statistics[ROIName][currentImgType]["Q_99"]
-                                                   - m_statistics[ROIName][currentImgType]["Median"] );
-          }
-        else if( m_normalizationMethod == "zScore" )
-          {
-          *featureElementIterator = ZScore( *featureElementIterator,
-                                            m_statistics[ROIName][currentImgType]["Mean"],
-                                            m_statistics[ROIName][currentImgType]["Sigma"] );
-          }
-        else if( m_normalizationMethod == "IQR" )
-          {
-          float current_IQR = m_statistics[ROIName][currentImgType]["Q_75"]
-            - m_statistics[ROIName][currentImgType]["Q_25"];
-          *featureElementIterator = ZScore( *featureElementIterator,
-                                            m_statistics[ROIName][currentImgType]["Median"],
-                                            current_IQR );
-          }
-        else if( m_normalizationMethod == "None" )
-          {
+        case Linear:
+          *featureElement = LinearScaling( *featureElement, parameters->first, parameters->second );
+          break;
+        case Sigmoid_Q05:
+        case Sigmoid_Q01:
+          *featureElement = Sigmoid( *featureElement, parameters->first, parameters->second );
+          break;
+        case DoubleSigmoid_Q05:
+        case DoubleSigmoid_Q01:
+          *featureElement = doubleSigmoid( *featureElement, parameters->first,
+                                           parameters->second, parameters->third );
+          break;
+        case zScore:
+        case IQR:
+          *featureElement = ZScore( *featureElement, parameters->first, parameters->second );
+          break;
+        case None:
           // do nothing
-          }
-        else
-          {
-          std::cout << "In valid normalization type of " << m_normalizationMethod << std::endl;
-          std::exit( EXIT_FAILURE);
-          }
-        ++featureElementIterator;
+          break;
         }
-      ++currentImgType;
+      ++featureElement;
       }
     }
 }
@@ -695,7 +914,7 @@ float
 FeatureInputVector
 ::Sigmoid( const float x,
            const float center,
-           const float range)
+           const float range) const
 {
   //    1
   // _____________
@@ -724,7 +943,7 @@ float
 FeatureInputVector
 ::LinearScaling( const float x,
                  const float min,
-                 const float max )
+                 const float max ) const
 {
   if( min == ZeroPercentValue && max == HundredPercentValue )
     {
@@ -742,7 +961,7 @@ float
 FeatureInputVector
 ::ZScore( const float x,
           const float mu,
-          const float sigma )
+          const float sigma ) const
 {
   float return_value;
   float zScore_value = ( x - mu ) / sigma;
@@ -763,7 +982,7 @@ FeatureInputVector
 ::doubleSigmoid( const float x,
                  const float t,
                  const float r1,
-                 const float r2)
+                 const float r2) const
 {
   //           1
   // ________________________
@@ -23,8 +23,71 @@
 
 #include <itkLinearInterpolateImageFunction.h>
 #include <itkGradientImageFilter.h>
+#include <itkMultiThreader.h>
 
 typedef unsigned int hashKeyType;
+
+/*
+ * Note
+ * - features of all candidate voxels of one ROI, one row per voxel.
+ *   Row r holds the features of the voxel with hash key GetKey(r), and all
+ *   rows live in a single contiguous row major buffer.
+ */
+class FeatureMatrix
+{
+public:
+  FeatureMatrix() : m_numberOfColumns(0)
+  {
+  }
+
+  void Resize( const size_t numberOfRows, const unsigned int numberOfColumns )
+  {
+    m_numberOfColumns = numberOfColumns;
+    m_keys.resize( numberOfRows );
+    m_values.resize( numberOfRows * numberOfColumns );
+  }
+
+  size_t GetNumberOfRows() const
+  {
+    return m_keys.size();
+  }
+
+  unsigned int GetNumberOfColumns() const
+  {
+    return m_numberOfColumns;
+  }
+
+  hashKeyType GetKey( const size_t row ) const
+  {
+    return m_keys[row];
+  }
+
+  void SetKey( const size_t row, const hashKeyType key )
+  {
+    m_keys[row] = key;
+  }
+
+  scalarType * GetRow( const size_t row )
+  {
+    return &( m_values[row * m_numberOfColumns] );
+  }
+
+  const scalarType * GetRow( const size_t row ) const
+  {
+    return &( m_values[row * m_numberOfColumns] );
+  }
+
+  /* first element of the row major buffer */
+  scalarType * GetBufferPointer()
+  {
+    return m_values.empty() ? ITK_NULLPTR : &( m_values[0] );
+  }
+
+private:
+  unsigned int             m_numberOfColumns;
+  std::vector<hashKeyType> m_keys;
+  std::vector<scalarType>  m_values;
+};
 /*
  * Note
  * - this class is to compute input vector of ONE subject for a given ROI
@@ -107,9 +170,17 @@ public:
 
   void NormalizationOfVector( InputVectorMapType& currentFeatureVector, std::string ROIName );
 
+  /** number of threads used by ComputeFeatureMatrixOfROI */
+  void SetNumberOfThreads( const unsigned int numberOfThreads );
+
   /** get function(s) */
   InputVectorMapType ComputeAndGetFeatureInputOfROI( std::string ROIName );
 
+  /* computes the same (normalized) features as ComputeAndGetFeatureInputOfROI,
+   * but resolves all image names once, writes into one contiguous matrix and
+   * is threaded over blocks of voxels. Rows are in image buffer order. */
+  void ComputeFeatureMatrixOfROI( const std::string & ROIName, FeatureMatrix & featureMatrix );
+
   /* HashGenerator From Index */
   /* hash function is based on fixed size of 'size'
    * This would not work if the size of image bigger than the size we are using here.
@@ -123,6 +194,7 @@ private:
   int          m_gradientSize;
   unsigned int m_inputVectorSize;
   std::string  m_normalizationMethod;
+  unsigned int m_numberOfThreads;
 
   ImageLinearInterpolatorType::Pointer m_imageInterpolator;
 
@@ -150,9 +222,44 @@ private:
 
   std::map<std::string, FeatureNormalizationMethodEnum> m_featureNormalizationMap;
 
+  /** normalization parameters of one image of interest, looked up once
+   *  per ROI instead of once per feature */
+  struct FeatureScalingParameters
+    {
+    float first;
+    float second;
+    float third;
+    };
+  typedef std::vector<FeatureScalingParameters> FeatureScalingParameterVectorType;
+
+  /** everything the feature extraction threads share */
+  struct FeatureExtractionThreadStruct
+    {
+    const FeatureInputVector *                      featureInputVector;
+    WorkingImagePointer                             roiImage;
+    std::vector<itk::OffsetValueType>               offsets;
+    std::vector<const WorkingPixelType *>           candidateROIBuffers;
+    std::vector<const WorkingPixelType *>           spatialLocationBuffers;
+    const GradientImageType::ObjectType::PixelType *gradientBuffer;
+    FeatureNormalizationMethodEnum                  normalizationMethod;
+    FeatureScalingParameterVectorType               scalingParameters;
+    FeatureMatrix *                                 featureMatrix;
+    };
+
   /** private functions */
   // void ComputeFeatureInputOfROI( std::string ROIName);
 
+  FeatureScalingParameterVectorType GetFeatureScalingParameters( const std::string & ROIName,
+                                                                 FeatureNormalizationMethodEnum & method );
+
+  void NormalizeFeatureRow( scalarType * row, const FeatureNormalizationMethodEnum method,
+                            const FeatureScalingParameterVectorType & scalingParameters ) const;
+
+  static ITK_THREAD_RETURN_TYPE ComputeFeatureMatrixThreaderCallback( void * arg );
+
+  void ThreadedComputeFeatureRows( const FeatureExtractionThreadStruct & str,
+                                   const size_t firstRow, const size_t lastRow ) const;
+
   void SetGradientImage( std::string ROIName );
 
   void SetNormalizationParameters( std::string ROIName);
@@ -179,12 +286,12 @@ private:
   inline std::pair<scalarType, scalarType>  SetMinMaxOfSubject( BinaryImageType::Pointer & labelImage,
                                                                 const WorkingImagePointer & Image );
 
-  inline float Sigmoid( const float x, const float t, const float r );
+  inline float Sigmoid( const float x, const float t, const float r ) const;
 
-  inline float LinearScaling( float x, float min, float max );
+  inline float LinearScaling( float x, float min, float max ) const;
 
-  inline float doubleSigmoid( const float x, const float t, const float r1, const float r2);
+  inline float doubleSigmoid( const float x, const float t, const float r1, const float r2) const;
 
-  inline float ZScore( const float x, const float mu, const float sigma );
+  inline float ZScore( const float x, const float mu, const float sigma ) const;
 };
 #endif
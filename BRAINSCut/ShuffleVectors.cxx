@@ -19,7 +19,8 @@
 #include "ShuffleVectors.h"
 #include "BRAINSCutDataHandler.h"
 
-#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
 
 #define MAX_LINE_SIZE 1000
 
@@ -131,31 +132,114 @@ class findUINT64Type<8>
 {
 public:  typedef unsigned long unsigned64;
 };
+
+typedef findUINT64Type<sizeof(unsigned long)>::unsigned64 unsigned64;
+
+inline unsigned64
+RandomUnsigned64( vnl_random & randgen )
+{
+  return ( static_cast<unsigned64>( randgen.lrand32() ) << 32 )
+         | static_cast<unsigned64>( randgen.lrand32() );
+}
 }
 
 void
-ShuffleVectors::ShuffleOrder(std::vector<std::ios::off_type> & rval) const
+ShuffleVectors::SetMemoryBudgetInMB( const unsigned int memoryBudgetInMB )
 {
-  typedef findUINT64Type<sizeof(unsigned long)>::unsigned64 unsigned64;
-  vnl_random randgen;
-#define randgen64()                                      \
-  ( ( static_cast<unsigned64>( randgen.lrand32() ) << 32 ) \
-    | static_cast<unsigned64>( randgen.lrand32() ) )
-
-  rval.resize(m_output_TVC);
-  for( unsigned long i = 0; i < m_output_TVC; i++ )
+  m_memoryBudgetInMB = memoryBudgetInMB;
+}
+
+std::string
+ShuffleVectors::TempName( const unsigned int bucketNumber ) const
+{
+  std::ostringstream tempName;
+
+  tempName << m_outputVectorFilename << ".bucket" << bucketNumber;
+  return tempName.str();
+}
+
+void
+ShuffleVectors::ReadInputRecords( std::ifstream & inputVectorFileStream,
+                                  float * buffer,
+                                  const unsigned long numberOfRecords,
+                                  unsigned long & inputRecordIndex ) const
+{
+  const unsigned long recordLength = m_IVS + m_OVS + 1;
+
+  unsigned long recordsToRead = numberOfRecords;
+
+  while( recordsToRead > 0 )
     {
-    rval[i] = static_cast<std::ios::off_type>( i );
+    if( inputRecordIndex == m_input_TVC )
+      {
+      std::cout << "*** Re-open the vector file" << std::endl;
+      // read input vector file stream from the first again
+      inputVectorFileStream.clear();
+      inputVectorFileStream.seekg( 0, std::ios::beg );
+      inputRecordIndex = 0;
+      }
+    const unsigned long numberOfRecordsInBlock = std::min( recordsToRead, m_input_TVC - inputRecordIndex );
+
+    inputVectorFileStream.read( (char *)buffer, numberOfRecordsInBlock * recordLength * sizeof( float ) );
+    if( !inputVectorFileStream.good() )
+      {
+      std::cerr << "Premature end of file at record "
+                << inputRecordIndex << " of " << m_inputVectorFilename << std::endl;
+      exit(EXIT_FAILURE);
+      }
+    for( unsigned long record = 0; record < numberOfRecordsInBlock; ++record )
+      {
+      const float sentinel = buffer[record * recordLength + m_IVS + m_OVS];
+      if( sentinel != LineGuard )
+        {
+        std::cerr << "Record not properly terminated by sentinel value ::  "
+                  << sentinel << " != "
+                  << LineGuard
+                  << " at Vector index " << inputRecordIndex + record
+                  << std::endl;
+        exit(EXIT_FAILURE);
+        }
+      }
+    buffer += numberOfRecordsInBlock * recordLength;
+    inputRecordIndex += numberOfRecordsInBlock;
+    recordsToRead -= numberOfRecordsInBlock;
     }
+}
+
+void
+ShuffleVectors::ShuffleRecords( std::vector<float> & records,
+                                const unsigned long numberOfRecords,
+                                vnl_random & randgen ) const
+{
+  const unsigned long recordLength = m_IVS + m_OVS + 1;
+
   // do the shuffle
-  for( std::ios::off_type i = m_output_TVC - 1; i > 0; i-- )
+  for( unsigned long i = numberOfRecords - 1; i > 0 && i < numberOfRecords; i-- )
+    {
+    const unsigned long j = RandomUnsigned64( randgen ) % ( i + 1 );
+    if( j != i )
+      {
+      std::swap_ranges( records.begin() + i * recordLength,
+                        records.begin() + ( i + 1 ) * recordLength,
+                        records.begin() + j * recordLength );
+      }
+    }
+}
+
+void
+ShuffleVectors::WriteRecords( std::ofstream & outputStream,
+                              const float * buffer,
+                              const unsigned long numberOfRecords,
+                              const std::string & filename ) const
+{
+  const unsigned long recordSize = ( m_IVS + m_OVS + 1 ) * sizeof( float );
+
+  outputStream.write( (const char *)buffer, numberOfRecords * recordSize );
+  if( !outputStream.good() )
     {
-    std::ios::off_type j( randgen64() % ( i + 1 ) ); // rand() % (i+1);
-    std::ios::off_type tmp(rval[i]);
-    rval[i] = rval[j];
-    rval[j] = tmp;
+    std::cerr << "Can't write to " << filename << std::endl;
+    exit(EXIT_FAILURE);
     }
-  return;
 }
 
 //
@@ -166,7 +250,8 @@ ShuffleVectors::ShuffleVectors() :
   m_OVS(0),
   m_input_TVC(0),
   m_output_TVC(0),
-  m_resampleProportion(0.0F)
+  m_resampleProportion(0.0F),
+  m_memoryBudgetInMB(512)
 {
 }
 
@@ -176,7 +261,8 @@ ShuffleVectors::ShuffleVectors(const std::string& inputVectorFilename, const std
   m_OVS(0),
   m_input_TVC(0),
   m_output_TVC(0),
-  m_resampleProportion(0.0F)
+  m_resampleProportion(0.0F),
+  m_memoryBudgetInMB(512)
 {
   std::cout << "Shuffle Vectors of ======================================= " << std::endl
             << inputVectorFilename << " to " << std::endl
@@ -221,103 +307,144 @@ ShuffleVectors::Shuffling()
                               std::ios::in | std::ios::binary);
   if( !inputVectorFileStream.is_open() )
     {
-    std::cout << "Can't open " << m_inputVectorFilename;
+    std::cerr << "Can't open " << m_inputVectorFilename << std::endl;
+    exit(EXIT_FAILURE);
+    }
+  if( m_input_TVC == 0 && m_output_TVC > 0 )
+    {
+    std::cerr << "No vectors to shuffle in " << m_inputVectorFilename << std::endl;
+    exit(EXIT_FAILURE);
     }
 
-  int shuffledFile =
-    open(m_outputVectorFilename.c_str(),
-         O_WRONLY | O_CREAT | O_TRUNC,
-         S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-  if( shuffledFile == -1 )
+  std::ofstream shuffledFile;
+  shuffledFile.open( m_outputVectorFilename.c_str(),
+                     std::ios::out | std::ios::binary | std::ios::trunc );
+  if( !shuffledFile.is_open() )
     {
-    std::cout << "Can't open output file " << m_outputVectorFilename;
+    std::cerr << "Can't open output file " << m_outputVectorFilename << std::endl;
+    exit(EXIT_FAILURE);
     }
-  // make a shuffled output ordering
 
-  std::vector<std::ios::off_type> randomOrder;
-  ShuffleOrder(randomOrder);
+  /**
+   * The output takes the first m_output_TVC input records, cycling through
+   * the input again when upsampling. Every record goes to a randomly chosen
+   * bucket, and every bucket is small enough to be shuffled in memory, which
+   * gives a uniformly shuffled output with sequential reads and writes only.
+   */
+  const unsigned long recordLength = m_IVS + m_OVS + 1;
+  const unsigned long recordSize = recordLength * sizeof( float );
+  const unsigned long budgetInRecords =
+    std::max<unsigned long>( ( static_cast<unsigned long>( m_memoryBudgetInMB ) << 20 ) / recordSize, 2 );
+  const unsigned long recordsPerBucket = budgetInRecords / 2;
+  const unsigned long numberOfBuckets = ( m_output_TVC + recordsPerBucket - 1 ) / recordsPerBucket;
 
-  unsigned recordsize = ( m_IVS + m_OVS + 1 ) * sizeof( float );
-  float *  buf = new float[m_IVS + m_OVS + 1];
+  vnl_random    randgen;
+  unsigned long inputRecordIndex = 0;
 
   std::cout << "Writing a shuffled output file "
             << m_outputVectorFilename
             << std::endl;
 
-  float VectorsPerPercent = m_input_TVC / 100.0F;
-  int   current_percent = 0;
-  /**
-   * shuffle process goes through entire input vector file and then
-   * include only those have (randomly assigned) index less
-   * than a desired output size
-   */
-  for( unsigned int vectorIndex = 0;
-       vectorIndex < m_output_TVC;
-       vectorIndex++ )
+  if( numberOfBuckets <= 1 )
+    {
+    std::vector<float> records( m_output_TVC * recordLength );
+    if( m_output_TVC > 0 )
+      {
+      ReadInputRecords( inputVectorFileStream, &( records[0] ), m_output_TVC, inputRecordIndex );
+      ShuffleRecords( records, m_output_TVC, randgen );
+      WriteRecords( shuffledFile, &( records[0] ), m_output_TVC, m_outputVectorFilename );
+      }
+    shuffledFile.close();
+    std::cout << "done." << std::endl;
+    return;
+    }
+
+  /* scatter: half the budget reads the input, the other half buffers the buckets */
+  const unsigned long readBlockInRecords = std::max<unsigned long>( budgetInRecords / 4, 1 );
+  const unsigned long bucketBlockInRecords =
+    std::max<unsigned long>( budgetInRecords / ( 4 * numberOfBuckets ), 1 );
+
+  std::cout << "Scatter " << m_output_TVC << " vectors into "
+            << numberOfBuckets << " temporary buckets" << std::endl;
+
+  std::vector<float>              readBlock( readBlockInRecords * recordLength );
+  std::vector<std::vector<float> > bucketBlocks( numberOfBuckets );
+  std::vector<unsigned long>      bucketBlockCounts( numberOfBuckets, 0 );
+  std::vector<unsigned long>      bucketCounts( numberOfBuckets, 0 );
+  for( unsigned long bucket = 0; bucket < numberOfBuckets; ++bucket )
+    {
+    bucketBlocks[bucket].resize( bucketBlockInRecords * recordLength );
+    // start every bucket with an empty file
+    std::ofstream bucketFile( TempName( bucket ).c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    }
+
+  int current_percent = 0;
+  for( unsigned long vectorIndex = 0; vectorIndex < m_output_TVC; )
     {
-    if( vectorIndex > current_percent * VectorsPerPercent )
+    const unsigned long numberOfRecordsInBlock = std::min( readBlockInRecords, m_output_TVC - vectorIndex );
+    ReadInputRecords( inputVectorFileStream, &( readBlock[0] ), numberOfRecordsInBlock, inputRecordIndex );
+
+    for( unsigned long record = 0; record < numberOfRecordsInBlock; ++record )
       {
-      current_percent += 1;
-      if( current_percent % 5 == 0 )
+      const unsigned long bucket = RandomUnsigned64( randgen ) % numberOfBuckets;
+      std::copy( readBlock.begin() + record * recordLength,
+                 readBlock.begin() + ( record + 1 ) * recordLength,
+                 bucketBlocks[bucket].begin() + bucketBlockCounts[bucket] * recordLength );
+      ++bucketBlockCounts[bucket];
+      if( bucketBlockCounts[bucket] == bucketBlockInRecords )
         {
-        std::cout << current_percent << "% " << std::endl;
+        std::ofstream bucketFile( TempName( bucket ).c_str(), std::ios::out | std::ios::binary | std::ios::app );
+        WriteRecords( bucketFile, &( bucketBlocks[bucket][0] ), bucketBlockCounts[bucket], TempName( bucket ) );
+        bucketCounts[bucket] += bucketBlockCounts[bucket];
+        bucketBlockCounts[bucket] = 0;
         }
       }
+    vectorIndex += numberOfRecordsInBlock;
 
-    if( (vectorIndex + 1) % m_input_TVC == 1 ) // vector index starts from 0
+    const int percent = static_cast<int>( 100.0F * vectorIndex / m_output_TVC );
+    if( percent / 5 > current_percent / 5 )
       {
-      std::cout << "*** Re-open the vector file" << std::endl;
-      // read input vector file stream from the first again
-      inputVectorFileStream.close();
-      inputVectorFileStream.open( m_inputVectorFilename.c_str(),
-                                  std::ios::in | std::ios::binary);
+      std::cout << percent << "% " << std::endl;
       }
-    else if( inputVectorFileStream.eof() )
+    current_percent = percent;
+    }
+  inputVectorFileStream.close();
+  readBlock.clear();
+
+  for( unsigned long bucket = 0; bucket < numberOfBuckets; ++bucket )
+    {
+    if( bucketBlockCounts[bucket] > 0 )
       {
-      std::cerr << "Premature end of file at record "
-                << vectorIndex << std::endl
-                << (vectorIndex + 1) % m_input_TVC << " != 1" << std::endl;
-      break; // TODO throw error here
+      std::ofstream bucketFile( TempName( bucket ).c_str(), std::ios::out | std::ios::binary | std::ios::app );
+      WriteRecords( bucketFile, &( bucketBlocks[bucket][0] ), bucketBlockCounts[bucket], TempName( bucket ) );
+      bucketCounts[bucket] += bucketBlockCounts[bucket];
       }
+    std::vector<float>().swap( bucketBlocks[bucket] );
+    }
 
-    // read in the record
-    inputVectorFileStream.read( (char *)buf, recordsize );
-    /*
-    std::cout<< " randomOrder[ "<< vectorIndex<<" ] :: "
-             << randomOrder[vectorIndex]
-             << " < " << m_output_TVC
-             << " ? " << std::endl;
-             */
-    if( randomOrder[vectorIndex] < static_cast<std::ios::off_type>( m_output_TVC) )
+  /* gather: shuffle each bucket in memory and append it to the output */
+  std::vector<float> records;
+  for( unsigned long bucket = 0; bucket < numberOfBuckets; ++bucket )
+    {
+    const std::string bucketFilename = TempName( bucket );
+    if( bucketCounts[bucket] > 0 )
       {
-      std::ios::off_type seekval =
-        randomOrder[vectorIndex] * static_cast<std::ios::off_type>( recordsize );
-      lseek(shuffledFile, seekval, SEEK_SET);
-      (void)write(shuffledFile, (const char *) buf, recordsize);
-      /*
-      // debugging code
-      for( int dummy_i = 0; dummy_i< m_IVS  + m_OVS +1; dummy_i++ )
+      records.resize( bucketCounts[bucket] * recordLength );
+
+      std::ifstream bucketFile( bucketFilename.c_str(), std::ios::in | std::ios::binary );
+      bucketFile.read( (char *)&( records[0] ), bucketCounts[bucket] * recordSize );
+      if( !bucketFile.good() )
         {
-        std::cout<<buf[dummy_i]<<" ";
+        std::cerr << "Can't read back " << bucketFilename << std::endl;
+        exit(EXIT_FAILURE);
         }
-      std::cout<< " randomOrder[ "<< vectorIndex<<" ] :: "
-               << randomOrder[vectorIndex]
-               << " @ "
-               <<seekval <<std::endl;
-      */
-      }
+      bucketFile.close();
 
-    if( buf[m_IVS  + m_OVS] != LineGuard )
-      {
-      std::cerr << "Record not properly terminated by sentinel value ::  "
-                << buf[m_IVS  + m_OVS] << " != "
-                << LineGuard
-                << " at Vector index " << vectorIndex
-                << std::endl;
-      exit(EXIT_FAILURE); // TODO throw error here
+      ShuffleRecords( records, bucketCounts[bucket], randgen );
+      WriteRecords( shuffledFile, &( records[0] ), bucketCounts[bucket], m_outputVectorFilename );
       }
+    std::remove( bucketFilename.c_str() );
     }
-  close(shuffledFile);
+  shuffledFile.close();
   std::cout << "done." << std::endl;
-  delete[] buf;
 }
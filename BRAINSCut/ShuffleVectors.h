@@ -25,6 +25,7 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <vector>
 #include <vnl/vnl_random.h>
 #include <itksys/SystemTools.hxx>
 
@@ -39,6 +40,9 @@ class ShuffleVectors
   // 'AnyVectorFilename'+'.hdr'.
   //    The output header file will be flaged as shuffle = True
   //    - Eun Young (Regina) Kim
+  //    Records are scattered to randomly chosen temporary bucket files and
+  //    each bucket is shuffled in memory, so at most about 'memory budget'
+  //    bytes of vectors are held at once and all I/O is sequential.
 public:
   ShuffleVectors();
   ShuffleVectors( const std::string& inputFilename, const std::string& outputFilename, float downSampleSize = 1.0F );
@@ -50,10 +54,19 @@ public:
 
   void WriteHeader();
 
+  void SetMemoryBudgetInMB( const unsigned int memoryBudgetInMB );
+
 private:
-  std::string TempName( const char *s );
+  std::string TempName( const unsigned int bucketNumber ) const;
+
+  void ReadInputRecords( std::ifstream & inputVectorFileStream, float * buffer,
+                         const unsigned long numberOfRecords, unsigned long & inputRecordIndex ) const;
+
+  void ShuffleRecords( std::vector<float> & records, const unsigned long numberOfRecords,
+                       vnl_random & randgen ) const;
 
-  void ShuffleOrder(std::vector<std::ios::off_type> & rval) const;
+  void WriteRecords( std::ofstream & outputStream, const float * buffer, const unsigned long numberOfRecords,
+                     const std::string & filename ) const;
 
   //
   // Member Variables::
@@ -74,6 +87,10 @@ private:
   // - Down Sampling Size
   //
   float m_resampleProportion;
+  //
+  // - Memory used for vectors while shuffling
+  //
+  unsigned int m_memoryBudgetInMB;
 };
 
 #endif
@@ -32,6 +32,7 @@ main(int argc, char * *argv)
   ShuffleVectors * my_ShuffleVector = new ShuffleVectors(  inputVectorFileBaseName,
                                                            outputVectorFileBaseName,
                                                            resampleProportion);
+  my_ShuffleVector->SetMemoryBudgetInMB( memoryBudgetInMB );
   my_ShuffleVector->ReadHeader();
   my_ShuffleVector->Shuffling();
   my_ShuffleVector->WriteHeader();
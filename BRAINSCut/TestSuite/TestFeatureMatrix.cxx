@@ -0,0 +1,178 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "FeatureInputVector.h"
+#include "BRAINSCutExceptionStringHandler.h"
+#include "itkImageRegionIteratorWithIndex.h"
+
+/*
+ * Compares the threaded feature matrix against the per voxel feature map
+ * on synthetic images. Both have to be identical for every voxel.
+ */
+static WorkingImagePointer
+CreateTestImage( const unsigned int imageType )
+{
+  WorkingImageType::SizeType size;
+  size.Fill( 24 );
+  WorkingImageType::SpacingType spacing;
+  spacing[0] = 1.0;
+  spacing[1] = 1.2;
+  spacing[2] = 0.9;
+  WorkingImageType::PointType origin;
+  origin[0] = -10.0;
+  origin[1] = 4.0;
+  origin[2] = 2.5;
+
+  WorkingImagePointer image = WorkingImageType::New();
+  image->SetRegions( size );
+  image->SetSpacing( spacing );
+  image->SetOrigin( origin );
+  image->Allocate();
+
+  itk::ImageRegionIteratorWithIndex<WorkingImageType> it( image, image->GetLargestPossibleRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+    const WorkingImageType::IndexType index = it.GetIndex();
+    const float                       x = index[0] - 11.5F;
+    const float                       y = index[1] - 12.0F;
+    const float                       z = index[2] - 10.5F;
+    float                             value = 0.0F;
+    switch( imageType )
+      {
+      case 0: // probability map of a blob
+        value = vcl_exp( -( x * x + y * y + z * z ) / 40.0F );
+        break;
+      case 1: // a second, shifted probability map
+        value = vcl_exp( -( ( x - 3.0F ) * ( x - 3.0F ) + y * y + z * z ) / 30.0F );
+        break;
+      case 2:
+        value = vcl_sqrt( x * x + y * y + z * z );
+        break;
+      case 3:
+        value = vcl_atan2( y, x );
+        break;
+      case 4:
+        value = vcl_atan2( z, x );
+        break;
+      case 5:
+        value = 100.0F + 3.0F * x - 2.0F * y + 0.5F * z * z;
+        break;
+      default:
+        value = 50.0F + 10.0F * vcl_sin( 0.3F * x ) * vcl_cos( 0.2F * y ) + z;
+        break;
+      }
+    it.Set( value );
+    }
+  return image;
+}
+
+static int
+CompareFeatures( const std::string & normalizationMethod, const unsigned int numberOfThreads )
+{
+  std::map<std::string, WorkingImagePointer> candidateROIs;
+  candidateROIs["l_caudate"] = CreateTestImage( 0 );
+  candidateROIs["l_putamen"] = CreateTestImage( 1 );
+
+  DataSet::StringVectorType roiIDsInOrder;
+  roiIDsInOrder.push_back( "l_caudate" );
+  roiIDsInOrder.push_back( "l_putamen" );
+
+  std::map<std::string, WorkingImagePointer> spatialLocations;
+  spatialLocations["rho"] = CreateTestImage( 2 );
+  spatialLocations["phi"] = CreateTestImage( 3 );
+  spatialLocations["theta"] = CreateTestImage( 4 );
+
+  WorkingImageVectorType imagesOfInterest;
+  imagesOfInterest.push_back( CreateTestImage( 5 ) );
+  imagesOfInterest.push_back( CreateTestImage( 6 ) );
+
+  FeatureInputVector inputVectorGenerator;
+  inputVectorGenerator.SetGradientSize( 1 );
+  inputVectorGenerator.SetImagesOfInterestInOrder( imagesOfInterest );
+  inputVectorGenerator.SetImagesOfSpatialLocation( spatialLocations );
+  inputVectorGenerator.SetCandidateROIs( candidateROIs );
+  inputVectorGenerator.SetROIInOrder( roiIDsInOrder );
+  inputVectorGenerator.SetInputVectorSize();
+  inputVectorGenerator.SetNormalizationMethod( normalizationMethod );
+  inputVectorGenerator.SetNumberOfThreads( numberOfThreads );
+
+  InputVectorMapType featureMap = inputVectorGenerator.ComputeAndGetFeatureInputOfROI( "l_caudate" );
+  FeatureMatrix      featureMatrix;
+  inputVectorGenerator.ComputeFeatureMatrixOfROI( "l_caudate", featureMatrix );
+
+  if( featureMap.empty() || featureMap.size() != featureMatrix.GetNumberOfRows() )
+    {
+    std::cout << "ERROR: " << featureMap.size() << " feature vectors but "
+              << featureMatrix.GetNumberOfRows() << " rows in the feature matrix." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const unsigned int inputVectorSize = inputVectorGenerator.GetInputVectorSize();
+  for( size_t row = 0; row < featureMatrix.GetNumberOfRows(); ++row )
+    {
+    InputVectorMapType::const_iterator featureVector = featureMap.find( featureMatrix.GetKey( row ) );
+    if( featureVector == featureMap.end() )
+      {
+      std::cout << "ERROR: key " << featureMatrix.GetKey( row ) << " is not in the feature map." << std::endl;
+      return EXIT_FAILURE;
+      }
+    const scalarType * matrixRow = featureMatrix.GetRow( row );
+    for( unsigned int i = 0; i < inputVectorSize; ++i )
+      {
+      if( matrixRow[i] != featureVector->second[i] )
+        {
+        std::cout << "ERROR: " << normalizationMethod << " with " << numberOfThreads << " threads at "
+                  << FeatureInputVector::HashIndexFromKey( featureMatrix.GetKey( row ) ) << "[" << i << "]: "
+                  << matrixRow[i] << " != " << featureVector->second[i] << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+  std::cout << normalizationMethod << " with " << numberOfThreads << " threads: "
+            << featureMatrix.GetNumberOfRows() << " identical feature vectors." << std::endl;
+  return EXIT_SUCCESS;
+}
+
+int
+main(int /*argc*/, char * [] /*argv*/)
+{
+  const char * const normalizationMethods[] = { "None", "Linear", "Sigmoid_Q05", "DoubleSigmoid_Q01",
+                                                "zScore", "IQR" };
+  const unsigned int threads[] = { 1, 3, 8 };
+
+  int allOK = EXIT_SUCCESS;
+  try
+    {
+    for( unsigned int m = 0; m < 6; ++m )
+      {
+      for( unsigned int t = 0; t < 3; ++t )
+        {
+        if( CompareFeatures( normalizationMethods[m], threads[t] ) != EXIT_SUCCESS )
+          {
+          allOK = EXIT_FAILURE;
+          }
+        }
+      }
+    }
+  catch( BRAINSCutExceptionStringHandler & e )
+    {
+    std::cout << e.Error() << std::endl;
+    return EXIT_FAILURE;
+    }
+  return allOK;
+}
@@ -0,0 +1,409 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+// Times VectorESMDemonsRegistrationFunction::ComputeUpdate over every voxel
+// of synthetic one, two and three component images, against the previous
+// implementation that read the components through GetPixel() and collected
+// them in std::vectors, which is kept below for reference. Both are run on a
+// single thread with the symmetric gradient, and must give the same update.
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "itkVectorImage.h"
+#include "itkVectorESMDemonsRegistrationFunction.h"
+#include "itkConstNeighborhoodIterator.h"
+#include "itkImageRegionIterator.h"
+#include "itkTimeProbe.h"
+#include "vnl/vnl_math.h"
+
+typedef itk::VectorImage<float, 3>           VectorImageType;
+typedef itk::Image<itk::Vector<float, 3>, 3> DisplacementFieldType;
+typedef itk::VectorESMDemonsRegistrationFunction<VectorImageType, VectorImageType,
+                                                 DisplacementFieldType> FunctionType;
+typedef FunctionType::PixelType           UpdateType;
+typedef FunctionType::CovariantVectorType CovariantVectorType;
+typedef FunctionType::MovingImageType     WarpedImageType;
+typedef FunctionType::MovingPixelType     MovingPixelType;
+typedef FunctionType::IndexType           IndexType;
+
+// Smooth blobs whose contrast changes from component to component.
+static VectorImageType::Pointer
+MakeImage(const unsigned int imageSize, const unsigned int numberOfComponents, const double shiftAmplitude)
+{
+  VectorImageType::Pointer  image = VectorImageType::New();
+  VectorImageType::SizeType size;
+
+  size.Fill(imageSize);
+  VectorImageType::RegionType region;
+  region.SetSize(size);
+  image->SetRegions(region);
+  image->SetVectorLength(numberOfComponents);
+  image->Allocate();
+
+  itk::ImageRegionIterator<VectorImageType> it(image, region);
+  VectorImageType::PixelType                value(numberOfComponents);
+  const double                              center = 0.5 * imageSize;
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+    const VectorImageType::IndexType index = it.GetIndex();
+    double                           x[3];
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      const double phase = 2.0 * vnl_math::pi * index[( d + 1 ) % 3] / imageSize;
+      x[d] = ( index[d] - shiftAmplitude * vcl_sin(phase) - center ) / imageSize;
+      }
+    const double r2 = x[0] * x[0] + x[1] * x[1] + x[2] * x[2];
+    const double inner = vcl_exp( -r2 / 0.01 );
+    const double outer = vcl_exp( -r2 / 0.08 );
+    for( unsigned int c = 0; c < numberOfComponents; ++c )
+      {
+      const double sign = ( c % 2 == 0 ) ? 1.0 : -1.0;
+      value[c] = static_cast<float>( 100.0 * outer + sign * 60.0 * inner + 20.0 * c );
+      }
+    it.Set(value);
+    }
+  return image;
+}
+
+// A smooth field of a few voxels, large enough to map the border voxels
+// outside of the moving image.
+static DisplacementFieldType::Pointer
+MakeField(const unsigned int imageSize)
+{
+  DisplacementFieldType::Pointer  field = DisplacementFieldType::New();
+  DisplacementFieldType::SizeType size;
+
+  size.Fill(imageSize);
+  DisplacementFieldType::RegionType region;
+  region.SetSize(size);
+  field->SetRegions(region);
+  field->Allocate();
+
+  itk::ImageRegionIterator<DisplacementFieldType> it(field, region);
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+    const DisplacementFieldType::IndexType index = it.GetIndex();
+    DisplacementFieldType::PixelType       displacement;
+    for( unsigned int d = 0; d < 3; ++d )
+      {
+      const double phase = 2.0 * vnl_math::pi * index[( d + 2 ) % 3] / imageSize;
+      displacement[d] = static_cast<float>( 1.5 * vcl_sin(phase) );
+      }
+    it.Set(displacement);
+    }
+  return field;
+}
+
+// The warped moving components, fixed image gradient calculators and
+// normalization used by the previous ComputeUpdate, set up the same way as
+// VectorESMDemonsRegistrationFunction::InitializeIteration() does.
+struct GetPixelData
+  {
+  const VectorImageType *                                  FixedImage;
+  std::vector<FunctionType::AdaptorType::Pointer>          FixedAdaptors;
+  std::vector<FunctionType::AdaptorType::Pointer>          MovingAdaptors;
+  std::vector<FunctionType::WarperPointer>                 Warpers;
+  std::vector<FunctionType::GradientCalculatorPointer>     FixedImageGradientCalculators;
+  FunctionType::SpacingType                                FixedImageSpacing;
+  double                                                   Normalizer;
+  double                                                   DenominatorThreshold;
+  double                                                   IntensityDifferenceThreshold;
+  };
+
+static void
+InitializeGetPixelData(const VectorImageType *fixedImage, const VectorImageType *movingImage,
+                       DisplacementFieldType *field, const FunctionType *function, GetPixelData & data)
+{
+  data.FixedImage = fixedImage;
+  data.FixedImageSpacing = fixedImage->GetSpacing();
+  data.DenominatorThreshold = 1e-9;
+  data.IntensityDifferenceThreshold = function->GetIntensityDifferenceThreshold();
+
+  data.Normalizer = 0.0;
+  for( unsigned int k = 0; k < 3; ++k )
+    {
+    data.Normalizer += data.FixedImageSpacing[k] * data.FixedImageSpacing[k];
+    }
+  data.Normalizer *= function->GetMaximumUpdateStepLength() * function->GetMaximumUpdateStepLength() / 3.0;
+
+  for( unsigned int i = 0; i < fixedImage->GetVectorLength(); ++i )
+    {
+    FunctionType::AdaptorType::Pointer fixedAdaptor = FunctionType::AdaptorType::New();
+    fixedAdaptor->SetExtractComponentIndex(i);
+    fixedAdaptor->SetImage( const_cast<VectorImageType *>( fixedImage ) );
+    fixedAdaptor->Update();
+    data.FixedAdaptors.push_back(fixedAdaptor);
+
+    FunctionType::AdaptorType::Pointer movingAdaptor = FunctionType::AdaptorType::New();
+    movingAdaptor->SetExtractComponentIndex(i);
+    movingAdaptor->SetImage( const_cast<VectorImageType *>( movingImage ) );
+    movingAdaptor->Update();
+    data.MovingAdaptors.push_back(movingAdaptor);
+
+    FunctionType::GradientCalculatorPointer gradientCalculator = FunctionType::GradientCalculatorType::New();
+    gradientCalculator->UseImageDirectionOff();
+    gradientCalculator->SetInputImage(fixedAdaptor);
+    data.FixedImageGradientCalculators.push_back(gradientCalculator);
+
+    FunctionType::WarperPointer warper = FunctionType::WarperType::New();
+    warper->SetInterpolator( FunctionType::DefaultInterpolatorType::New() );
+    warper->SetEdgePaddingValue( itk::NumericTraits<MovingPixelType>::max() );
+    warper->SetOutputOrigin( fixedImage->GetOrigin() );
+    warper->SetOutputSpacing( fixedImage->GetSpacing() );
+    warper->SetOutputDirection( fixedImage->GetDirection() );
+    warper->SetInput(movingAdaptor);
+    warper->SetDisplacementField(field);
+    warper->GetOutput()->SetRequestedRegion( field->GetRequestedRegion() );
+    warper->Update();
+    data.Warpers.push_back(warper);
+    }
+}
+
+// ComputeUpdate as it was before the component loop was made allocation
+// free, for the symmetric gradient.
+static UpdateType
+ComputeUpdateWithGetPixel(const GetPixelData & data, const IndexType & index, double & sumOfSquaredChange)
+{
+  UpdateType update;
+  IndexType  FirstIndex = data.FixedImage->GetLargestPossibleRegion().GetIndex();
+  IndexType  LastIndex = data.FixedImage->GetLargestPossibleRegion().GetIndex()
+    + data.FixedImage->GetLargestPossibleRegion().GetSize();
+
+  std::vector<CovariantVectorType> usedOrientFreeGradientTimes2;
+  std::vector<double>              speedValue;
+
+  for( unsigned int i = 0; i < data.FixedImage->GetVectorLength(); ++i )
+    {
+    const WarpedImageType *warpedImage = data.Warpers[i]->GetOutput();
+    const double           fixedValue = static_cast<double>( data.FixedImage->GetPixel(index).GetElement(i) );
+    MovingPixelType        movingPixValue = warpedImage->GetPixel(index);
+
+    if( movingPixValue == itk::NumericTraits<MovingPixelType>::max() )
+      {
+      update.Fill(0.0);
+      return update;
+      }
+    const double movingValue = static_cast<double>( movingPixValue );
+
+    CovariantVectorType warpedMovingGradient;
+    IndexType           tmpIndex = index;
+    for( unsigned int dim = 0; dim < 3; dim++ )
+      {
+      if( FirstIndex[dim] == LastIndex[dim] || index[dim] < FirstIndex[dim] || index[dim] >= LastIndex[dim] )
+        {
+        warpedMovingGradient[dim] = 0.0;
+        continue;
+        }
+      else if( index[dim] == FirstIndex[dim] )
+        {
+        tmpIndex[dim] += 1;
+        movingPixValue = warpedImage->GetPixel(tmpIndex);
+        if( movingPixValue == itk::NumericTraits<MovingPixelType>::max() )
+          {
+          warpedMovingGradient[dim] = 0.0;
+          }
+        else
+          {
+          warpedMovingGradient[dim] = static_cast<double>( movingPixValue ) - movingValue;
+          warpedMovingGradient[dim] /= data.FixedImageSpacing[dim];
+          }
+        tmpIndex[dim] -= 1;
+        continue;
+        }
+      else if( index[dim] == ( LastIndex[dim] - 1 ) )
+        {
+        tmpIndex[dim] -= 1;
+        movingPixValue = warpedImage->GetPixel(tmpIndex);
+        if( movingPixValue == itk::NumericTraits<MovingPixelType>::max() )
+          {
+          warpedMovingGradient[dim] = 0.0;
+          }
+        else
+          {
+          warpedMovingGradient[dim] = movingValue - static_cast<double>( movingPixValue );
+          warpedMovingGradient[dim] /= data.FixedImageSpacing[dim];
+          }
+        tmpIndex[dim] += 1;
+        continue;
+        }
+
+      tmpIndex[dim] += 1;
+      movingPixValue = warpedImage->GetPixel(tmpIndex);
+      if( movingPixValue == itk::NumericTraits<MovingPixelType>::max() )
+        {
+        warpedMovingGradient[dim] = movingValue;
+
+        tmpIndex[dim] -= 2;
+        movingPixValue = warpedImage->GetPixel(tmpIndex);
+        if( movingPixValue == itk::NumericTraits<MovingPixelType>::max() )
+          {
+          warpedMovingGradient[dim] = 0.0;
+          }
+        else
+          {
+          warpedMovingGradient[dim] -= static_cast<double>( warpedImage->GetPixel(tmpIndex) );
+          warpedMovingGradient[dim] /= data.FixedImageSpacing[dim];
+          }
+        }
+      else
+        {
+        warpedMovingGradient[dim] = static_cast<double>( movingPixValue );
+
+        tmpIndex[dim] -= 2;
+        movingPixValue = warpedImage->GetPixel(tmpIndex);
+        if( movingPixValue == itk::NumericTraits<MovingPixelType>::max() )
+          {
+          warpedMovingGradient[dim] -= movingValue;
+          warpedMovingGradient[dim] /= data.FixedImageSpacing[dim];
+          }
+        else
+          {
+          warpedMovingGradient[dim] -= static_cast<double>( movingPixValue );
+          warpedMovingGradient[dim] *= 0.5 / data.FixedImageSpacing[dim];
+          }
+        }
+      tmpIndex[dim] += 1;
+      }
+
+    const CovariantVectorType fixedGradient = data.FixedImageGradientCalculators[i]->EvaluateAtIndex(index);
+    usedOrientFreeGradientTimes2.push_back(fixedGradient + warpedMovingGradient);
+    speedValue.push_back(fixedValue - movingValue);
+    }
+
+  std::vector<CovariantVectorType> usedGradientTimes2;
+  usedGradientTimes2.reserve(10);
+  for( unsigned int i = 0; i < data.FixedImage->GetVectorLength(); ++i )
+    {
+    CovariantVectorType tempGradientTimes2;
+    data.FixedImage->TransformLocalVectorToPhysicalVector(usedOrientFreeGradientTimes2[i], tempGradientTimes2);
+    usedGradientTimes2.push_back(tempGradientTimes2);
+    }
+
+  CovariantVectorType tempGradient = usedGradientTimes2[0];
+  double              sum_speedValue = speedValue[0];
+  for( unsigned int i = 1; i < usedGradientTimes2.size(); ++i )
+    {
+    tempGradient += usedGradientTimes2[i];
+    sum_speedValue += speedValue[i];
+    }
+  const double usedGradientTimes2SquaredMagnitude = tempGradient.GetSquaredNorm();
+
+  if( vnl_math_abs(speedValue[0]) < data.IntensityDifferenceThreshold )
+    {
+    update.Fill(0.0);
+    }
+  else
+    {
+    const double denom = usedGradientTimes2SquaredMagnitude + ( vnl_math_sqr(sum_speedValue) / data.Normalizer );
+    if( denom < data.DenominatorThreshold )
+      {
+      update.Fill(0.0);
+      }
+    else
+      {
+      const double factor = 2.0 * sum_speedValue / denom;
+      for( unsigned int j = 0; j < 3; j++ )
+        {
+        update[j] = factor * tempGradient[j];
+        }
+      }
+    }
+  sumOfSquaredChange += update.GetSquaredNorm();
+  return update;
+}
+
+int main(int argc, char * *argv)
+{
+  const unsigned int imageSize = ( argc > 1 ) ? atoi(argv[1]) : 64;
+  const unsigned int numberOfRepetitions = ( argc > 2 ) ? atoi(argv[2]) : 5;
+
+  DisplacementFieldType::Pointer field = MakeField(imageSize);
+  const DisplacementFieldType::RegionType region = field->GetLargestPossibleRegion();
+
+  bool ok = true;
+  for( unsigned int numberOfComponents = 1; numberOfComponents <= 3; ++numberOfComponents )
+    {
+    VectorImageType::Pointer fixedImage = MakeImage(imageSize, numberOfComponents, 0.0);
+    VectorImageType::Pointer movingImage = MakeImage(imageSize, numberOfComponents, 2.0);
+
+    FunctionType::Pointer function = FunctionType::New();
+    function->SetFixedImage(fixedImage);
+    function->SetMovingImage(movingImage);
+    function->SetDisplacementField(field);
+    function->InitializeIteration();
+
+    GetPixelData data;
+    InitializeGetPixelData(fixedImage, movingImage, field, function, data);
+
+    std::vector<UpdateType> updates(region.GetNumberOfPixels() );
+    std::vector<UpdateType> getPixelUpdates(region.GetNumberOfPixels() );
+
+    itk::TimeProbe computeUpdateTimer;
+    for( unsigned int r = 0; r < numberOfRepetitions; ++r )
+      {
+      void *globalData = function->GetGlobalDataPointer();
+      computeUpdateTimer.Start();
+      itk::ConstNeighborhoodIterator<DisplacementFieldType> nit(function->GetRadius(), field, region);
+      size_t                                                n = 0;
+      for( nit.GoToBegin(); !nit.IsAtEnd(); ++nit, ++n )
+        {
+        updates[n] = function->ComputeUpdate(nit, globalData);
+        }
+      computeUpdateTimer.Stop();
+      function->ReleaseGlobalDataPointer(globalData);
+      }
+
+    itk::TimeProbe getPixelTimer;
+    double         sumOfSquaredChange = 0.0;
+    for( unsigned int r = 0; r < numberOfRepetitions; ++r )
+      {
+      getPixelTimer.Start();
+      itk::ConstNeighborhoodIterator<DisplacementFieldType> nit(function->GetRadius(), field, region);
+      size_t                                                n = 0;
+      for( nit.GoToBegin(); !nit.IsAtEnd(); ++nit, ++n )
+        {
+        getPixelUpdates[n] = ComputeUpdateWithGetPixel(data, nit.GetIndex(), sumOfSquaredChange);
+        }
+      getPixelTimer.Stop();
+      }
+
+    size_t numberOfDifferences = 0;
+    for( size_t n = 0; n < updates.size(); ++n )
+      {
+      if( updates[n] != getPixelUpdates[n] )
+        {
+        ++numberOfDifferences;
+        }
+      }
+
+    std::cout << numberOfComponents << " component(s), " << imageSize << "^3 voxels, "
+              << numberOfRepetitions << " passes" << std::endl;
+    std::cout << "  ComputeUpdate:           " << computeUpdateTimer.GetMean() << " s/pass" << std::endl;
+    std::cout << "  GetPixel ComputeUpdate:  " << getPixelTimer.GetMean() << " s/pass" << std::endl;
+    std::cout << "  speedup:                 " << getPixelTimer.GetMean() / computeUpdateTimer.GetMean()
+              << "  different updates: " << numberOfDifferences << std::endl;
+
+    if( numberOfDifferences != 0 )
+      {
+      std::cerr << "ComputeUpdate with " << numberOfComponents
+                << " component(s) differs from the GetPixel implementation" << std::endl;
+      ok = false;
+      }
+    }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
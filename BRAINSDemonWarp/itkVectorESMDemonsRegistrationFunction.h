@@ -362,6 +362,15 @@ private:
   /** Mutex lock to protect modification to metric. */
   mutable SimpleFastMutexLock m_MetricCalculationLock;
 
+  /** Raw buffers of the fixed image and of the warped moving components,
+    * cached by InitializeIteration() so that ComputeUpdate() does not go
+    * through GetPixel() for every component. */
+  typedef typename VectorFixedImageType::InternalPixelType FixedInternalPixelType;
+  typedef typename MovingImageType::OffsetValueType        OffsetValueType;
+  const FixedInternalPixelType *       m_FixedImageBuffer;
+  std::vector<const MovingPixelType *> m_WarpedMovingImageBufferVector;
+  unsigned int                         m_NumberOfComponents;
+
   std::vector<WarperPointer>                        m_MovingImageWarperVector;
   std::vector<InterpolatorPointer>                  m_MovingImageInterpolatorVector;
   std::vector<GradientCalculatorPointer>            m_FixedImageGradientCalculatorVector;
@@ -108,6 +108,9 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
   m_NumberOfPixelsProcessed = 0L;
   m_RMSChange = NumericTraits<double>::max();
   m_SumOfSquaredChange = 0.0;
+
+  m_FixedImageBuffer = ITK_NULLPTR;
+  m_NumberOfComponents = 0;
 }
 
 /*
@@ -260,6 +263,16 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
     m_MovingImageInterpolatorVector[i]->SetInputImage(
       vectorMovingImageToImageAdaptor);
     }
+
+  // cache the raw buffers read by ComputeUpdate
+  m_NumberOfComponents = this->GetFixedImage()->GetVectorLength();
+  m_FixedImageBuffer = this->GetFixedImage()->GetBufferPointer();
+  m_WarpedMovingImageBufferVector.resize(m_NumberOfComponents);
+  for( unsigned int i = 0; i < m_NumberOfComponents; ++i )
+    {
+    m_WarpedMovingImageBufferVector[i] =
+      m_MovingImageWarperVector[i]->GetOutput()->GetBufferPointer();
+    }
   // initialize metric computation variables
   m_SumOfSquaredDifference  = 0.0;
   m_NumberOfPixelsProcessed = 0L;
@@ -292,26 +305,33 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
   // Get fixed image related information
   // Note: no need to check if the index is within
   // fixed image buffer. This is done by the external filter.
-  std::vector<CovariantVectorType> usedOrientFreeGradientTimes2;
-  std::vector<double>              speedValue;
-
-  for( unsigned int i = 0; i < this->GetFixedImage()->GetVectorLength(); ++i )
+  //
+  // The components are read straight from the image buffers. All the warped
+  // moving components share the buffered region of the displacement field,
+  // so one offset and one offset table serve all of them.
+  const MovingImageType *firstWarpedImage = m_MovingImageWarperVector[0]->GetOutput();
+  const OffsetValueType  warpedOffset = firstWarpedImage->ComputeOffset(index);
+  const OffsetValueType *warpedOffsetTable = firstWarpedImage->GetOffsetTable();
+  const FixedInternalPixelType *fixedPixel = m_FixedImageBuffer
+    + this->GetFixedImage()->ComputeOffset(index) * m_NumberOfComponents;
+
+  // The per component gradients and speeds are only ever summed, so they
+  // are accumulated here in component order instead of being collected
+  // into per voxel containers first.
+  CovariantVectorType tempGradient;
+  tempGradient.Fill(0.0);
+  double firstSpeedValue = 0.0;
+  double sum_speedValue = 0.0;
+  double sqr_speedValue = 0.0;
+  for( unsigned int i = 0; i < m_NumberOfComponents; ++i )
     {
-    const double fixedValue = static_cast<double>(
-        this->GetFixedImage()->GetPixel(index).GetElement(i) );
-    /*
-      * if(index[0]==32 && index[1]==32 && index[2]==32)
-      *  {
-      *  std::cout <<  "FV  at index "<< i  << "is " << fixedValue << std::endl;
-      *  std::cout <<  "FV  at index is " << this->GetFixedImage()->GetPixel(
-      * index) << std::endl;
-      *  }
-      */
+    const double fixedValue = static_cast<double>( fixedPixel[i] );
+    const MovingPixelType *warpedPixel = m_WarpedMovingImageBufferVector[i] + warpedOffset;
+
     // Get moving image related information
     // check if the point was mapped outside of the moving image using
     // the "special value" NumericTraits<MovingPixelType>::max()
-    MovingPixelType movingPixValue =
-      m_MovingImageWarperVector[i]->GetOutput()->GetPixel(index);
+    MovingPixelType movingPixValue = *warpedPixel;
 
     if( movingPixValue == NumericTraits<MovingPixelType>::max() )
       {
@@ -323,6 +343,7 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
     // We compute the gradient more or less by hand.
     // We first start by ignoring the image orientation and introduce it
     // afterwards
+    CovariantVectorType usedOrientFreeGradientTimes2;
 
     if( ( this->m_UseGradientType == Symmetric )
         ||   ( this->m_UseGradientType == WarpedMoving ) )
@@ -330,9 +351,9 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
       // we don't use a CentralDifferenceImageFunction here to be able to
       // check for NumericTraits<MovingPixelType>::max()
       CovariantVectorType warpedMovingGradient;
-      IndexType           tmpIndex = index;
       for( unsigned int dim = 0; dim < ImageDimension; dim++ )
         {
+        const OffsetValueType stride = warpedOffsetTable[dim];
         // bounds checking
         if( FirstIndex[dim] == LastIndex[dim] || index[dim] <
             FirstIndex[dim] || index[dim] >= LastIndex[dim] )
@@ -343,9 +364,7 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
         else if( index[dim] == FirstIndex[dim] )
           {
           // compute derivative
-          tmpIndex[dim] += 1;
-          movingPixValue = m_MovingImageWarperVector[i]->GetOutput()->GetPixel(
-              tmpIndex);
+          movingPixValue = warpedPixel[stride];
           if( movingPixValue == NumericTraits<MovingPixelType>::max() )
             {
             // weird crunched border case
@@ -358,15 +377,12 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
               - movingValue;
             warpedMovingGradient[dim] /= m_FixedImageSpacing[dim];
             }
-          tmpIndex[dim] -= 1;
           continue;
           }
         else if( index[dim] == ( LastIndex[dim] - 1 ) )
           {
           // compute derivative
-          tmpIndex[dim] -= 1;
-          movingPixValue = m_MovingImageWarperVector[i]->GetOutput()->GetPixel(
-              tmpIndex);
+          movingPixValue = warpedPixel[-stride];
           if( movingPixValue == NumericTraits<MovingPixelType>::max() )
             {
             // weird crunched border case
@@ -379,22 +395,17 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
                 movingPixValue );
             warpedMovingGradient[dim] /= m_FixedImageSpacing[dim];
             }
-          tmpIndex[dim] += 1;
           continue;
           }
 
         // compute derivative
-        tmpIndex[dim] += 1;
-        movingPixValue = m_MovingImageWarperVector[i]->GetOutput()->GetPixel(
-            tmpIndex);
+        movingPixValue = warpedPixel[stride];
         if( movingPixValue == NumericTraits<MovingPixelType>::max() )
           {
           // backward difference
           warpedMovingGradient[dim] = movingValue;
 
-          tmpIndex[dim] -= 2;
-          movingPixValue = m_MovingImageWarperVector[i]->GetOutput()->GetPixel(
-              tmpIndex);
+          movingPixValue = warpedPixel[-stride];
           if( movingPixValue == NumericTraits<MovingPixelType>::max() )
             {
             // weird crunched border case
@@ -403,8 +414,7 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
           else
             {
             // backward difference
-            warpedMovingGradient[dim] -= static_cast<double>(
-                m_MovingImageWarperVector[i]->GetOutput()->GetPixel(tmpIndex) );
+            warpedMovingGradient[dim] -= static_cast<double>( movingPixValue );
 
             warpedMovingGradient[dim] /= m_FixedImageSpacing[dim];
             }
@@ -413,9 +423,7 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
           {
           warpedMovingGradient[dim] = static_cast<double>( movingPixValue );
 
-          tmpIndex[dim] -= 2;
-          movingPixValue = m_MovingImageWarperVector[i]->GetOutput()->GetPixel(
-              tmpIndex);
+          movingPixValue = warpedPixel[-stride];
           if( movingPixValue == NumericTraits<MovingPixelType>::max() )
             {
             // forward difference
@@ -429,7 +437,6 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
             warpedMovingGradient[dim] *= 0.5 / m_FixedImageSpacing[dim];
             }
           }
-        tmpIndex[dim] += 1;
         }
 
       if( this->m_UseGradientType == Symmetric )
@@ -438,13 +445,11 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
         const CovariantVectorType fixedGradient =
           m_FixedImageGradientCalculatorVector[i]->EvaluateAtIndex(index);
 
-        usedOrientFreeGradientTimes2.push_back(
-          fixedGradient + warpedMovingGradient);
+        usedOrientFreeGradientTimes2 = fixedGradient + warpedMovingGradient;
         }
       else if( this->m_UseGradientType == WarpedMoving )
         {
-        usedOrientFreeGradientTimes2.push_back(
-          warpedMovingGradient + warpedMovingGradient);
+        usedOrientFreeGradientTimes2 = warpedMovingGradient + warpedMovingGradient;
         }
       else
         {
@@ -457,7 +462,7 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
       const CovariantVectorType fixedGradient =
         m_FixedImageGradientCalculatorVector[i]->EvaluateAtIndex(index);
 
-      usedOrientFreeGradientTimes2.push_back(fixedGradient + fixedGradient);
+      usedOrientFreeGradientTimes2 = fixedGradient + fixedGradient;
       }
     else if( this->m_UseGradientType == MappedMoving )
       {
@@ -471,24 +476,31 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
       const CovariantVectorType mappedMovingGradient =
         m_MappedMovingImageGradientCalculatorVector[i]->Evaluate(mappedPoint);
 
-      usedOrientFreeGradientTimes2.push_back(
-        mappedMovingGradient + mappedMovingGradient);
+      usedOrientFreeGradientTimes2 = mappedMovingGradient + mappedMovingGradient;
       }
     else
       {
       itkExceptionMacro(<< "Unknown gradient type");
       }
-    speedValue.push_back(fixedValue - movingValue);
-    }
 
-  std::vector<CovariantVectorType> usedGradientTimes2;
-  usedGradientTimes2.reserve(10);
-  for( unsigned int i = 0; i < this->GetFixedImage()->GetVectorLength(); ++i )
-    {
-    CovariantVectorType tempGradientTimes2;
+    CovariantVectorType usedGradientTimes2;
     this->GetFixedImage()->TransformLocalVectorToPhysicalVector(
-      usedOrientFreeGradientTimes2[i], tempGradientTimes2);
-    usedGradientTimes2.push_back(tempGradientTimes2);
+      usedOrientFreeGradientTimes2, usedGradientTimes2);
+
+    const double speedValue = fixedValue - movingValue;
+    if( i == 0 )
+      {
+      tempGradient = usedGradientTimes2;
+      firstSpeedValue = speedValue;
+      sum_speedValue = speedValue;
+      sqr_speedValue = vnl_math_sqr(speedValue);
+      }
+    else
+      {
+      tempGradient += usedGradientTimes2;
+      sum_speedValue += speedValue;
+      sqr_speedValue += vnl_math_sqr(speedValue);
+      }
     }
 
   /**
@@ -496,23 +508,13 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
     * We avoid the mismatch in units between the two terms.
     * and avoid large step using a normalization term.
     */
-
-  CovariantVectorType tempGradient = usedGradientTimes2[0];
-  double              sum_speedValue = speedValue[0];
-  double              sqr_speedValue = vnl_math_sqr(speedValue[0]);
-  for( unsigned int i = 1; i < usedGradientTimes2.size(); ++i )
-    {
-    tempGradient += usedGradientTimes2[i];
-    sum_speedValue += speedValue[i];
-    sqr_speedValue += vnl_math_sqr(speedValue[i]);
-    }
   const double usedGradientTimes2SquaredMagnitude = tempGradient.GetSquaredNorm();
 
   //  const double usedGradientTimes2SquaredMagnitude =
   // usedGradientTimes2.GetSquaredNorm();
 
   //  const double speedValue = fixedValue - movingValue;
-  if( vnl_math_abs(speedValue[0]) < m_IntensityDifferenceThreshold )
+  if( vnl_math_abs(firstSpeedValue) < m_IntensityDifferenceThreshold )
     {
     update.Fill(0.0);
     }
@@ -555,8 +557,7 @@ VectorESMDemonsRegistrationFunction<TFixedImage, TMovingImage,
   if( globalData )
     {
     globalData->m_SumOfSquaredDifference += vnl_math_sqr(sqr_speedValue);
-    globalData->m_NumberOfPixelsProcessed +=
-      this->GetFixedImage()->GetVectorLength();
+    globalData->m_NumberOfPixelsProcessed += m_NumberOfComponents;
     globalData->m_SumOfSquaredChange += update.GetSquaredNorm();
     }
 
@@ -33,14 +33,16 @@ PURPOSE.  See the above copyright notices for more information.
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <map>
 
 #include "itkImage.h"
-#include "itkLabelStatisticsImageFilter.h"
-#include "itkMinimumMaximumImageFilter.h"
 #include "itkImageFileReader.h"
 #include "itkDOMNodeXMLReader.h"
 #include "itkDOMNode.h"
 
+#include "LabelStatisticsEngine.h"
+#include "BRAINSThreadControl.h"
+
 #include "BRAINSLabelStatsCLP.h"
 
 std::string GetXmlLabelName( std::string fileName, int label )
@@ -147,7 +149,9 @@ int main(int argc, char *argv[])
 {
   PARSE_ARGS;
 
-  if( ( imageVolume.length() == 0 ) &&
+  const BRAINSUtils::StackPushITKDefaultNumberOfThreads TempDefaultNumberOfThreadsHolder(numberOfThreads);
+
+  if( imageVolume.empty() ||
       ( labelVolume.length() == 0 ) )
     {
     std::cout << "Error: Both the image and label must be specified" << std::endl;
@@ -177,7 +181,10 @@ int main(int argc, char *argv[])
   if( echoSwitch )
     {
     std::cout << "=====================================================" << std::endl;
-    std::cout << "Image: " <<   imageVolume << std::endl;
+    for( size_t i = 0; i < imageVolume.size(); ++i )
+      {
+      std::cout << "Image: " <<   imageVolume[i] << std::endl;
+      }
     std::cout << "Label Map: " <<   labelVolume << std::endl;
     std::cout << "Label Name File: " <<   labelNameFile << std::endl;
     std::cout << "Column Prefix Names: ";
@@ -200,80 +207,22 @@ int main(int argc, char *argv[])
     std::cout << "=====================================================" << std::endl;
     }
 
-  typedef itk::Image<float, 3>            ImageType;
-  typedef itk::ImageFileReader<ImageType> ImageReaderType;
-  ImageReaderType::Pointer imageReader = ImageReaderType::New();
-  imageReader->SetFileName( imageVolume );
-  imageReader->UpdateLargestPossibleRegion();
-
-  ImageType::RegionType  imageRegion;
-  ImageType::SizeType    imageSize;
-  ImageType::SpacingType imageSpacing;
-  ImageType::PointType   imageOrigin;
-  imageRegion = imageReader->GetOutput()->GetLargestPossibleRegion();
-  imageSize = imageRegion.GetSize();
-  imageSpacing = imageReader->GetOutput()->GetSpacing();
-  imageOrigin = imageReader->GetOutput()->GetOrigin();
-
-  typedef itk::Image<short, 3>            LabelType;
-  typedef itk::ImageFileReader<LabelType> LabelReaderType;
-  LabelReaderType::Pointer labelReader = LabelReaderType::New();
-  labelReader->SetFileName( labelVolume );
-  labelReader->UpdateLargestPossibleRegion();
-
-  LabelType::RegionType  labelRegion;
-  LabelType::SizeType    labelSize;
-  LabelType::SpacingType labelSpacing;
-  LabelType::PointType   labelOrigin;
-  labelRegion = labelReader->GetOutput()->GetLargestPossibleRegion();
-  labelSize = labelRegion.GetSize();
-  labelSpacing = labelReader->GetOutput()->GetSpacing();
-  labelOrigin = labelReader->GetOutput()->GetOrigin();
-  // Check the Image and Label Map to Make sure they define the same space
-  for( size_t i = 0; i < 3; ++i )
+  if( numberOfHistogramBins <= 0 )
     {
-    if( imageSize[i] != labelSize[i] )
-      {
-      std::cout << "Error: Image and label size do not match" << std::endl;
-      std::cout << "Image: " << imageSize << std::endl;
-      std::cout << "Label: " << labelSize << std::endl;
-      return EXIT_FAILURE;
-      }
-    if( fabs(labelSpacing[i] - imageSpacing[i]) > 0.01 )
-      {
-      std::cout << "Error: Image and label spacing do not match" << std::endl;
-      std::cout << "Image: " << imageSpacing << std::endl;
-      std::cout << "Label: " << labelSpacing << std::endl;
-      return EXIT_FAILURE;
-      }
-    if( fabs(labelOrigin[i] - imageOrigin[i]) > 0.01 )
-      {
-      std::cout << "Error: Image and label origin do not match" << std::endl;
-      std::cout << "Image: " << imageOrigin << std::endl;
-      std::cout << "Label: " << labelOrigin << std::endl;
-      return EXIT_FAILURE;
-      }
+    std::cerr << "Error: Number of histogram bins must be positive" << std::endl;
+    return EXIT_FAILURE;
     }
 
-  float minValue;
-  float maxValue;
-  bool  computeGlobalHistogram = false;
+  LabelStatisticsEngine statsEngine;
+  statsEngine.SetNumberOfHistogramBins( numberOfHistogramBins );
 
   if( minMaxType == "manual" )
     {
-    minValue = userDefineMinimum;
-    maxValue = userDefineMaximum;
-    computeGlobalHistogram = true;
+    statsEngine.SetHistogramRange( userDefineMinimum, userDefineMaximum );
     }
   else if( minMaxType == "image" )
     {
-    typedef itk::MinimumMaximumImageFilter<ImageType> MinMaxFilterType;
-    MinMaxFilterType::Pointer minMaxFilter = MinMaxFilterType::New();
-    minMaxFilter->SetInput( imageReader->GetOutput() );
-    minMaxFilter->UpdateLargestPossibleRegion();
-    minValue = minMaxFilter->GetMinimum();
-    maxValue = minMaxFilter->GetMaximum();
-    computeGlobalHistogram = true;
+    // The range of each image comes out of the first pass of the statistics.
     }
   else if( minMaxType == "label" )
     {
@@ -286,65 +235,114 @@ int main(int argc, char *argv[])
     return EXIT_FAILURE;
     }
 
-  typedef itk::LabelStatisticsImageFilter<ImageType, LabelType> StatsFilterType;
-  StatsFilterType::Pointer statsFilter = StatsFilterType::New();
-  statsFilter->SetInput( imageReader->GetOutput() );
-  statsFilter->SetLabelInput( labelReader->GetOutput() );
-  if( computeGlobalHistogram )
+  typedef LabelStatisticsEngine::LabelImageType LabelType;
+  typedef itk::ImageFileReader<LabelType>       LabelReaderType;
+  LabelReaderType::Pointer labelReader = LabelReaderType::New();
+  labelReader->SetFileName( labelVolume );
+  labelReader->UpdateLargestPossibleRegion();
+
+  LabelType::RegionType  labelRegion;
+  LabelType::SizeType    labelSize;
+  LabelType::SpacingType labelSpacing;
+  LabelType::PointType   labelOrigin;
+  labelRegion = labelReader->GetOutput()->GetLargestPossibleRegion();
+  labelSize = labelRegion.GetSize();
+  labelSpacing = labelReader->GetOutput()->GetSpacing();
+  labelOrigin = labelReader->GetOutput()->GetOrigin();
+
+  // The label map is read and indexed once for all of the images
+  statsEngine.SetLabelImage( labelReader->GetOutput() );
+
+  typedef LabelStatisticsEngine::LabelPixelType LabelPixelType;
+  std::map<LabelPixelType, std::string>         labelNames;
+  for( size_t l = 0; l < statsEngine.GetLabels().size(); ++l )
     {
-    statsFilter->UseHistogramsOn();
-    statsFilter->SetHistogramParameters(numberOfHistogramBins, minValue, maxValue);
+    const LabelPixelType labelValue = statsEngine.GetLabels()[l];
+    labelNames[labelValue] = GetLabelName(mode, labelNameFile, labelValue);
     }
-  statsFilter->UpdateLargestPossibleRegion();
 
-  typedef StatsFilterType::ValidLabelValuesContainerType ValidLabelValuesType;
-  typedef StatsFilterType::LabelPixelType                LabelPixelType;
+  // With several images, a column tells which one each row belongs to
+  const bool printImageColumn = imageVolume.size() > 1;
   for( size_t i = 0; i < outputPrefixColumnNames.size(); ++i )
     {
     std::cout << outputPrefixColumnNames[i] << ", ";
     }
+  if( printImageColumn )
+    {
+    std::cout << "Image, ";
+    }
   std::cout << "Name, label, min, max, median, mean, stddev, var, sum, count" << std::endl;
-  for( ValidLabelValuesType::const_iterator vIt = statsFilter->GetValidLabelValues().begin();
-       vIt != statsFilter->GetValidLabelValues().end();
-       ++vIt )
+
+  typedef LabelStatisticsEngine::ImageType ImageType;
+  typedef itk::ImageFileReader<ImageType>  ImageReaderType;
+  for( size_t imageIndex = 0; imageIndex < imageVolume.size(); ++imageIndex )
     {
-    if( statsFilter->HasLabel(*vIt) )
+    ImageReaderType::Pointer imageReader = ImageReaderType::New();
+    imageReader->SetFileName( imageVolume[imageIndex] );
+    imageReader->UpdateLargestPossibleRegion();
+
+    ImageType::RegionType  imageRegion;
+    ImageType::SizeType    imageSize;
+    ImageType::SpacingType imageSpacing;
+    ImageType::PointType   imageOrigin;
+    imageRegion = imageReader->GetOutput()->GetLargestPossibleRegion();
+    imageSize = imageRegion.GetSize();
+    imageSpacing = imageReader->GetOutput()->GetSpacing();
+    imageOrigin = imageReader->GetOutput()->GetOrigin();
+    // Check the Image and Label Map to Make sure they define the same space
+    for( size_t i = 0; i < 3; ++i )
       {
-      LabelPixelType labelValue = *vIt;
-
-      std::string labelName = GetLabelName(mode, labelNameFile, labelValue);
-      for( size_t i = 0; i < outputPrefixColumnValues.size(); ++i )
+      if( imageSize[i] != labelSize[i] )
         {
-        std::cout << outputPrefixColumnValues[i] << ", ";
+        std::cout << "Error: Image and label size do not match" << std::endl;
+        std::cout << "Image: " << imageSize << std::endl;
+        std::cout << "Label: " << labelSize << std::endl;
+        return EXIT_FAILURE;
         }
-      std::cout << labelName << ", ";
-      std::cout << labelValue << ", ";
-      std::cout << statsFilter->GetMinimum( labelValue ) << ", ";
-      std::cout << statsFilter->GetMaximum( labelValue ) << ", ";
-      float medianValue;
+      if( fabs(labelSpacing[i] - imageSpacing[i]) > 0.01 )
+        {
+        std::cout << "Error: Image and label spacing do not match" << std::endl;
+        std::cout << "Image: " << imageSpacing << std::endl;
+        std::cout << "Label: " << labelSpacing << std::endl;
+        return EXIT_FAILURE;
+        }
+      if( fabs(labelOrigin[i] - imageOrigin[i]) > 0.01 )
+        {
+        std::cout << "Error: Image and label origin do not match" << std::endl;
+        std::cout << "Image: " << imageOrigin << std::endl;
+        std::cout << "Label: " << labelOrigin << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
 
-      if( !computeGlobalHistogram )
+    LabelStatisticsEngine::LabelStatisticsList statistics;
+    statsEngine.ComputeStatistics( imageReader->GetOutput(), statistics );
+
+    for( LabelStatisticsEngine::LabelStatisticsList::const_iterator sIt = statistics.begin();
+         sIt != statistics.end();
+         ++sIt )
+      {
+      const LabelPixelType labelValue = sIt->Label;
+
+      for( size_t i = 0; i < outputPrefixColumnValues.size(); ++i )
         {
-        minValue = statsFilter->GetMinimum( labelValue );
-        maxValue = statsFilter->GetMaximum( labelValue );
-        StatsFilterType::Pointer labelStatsFilter = StatsFilterType::New();
-        labelStatsFilter->SetInput( imageReader->GetOutput() );
-        labelStatsFilter->SetLabelInput( labelReader->GetOutput() );
-        labelStatsFilter->UseHistogramsOn();
-        labelStatsFilter->SetHistogramParameters(numberOfHistogramBins, minValue, maxValue);
-        labelStatsFilter->UpdateLargestPossibleRegion();
-        medianValue = labelStatsFilter->GetMedian( labelValue );
+        std::cout << outputPrefixColumnValues[i] << ", ";
         }
-      else
+      if( printImageColumn )
         {
-        medianValue = statsFilter->GetMedian( labelValue );
+        std::cout << imageVolume[imageIndex] << ", ";
         }
+      std::cout << labelNames[labelValue] << ", ";
+      std::cout << labelValue << ", ";
+      std::cout << sIt->Minimum << ", ";
+      std::cout << sIt->Maximum << ", ";
+      const float medianValue = sIt->Median;
       std::cout << medianValue << ", ";
-      std::cout << statsFilter->GetMean( labelValue ) << ", ";
-      std::cout << statsFilter->GetSigma( labelValue ) << ", ";
-      std::cout << statsFilter->GetVariance( labelValue ) << ", ";
-      std::cout << statsFilter->GetSum( labelValue ) << ", ";
-      std::cout << statsFilter->GetCount( labelValue ) << std::endl;
+      std::cout << sIt->Mean << ", ";
+      std::cout << sIt->Sigma << ", ";
+      std::cout << sIt->Variance << ", ";
+      std::cout << sIt->Sum << ", ";
+      std::cout << sIt->Count << std::endl;
       }
     }
   return EXIT_SUCCESS;
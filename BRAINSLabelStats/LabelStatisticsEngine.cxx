@@ -0,0 +1,418 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "LabelStatisticsEngine.h"
+
+#include "itkNumericTraits.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+typedef LabelStatisticsEngine::LabelPixelType LabelPixelType;
+
+inline unsigned int LabelOffset(const LabelPixelType label)
+{
+  return static_cast<unsigned int>( static_cast<long>( label )
+                                    - static_cast<long>( itk::NumericTraits<LabelPixelType>::NonpositiveMin() ) );
+}
+}
+
+LabelStatisticsEngine::LabelStatisticsEngine() :
+  m_Threader( itk::MultiThreader::New() ),
+  m_NumberOfHistogramBins(100000),
+  m_UserDefinedHistogramRange(false),
+  m_LowerBound(0.0),
+  m_UpperBound(0.0),
+  m_BinInterval(0.0),
+  m_BinsPerGroup(1),
+  m_NumberOfGroups(1)
+{
+}
+
+void
+LabelStatisticsEngine::SetNumberOfThreads(unsigned int numberOfThreads)
+{
+  m_Threader->SetNumberOfThreads( numberOfThreads );
+}
+
+void
+LabelStatisticsEngine::SetNumberOfHistogramBins(unsigned int numberOfBins)
+{
+  if( numberOfBins == 0 )
+    {
+    itkGenericExceptionMacro(<< "The number of histogram bins must be positive.");
+    }
+  m_NumberOfHistogramBins = numberOfBins;
+}
+
+void
+LabelStatisticsEngine::SetHistogramRange(RealType lowerBound, RealType upperBound)
+{
+  m_LowerBound = lowerBound;
+  m_UpperBound = upperBound;
+  m_UserDefinedHistogramRange = true;
+}
+
+void
+LabelStatisticsEngine::SetLabelImage(const LabelImageType *labelImage)
+{
+  m_LabelImage = labelImage;
+
+  const LabelPixelType *     labels = labelImage->GetBufferPointer();
+  const itk::SizeValueType   numberOfPixels = labelImage->GetBufferedRegion().GetNumberOfPixels();
+  const unsigned int         numberOfLabelValues =
+    LabelOffset( itk::NumericTraits<LabelPixelType>::max() ) + 1;
+  std::vector<unsigned char> present(numberOfLabelValues, 0);
+  for( itk::SizeValueType i = 0; i < numberOfPixels; ++i )
+    {
+    present[LabelOffset( labels[i] )] = 1;
+    }
+
+  m_Labels.clear();
+  m_LabelIndexes.assign(numberOfLabelValues, 0);
+  for( unsigned int offset = 0; offset < numberOfLabelValues; ++offset )
+    {
+    if( present[offset] )
+      {
+      m_LabelIndexes[offset] = m_Labels.size();
+      m_Labels.push_back( static_cast<LabelPixelType>( static_cast<long>( offset )
+                                                       + itk::NumericTraits<LabelPixelType>::NonpositiveMin() ) );
+      }
+    }
+}
+
+void
+LabelStatisticsEngine::InitializeBins(RealType lowerBound, RealType upperBound)
+{
+  const unsigned int numberOfBins = m_NumberOfHistogramBins;
+
+  // Same float arithmetic as itk::Statistics::Histogram::Initialize, so that
+  // values fall in the same bins.
+  const float interval = static_cast<float>( upperBound - lowerBound ) / static_cast<RealType>( numberOfBins );
+
+  m_LowerBound = lowerBound;
+  m_UpperBound = upperBound;
+  m_BinInterval = interval;
+  m_BinMinimums.resize(numberOfBins);
+  for( unsigned int j = 0; j < numberOfBins; ++j )
+    {
+    m_BinMinimums[j] = static_cast<RealType>( lowerBound + ( static_cast<float>( j ) * interval ) );
+    }
+
+  m_BinsPerGroup = static_cast<unsigned int>( std::ceil( std::sqrt( static_cast<double>( numberOfBins ) ) ) );
+  m_NumberOfGroups = ( numberOfBins + m_BinsPerGroup - 1 ) / m_BinsPerGroup;
+}
+
+bool
+LabelStatisticsEngine::GetBin(RealType value, unsigned int & bin) const
+{
+  const unsigned int lastBin = m_NumberOfHistogramBins - 1;
+
+  if( !( value >= m_BinMinimums[0] ) )
+    {
+    return false;
+    }
+  if( value >= m_UpperBound )
+    {
+    // The last bin includes the upper bound
+    if( value > m_UpperBound )
+      {
+      return false;
+      }
+    bin = lastBin;
+    return true;
+    }
+
+  const RealType position = ( value - m_LowerBound ) / m_BinInterval;
+  unsigned int   j = ( position < lastBin ) ? static_cast<unsigned int>( position ) : lastBin;
+  while( j > 0 && value < m_BinMinimums[j] )
+    {
+    --j;
+    }
+  while( j < lastBin && value >= m_BinMinimums[j + 1] )
+    {
+    ++j;
+    }
+  bin = j;
+  return true;
+}
+
+LabelStatisticsEngine::RealType
+LabelStatisticsEngine::GetBinMaximum(unsigned int bin) const
+{
+  if( bin + 1 == m_NumberOfHistogramBins )
+    {
+    return m_UpperBound;
+    }
+  return static_cast<RealType>( m_LowerBound + ( ( static_cast<float>( bin ) + 1 ) * static_cast<float>( m_BinInterval ) ) );
+}
+
+void
+LabelStatisticsEngine::ComputeStatistics(const ImageType *image, LabelStatisticsList & statistics)
+{
+  if( m_LabelImage.IsNull() )
+    {
+    itkGenericExceptionMacro(<< "The label image must be set before computing statistics.");
+    }
+  if( image->GetBufferedRegion().GetSize() != m_LabelImage->GetBufferedRegion().GetSize() )
+    {
+    itkGenericExceptionMacro(<< "The image and the label map do not have the same size.");
+    }
+
+  m_Image = image;
+
+  const size_t numberOfLabels = m_Labels.size();
+
+  //
+  // Moments, and the intensity range
+  //
+  this->ExecutePass(MomentsPass);
+
+  statistics.resize(numberOfLabels);
+
+  RealType imageMinimum = itk::NumericTraits<RealType>::max();
+  RealType imageMaximum = itk::NumericTraits<RealType>::NonpositiveMin();
+  for( size_t l = 0; l < numberOfLabels; ++l )
+    {
+    LabelStatistics & ls = statistics[l];
+    ls.Label = m_Labels[l];
+    ls.Count = 0;
+    ls.Minimum = itk::NumericTraits<RealType>::max();
+    ls.Maximum = itk::NumericTraits<RealType>::NonpositiveMin();
+    ls.Sum = 0.0;
+    ls.SumOfSquares = 0.0;
+    for( size_t t = 0; t < m_ThreadMoments.size(); ++t )
+      {
+      const Moments & moments = m_ThreadMoments[t][l];
+      ls.Count += moments.Count;
+      ls.Minimum = std::min( ls.Minimum, moments.Minimum );
+      ls.Maximum = std::max( ls.Maximum, moments.Maximum );
+      ls.Sum += moments.Sum;
+      ls.SumOfSquares += moments.SumOfSquares;
+      }
+
+    const RealType count = static_cast<RealType>( ls.Count );
+    ls.Mean = ls.Sum / count;
+    if( ls.Count > 1 )
+      {
+      // unbiased estimate of variance
+      ls.Variance = ( ls.SumOfSquares - ls.Sum * ls.Sum / count ) / ( count - 1.0 );
+      }
+    else
+      {
+      ls.Variance = 0.0;
+      }
+    ls.Sigma = std::sqrt( ls.Variance );
+
+    imageMinimum = std::min( imageMinimum, ls.Minimum );
+    imageMaximum = std::max( imageMaximum, ls.Maximum );
+    }
+  m_ThreadMoments.clear();
+
+  if( m_UserDefinedHistogramRange )
+    {
+    this->InitializeBins( m_LowerBound, m_UpperBound );
+    }
+  else
+    {
+    this->InitializeBins( imageMinimum, imageMaximum );
+    }
+
+  //
+  // Median. As in LabelStatisticsImageFilter::GetMedian, it is the center of
+  // the first bin at which the cumulated count goes past Count / 2, or of the
+  // last bin when values outside of the range never let it get there.
+  //
+  std::vector<CountType> medianRanks(numberOfLabels);
+  m_MedianGroups.assign(numberOfLabels, -1);
+
+  this->ExecutePass(CoarseHistogramPass);
+
+  for( size_t l = 0; l < numberOfLabels; ++l )
+    {
+    const CountType half = statistics[l].Count / 2;
+    CountType       total = 0;
+    for( unsigned int g = 0; g < m_NumberOfGroups; ++g )
+      {
+      CountType groupCount = 0;
+      for( size_t t = 0; t < m_ThreadCounts.size(); ++t )
+        {
+        groupCount += m_ThreadCounts[t][l * m_NumberOfGroups + g];
+        }
+      if( total + groupCount > half )
+        {
+        m_MedianGroups[l] = g;
+        medianRanks[l] = half - total;
+        break;
+        }
+      total += groupCount;
+      }
+    }
+
+  this->ExecutePass(FineHistogramPass);
+
+  for( size_t l = 0; l < numberOfLabels; ++l )
+    {
+    unsigned int medianBin = m_NumberOfHistogramBins - 1;
+    if( m_MedianGroups[l] >= 0 )
+      {
+      const unsigned int firstBin = m_MedianGroups[l] * m_BinsPerGroup;
+      const unsigned int numberOfGroupBins = std::min( m_BinsPerGroup, m_NumberOfHistogramBins - firstBin );
+      CountType          total = 0;
+      for( unsigned int b = 0; b < numberOfGroupBins; ++b )
+        {
+        for( size_t t = 0; t < m_ThreadCounts.size(); ++t )
+          {
+          total += m_ThreadCounts[t][l * m_BinsPerGroup + b];
+          }
+        if( total > medianRanks[l] )
+          {
+          medianBin = firstBin + b;
+          break;
+          }
+        }
+      }
+    const RealType lowRange = m_BinMinimums[medianBin];
+    const RealType highRange = this->GetBinMaximum( medianBin );
+    statistics[l].Median = lowRange + ( highRange - lowRange ) / 2;
+    }
+
+  m_ThreadCounts.clear();
+  m_Image = ITK_NULLPTR;
+}
+
+void
+LabelStatisticsEngine::ExecutePass(PassType pass)
+{
+  const unsigned int numberOfThreads = m_Threader->GetNumberOfThreads();
+  const size_t       numberOfLabels = m_Labels.size();
+
+  // Accumulators are allocated here, so that each thread only writes its own.
+  switch( pass )
+    {
+    case MomentsPass:
+      {
+      Moments empty;
+      empty.Count = 0;
+      empty.Minimum = itk::NumericTraits<RealType>::max();
+      empty.Maximum = itk::NumericTraits<RealType>::NonpositiveMin();
+      empty.Sum = 0.0;
+      empty.SumOfSquares = 0.0;
+      m_ThreadMoments.assign( numberOfThreads, std::vector<Moments>(numberOfLabels, empty) );
+      }
+      break;
+    case CoarseHistogramPass:
+      m_ThreadCounts.assign( numberOfThreads, std::vector<CountType>(numberOfLabels * m_NumberOfGroups, 0) );
+      break;
+    case FineHistogramPass:
+      m_ThreadCounts.assign( numberOfThreads, std::vector<CountType>(numberOfLabels * m_BinsPerGroup, 0) );
+      break;
+    }
+
+  ThreadStruct str;
+  str.Engine = this;
+  str.Pass = pass;
+
+  m_Threader->SetSingleMethod( ThreaderCallback, &str );
+  m_Threader->SingleMethodExecute();
+}
+
+ITK_THREAD_RETURN_TYPE
+LabelStatisticsEngine::ThreaderCallback(void *arg)
+{
+  const itk::ThreadIdType threadId = ( (itk::MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  const itk::ThreadIdType threadCount = ( (itk::MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+
+  ThreadStruct *str = (ThreadStruct *)( ( (itk::MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+  LabelStatisticsEngine *engine = str->Engine;
+
+  const itk::SizeValueType numberOfPixels = engine->m_Image->GetBufferedRegion().GetNumberOfPixels();
+  const itk::SizeValueType chunk = numberOfPixels / threadCount;
+  const itk::SizeValueType remainder = numberOfPixels % threadCount;
+  const itk::SizeValueType first = threadId * chunk + std::min( static_cast<itk::SizeValueType>( threadId ), remainder );
+  const itk::SizeValueType last = first + chunk + ( threadId < remainder ? 1 : 0 );
+
+  switch( str->Pass )
+    {
+    case MomentsPass:
+      engine->ThreadedComputeMoments( first, last, threadId );
+      break;
+    case CoarseHistogramPass:
+      engine->ThreadedComputeHistogram( first, last, threadId, false );
+      break;
+    case FineHistogramPass:
+      engine->ThreadedComputeHistogram( first, last, threadId, true );
+      break;
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+void
+LabelStatisticsEngine::ThreadedComputeMoments(itk::SizeValueType first, itk::SizeValueType last,
+                                              itk::ThreadIdType threadId)
+{
+  const ImageType::PixelType *pixels = m_Image->GetBufferPointer();
+  const LabelPixelType *      labels = m_LabelImage->GetBufferPointer();
+
+  std::vector<Moments> & moments = m_ThreadMoments[threadId];
+  for( itk::SizeValueType i = first; i < last; ++i )
+    {
+    const RealType value = static_cast<RealType>( pixels[i] );
+    Moments &      labelMoments = moments[m_LabelIndexes[LabelOffset( labels[i] )]];
+
+    labelMoments.Count++;
+    labelMoments.Minimum = std::min( labelMoments.Minimum, value );
+    labelMoments.Maximum = std::max( labelMoments.Maximum, value );
+    labelMoments.Sum += value;
+    labelMoments.SumOfSquares += value * value;
+    }
+}
+
+void
+LabelStatisticsEngine::ThreadedComputeHistogram(itk::SizeValueType first, itk::SizeValueType last,
+                                                itk::ThreadIdType threadId, bool fine)
+{
+  const ImageType::PixelType *pixels = m_Image->GetBufferPointer();
+  const LabelPixelType *      labels = m_LabelImage->GetBufferPointer();
+
+  std::vector<CountType> & counts = m_ThreadCounts[threadId];
+  for( itk::SizeValueType i = first; i < last; ++i )
+    {
+    unsigned int bin;
+    if( !this->GetBin( static_cast<RealType>( pixels[i] ), bin ) )
+      {
+      continue;
+      }
+
+    const unsigned int labelIndex = m_LabelIndexes[LabelOffset( labels[i] )];
+    const unsigned int group = bin / m_BinsPerGroup;
+    if( !fine )
+      {
+      counts[labelIndex * m_NumberOfGroups + group]++;
+      }
+    else if( m_MedianGroups[labelIndex] == static_cast<int>( group ) )
+      {
+      counts[labelIndex * m_BinsPerGroup + ( bin - group * m_BinsPerGroup )]++;
+      }
+    }
+}
@@ -0,0 +1,158 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __LabelStatisticsEngine_h
+#define __LabelStatisticsEngine_h
+
+#include "itkImage.h"
+#include "itkMultiThreader.h"
+
+#include <vector>
+
+/** \class LabelStatisticsEngine
+ * \brief Per label intensity statistics of several images against one label map.
+ *
+ * Computes the same values as itk::LabelStatisticsImageFilter with
+ * UseHistogramsOn(), including the histogram median (center of the bin that
+ * holds the middle sample), without a full histogram per label and thread.
+ *
+ * The labels present in the label map are indexed once by SetLabelImage().
+ * ComputeStatistics() then makes three threaded passes over each image, with
+ * per thread accumulators indexed by label:
+ *   - count, minimum, maximum, sum and sum of squares, which also give the
+ *     histogram range when none is set;
+ *   - counts in coarse groups of about sqrt(NumberOfHistogramBins) bins,
+ *     locating the group that holds the median of every label;
+ *   - counts of the bins of that group only, locating the median bin.
+ */
+class LabelStatisticsEngine
+{
+public:
+  typedef itk::Image<float, 3>      ImageType;
+  typedef itk::Image<short, 3>      LabelImageType;
+  typedef LabelImageType::PixelType LabelPixelType;
+  typedef double                    RealType;
+  typedef itk::SizeValueType        CountType;
+
+  struct LabelStatistics
+    {
+    LabelPixelType Label;
+    CountType      Count;
+    RealType       Minimum;
+    RealType       Maximum;
+    RealType       Sum;
+    RealType       SumOfSquares;
+    RealType       Mean;
+    RealType       Variance;
+    RealType       Sigma;
+    RealType       Median;
+    };
+
+  /** Statistics of the labels present in the label map, in increasing
+   * label order. */
+  typedef std::vector<LabelStatistics> LabelStatisticsList;
+
+  LabelStatisticsEngine();
+
+  /** Number of threads of every pass. Defaults to the ITK global default. */
+  void SetNumberOfThreads(unsigned int numberOfThreads);
+
+  void SetNumberOfHistogramBins(unsigned int numberOfBins);
+
+  /** Histogram range, as in LabelStatisticsImageFilter::SetHistogramParameters.
+   * Values outside of it do not count for the median. Without it, the
+   * intensity range of each image is used. */
+  void SetHistogramRange(RealType lowerBound, RealType upperBound);
+
+  /** Index the labels present in the label map. Must be called before
+   * ComputeStatistics(); the label map must stay alive until then. */
+  void SetLabelImage(const LabelImageType *labelImage);
+
+  const std::vector<LabelPixelType> & GetLabels() const
+  {
+    return m_Labels;
+  }
+
+  /** Compute the statistics of an image occupying the same buffer region as
+   * the label map. */
+  void ComputeStatistics(const ImageType *image, LabelStatisticsList & statistics);
+
+private:
+  enum PassType
+    {
+    MomentsPass,
+    CoarseHistogramPass,
+    FineHistogramPass
+    };
+
+  struct Moments
+    {
+    CountType Count;
+    RealType  Minimum;
+    RealType  Maximum;
+    RealType  Sum;
+    RealType  SumOfSquares;
+    };
+
+  struct ThreadStruct
+    {
+    LabelStatisticsEngine *Engine;
+    PassType               Pass;
+    };
+
+  void ExecutePass(PassType pass);
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback(void *arg);
+
+  void ThreadedComputeMoments(itk::SizeValueType first, itk::SizeValueType last, itk::ThreadIdType threadId);
+
+  void ThreadedComputeHistogram(itk::SizeValueType first, itk::SizeValueType last, itk::ThreadIdType threadId,
+                                bool fine);
+
+  /** Build the bin bounds the way itk::Statistics::Histogram::Initialize does. */
+  void InitializeBins(RealType lowerBound, RealType upperBound);
+
+  /** Bin of a value, or false when it is outside of the histogram range. */
+  bool GetBin(RealType value, unsigned int & bin) const;
+
+  RealType GetBinMaximum(unsigned int bin) const;
+
+  itk::MultiThreader::Pointer m_Threader;
+
+  unsigned int m_NumberOfHistogramBins;
+  bool         m_UserDefinedHistogramRange;
+  RealType     m_LowerBound;
+  RealType     m_UpperBound;
+
+  LabelImageType::ConstPointer m_LabelImage;
+  std::vector<LabelPixelType>  m_Labels;
+  std::vector<unsigned int>    m_LabelIndexes; // label - min(LabelPixelType) -> index in m_Labels
+
+  // State of the image being processed
+  ImageType::ConstPointer m_Image;
+  std::vector<RealType>   m_BinMinimums;
+  RealType                m_BinInterval;
+  unsigned int            m_BinsPerGroup;
+  unsigned int            m_NumberOfGroups;
+  std::vector<int>        m_MedianGroups; // per label, -1 once the median bin is known
+
+  std::vector<std::vector<Moments> >   m_ThreadMoments;
+  std::vector<std::vector<CountType> > m_ThreadCounts;
+};
+
+#endif
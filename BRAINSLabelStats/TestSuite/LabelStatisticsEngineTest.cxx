@@ -0,0 +1,182 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+//
+// Compares LabelStatisticsEngine with itk::LabelStatisticsImageFilter and
+// UseHistogramsOn() on a random image and label map, with the intensity
+// range of the image ("image" mode of BRAINSLabelStats) and with a manual
+// range that leaves some values out, for one and several threads. The
+// intensities are quantized so that many of them fall exactly on bin
+// bounds, and some are exactly the upper bound of the manual range.
+//
+#include "LabelStatisticsEngine.h"
+#include "itkLabelStatisticsImageFilter.h"
+#include "itkMinimumMaximumImageCalculator.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+typedef LabelStatisticsEngine::ImageType                           ImageType;
+typedef LabelStatisticsEngine::LabelImageType                      LabelImageType;
+typedef itk::LabelStatisticsImageFilter<ImageType, LabelImageType> ReferenceFilterType;
+typedef itk::Statistics::MersenneTwisterRandomVariateGenerator     GeneratorType;
+
+// Seed of the random image and label map of this test only.
+const GeneratorType::IntegerType LabelStatisticsEngineTestSeed = 4711;
+
+const float ManualLowerBound = 0.0F;
+const float ManualUpperBound = 100.0F;
+
+bool
+Differ(double value, double reference)
+{
+  return std::fabs( value - reference ) > 1.0e-9 * std::max( 1.0, std::fabs( reference ) );
+}
+
+int
+CompareWithReference(const ImageType *image, const LabelImageType *labelImage,
+                     unsigned int numberOfBins, bool manualRange, unsigned int numberOfThreads)
+{
+  double lowerBound = ManualLowerBound;
+  double upperBound = ManualUpperBound;
+  if( !manualRange )
+    {
+    typedef itk::MinimumMaximumImageCalculator<ImageType> CalculatorType;
+    CalculatorType::Pointer calculator = CalculatorType::New();
+    calculator->SetImage(image);
+    calculator->Compute();
+    lowerBound = calculator->GetMinimum();
+    upperBound = calculator->GetMaximum();
+    }
+
+  ReferenceFilterType::Pointer reference = ReferenceFilterType::New();
+  reference->SetInput(image);
+  reference->SetLabelInput(labelImage);
+  reference->UseHistogramsOn();
+  reference->SetHistogramParameters(numberOfBins, lowerBound, upperBound);
+  reference->Update();
+
+  LabelStatisticsEngine engine;
+  engine.SetNumberOfThreads(numberOfThreads);
+  engine.SetNumberOfHistogramBins(numberOfBins);
+  if( manualRange )
+    {
+    engine.SetHistogramRange(ManualLowerBound, ManualUpperBound);
+    }
+  engine.SetLabelImage(labelImage);
+
+  LabelStatisticsEngine::LabelStatisticsList statistics;
+  engine.ComputeStatistics(image, statistics);
+
+  std::cout << ( manualRange ? "manual" : "image" ) << " range, " << numberOfBins << " bins, "
+            << numberOfThreads << " threads: ";
+
+  if( statistics.size() != reference->GetNumberOfLabels() )
+    {
+    std::cout << statistics.size() << " labels instead of " << reference->GetNumberOfLabels() << std::endl;
+    return 1;
+    }
+
+  int failures = 0;
+  for( size_t l = 0; l < statistics.size(); ++l )
+    {
+    const LabelStatisticsEngine::LabelStatistics & ls = statistics[l];
+    if( !reference->HasLabel(ls.Label) )
+      {
+      std::cout << "unexpected label " << ls.Label << std::endl;
+      return 1;
+      }
+    if( ls.Count != reference->GetCount(ls.Label)
+        || ls.Minimum != reference->GetMinimum(ls.Label)
+        || ls.Maximum != reference->GetMaximum(ls.Label)
+        || Differ( ls.Sum, reference->GetSum(ls.Label) )
+        || Differ( ls.Mean, reference->GetMean(ls.Label) )
+        || Differ( ls.Variance, reference->GetVariance(ls.Label) )
+        || Differ( ls.Sigma, reference->GetSigma(ls.Label) )
+        || ls.Median != reference->GetMedian(ls.Label) )
+      {
+      std::cout << std::endl << "  label " << ls.Label
+                << ": count " << ls.Count << " / " << reference->GetCount(ls.Label)
+                << ", mean " << ls.Mean << " / " << reference->GetMean(ls.Label)
+                << ", variance " << ls.Variance << " / " << reference->GetVariance(ls.Label)
+                << ", median " << ls.Median << " / " << reference->GetMedian(ls.Label);
+      ++failures;
+      }
+    }
+  std::cout << ( failures == 0 ? "ok" : "" ) << std::endl;
+  return failures;
+}
+} // end anonymous namespace
+
+int main(int, char * *)
+{
+  ImageType::SizeType size;
+  size[0] = 37;
+  size[1] = 29;
+  size[2] = 23;
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions(size);
+  image->Allocate();
+
+  LabelImageType::Pointer labelImage = LabelImageType::New();
+  labelImage->SetRegions(size);
+  labelImage->Allocate();
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->Initialize(LabelStatisticsEngineTestSeed);
+
+  float *                     pixels = image->GetBufferPointer();
+  LabelImageType::PixelType * labels = labelImage->GetBufferPointer();
+  const itk::SizeValueType    numberOfPixels = image->GetBufferedRegion().GetNumberOfPixels();
+  for( itk::SizeValueType i = 0; i < numberOfPixels; ++i )
+    {
+    // Labels -2 to 6, label 6 being rare, and intensities on a 0.25 grid
+    // from -30 to 130, every label having some beyond the manual range.
+    const LabelImageType::PixelType label =
+      static_cast<LabelImageType::PixelType>( generator->GetIntegerVariate(8) ) - 2;
+    labels[i] = ( label == 6 && generator->GetVariate() > 0.05 ) ? 0 : label;
+    pixels[i] = static_cast<float>( std::floor( generator->GetUniformVariate(-30.0, 130.0) * 4.0 ) / 4.0 );
+    if( generator->GetVariate() < 0.01 )
+      {
+      pixels[i] = ManualUpperBound;
+      }
+    }
+
+  int failures = 0;
+  const unsigned int threads[2] = { 1, 5 };
+  for( unsigned int t = 0; t < 2; ++t )
+    {
+    failures += CompareWithReference(image, labelImage, 1000, false, threads[t]);
+    failures += CompareWithReference(image, labelImage, 37, false, threads[t]);
+    failures += CompareWithReference(image, labelImage, 100, true, threads[t]);
+    failures += CompareWithReference(image, labelImage, 7, true, threads[t]);
+    }
+
+  if( failures != 0 )
+    {
+    std::cerr << failures << " label statistics differ from LabelStatisticsImageFilter" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "Test PASSED" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -23,12 +23,56 @@
 #include "itkIdentityTransform.h"
 #include "itkResampleImageFilter.h"
 #include "itkLabelImageGaussianInterpolateImageFunction.h"
-#include "itkMultiLabelSTAPLEImageFilter.h"
+#include "itkThreadedMultiLabelSTAPLEImageFilter.h"
+#include "itkMultiThreader.h"
 #include "vnl/vnl_matlab_write.h"
 #include <sstream>
 #include <vector>
+#include <algorithm>
 
 #include "BRAINSCommonLib.h"
+#include "BRAINSThreadControl.h"
+
+typedef itk::Image<unsigned short, 3>                              USImageType;
+typedef itk::ResampleImageFilter<USImageType, USImageType, double> ResampleFilterType;
+typedef std::vector<ResampleFilterType::Pointer>                   ResampleFilterListType;
+
+namespace
+{
+/* Resamplers are updated concurrently, each thread taking a contiguous
+ * share of the atlases */
+struct ResampleThreadStruct
+  {
+  ResampleFilterListType *  resamplers;
+  std::vector<std::string> *errors;
+  };
+
+ITK_THREAD_RETURN_TYPE
+ResampleThreaderCallback(void *arg)
+{
+  itk::MultiThreader::ThreadInfoStruct *info = static_cast<itk::MultiThreader::ThreadInfoStruct *>( arg );
+  ResampleThreadStruct *                str = static_cast<ResampleThreadStruct *>( info->UserData );
+  const size_t                          numberOfResamplers = str->resamplers->size();
+  const size_t                          perThread = ( numberOfResamplers + info->NumberOfThreads - 1 )
+    / info->NumberOfThreads;
+  const size_t first = std::min( info->ThreadID * perThread, numberOfResamplers );
+  const size_t last = std::min( first + perThread, numberOfResamplers );
+  for( size_t i = first; i < last; ++i )
+    {
+    try
+      {
+      ( *str->resamplers )[i]->Update();
+      }
+    catch( itk::ExceptionObject & err )
+      {
+      std::stringstream msg;
+      msg << err;
+      ( *str->errors )[i] = msg.str();
+      }
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+}
 
 template <typename TImage>
 void
@@ -51,6 +95,7 @@ int main(int argc, char *argv[])
 {
   PARSE_ARGS;
   BRAINSRegisterAlternateIO();
+  const BRAINSUtils::StackPushITKDefaultNumberOfThreads TempDefaultNumberOfThreadsHolder(numberOfThreads);
 
   if( inputCompositeT1Volume == "" )
     {
@@ -81,8 +126,6 @@ int main(int argc, char *argv[])
     return 1;
     }
 
-  typedef itk::Image<unsigned short, 3> USImageType;
-
   typedef std::vector<USImageType::Pointer> ImageList;
   ImageList inputLabelVolumes;
   for( std::vector<std::string>::const_iterator it = inputLabelVolume.begin();
@@ -103,6 +146,8 @@ int main(int argc, char *argv[])
     }
 
   ImageList transformedLabelVolumes;
+  // kept for the whole run, streamed resampling updates them from STAPLE
+  ResampleFilterListType resamplers;
 
   // resample all input label images into a common space defined by
   // the input Composite volume.
@@ -180,29 +225,28 @@ int main(int argc, char *argv[])
     typedef std::less<itk::NumericTraits<unsigned char>::RealType> ucharLess;
     typedef itk::LabelImageGaussianInterpolateImageFunction<USImageType, double, ucharLess>
       InterpolationFunctionType;
-    InterpolationFunctionType::Pointer interpolateFunc =
-      InterpolationFunctionType::New();
     double                   sigma[3];
     USImageType::SpacingType spacing = compositeVolume->GetSpacing();
     for( unsigned i = 0; i < 3; ++i )
       {
       sigma[i] = spacing[i];
       }
-    interpolateFunc->SetParameters(sigma, 4.0);
 
+    if( streamResampling && resampledVolumePrefix != "" )
+      {
+      std::cout << "Writing resampled volumes needs them whole, not streaming the resampling" << std::endl;
+      streamResampling = false;
+      }
+
+    // Each atlas gets its own interpolator, as resamplers set their input
+    // into it and may run at the same time
     std::vector<std::string>::const_iterator nameIt = inputLabelVolume.begin();
     TransformListType::const_iterator        xfrmIt = inputTransforms.begin();
     for( ImageList::const_iterator it = inputLabelVolumes.begin();
          it != inputLabelVolumes.end(); ++it, ++xfrmIt, ++nameIt )
       {
-      USImageType::Pointer current = (*it);
-
       itk::TransformFileReader::TransformPointer curTransformBase = (*xfrmIt);
 
-      typedef itk::ResampleImageFilter<USImageType, USImageType, double> ResampleFilterType;
-
-      std::cout << "Resampling " << (*nameIt) << std::flush;
-
       const ResampleFilterType::TransformType *curTransform =
         dynamic_cast<const ResampleFilterType::TransformType *>(curTransformBase.GetPointer() );
       if( curTransform == ITK_NULLPTR )
@@ -210,47 +254,84 @@ int main(int argc, char *argv[])
         std::cerr << "Invalid transform " << curTransformBase << std::endl;
         exit(1);
         }
+      InterpolationFunctionType::Pointer interpolateFunc =
+        InterpolationFunctionType::New();
+      interpolateFunc->SetParameters(sigma, 4.0);
+
       ResampleFilterType::Pointer resampler = ResampleFilterType::New();
-      try
+      resampler->SetInput( (*it) );
+      resampler->SetUseReferenceImage(true);
+      resampler->SetReferenceImage(compositeVolume);
+      resampler->SetInterpolator(interpolateFunc);
+      resampler->SetTransform(curTransform);
+      resamplers.push_back(resampler);
+      }
+
+    if( streamResampling )
+      {
+      std::cout << "Resampling the label volumes on the fly" << std::endl;
+      for( ResampleFilterListType::const_iterator it = resamplers.begin(); it != resamplers.end(); ++it )
         {
-        resampler->SetInput(current);
-        resampler->SetUseReferenceImage(true);
-        resampler->SetReferenceImage(compositeVolume);
-        resampler->SetInterpolator(interpolateFunc);
-        resampler->SetTransform(curTransform);
-        resampler->Update();
+        transformedLabelVolumes.push_back( (*it)->GetOutput() );
         }
-      catch( itk::ExceptionObject & err )
+      }
+    else
+      {
+      // Resample several atlases at once, sharing the threads among them
+      itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+      const unsigned int          totalThreads = threader->GetNumberOfThreads();
+      const unsigned int          concurrentResamplers =
+        std::max( 1U, std::min( totalThreads, static_cast<unsigned int>( resamplers.size() ) ) );
+      for( ResampleFilterListType::const_iterator it = resamplers.begin(); it != resamplers.end(); ++it )
         {
-        std::cerr << err << std::endl;
-        return 1;
+        (*it)->SetNumberOfThreads( std::max( 1U, totalThreads / concurrentResamplers ) );
         }
+      std::cout << "Resampling " << resamplers.size() << " label volumes, "
+                << concurrentResamplers << " at a time" << std::flush;
+      std::vector<std::string> errors( resamplers.size() );
+      ResampleThreadStruct     str;
+      str.resamplers = &resamplers;
+      str.errors = &errors;
+      threader->SetNumberOfThreads( concurrentResamplers );
+      threader->SetSingleMethod( ResampleThreaderCallback, &str );
+      threader->SingleMethodExecute();
       std::cout << " done." << std::endl;
-      if( resampledVolumePrefix != "" )
+
+      nameIt = inputLabelVolume.begin();
+      for( size_t i = 0; i < resamplers.size(); ++i, ++nameIt )
         {
-        std::string namePart(itksys::SystemTools::GetFilenameName( (*nameIt) ) );
-        std::string resampledName = resampledVolumePrefix;
-        resampledName += namePart;
-        std::cerr << "Writing " << resampledName << std::flush;
-        try
+        if( errors[i] != "" )
           {
-          itkUtil::WriteImage<USImageType>(resampler->GetOutput(), resampledName);
+          std::cerr << "Resampling " << (*nameIt) << " failed" << std::endl
+                    << errors[i] << std::endl;
+          return 1;
           }
-        catch( itk::ExceptionObject & err )
+        if( resampledVolumePrefix != "" )
           {
-          std::cerr << err << std::endl;
-          return 1;
+          std::string namePart(itksys::SystemTools::GetFilenameName( (*nameIt) ) );
+          std::string resampledName = resampledVolumePrefix;
+          resampledName += namePart;
+          std::cerr << "Writing " << resampledName << std::flush;
+          try
+            {
+            itkUtil::WriteImage<USImageType>(resamplers[i]->GetOutput(), resampledName);
+            }
+          catch( itk::ExceptionObject & err )
+            {
+            std::cerr << err << std::endl;
+            return 1;
+            }
+          std::cerr << " ... done." << std::endl;
           }
-        std::cerr << " ... done." << std::endl;
+        printImageStats<USImageType>(resamplers[i]->GetOutput() );
+        transformedLabelVolumes.push_back(resamplers[i]->GetOutput() );
         }
-      printImageStats<USImageType>(resampler->GetOutput() );
-      transformedLabelVolumes.push_back(resampler->GetOutput() );
       }
     }
 
-  typedef itk::MultiLabelSTAPLEImageFilter<USImageType, USImageType> STAPLEFilterType;
+  typedef itk::ThreadedMultiLabelSTAPLEImageFilter<USImageType, USImageType> STAPLEFilterType;
   STAPLEFilterType::Pointer STAPLEFilter = STAPLEFilterType::New();
-  STAPLEFilter->SetNumberOfThreads(1);
+  STAPLEFilter->SetStreamInputs(streamResampling && !skipResampling);
 
   if( labelForUndecidedPixels != -1 )
     {
@@ -0,0 +1,145 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "../itkThreadedMultiLabelSTAPLEImageFilter.h"
+#include "itkMultiLabelSTAPLEImageFilter.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+
+#include <iostream>
+
+typedef itk::Image<unsigned short, 3>                                            LabelImageType;
+typedef itk::ThreadedMultiLabelSTAPLEImageFilter<LabelImageType, LabelImageType> STAPLEFilterType;
+
+static LabelImageType::Pointer
+RunSTAPLE( const std::vector<LabelImageType::Pointer> & raters, const unsigned int numberOfThreads,
+           const bool streamInputs, STAPLEFilterType::ConfusionMatrixType & confusionMatrix )
+{
+  STAPLEFilterType::Pointer staple = STAPLEFilterType::New();
+  for( size_t k = 0; k < raters.size(); ++k )
+    {
+    staple->PushBackInput( raters[k] );
+    }
+  staple->SetNumberOfThreads( numberOfThreads );
+  staple->SetStreamInputs( streamInputs );
+  staple->SetNumberOfStreamDivisions( 7 );
+  staple->Update();
+  confusionMatrix = staple->GetConfusionMatrix( 1 );
+  return staple->GetOutput();
+}
+
+static bool
+SameImages( const LabelImageType * a, const LabelImageType * b )
+{
+  itk::ImageRegionConstIterator<LabelImageType> ait( a, a->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIterator<LabelImageType> bit( b, b->GetLargestPossibleRegion() );
+  for( ; !ait.IsAtEnd(); ++ait, ++bit )
+    {
+    if( ait.Get() != bit.Get() )
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+// Checks that the threaded and streamed fusions are identical to the single
+// threaded one, and agree with MultiLabelSTAPLEImageFilter.
+int main(int, char * *)
+{
+  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomType;
+  RandomType::Pointer random = RandomType::New();
+  random->SetSeed( 4099 );
+
+  LabelImageType::SizeType size;
+  size[0] = 31;
+  size[1] = 27;
+  size[2] = 23;
+
+  // nested boxes with sparse labels, each rater mislabelling some pixels
+  std::vector<LabelImageType::Pointer> raters;
+  const double                         errorRates[5] = { 0.05, 0.1, 0.15, 0.2, 0.3 };
+  for( unsigned int k = 0; k < 5; ++k )
+    {
+    LabelImageType::Pointer rater = LabelImageType::New();
+    rater->SetRegions( size );
+    rater->Allocate();
+    itk::ImageRegionIteratorWithIndex<LabelImageType> it( rater, rater->GetLargestPossibleRegion() );
+    for( ; !it.IsAtEnd(); ++it )
+      {
+      const LabelImageType::IndexType & idx = it.GetIndex();
+      unsigned short                    label = 0;
+      if( idx[0] > 5 && idx[0] < 25 && idx[1] > 4 && idx[1] < 22 )
+        {
+        label = ( idx[2] < 12 ) ? 4 : 17;
+        }
+      if( random->GetVariateWithClosedRange() < errorRates[k] )
+        {
+        const unsigned short labels[3] = { 0, 4, 17 };
+        label = labels[random->GetIntegerVariate( 2 )];
+        }
+      it.Set( label );
+      }
+    raters.push_back( rater );
+    }
+
+  int                                   status = EXIT_SUCCESS;
+  STAPLEFilterType::ConfusionMatrixType singleMatrix;
+  STAPLEFilterType::ConfusionMatrixType threadedMatrix;
+  STAPLEFilterType::ConfusionMatrixType streamedMatrix;
+  LabelImageType::Pointer               single = RunSTAPLE( raters, 1, false, singleMatrix );
+  LabelImageType::Pointer               threaded = RunSTAPLE( raters, 4, false, threadedMatrix );
+  LabelImageType::Pointer               streamed = RunSTAPLE( raters, 3, true, streamedMatrix );
+
+  if( !SameImages( single, threaded ) || singleMatrix != threadedMatrix )
+    {
+    std::cerr << "Threading changed the fusion" << std::endl;
+    status = EXIT_FAILURE;
+    }
+  if( !SameImages( single, streamed ) || singleMatrix != streamedMatrix )
+    {
+    std::cerr << "Streaming changed the fusion" << std::endl;
+    status = EXIT_FAILURE;
+    }
+
+  typedef itk::MultiLabelSTAPLEImageFilter<LabelImageType, LabelImageType> ReferenceFilterType;
+  ReferenceFilterType::Pointer reference = ReferenceFilterType::New();
+  for( size_t k = 0; k < raters.size(); ++k )
+    {
+    reference->PushBackInput( raters[k] );
+    }
+  reference->Update();
+
+  itk::ImageRegionConstIterator<LabelImageType> sit( single, single->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIterator<LabelImageType> rit( reference->GetOutput(),
+                                                     reference->GetOutput()->GetLargestPossibleRegion() );
+  size_t differences = 0;
+  for( ; !sit.IsAtEnd(); ++sit, ++rit )
+    {
+    if( sit.Get() != rit.Get() )
+      {
+      ++differences;
+      }
+    }
+  if( differences > single->GetLargestPossibleRegion().GetNumberOfPixels() / 1000 )
+    {
+    std::cerr << differences << " pixels differ from MultiLabelSTAPLEImageFilter" << std::endl;
+    status = EXIT_FAILURE;
+    }
+  return status;
+}
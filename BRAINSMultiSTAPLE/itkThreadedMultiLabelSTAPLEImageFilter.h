@@ -0,0 +1,213 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkThreadedMultiLabelSTAPLEImageFilter_h
+#define __itkThreadedMultiLabelSTAPLEImageFilter_h
+
+#include "itkImageToImageFilter.h"
+#include "itkIntTypes.h"
+#include "itkArray.h"
+#include "vnl/vnl_matrix.h"
+
+#include <vector>
+
+namespace itk
+{
+/** \class ThreadedMultiLabelSTAPLEImageFilter
+ * \brief Multi-label STAPLE with threaded expectation-maximization steps.
+ *
+ * Computes the same estimate as MultiLabelSTAPLEImageFilter: priors from the
+ * label frequencies, confusion matrices initialized from majority voting,
+ * then alternating E and M steps until no confusion matrix entry changes by
+ * more than the termination threshold.
+ *
+ * Every pass over the image is split across threads, each one accumulating
+ * its own confusion matrices, which are summed at the end of the pass. The
+ * M step weights are accumulated in 32.32 fixed point, so the sums and the
+ * result are the same for any number of threads. Matrices only cover the
+ * labels present in the inputs.
+ *
+ * With StreamInputs on, the inputs are never requested whole: every pass
+ * updates them one slab at a time, so inputs produced by a pipeline (for
+ * example resampling filters) are recomputed on the fly instead of being
+ * kept in memory.
+ */
+template <typename TInputImage, typename TOutputImage = TInputImage>
+class ThreadedMultiLabelSTAPLEImageFilter :
+  public ImageToImageFilter<TInputImage, TOutputImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef ThreadedMultiLabelSTAPLEImageFilter           Self;
+  typedef ImageToImageFilter<TInputImage, TOutputImage> Superclass;
+  typedef SmartPointer<Self>                            Pointer;
+  typedef SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods) */
+  itkTypeMacro(ThreadedMultiLabelSTAPLEImageFilter, ImageToImageFilter);
+
+  typedef TInputImage                          InputImageType;
+  typedef typename InputImageType::PixelType   InputPixelType;
+  typedef TOutputImage                         OutputImageType;
+  typedef typename OutputImageType::PixelType  OutputPixelType;
+  typedef typename OutputImageType::RegionType RegionType;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TOutputImage::ImageDimension);
+
+  typedef double                  WeightsType;
+  typedef vnl_matrix<WeightsType> ConfusionMatrixType;
+  typedef Array<WeightsType>      PriorProbabilitiesType;
+
+  /** Label of the pixels with more than one most likely label; defaults
+   *  to the largest input label plus one. */
+  void SetLabelForUndecidedPixels( const OutputPixelType l )
+  {
+    this->m_LabelForUndecidedPixels = l;
+    this->m_HasLabelForUndecidedPixels = true;
+    this->Modified();
+  }
+
+  itkGetConstMacro(LabelForUndecidedPixels, OutputPixelType);
+
+  void SetMaximumNumberOfIterations( const unsigned int mit )
+  {
+    this->m_MaximumNumberOfIterations = mit;
+    this->m_HasMaximumNumberOfIterations = true;
+    this->Modified();
+  }
+
+  itkGetConstMacro(MaximumNumberOfIterations, unsigned int);
+
+  itkSetMacro(TerminationUpdateThreshold, WeightsType);
+  itkGetConstMacro(TerminationUpdateThreshold, WeightsType);
+
+  itkGetConstMacro(ElapsedNumberOfIterations, unsigned int);
+
+  /** Update the inputs slab by slab at every pass instead of requesting
+   *  them whole. */
+  itkSetMacro(StreamInputs, bool);
+  itkGetConstMacro(StreamInputs, bool);
+  itkBooleanMacro(StreamInputs);
+
+  /** Number of slabs the image is split into when streaming the inputs */
+  itkSetMacro(NumberOfStreamDivisions, unsigned int);
+  itkGetConstMacro(NumberOfStreamDivisions, unsigned int);
+
+  /** Prior probability of every label, 0 to the largest input label */
+  const PriorProbabilitiesType & GetPriorProbabilities() const
+  {
+    return this->m_PriorProbabilities;
+  }
+
+  /** Confusion matrix of input k, rows are the labels the input assigns and
+   *  columns the estimated true labels, one more row than columns. */
+  ConfusionMatrixType GetConfusionMatrix( const unsigned int k ) const;
+
+protected:
+  ThreadedMultiLabelSTAPLEImageFilter();
+  ~ThreadedMultiLabelSTAPLEImageFilter()
+  {
+  }
+
+  void PrintSelf(std::ostream & os, Indent indent) const ITK_OVERRIDE;
+
+  void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
+  void EnlargeOutputRequestedRegion( DataObject * data ) ITK_OVERRIDE;
+
+  void GenerateData() ITK_OVERRIDE;
+
+private:
+  ThreadedMultiLabelSTAPLEImageFilter(const Self &); // purposely not implemented
+  void operator=(const Self &);                      // purposely not implemented
+
+  typedef int64_t FixedPointType;
+
+  typedef enum
+    {
+    MaximumLabelPass,
+    LabelCountPass,
+    VotingPass,
+    ExpectationMaximizationPass,
+    OutputPass
+    } PassType;
+
+  /* What one thread gathers during one pass */
+  struct ThreadAccumulator
+    {
+    InputPixelType             maximumLabel;
+    std::vector<SizeValueType> labelCounts;
+    /* per input, square matrix over the present labels, row major */
+    std::vector<std::vector<FixedPointType> > confusion;
+    };
+
+  struct PassThreadStruct
+    {
+    Self *                           filter;
+    PassType                         pass;
+    RegionType                       region;
+    std::vector<ThreadAccumulator> * accumulators;
+    };
+
+  /* piece of region along its slowest dimension, possibly empty */
+  static RegionType SplitRegion( const RegionType & region, const unsigned int piece,
+                                 const unsigned int numberOfPieces );
+
+  /* runs pass over the whole output region, one slab at a time when
+   * streaming, and sums the thread accumulators into the first one */
+  void RunPass( const PassType pass, ThreadAccumulator & total );
+
+  void ResetAccumulator( const PassType pass, ThreadAccumulator & accumulator ) const;
+
+  void ThreadedPass( const PassType pass, const RegionType & region, ThreadAccumulator & accumulator );
+
+  static ITK_THREAD_RETURN_TYPE PassThreaderCallback( void *arg );
+
+  /* normalizes the columns of the matrices of total into
+   * m_ConfusionMatrices, returns the largest change */
+  WeightsType UpdateConfusionMatrices( const ThreadAccumulator & total );
+
+  size_t                 m_TotalLabelCount;
+  OutputPixelType        m_LabelForUndecidedPixels;
+  bool                   m_HasLabelForUndecidedPixels;
+  PriorProbabilitiesType m_PriorProbabilities;
+  unsigned int           m_MaximumNumberOfIterations;
+  bool                   m_HasMaximumNumberOfIterations;
+  unsigned int           m_ElapsedNumberOfIterations;
+  WeightsType            m_TerminationUpdateThreshold;
+  bool                   m_StreamInputs;
+  unsigned int           m_NumberOfStreamDivisions;
+
+  /* labels present in the inputs, and the compact index of every label */
+  std::vector<InputPixelType> m_PresentLabels;
+  std::vector<unsigned int>   m_CompactIndex;
+
+  /* per input, compact matrices stored row major */
+  std::vector<std::vector<WeightsType> > m_ConfusionMatrices;
+  std::vector<WeightsType>               m_CompactPriors;
+};
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkThreadedMultiLabelSTAPLEImageFilter.hxx"
+#endif
+
+#endif
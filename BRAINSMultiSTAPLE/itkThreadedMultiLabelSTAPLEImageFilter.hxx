@@ -0,0 +1,478 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkThreadedMultiLabelSTAPLEImageFilter_hxx
+#define __itkThreadedMultiLabelSTAPLEImageFilter_hxx
+
+#include "itkThreadedMultiLabelSTAPLEImageFilter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
+#include "itkMultiThreader.h"
+
+#include <vcl_cmath.h>
+#include <algorithm>
+
+namespace itk
+{
+template <typename TInputImage, typename TOutputImage>
+ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>
+::ThreadedMultiLabelSTAPLEImageFilter() :
+  m_TotalLabelCount(0),
+  m_LabelForUndecidedPixels(NumericTraits<OutputPixelType>::ZeroValue() ),
+  m_HasLabelForUndecidedPixels(false),
+  m_PriorProbabilities(),
+  m_MaximumNumberOfIterations(NumericTraits<unsigned int>::max() ),
+  m_HasMaximumNumberOfIterations(false),
+  m_ElapsedNumberOfIterations(0),
+  m_TerminationUpdateThreshold(1e-5),
+  m_StreamInputs(false),
+  m_NumberOfStreamDivisions(16)
+{
+}
+
+template <typename TInputImage, typename TOutputImage>
+typename ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>::ConfusionMatrixType
+ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>
+::GetConfusionMatrix( const unsigned int k ) const
+{
+  if( k >= this->m_ConfusionMatrices.size() )
+    {
+    itkExceptionMacro(<< "No confusion matrix for input " << k);
+    }
+  const size_t        presentLabelCount = this->m_PresentLabels.size();
+  ConfusionMatrixType matrix( this->m_TotalLabelCount + 1, this->m_TotalLabelCount, 0.0 );
+  for( size_t j = 0; j < presentLabelCount; ++j )
+    {
+    for( size_t c = 0; c < presentLabelCount; ++c )
+      {
+      matrix( this->m_PresentLabels[j], this->m_PresentLabels[c] ) =
+        this->m_ConfusionMatrices[k][j * presentLabelCount + c];
+      }
+    }
+  return matrix;
+}
+
+template <typename TInputImage, typename TOutputImage>
+void
+ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>
+::GenerateInputRequestedRegion()
+{
+  Superclass::GenerateInputRequestedRegion();
+
+  if( this->m_StreamInputs )
+    {
+    // only ask for the first slab, GenerateData updates the others
+    const RegionType firstSlab =
+      SplitRegion( this->GetOutput()->GetRequestedRegion(), 0, std::max( 1U, this->m_NumberOfStreamDivisions ) );
+    for( unsigned int k = 0; k < this->GetNumberOfIndexedInputs(); ++k )
+      {
+      InputImageType *input = const_cast<InputImageType *>( this->GetInput( k ) );
+      if( input )
+        {
+        input->SetRequestedRegion( firstSlab );
+        }
+      }
+    }
+}
+
+template <typename TInputImage, typename TOutputImage>
+void
+ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>
+::EnlargeOutputRequestedRegion( DataObject *data )
+{
+  Superclass::EnlargeOutputRequestedRegion( data );
+  data->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template <typename TInputImage, typename TOutputImage>
+typename ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>::RegionType
+ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>
+::SplitRegion( const RegionType & region, const unsigned int piece, const unsigned int numberOfPieces )
+{
+  const unsigned int  slowest = ImageDimension - 1;
+  const SizeValueType size = region.GetSize( slowest );
+  const SizeValueType perPiece = ( size + numberOfPieces - 1 ) / numberOfPieces;
+  const SizeValueType first = std::min( piece * perPiece, size );
+  const SizeValueType last = std::min( first + perPiece, size );
+
+  RegionType split = region;
+  split.SetIndex( slowest, region.GetIndex( slowest ) + first );
+  split.SetSize( slowest, last - first );
+  return split;
+}
+
+template <typename TInputImage, typename TOutputImage>
+void
+ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>
+::ResetAccumulator( const PassType pass, ThreadAccumulator & accumulator ) const
+{
+  accumulator.maximumLabel = NumericTraits<InputPixelType>::ZeroValue();
+  accumulator.labelCounts.assign( ( pass == LabelCountPass ) ? this->m_TotalLabelCount : 0, 0 );
+
+  const size_t presentLabelCount = this->m_PresentLabels.size();
+  if( pass == VotingPass || pass == ExpectationMaximizationPass )
+    {
+    accumulator.confusion.assign( this->GetNumberOfIndexedInputs(),
+                                  std::vector<FixedPointType>( presentLabelCount * presentLabelCount, 0 ) );
+    }
+  else
+    {
+    accumulator.confusion.clear();
+    }
+}
+
+template <typename TInputImage, typename TOutputImage>
+void
+ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>
+::RunPass( const PassType pass, ThreadAccumulator & total )
+{
+  const RegionType   outputRegion = this->GetOutput()->GetRequestedRegion();
+  const unsigned int numberOfSlabs = this->m_StreamInputs ? std::max( 1U, this->m_NumberOfStreamDivisions ) : 1;
+  const unsigned int numberOfThreads = std::max( 1U, static_cast<unsigned int>( this->GetNumberOfThreads() ) );
+
+  std::vector<ThreadAccumulator> accumulators( numberOfThreads );
+  for( unsigned int t = 0; t < numberOfThreads; ++t )
+    {
+    this->ResetAccumulator( pass, accumulators[t] );
+    }
+
+  for( unsigned int slab = 0; slab < numberOfSlabs; ++slab )
+    {
+    const RegionType slabRegion = SplitRegion( outputRegion, slab, numberOfSlabs );
+    if( slabRegion.GetNumberOfPixels() == 0 )
+      {
+      continue;
+      }
+    if( this->m_StreamInputs )
+      {
+      for( unsigned int k = 0; k < this->GetNumberOfIndexedInputs(); ++k )
+        {
+        InputImageType *input = const_cast<InputImageType *>( this->GetInput( k ) );
+        input->SetRequestedRegion( slabRegion );
+        input->PropagateRequestedRegion();
+        input->UpdateOutputData();
+        }
+      }
+
+    PassThreadStruct str;
+    str.filter = this;
+    str.pass = pass;
+    str.region = slabRegion;
+    str.accumulators = &accumulators;
+
+    this->GetMultiThreader()->SetNumberOfThreads( numberOfThreads );
+    this->GetMultiThreader()->SetSingleMethod( PassThreaderCallback, &str );
+    this->GetMultiThreader()->SingleMethodExecute();
+    }
+
+  // Every sum is an integer one, so the order does not matter
+  total = accumulators[0];
+  for( unsigned int t = 1; t < numberOfThreads; ++t )
+    {
+    total.maximumLabel = std::max( total.maximumLabel, accumulators[t].maximumLabel );
+    for( size_t l = 0; l < total.labelCounts.size(); ++l )
+      {
+      total.labelCounts[l] += accumulators[t].labelCounts[l];
+      }
+    for( size_t k = 0; k < total.confusion.size(); ++k )
+      {
+      for( size_t e = 0; e < total.confusion[k].size(); ++e )
+        {
+        total.confusion[k][e] += accumulators[t].confusion[k][e];
+        }
+      }
+    }
+}
+
+template <typename TInputImage, typename TOutputImage>
+ITK_THREAD_RETURN_TYPE
+ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>
+::PassThreaderCallback( void *arg )
+{
+  MultiThreader::ThreadInfoStruct *info = static_cast<MultiThreader::ThreadInfoStruct *>( arg );
+  PassThreadStruct *               str = static_cast<PassThreadStruct *>( info->UserData );
+
+  const RegionType region = SplitRegion( str->region, info->ThreadID, info->NumberOfThreads );
+  if( region.GetNumberOfPixels() > 0 )
+    {
+    str->filter->ThreadedPass( str->pass, region, ( *str->accumulators )[info->ThreadID] );
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <typename TInputImage, typename TOutputImage>
+void
+ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>
+::ThreadedPass( const PassType pass, const RegionType & region, ThreadAccumulator & accumulator )
+{
+  typedef ImageRegionConstIterator<InputImageType> InputIteratorType;
+
+  const unsigned int numberOfInputs = this->GetNumberOfIndexedInputs();
+  const size_t       presentLabelCount = this->m_PresentLabels.size();
+  // one in the 32.32 fixed point the M step weights are summed in
+  const WeightsType unit = static_cast<WeightsType>( static_cast<FixedPointType>( 1 ) << 32 );
+
+  std::vector<InputIteratorType> inputIts;
+  for( unsigned int k = 0; k < numberOfInputs; ++k )
+    {
+    inputIts.push_back( InputIteratorType( this->GetInput( k ), region ) );
+    }
+  ImageRegionIterator<OutputImageType> outIt( this->GetOutput(), region );
+
+  std::vector<unsigned int> labels( numberOfInputs );
+  std::vector<unsigned int> votes( presentLabelCount, 0 );
+  std::vector<WeightsType>  W( presentLabelCount );
+
+  for( ; !outIt.IsAtEnd(); ++outIt )
+    {
+    if( pass == MaximumLabelPass || pass == LabelCountPass )
+      {
+      for( unsigned int k = 0; k < numberOfInputs; ++k )
+        {
+        const InputPixelType label = inputIts[k].Get();
+        ++inputIts[k];
+        if( pass == MaximumLabelPass )
+          {
+          accumulator.maximumLabel = std::max( accumulator.maximumLabel, label );
+          }
+        else
+          {
+          ++accumulator.labelCounts[static_cast<size_t>( label )];
+          }
+        }
+      continue;
+      }
+
+    for( unsigned int k = 0; k < numberOfInputs; ++k )
+      {
+      labels[k] = this->m_CompactIndex[static_cast<size_t>( inputIts[k].Get() )];
+      ++inputIts[k];
+      }
+
+    if( pass == VotingPass )
+      {
+      // count the pixel only for the inputs of a strict majority winner
+      for( unsigned int k = 0; k < numberOfInputs; ++k )
+        {
+        ++votes[labels[k]];
+        }
+      unsigned int winner = 0;
+      unsigned int winnerVotes = 0;
+      bool         tie = false;
+      for( unsigned int k = 0; k < numberOfInputs; ++k )
+        {
+        const unsigned int label = labels[k];
+        if( votes[label] > winnerVotes )
+          {
+          winner = label;
+          winnerVotes = votes[label];
+          tie = false;
+          }
+        else if( votes[label] == winnerVotes && label != winner )
+          {
+          tie = true;
+          }
+        }
+      for( unsigned int k = 0; k < numberOfInputs; ++k )
+        {
+        votes[labels[k]] = 0;
+        }
+      if( !tie )
+        {
+        for( unsigned int k = 0; k < numberOfInputs; ++k )
+          {
+          ++accumulator.confusion[k][labels[k] * presentLabelCount + winner];
+          }
+        }
+      continue;
+      }
+
+    // E step
+    for( size_t c = 0; c < presentLabelCount; ++c )
+      {
+      W[c] = this->m_CompactPriors[c];
+      }
+    for( unsigned int k = 0; k < numberOfInputs; ++k )
+      {
+      const WeightsType *row = &( this->m_ConfusionMatrices[k][labels[k] * presentLabelCount] );
+      for( size_t c = 0; c < presentLabelCount; ++c )
+        {
+        W[c] *= row[c];
+        }
+      }
+
+    if( pass == ExpectationMaximizationPass )
+      {
+      WeightsType sumW = 0.0;
+      for( size_t c = 0; c < presentLabelCount; ++c )
+        {
+        sumW += W[c];
+        }
+      if( sumW > 0.0 )
+        {
+        for( size_t c = 0; c < presentLabelCount; ++c )
+          {
+          W[c] /= sumW;
+          }
+        }
+      // M step accumulation
+      for( unsigned int k = 0; k < numberOfInputs; ++k )
+        {
+        FixedPointType *row = &( accumulator.confusion[k][labels[k] * presentLabelCount] );
+        for( size_t c = 0; c < presentLabelCount; ++c )
+          {
+          row[c] += static_cast<FixedPointType>( W[c] * unit + 0.5 );
+          }
+        }
+      continue;
+      }
+
+    // OutputPass
+    OutputPixelType winningLabel = this->m_LabelForUndecidedPixels;
+    WeightsType     winningLabelW = 0.0;
+    for( size_t c = 0; c < presentLabelCount; ++c )
+      {
+      if( W[c] > winningLabelW )
+        {
+        winningLabelW = W[c];
+        winningLabel = static_cast<OutputPixelType>( this->m_PresentLabels[c] );
+        }
+      else if( !( W[c] < winningLabelW ) )
+        {
+        winningLabel = this->m_LabelForUndecidedPixels;
+        }
+      }
+    outIt.Set( winningLabel );
+    }
+}
+
+template <typename TInputImage, typename TOutputImage>
+typename ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>::WeightsType
+ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>
+::UpdateConfusionMatrices( const ThreadAccumulator & total )
+{
+  const size_t presentLabelCount = this->m_PresentLabels.size();
+  WeightsType  maximumUpdate = 0.0;
+
+  for( size_t k = 0; k < total.confusion.size(); ++k )
+    {
+    const std::vector<FixedPointType> & counts = total.confusion[k];
+    std::vector<WeightsType> &          matrix = this->m_ConfusionMatrices[k];
+    for( size_t c = 0; c < presentLabelCount; ++c )
+      {
+      FixedPointType sum = 0;
+      for( size_t j = 0; j < presentLabelCount; ++j )
+        {
+        sum += counts[j * presentLabelCount + c];
+        }
+      for( size_t j = 0; j < presentLabelCount; ++j )
+        {
+        const WeightsType updated = ( sum > 0 ) ?
+          static_cast<WeightsType>( counts[j * presentLabelCount + c] ) / static_cast<WeightsType>( sum ) : 0.0;
+        maximumUpdate = std::max( maximumUpdate, vcl_abs( updated - matrix[j * presentLabelCount + c] ) );
+        matrix[j * presentLabelCount + c] = updated;
+        }
+      }
+    }
+  return maximumUpdate;
+}
+
+template <typename TInputImage, typename TOutputImage>
+void
+ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>
+::GenerateData()
+{
+  const unsigned int numberOfInputs = this->GetNumberOfIndexedInputs();
+  if( numberOfInputs == 0 )
+    {
+    itkExceptionMacro(<< "At least one input is required");
+    }
+  this->AllocateOutputs();
+
+  ThreadAccumulator total;
+  this->RunPass( MaximumLabelPass, total );
+  this->m_TotalLabelCount = static_cast<size_t>( total.maximumLabel ) + 1;
+  if( !this->m_HasLabelForUndecidedPixels )
+    {
+    this->m_LabelForUndecidedPixels = static_cast<OutputPixelType>( this->m_TotalLabelCount );
+    }
+
+  // priors are the label frequencies over all inputs
+  this->RunPass( LabelCountPass, total );
+  SizeValueType totalCount = 0;
+  for( size_t l = 0; l < this->m_TotalLabelCount; ++l )
+    {
+    totalCount += total.labelCounts[l];
+    }
+  this->m_PriorProbabilities.SetSize( this->m_TotalLabelCount );
+  this->m_PresentLabels.clear();
+  this->m_CompactPriors.clear();
+  this->m_CompactIndex.assign( this->m_TotalLabelCount, 0 );
+  for( size_t l = 0; l < this->m_TotalLabelCount; ++l )
+    {
+    this->m_PriorProbabilities[l] =
+      static_cast<WeightsType>( total.labelCounts[l] ) / static_cast<WeightsType>( totalCount );
+    if( total.labelCounts[l] > 0 )
+      {
+      this->m_CompactIndex[l] = static_cast<unsigned int>( this->m_PresentLabels.size() );
+      this->m_PresentLabels.push_back( static_cast<InputPixelType>( l ) );
+      this->m_CompactPriors.push_back( this->m_PriorProbabilities[l] );
+      }
+    }
+
+  const size_t presentLabelCount = this->m_PresentLabels.size();
+  this->m_ConfusionMatrices.assign( numberOfInputs, std::vector<WeightsType>( presentLabelCount * presentLabelCount,
+                                                                               0.0 ) );
+  this->RunPass( VotingPass, total );
+  this->UpdateConfusionMatrices( total );
+
+  const unsigned int maximumNumberOfIterations = this->m_HasMaximumNumberOfIterations ?
+    this->m_MaximumNumberOfIterations : NumericTraits<unsigned int>::max();
+  for( this->m_ElapsedNumberOfIterations = 0;
+       this->m_ElapsedNumberOfIterations < maximumNumberOfIterations; )
+    {
+    this->RunPass( ExpectationMaximizationPass, total );
+    ++this->m_ElapsedNumberOfIterations;
+    if( this->UpdateConfusionMatrices( total ) < this->m_TerminationUpdateThreshold )
+      {
+      break;
+      }
+    }
+
+  this->RunPass( OutputPass, total );
+}
+
+template <typename TInputImage, typename TOutputImage>
+void
+ThreadedMultiLabelSTAPLEImageFilter<TInputImage, TOutputImage>
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "TotalLabelCount: " << this->m_TotalLabelCount << std::endl;
+  os << indent << "LabelForUndecidedPixels: "
+     << static_cast<typename NumericTraits<OutputPixelType>::PrintType>( this->m_LabelForUndecidedPixels )
+     << std::endl;
+  os << indent << "MaximumNumberOfIterations: " << this->m_MaximumNumberOfIterations << std::endl;
+  os << indent << "ElapsedNumberOfIterations: " << this->m_ElapsedNumberOfIterations << std::endl;
+  os << indent << "TerminationUpdateThreshold: " << this->m_TerminationUpdateThreshold << std::endl;
+  os << indent << "StreamInputs: " << this->m_StreamInputs << std::endl;
+  os << indent << "NumberOfStreamDivisions: " << this->m_NumberOfStreamDivisions << std::endl;
+}
+} // end namespace itk
+
+#endif
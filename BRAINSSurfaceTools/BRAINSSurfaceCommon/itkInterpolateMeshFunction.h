@@ -21,6 +21,7 @@
 
 #include "itkMeshFunction.h"
 #include "itkPointLocator2.h"
+#include "itkSimpleFastMutexLock.h"
 
 namespace itk
 {
@@ -93,7 +94,7 @@ public:
 
   /** Prepare internal data structures of the PointLocator. This method must be
    * called before performing any call to Evaluate. */
-  void Initialize();
+  virtual void Initialize();
 
 protected:
   InterpolateMeshFunction();
@@ -121,6 +122,10 @@ private:
   void operator=( const Self & );          // purposely not implemented
 
   PointLocatorPointer m_PointLocator;
+
+  /** The Kd-Tree keeps the state of a search in itself, so searches from
+   * different threads are serialized. */
+  mutable SimpleFastMutexLock m_SearchLock;
 };
 } // end namespace itk
 
@@ -62,7 +62,9 @@ InterpolateMeshFunction<TInputMesh>
          InstanceIdentifierVectorType& result) const
 {
   typename PointLocatorType::PointType point( query );
+  this->m_SearchLock.Lock();
   this->m_PointLocator->Search( point, numberOfNeighborsRequested, result );
+  this->m_SearchLock.Unlock();
 }
 
 template <class TInputMesh>
@@ -73,7 +75,9 @@ InterpolateMeshFunction<TInputMesh>
          InstanceIdentifierVectorType& result) const
 {
   typename PointLocatorType::PointType point( query );
+  this->m_SearchLock.Lock();
   this->m_PointLocator->Search( point, radius, result );
+  this->m_SearchLock.Unlock();
 }
 
 /**
@@ -97,6 +97,7 @@ protected:
   void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
 
   typedef typename Superclass::InstanceIdentifierVectorType InstanceIdentifierVectorType;
+  typedef typename Superclass::TriangleWeightsType          TriangleWeightsType;
 private:
   LinearInterpolateDeformationFieldMeshFunction( const Self & ); // purposely not implemented
   void operator=( const Self & );                                // purposely not implemented
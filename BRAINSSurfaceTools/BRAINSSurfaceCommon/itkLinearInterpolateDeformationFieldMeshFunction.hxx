@@ -78,8 +78,9 @@ LinearInterpolateDeformationFieldMeshFunction<TInputMesh, TDestinationPointsCont
             const PointType & point, PointType & outputPoint ) const
 {
   InstanceIdentifierVectorType pointIds(3);
+  TriangleWeightsType          weights;
 
-  bool foundTriangle = this->FindTriangle( point, pointIds );
+  bool foundTriangle = this->FindTriangle( point, pointIds, weights );
 
   if( !foundTriangle )
     {
@@ -106,8 +107,8 @@ LinearInterpolateDeformationFieldMeshFunction<TInputMesh, TDestinationPointsCont
   const PointType & point2 = field->ElementAt( pointIds[1] );
   const PointType & point3 = field->ElementAt( pointIds[2] );
 
-  const RealType & weight1 = this->GetInterpolationWeight(0);
-  const RealType & weight2 = this->GetInterpolationWeight(1);
+  const RealType & weight1 = weights.Weights[0];
+  const RealType & weight2 = weights.Weights[1];
 
   outputPoint.SetToBarycentricCombination( point1, point2, point3, weight1, weight2 );
 
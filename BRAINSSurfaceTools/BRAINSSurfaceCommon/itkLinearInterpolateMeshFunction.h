@@ -22,6 +22,7 @@
 #include "itkInterpolateMeshFunction.h"
 #include "itkTriangleBasisSystem.h"
 #include "itkTriangleBasisSystemCalculator.h"
+#include "itkSphericalTriangleLocator.h"
 
 namespace itk
 {
@@ -32,6 +33,10 @@ namespace itk
  * point, and then will compute on it the output value using linear
  * interpolation among the values at the points of the cell.
  *
+ * Triangles are located with a SphericalTriangleLocator built by
+ * Initialize(), and the barycentric weights are computed per call, so that
+ * Evaluate() and EvaluateDerivative() can be called from several threads.
+ *
  * \sa VectorLinearInterpolateMeshFunction
  * \ingroup MeshFunctions MeshInterpolators
  *
@@ -96,6 +101,25 @@ public:
 
   typedef typename Superclass::InstanceIdentifierVectorType InstanceIdentifierVectorType;
 
+  /** Barycentric weights of a point in a triangle, together with the dual
+   * basis of the triangle. */
+  struct TriangleWeightsType
+    {
+    RealType   Weights[3];
+    VectorType U12;
+    VectorType U32;
+    };
+
+  /** Prepare the point locator and the triangle locator. This method must be
+   * called after setting the input mesh and the sphere center, and before
+   * calling Evaluate. */
+  virtual void Initialize() ITK_OVERRIDE;
+
+  /** Find the triangle that contains the input point. Return the point Ids of
+   * the triangle vertices, and the weights of the point in that triangle. */
+  virtual bool FindTriangle( const PointType& point, InstanceIdentifierVectorType & pointIds,
+                             TriangleWeightsType & weights ) const;
+
   /** Find the triangle that contains the input point. Return the point Ids of the triangle vertices. */
   virtual bool FindTriangle( const PointType& point, InstanceIdentifierVectorType & pointIds ) const;
 
@@ -109,7 +133,7 @@ public:
   /** Set Sphere Center.  The implementation of this interpolator assumes that the
    * Mesh surface has a spherical geometry (not only spherical topology). With
    * this method you can specify the coordinates of the center of the sphere
-   * represented by the Mesh.
+   * represented by the Mesh. It must be set before calling Initialize().
    */
   itkSetMacro( SphereCenter, PointType );
   itkGetConstMacro( SphereCenter, PointType );
@@ -129,21 +153,22 @@ protected:
 
   void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
 
-  virtual bool ComputeWeights( const PointType & point, const InstanceIdentifierVectorType & pointIds ) const;
-
-  const RealType & GetInterpolationWeight( unsigned int ) const;
+  virtual bool ComputeWeights( const PointType & point, const InstanceIdentifierVectorType & pointIds,
+                               TriangleWeightsType & weights ) const;
 
 private:
   LinearInterpolateMeshFunction( const Self & ); // purposely not implemented
   void operator=( const Self & );                // purposely not implemented
 
-  mutable VectorType m_V12;
-  mutable VectorType m_V32;
+  /** Among the triangles around pointId, find the first one, in Onext order,
+   * that contains the point. */
+  bool FindTriangleAroundPoint( const PointType & point, PointIdentifier pointId,
+                                InstanceIdentifierVectorType & pointIds, TriangleWeightsType & weights ) const;
 
-  mutable VectorType m_U12;
-  mutable VectorType m_U32;
-
-  mutable RealType m_InterpolationWeights[MeshDimension];
+  /** Search for the triangle among those of an increasing number of closest
+   * points. Used when the triangle locator finds nothing. */
+  bool FindTriangleAroundClosestPoints( const PointType & point, InstanceIdentifierVectorType & pointIds,
+                                        TriangleWeightsType & weights ) const;
 
   itkStaticConstMacro( SurfaceDimension, unsigned int, 2 );
 
@@ -152,6 +177,11 @@ private:
 
   typename TriangleBasisSystemCalculatorType::Pointer m_TriangleBasisSystemCalculator;
 
+  typedef SphericalTriangleLocator<TInputMesh>             TriangleLocatorType;
+  typedef typename TriangleLocatorType::TriangleIdentifier TriangleIdentifier;
+
+  typename TriangleLocatorType::Pointer m_TriangleLocator;
+
   bool      m_UseNearestNeighborInterpolationAsBackup;
   PointType m_SphereCenter;
 };
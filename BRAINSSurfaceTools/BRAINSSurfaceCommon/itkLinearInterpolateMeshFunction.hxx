@@ -34,6 +34,7 @@ LinearInterpolateMeshFunction<TInputMesh>
 ::LinearInterpolateMeshFunction()
 {
   this->m_TriangleBasisSystemCalculator = TriangleBasisSystemCalculatorType::New();
+  this->m_TriangleLocator = TriangleLocatorType::New();
   this->m_SphereCenter.Fill( 0.0 );
   this->m_UseNearestNeighborInterpolationAsBackup = false;
 }
@@ -58,6 +59,21 @@ LinearInterpolateMeshFunction<TInputMesh>
   this->Superclass::PrintSelf( os, indent );
 }
 
+/**
+ * Prepare the point locator and the triangle locator
+ */
+template <class TInputMesh>
+void
+LinearInterpolateMeshFunction<TInputMesh>
+::Initialize()
+{
+  this->Superclass::Initialize();
+
+  this->m_TriangleLocator->SetMesh( this->GetInputMesh() );
+  this->m_TriangleLocator->SetSphereCenter( this->m_SphereCenter );
+  this->m_TriangleLocator->Initialize();
+}
+
 /**
  * Evaluate the mesh at a given point position.
  */
@@ -67,8 +83,9 @@ LinearInterpolateMeshFunction<TInputMesh>
 ::EvaluateDerivative( const PointType& point, DerivativeType & derivative ) const
 {
   InstanceIdentifierVectorType pointIds(3);
+  TriangleWeightsType          weights;
 
-  if( this->FindTriangle( point, pointIds ) )
+  if( this->FindTriangle( point, pointIds, weights ) )
     {
     PixelType pixelValue1 = itk::NumericTraits<PixelType>::ZeroValue();
     PixelType pixelValue2 = itk::NumericTraits<PixelType>::ZeroValue();
@@ -79,7 +96,7 @@ LinearInterpolateMeshFunction<TInputMesh>
     this->GetPointData( pointIds[2], &pixelValue3 );
 
     this->GetDerivativeFromPixelsAndBasis(
-      pixelValue1, pixelValue2, pixelValue3, m_U12, m_U32, derivative);
+      pixelValue1, pixelValue2, pixelValue3, weights.U12, weights.U32, derivative);
     }
   else
     {
@@ -87,6 +104,12 @@ LinearInterpolateMeshFunction<TInputMesh>
       {
       this->FindTriangleOfClosestPoint( point, pointIds );
 
+      // The point is outside of this triangle, but its basis is still the
+      // one to use for the derivative.
+      weights.U12.Fill( NumericTraits<RealType>::ZeroValue() );
+      weights.U32.Fill( NumericTraits<RealType>::ZeroValue() );
+      this->ComputeWeights( point, pointIds, weights );
+
       PixelType pixelValue1 = itk::NumericTraits<PixelType>::ZeroValue();
       PixelType pixelValue2 = itk::NumericTraits<PixelType>::ZeroValue();
       PixelType pixelValue3 = itk::NumericTraits<PixelType>::ZeroValue();
@@ -96,7 +119,7 @@ LinearInterpolateMeshFunction<TInputMesh>
       this->GetPointData( pointIds[2], &pixelValue3 );
 
       this->GetDerivativeFromPixelsAndBasis(
-        pixelValue1, pixelValue2, pixelValue3, m_U12, m_U32, derivative);
+        pixelValue1, pixelValue2, pixelValue3, weights.U12, weights.U32, derivative);
       }
     else
       {
@@ -157,8 +180,9 @@ LinearInterpolateMeshFunction<TInputMesh>
 ::Evaluate( const PointType& point ) const
 {
   InstanceIdentifierVectorType pointIds(3);
+  TriangleWeightsType          weights;
 
-  bool foundTriangle = this->FindTriangle( point, pointIds );
+  bool foundTriangle = this->FindTriangle( point, pointIds, weights );
 
   if( !foundTriangle )
     {
@@ -172,7 +196,7 @@ LinearInterpolateMeshFunction<TInputMesh>
 
       PixelType pixelValue0 = itk::NumericTraits<PixelType>::ZeroValue();
 
-      this->GetPointData( pointIds[0], &pixelValue0 );
+      this->GetPointData( closestPointIds[0], &pixelValue0 );
 
       return pixelValue0;
       }
@@ -198,9 +222,9 @@ LinearInterpolateMeshFunction<TInputMesh>
   RealType pixelValueReal3 = static_cast<RealType>( pixelValue3 );
 
   RealType returnValue =
-    pixelValueReal1 * m_InterpolationWeights[0]
-    + pixelValueReal2 * m_InterpolationWeights[1]
-    + pixelValueReal3 * m_InterpolationWeights[2];
+    pixelValueReal1 * weights.Weights[0]
+    + pixelValueReal2 * weights.Weights[1]
+    + pixelValueReal3 * weights.Weights[2];
 
   return returnValue;
 }
@@ -212,6 +236,151 @@ template <class TInputMesh>
 bool
 LinearInterpolateMeshFunction<TInputMesh>
 ::FindTriangle( const PointType& point, InstanceIdentifierVectorType & pointIds ) const
+{
+  TriangleWeightsType weights;
+
+  return this->FindTriangle( point, pointIds, weights );
+}
+
+template <class TInputMesh>
+bool
+LinearInterpolateMeshFunction<TInputMesh>
+::FindTriangle( const PointType& point, InstanceIdentifierVectorType & pointIds,
+                TriangleWeightsType & weights ) const
+{
+  const TriangleIdentifier * candidates = ITK_NULLPTR;
+
+  const unsigned int numberOfCandidates =
+    this->m_TriangleLocator->GetCandidateTriangles( point, candidates );
+
+  const InputMeshType * mesh = this->GetInputMesh();
+
+  typedef typename InputMeshType::PointsContainer PointsContainer;
+
+  const PointsContainer * points = mesh->GetPoints();
+
+  //
+  // Test all the triangles of the bin of the point. Near an edge or a
+  // vertex the point may be inside several of them, within the tolerance of
+  // ComputeWeights(). Keep the closest vertex of those triangles: the search
+  // around closest points picks the first triangle around that vertex.
+  //
+  InstanceIdentifierVectorType candidatePointIds(3);
+  TriangleWeightsType          candidateWeights;
+
+  unsigned int    numberOfContainingTriangles = 0;
+  PointIdentifier closestPointId = NumericTraits<PointIdentifier>::ZeroValue();
+  double          closestSquaredDistance = NumericTraits<double>::max();
+
+  for( unsigned int c = 0; c < numberOfCandidates; c++ )
+    {
+    const PointIdentifier * trianglePointIds = this->m_TriangleLocator->GetTrianglePointIds( candidates[c] );
+
+    candidatePointIds[0] = trianglePointIds[0];
+    candidatePointIds[1] = trianglePointIds[1];
+    candidatePointIds[2] = trianglePointIds[2];
+
+    if( !this->ComputeWeights( point, candidatePointIds, candidateWeights ) )
+      {
+      continue;
+      }
+
+    if( numberOfContainingTriangles == 0 )
+      {
+      pointIds[0] = candidatePointIds[0];
+      pointIds[1] = candidatePointIds[1];
+      pointIds[2] = candidatePointIds[2];
+      weights = candidateWeights;
+      }
+
+    ++numberOfContainingTriangles;
+
+    for( unsigned int k = 0; k < 3; k++ )
+      {
+      const double squaredDistance =
+        point.SquaredEuclideanDistanceTo( points->GetElement( candidatePointIds[k] ) );
+
+      if( squaredDistance < closestSquaredDistance )
+        {
+        closestSquaredDistance = squaredDistance;
+        closestPointId = candidatePointIds[k];
+        }
+      }
+    }
+
+  if( numberOfContainingTriangles == 1 )
+    {
+    return true;
+    }
+
+  if( numberOfContainingTriangles > 1 &&
+      this->FindTriangleAroundPoint( point, closestPointId, pointIds, weights ) )
+    {
+    return true;
+    }
+
+  return this->FindTriangleAroundClosestPoints( point, pointIds, weights );
+}
+
+/**
+ * Find the first triangle around a point that contains the input point
+ */
+template <class TInputMesh>
+bool
+LinearInterpolateMeshFunction<TInputMesh>
+::FindTriangleAroundPoint( const PointType & point, PointIdentifier pointId,
+                           InstanceIdentifierVectorType & pointIds, TriangleWeightsType & weights ) const
+{
+  const InputMeshType * mesh = this->GetInputMesh();
+
+  typedef typename InputMeshType::QEPrimal EdgeType;
+
+  //
+  // Find the edge connected to the point.
+  //
+  pointIds[0] = pointId;
+
+  EdgeType * edge1 = mesh->FindEdge( pointIds[0] );
+
+  if( edge1 == ITK_NULLPTR )
+    {
+    return false;
+    }
+
+  //
+  // Explore triangles around pointIds[0]
+  //
+  EdgeType * temp1 = ITK_NULLPTR;
+  EdgeType * temp2 = edge1;
+
+  do
+    {
+    temp1 = temp2;
+    temp2 = temp1->GetOnext();
+
+    pointIds[1] = temp1->GetDestination();
+    pointIds[2] = temp2->GetDestination();
+
+    const bool isInside = this->ComputeWeights( point, pointIds, weights );
+
+    if( isInside )
+      {
+      return true;
+      }
+    }
+  while( temp2 != edge1 );
+
+  return false;
+}
+
+/**
+ * Search the triangle around the closest points of the input point
+ */
+template <class TInputMesh>
+bool
+LinearInterpolateMeshFunction<TInputMesh>
+::FindTriangleAroundClosestPoints( const PointType& point, InstanceIdentifierVectorType & pointIds,
+                                   TriangleWeightsType & weights ) const
 {
   //
   // start numberOfNeighbors with a certain value
@@ -238,41 +407,13 @@ LinearInterpolateMeshFunction<TInputMesh>
 
     this->Search( point, numberOfNeighbors, closestPointIds );
 
-    const InputMeshType * mesh = this->GetInputMesh();
-
-    typedef typename InputMeshType::QEPrimal EdgeType;
-    //
-    // Find the edge connected to the closest point.
-    //
     // go through triangles around each neighbors
     for( unsigned int i = 0; i < numberOfNeighbors; i++ )
       {
-      pointIds[0] = closestPointIds[i];
-
-      EdgeType * edge1 = mesh->FindEdge( pointIds[0] );
-
-      //
-      // Explore triangles around pointIds[0]
-      //
-      EdgeType * temp1 = ITK_NULLPTR;
-      EdgeType * temp2 = edge1;
-
-      do
+      if( this->FindTriangleAroundPoint( point, closestPointIds[i], pointIds, weights ) )
         {
-        temp1 = temp2;
-        temp2 = temp1->GetOnext();
-
-        pointIds[1] = temp1->GetDestination();
-        pointIds[2] = temp2->GetDestination();
-
-        const bool isInside = this->ComputeWeights( point, pointIds );
-
-        if( isInside )
-          {
-          return true;
-          }
+        return true;
         }
-      while( temp2 != edge1 );
       }
 
     numberOfNeighbors += 20;
@@ -319,7 +460,8 @@ template <class TInputMesh>
 bool
 LinearInterpolateMeshFunction<TInputMesh>
 ::ComputeWeights( const PointType & inputPoint,
-                  const InstanceIdentifierVectorType & pointIds ) const
+                  const InstanceIdentifierVectorType & pointIds,
+                  TriangleWeightsType & weights ) const
 {
   const InputMeshType * mesh = this->GetInputMesh();
 
@@ -370,33 +512,20 @@ LinearInterpolateMeshFunction<TInputMesh>
   this->m_TriangleBasisSystemCalculator->CalculateBasis(
     ppt1, ppt2, ppt3, triangleBasisSystem, orthogonalBasisSytem );
 
-  m_U12 = triangleBasisSystem.GetVector(0);
-  m_U32 = triangleBasisSystem.GetVector(1);
-
-  m_V12 = orthogonalBasisSytem.GetVector(0);
-  m_V32 = orthogonalBasisSytem.GetVector(1);
+  weights.U12 = triangleBasisSystem.GetVector(0);
+  weights.U32 = triangleBasisSystem.GetVector(1);
 
   //
   // Project inputPoint to plane, by using the dual vector base
   //
   // Compute components of the input point in the 2D
-  // space defined by m_V12 and m_V32
+  // space defined by the edges of the projected triangle
   //
   // VectorType xo = inputPoint - pt2;
   VectorType xo = inputPoint - ppt2;
 
-  const double u12p = xo * m_U12;
-  const double u32p = xo * m_U32;
-
-  /* ---------------never used
-  VectorType x12 = m_V12 * u12p;
-  VectorType x32 = m_V32 * u32p;
-
-  //
-  // The projection of point X in the plane is cp
-  //
-  PointType cp = pt2 + x12 + x32;
-  -----------------never used */
+  const double u12p = xo * weights.U12;
+  const double u32p = xo * weights.U32;
 
   //
   // Compute barycentric coordinates in the tangent Triangle
@@ -414,9 +543,9 @@ LinearInterpolateMeshFunction<TInputMesh>
 
   bool isInside = false;
 
-  m_InterpolationWeights[0] = b1;
-  m_InterpolationWeights[1] = b2;
-  m_InterpolationWeights[2] = b3;
+  weights.Weights[0] = b1;
+  weights.Weights[1] = b2;
+  weights.Weights[2] = b3;
 
   //
   // Since the three barycentric coordinates are interdependent
@@ -437,18 +566,6 @@ LinearInterpolateMeshFunction<TInputMesh>
 
   return isInside;
 }
-
-/**
- * Return interpolate weight values. This is provided as a convenience for
- * derived classes.
- */
-template <class TInputMesh>
-const typename LinearInterpolateMeshFunction<TInputMesh>::RealType
-& LinearInterpolateMeshFunction<TInputMesh>
-::GetInterpolationWeight( unsigned int index ) const
-  {
-  return this->m_InterpolationWeights[index];
-  }
 } // end namespace itk
 
 #endif
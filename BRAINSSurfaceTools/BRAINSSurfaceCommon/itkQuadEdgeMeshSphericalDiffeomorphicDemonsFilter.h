@@ -28,6 +28,11 @@
 #include "itkVectorContainer.h"
 #include "itkVector.h"
 #include "itkTimeProbesCollectorBase.h"
+#include "itkMatrix.h"
+#include "itkMultiThreader.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -85,6 +90,10 @@ public:
   typedef typename DestinationPointContainerType::Pointer       DestinationPointContainerPointer;
   typedef typename DestinationPointContainerType::Iterator      DestinationPointIterator;
   typedef typename DestinationPointContainerType::ConstIterator DestinationPointConstIterator;
+  typedef VectorContainer<PointIdentifier, PointType>           DestinationPointArrayType;
+  typedef typename DestinationPointArrayType::Pointer           DestinationPointArrayPointer;
+  typedef typename DestinationPointArrayType::Iterator          DestinationPointArrayIterator;
+  typedef typename DestinationPointArrayType::ConstIterator     DestinationPointArrayConstIterator;
   typedef VectorContainer<PointIdentifier, double>              NodeSigmaContainerType;
   typedef typename NodeSigmaContainerType::Pointer              NodeSigmaContainerPointer;
   typedef typename NodeSigmaContainerType::Iterator             NodeSigmaContainerIterator;
@@ -324,6 +333,8 @@ private:
 
   void ComputeShortestEdgeLength();
 
+  void ComputeNeighborhoodTable();
+
   double ComputeLargestVelocityMagnitude() const;
 
   void ComputeLargestVelocityMagnitudeToShortestEdgeLengthRatio();
@@ -340,12 +351,57 @@ private:
 
   void SwapOldAndNewTangetFieldContainers();
 
-  void ParalelTransport(const PointType sourcePoint, const PointType destinationPoint,
-                        const TangentVectorType & inputVector, TangentVectorType & transportedVector ) const;
+  /** Rotation matrix of the parallel transport of tangent vectors from
+   * sourcePoint to destinationPoint along the great circle joining them. */
+  typedef Matrix<double, 3, 3> TransportMatrixType;
+
+  TransportMatrixType ComputeParalelTransportMatrix( const PointType & sourcePoint,
+                                                    const PointType & destinationPoint ) const;
+
+  /** Steps of the iterations that are run over blocks of nodes, one block
+   * per thread. */
+  enum ThreadedStepType
+    {
+    MappedMovingValueStep,
+    InitialDisplacementFieldStep,
+    SquaringStep,
+    ComposeUpdateStep,
+    ConvertDeformationToTangentStep,
+    SmoothTangentStep,
+    ConvertTangentToDeformationStep
+    };
+
+  struct ThreadStruct
+    {
+    Self *              Filter;
+    ThreadedStepType    Step;
+    bool                ExceptionCaught;
+    ExceptionObject     Exception;
+    SimpleFastMutexLock ExceptionLock;
+    };
+
+  /** Run one of the steps over all the nodes with the filter threads. */
+  void ThreadedExecute( ThreadedStepType step );
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback( void *arg );
+
+  void ThreadedComputeMappedMovingValues( PointIdentifier first, PointIdentifier last );
+
+  void ThreadedComputeInitialDisplacementField( PointIdentifier first, PointIdentifier last );
+
+  void ThreadedSquareDisplacementField( PointIdentifier first, PointIdentifier last );
+
+  void ThreadedComposeDeformationUpdate( PointIdentifier first, PointIdentifier last );
+
+  void ThreadedConvertDeformationFieldToTangentVectorField( PointIdentifier first, PointIdentifier last );
+
+  void ThreadedSmoothTangentVectorField( PointIdentifier first, PointIdentifier last );
+
+  void ThreadedConvertTangentVectorFieldToDeformationField( PointIdentifier first, PointIdentifier last );
 
   void PrintOutDeformationVectors( std::ostream & os = std::cout );
 
-  virtual PointType InterpolateDestinationFieldAtPoint(const DestinationPointContainerType * destinationField,
+  virtual PointType InterpolateDestinationFieldAtPoint(const DestinationPointArrayType * destinationField,
                                                        const PointType & point );
 
   virtual void ProjectPointToSphereSurface( PointType & point ) const;
@@ -361,14 +417,18 @@ private:
   /** Array containing the destination coordinates of every node in the Fixed
    * Mesh.  This array represents both the deformation field c(xn) and its
    * smoothed version, the field s(xn) as defined in.  */
-  DestinationPointContainerPointer m_DestinationPoints;
-  DestinationPointContainerPointer m_DestinationPointsSwap;
-  bool                             m_UserProvidedInitialDestinationPoints;
+  DestinationPointArrayPointer m_DestinationPoints;
+  DestinationPointArrayPointer m_DestinationPointsSwap;
+  bool                         m_UserProvidedInitialDestinationPoints;
+
+  /** Copy of the destination points in the container type of the
+   * DestinationPointSet output. */
+  DestinationPointContainerPointer m_OutputDestinationPoints;
 
   /** Auxiliary array for computing the Exponential of the velocity field
    * via the Scaling and Squaring method.  */
-  DestinationPointContainerPointer m_DisplacementField;
-  DestinationPointContainerPointer m_DisplacementFieldSwap;
+  DestinationPointArrayPointer m_DisplacementField;
+  DestinationPointArrayPointer m_DisplacementFieldSwap;
 
   /** Maximum number of iterations that the filter will be allowed to run. */
   unsigned int m_MaximumNumberOfIterations;
@@ -406,7 +466,8 @@ private:
   typename ScalarInterpolatorType::Pointer                      m_ScalarInterpolator;
 
   /** Interpolator for the deformation field values on the grid of the Fixed mesh. */
-  typedef LinearInterpolateDeformationFieldMeshFunction<FixedMeshType> DeformationInterpolatorType;
+  typedef LinearInterpolateDeformationFieldMeshFunction<
+      FixedMeshType, DestinationPointArrayType>                 DeformationInterpolatorType;
 
   /** Interpolator object that will compute deformation destination points on the fixed mesh grid. */
   typename DeformationInterpolatorType::Pointer                 m_DeformationInterpolator;
@@ -422,7 +483,7 @@ private:
    * at every node of the Fixed mesh with respect to the coordinate system
    * of that node in the fixed mesh. */
   typedef NodeVectorJacobianCalculator<
-      FixedMeshType, DestinationPointContainerType>              NodeVectorJacobianCalculatorType;
+      FixedMeshType, DestinationPointArrayType>                  NodeVectorJacobianCalculatorType;
   typename NodeVectorJacobianCalculatorType::Pointer            m_NodeVectorJacobianCalculator;
 
   /** Center of spherical mesh. We assume that both the Fixed and
@@ -496,6 +557,19 @@ private:
 
   /** Container of lengths corresponding to the shortest edge of every node. */
   ShortestLengthContainerPointer m_ShortestEdgeLengthPerPoint;
+
+  /** Neighbors of every node of the fixed mesh in compressed sparse row
+   * form: the neighbors of node i are m_NeighborIds[k] for k in
+   * [ m_NeighborOffsets[i], m_NeighborOffsets[i+1] ), and m_NeighborTransports[k]
+   * is the parallel transport from that neighbor to node i. The table, the
+   * node coordinates and their unit radial directions are computed once per
+   * call to Update(), since the fixed mesh does not move during the
+   * iterations. */
+  std::vector<unsigned long>       m_NeighborOffsets;
+  std::vector<PointIdentifier>     m_NeighborIds;
+  std::vector<TransportMatrixType> m_NeighborTransports;
+  std::vector<PointType>           m_NodePoints;
+  std::vector<VectorType>          m_NodeRadialDirections;
 };
 }
 
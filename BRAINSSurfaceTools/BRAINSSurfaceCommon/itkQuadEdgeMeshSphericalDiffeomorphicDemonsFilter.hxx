@@ -40,8 +40,8 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputM
   this->SetNthOutput( 2, DestinationPointSetType::New() );
 
   this->m_BasisSystemAtNode = BasisSystemContainerType::New();
-  this->m_DestinationPoints = DestinationPointContainerType::New();
-  this->m_DestinationPointsSwap = DestinationPointContainerType::New();
+  this->m_DestinationPoints = DestinationPointArrayType::New();
+  this->m_DestinationPointsSwap = DestinationPointArrayType::New();
   this->m_UserProvidedInitialDestinationPoints = false;
 
   this->m_TriangleListBasisSystemCalculator = TriangleListBasisSystemCalculatorType::New();
@@ -231,13 +231,13 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputM
   FixedPointsContainer * fixedPoints = this->m_FixedMeshAtInitialDestinationPoints->GetPoints();
   FixedPointsIterator    fixedPointItr = fixedPoints->Begin();
 
-  this->m_DestinationPoints = DestinationPointContainerType::New();
+  this->m_DestinationPoints = DestinationPointArrayType::New();
   this->m_DestinationPoints->Reserve( destinationPoints->Size() );
 
   DestinationPointConstIterator srcPointItr = destinationPoints->Begin();
 
-  DestinationPointIterator dstPointItr = this->m_DestinationPoints->Begin();
-  DestinationPointIterator dstPointEnd = this->m_DestinationPoints->End();
+  DestinationPointArrayIterator dstPointItr = this->m_DestinationPoints->Begin();
+  DestinationPointArrayIterator dstPointEnd = this->m_DestinationPoints->End();
 
   PointType point;
   while( dstPointItr != dstPointEnd )
@@ -267,6 +267,7 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputM
   this->ComputeInitialArrayOfDestinationPoints();
   this->InitializeFixedNodesSigmas();
   this->ComputeBasisSystemAtEveryNode();
+  this->ComputeNeighborhoodTable();
   this->ComputeShortestEdgeLength();
   this->ComposeDestinationPointsOutputPointSet();
   this->InitializeInterpolators();
@@ -300,6 +301,29 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputM
 {
   const PointIdentifier numberOfNodes = this->m_FixedMesh->GetNumberOfPoints();
 
+  //
+  // The internal arrays and the neighborhood table are indexed directly by
+  // point identifier, which requires the identifiers to run from 0 to N-1.
+  //
+  const FixedPointsContainer * points = this->m_FixedMesh->GetPoints();
+
+  FixedPointsConstIterator pointItr = points->Begin();
+  FixedPointsConstIterator pointEnd = points->End();
+
+  PointIdentifier expectedPointId = 0;
+
+  while( pointItr != pointEnd )
+    {
+    if( pointItr.Index() != expectedPointId )
+      {
+      itkExceptionMacro("The point identifiers of the fixed mesh must run contiguously from 0 to "
+                        << numberOfNodes - 1 << ", found point " << pointItr.Index()
+                        << " where " << expectedPointId << " was expected." );
+      }
+    ++expectedPointId;
+    ++pointItr;
+    }
+
   //
   // create new containers and allocate memory for them, in case the filter has
   // been run previously with a mesh having a larger number of nodes than the
@@ -311,17 +335,20 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputM
 
   if( !this->m_UserProvidedInitialDestinationPoints )
     {
-    this->m_DestinationPoints = DestinationPointContainerType::New();
+    this->m_DestinationPoints = DestinationPointArrayType::New();
     this->m_DestinationPoints->Reserve( numberOfNodes );
     }
 
-  this->m_DestinationPointsSwap = DestinationPointContainerType::New();
+  this->m_DestinationPointsSwap = DestinationPointArrayType::New();
   this->m_DestinationPointsSwap->Reserve( numberOfNodes );
 
-  this->m_DisplacementField = DestinationPointContainerType::New();
+  this->m_OutputDestinationPoints = DestinationPointContainerType::New();
+  this->m_OutputDestinationPoints->Reserve( numberOfNodes );
+
+  this->m_DisplacementField = DestinationPointArrayType::New();
   this->m_DisplacementField->Reserve( numberOfNodes );
 
-  this->m_DisplacementFieldSwap = DestinationPointContainerType::New();
+  this->m_DisplacementFieldSwap = DestinationPointArrayType::New();
   this->m_DisplacementFieldSwap->Reserve( numberOfNodes );
 
   this->m_ResampledMovingValuesContainer = ResampledMovingValuesContainerType::New();
@@ -436,8 +463,8 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
 
   FixedPointsConstIterator srcPointItr = points->Begin();
 
-  DestinationPointIterator dstPointItr = this->m_DestinationPoints->Begin();
-  DestinationPointIterator dstPointEnd = this->m_DestinationPoints->End();
+  DestinationPointArrayIterator dstPointItr = this->m_DestinationPoints->Begin();
+  DestinationPointArrayIterator dstPointEnd = this->m_DestinationPoints->End();
 
   while( dstPointItr != dstPointEnd )
     {
@@ -455,8 +482,8 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputM
   this->m_ScalarInterpolator->Initialize();
 
   this->m_DeformationInterpolator->SetInputMesh( this->m_FixedMeshAtInitialDestinationPoints );
-  this->m_DeformationInterpolator->Initialize();
   this->m_DeformationInterpolator->SetSphereCenter( this->m_SphereCenter );
+  this->m_DeformationInterpolator->Initialize();
 }
 
 template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
@@ -582,17 +609,23 @@ void
 QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
                                                TOutputMesh>::ComputeMappedMovingValueAtEveryNode()
 {
-  DestinationPointIterator pointItr = this->m_DestinationPoints->Begin();
-  DestinationPointIterator pointEnd = this->m_DestinationPoints->End();
+  this->ThreadedExecute( MappedMovingValueStep );
+}
 
-  ResampledMovingValuesContainerIterator resampledArrayItr = this->m_ResampledMovingValuesContainer->Begin();
+template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
+void
+QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
+                                               TOutputMesh>::ThreadedComputeMappedMovingValues(
+  PointIdentifier first, PointIdentifier last )
+{
+  const DestinationPointArrayType * destinationPoints = this->m_DestinationPoints;
 
-  while( pointItr != pointEnd )
-    {
-    resampledArrayItr.Value() = this->m_ScalarInterpolator->Evaluate( pointItr.Value() );
+  ResampledMovingValuesContainerType * resampledValues = this->m_ResampledMovingValuesContainer;
 
-    ++pointItr;
-    ++resampledArrayItr;
+  for( PointIdentifier pointId = first; pointId < last; pointId++ )
+    {
+    resampledValues->ElementAt( pointId ) =
+      this->m_ScalarInterpolator->Evaluate( destinationPoints->ElementAt( pointId ) );
     }
 }
 
@@ -824,38 +857,83 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
 
 template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
 void
-QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputMesh>::ComputeShortestEdgeLength()
+QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputMesh>::ComputeNeighborhoodTable()
 {
-  double shortestLength = NumericTraits<double>::max();
-
-  typedef typename FixedMeshType::QEPrimal EdgeType;
+  const PointIdentifier numberOfNodes = this->m_FixedMeshAtInitialDestinationPoints->GetNumberOfPoints();
 
   const FixedPointsContainer * points = this->m_FixedMeshAtInitialDestinationPoints->GetPoints();
 
-  FixedPointsConstIterator pointItr = points->Begin();
-  FixedPointsConstIterator pointEnd = points->End();
-
-  ShortestLengthContainerIterator shortestEdgeItr = this->m_ShortestEdgeLengthPerPoint->Begin();
+  this->m_NodePoints.resize( numberOfNodes );
+  this->m_NodeRadialDirections.resize( numberOfNodes );
 
-  while( pointItr != pointEnd )
+  for( PointIdentifier pointId = 0; pointId < numberOfNodes; pointId++ )
     {
-    EdgeType * edge1 = this->m_FixedMeshAtInitialDestinationPoints->FindEdge( pointItr.Index() );
+    this->m_NodePoints[pointId] = points->GetElement( pointId );
 
-    EdgeType * temp1 = ITK_NULLPTR;
-    EdgeType * temp2 = edge1;
+    VectorType vectorToCenter = this->m_NodePoints[pointId] - this->m_SphereCenter;
+    vectorToCenter.Normalize();
 
-    const PointType & point = pointItr.Value();
+    this->m_NodeRadialDirections[pointId] = vectorToCenter;
+    }
 
-    double localShortestLength = NumericTraits<double>::max();
+  //
+  // Every edge is visited once from each one of its end points.
+  //
+  const unsigned long numberOfNeighbors = 2 * this->m_FixedMeshAtInitialDestinationPoints->GetNumberOfEdges();
+
+  this->m_NeighborOffsets.assign( numberOfNodes + 1, 0 );
+
+  this->m_NeighborIds.clear();
+  this->m_NeighborIds.reserve( numberOfNeighbors );
+
+  this->m_NeighborTransports.clear();
+  this->m_NeighborTransports.reserve( numberOfNeighbors );
+
+  typedef typename FixedMeshType::QEPrimal EdgeType;
+  for( PointIdentifier pointId = 0; pointId < numberOfNodes; pointId++ )
+    {
+    const EdgeType * edgeToFirstNeighborPoint = this->m_FixedMeshAtInitialDestinationPoints->FindEdge( pointId );
+
+    if( !edgeToFirstNeighborPoint )
+      {
+      itkExceptionMacro("FindEdge() returned NULL for pointId " << pointId );
+      }
+
+    const EdgeType * edgeToNeighborPoint = edgeToFirstNeighborPoint;
 
     do
       {
-      temp1 = temp2;
-      temp2 = temp1->GetOnext();
+      const PointIdentifier neighborPointId = edgeToNeighborPoint->GetDestination();
+
+      this->m_NeighborIds.push_back( neighborPointId );
+      this->m_NeighborTransports.push_back(
+        this->ComputeParalelTransportMatrix( this->m_NodePoints[neighborPointId], this->m_NodePoints[pointId] ) );
+
+      edgeToNeighborPoint = edgeToNeighborPoint->GetOnext();
+      }
+    while( edgeToNeighborPoint != edgeToFirstNeighborPoint );
+
+    this->m_NeighborOffsets[pointId + 1] = this->m_NeighborIds.size();
+    }
+}
 
-      const PointIdentifier neighborPointId = temp1->GetDestination();
+template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
+void
+QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputMesh>::ComputeShortestEdgeLength()
+{
+  double shortestLength = NumericTraits<double>::max();
 
-      const PointType & neighborPoint = points->GetElement( neighborPointId );
+  const PointIdentifier numberOfNodes = this->m_NodePoints.size();
+
+  for( PointIdentifier pointId = 0; pointId < numberOfNodes; pointId++ )
+    {
+    const PointType & point = this->m_NodePoints[pointId];
+
+    double localShortestLength = NumericTraits<double>::max();
+
+    for( unsigned long k = this->m_NeighborOffsets[pointId]; k < this->m_NeighborOffsets[pointId + 1]; k++ )
+      {
+      const PointType & neighborPoint = this->m_NodePoints[this->m_NeighborIds[k]];
 
       const double distance = point.EuclideanDistanceTo( neighborPoint );
 
@@ -864,17 +942,13 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputM
         localShortestLength = distance;
         }
       }
-    while( temp2 != edge1 );
 
-    shortestEdgeItr.Value() = localShortestLength;
+    this->m_ShortestEdgeLengthPerPoint->ElementAt( pointId ) = localShortestLength;
 
     if( localShortestLength < shortestLength )
       {
       shortestLength = localShortestLength;
       }
-
-    ++pointItr;
-    ++shortestEdgeItr;
     }
 
   this->m_ShortestEdgeLength = shortestLength;
@@ -915,6 +989,21 @@ template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
 void
 QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
                                                TOutputMesh>::ComputeDeformationByScalingAndSquaring()
+{
+  this->ThreadedExecute( InitialDisplacementFieldStep );
+
+  for( unsigned int i = 0; i < this->m_ScalingAndSquaringNumberOfIterations; i++ )
+    {
+    this->ThreadedExecute( SquaringStep );
+    this->SwapOldAndNewDisplacementFieldContainers();
+    }
+}
+
+template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
+void
+QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
+                                               TOutputMesh>::ThreadedComputeInitialDisplacementField(
+  PointIdentifier first, PointIdentifier last )
 {
   unsigned long powerOfTwo = 1;
 
@@ -922,51 +1011,42 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
 
   const double scalingFactor = 1.0 / powerOfTwo;
 
-  DestinationPointIterator displacementItr = this->m_DisplacementField->Begin();
-  DestinationPointIterator displacementEnd = this->m_DisplacementField->End();
-
-  VelocityVectorConstIterator velocityItr = this->m_VelocityField->Begin();
-
-  const FixedPointsContainer * points = this->m_FixedMeshAtInitialDestinationPoints->GetPoints();
+  const VelocityVectorContainer * velocityField = this->m_VelocityField;
 
-  FixedPointsConstIterator pointItr = points->Begin();
+  DestinationPointArrayType * displacementField = this->m_DisplacementField;
 
   PointType destinationPoint;
 
-  while( displacementItr != displacementEnd )
+  for( PointIdentifier pointId = first; pointId < last; pointId++ )
     {
-    destinationPoint = pointItr.Value() +  velocityItr.Value() * scalingFactor;
+    destinationPoint = this->m_NodePoints[pointId] + velocityField->ElementAt( pointId ) * scalingFactor;
 
     this->ProjectPointToSphereSurface( destinationPoint );
 
-    displacementItr.Value() = destinationPoint;
-
-    ++displacementItr;
-    ++pointItr;
-    ++velocityItr;
+    displacementField->ElementAt( pointId ) = destinationPoint;
     }
-  for( unsigned int i = 0; i < this->m_ScalingAndSquaringNumberOfIterations; i++ )
-    {
-    DestinationPointConstIterator oldDisplacementItr = this->m_DisplacementField->Begin();
-    DestinationPointConstIterator oldDisplacementEnd = this->m_DisplacementField->End();
+}
 
-    DestinationPointIterator newDisplacementItr = this->m_DisplacementFieldSwap->Begin();
+template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
+void
+QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
+                                               TOutputMesh>::ThreadedSquareDisplacementField(
+  PointIdentifier first, PointIdentifier last )
+{
+  const DestinationPointArrayType * oldDisplacementField = this->m_DisplacementField;
 
-    while( oldDisplacementItr != oldDisplacementEnd )
-      {
-      destinationPoint = oldDisplacementItr.Value();
+  DestinationPointArrayType * newDisplacementField = this->m_DisplacementFieldSwap;
 
-      this->ProjectPointToSphereSurface( destinationPoint );
+  PointType destinationPoint;
 
-      newDisplacementItr.Value() =
-        this->InterpolateDestinationFieldAtPoint(
-          this->m_DisplacementField, destinationPoint );
+  for( PointIdentifier pointId = first; pointId < last; pointId++ )
+    {
+    destinationPoint = oldDisplacementField->ElementAt( pointId );
 
-      ++newDisplacementItr;
-      ++oldDisplacementItr;
-      }
+    this->ProjectPointToSphereSurface( destinationPoint );
 
-    this->SwapOldAndNewDisplacementFieldContainers();
+    newDisplacementField->ElementAt( pointId ) =
+      this->InterpolateDestinationFieldAtPoint( oldDisplacementField, destinationPoint );
     }
 }
 
@@ -995,14 +1075,24 @@ void
 QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
                                                TOutputMesh>::ComposeDeformationUpdateWithPreviousDeformation()
 {
-  DestinationPointConstIterator displacementItr = this->m_DisplacementField->Begin();
-  DestinationPointConstIterator displacementEnd = this->m_DisplacementField->End();
+  this->ThreadedExecute( ComposeUpdateStep );
 
-  DestinationPointIterator newDestinationPointItr = this->m_DestinationPointsSwap->Begin();
+  this->SwapOldAndNewDestinationPointContainers();
+}
+
+template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
+void
+QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
+                                               TOutputMesh>::ThreadedComposeDeformationUpdate(
+  PointIdentifier first, PointIdentifier last )
+{
+  const DestinationPointArrayType * displacementField = this->m_DisplacementField;
 
-  while( displacementItr != displacementEnd )
+  DestinationPointArrayType * newDestinationPoints = this->m_DestinationPointsSwap;
+
+  for( PointIdentifier pointId = first; pointId < last; pointId++ )
     {
-    PointType point = displacementItr.Value();
+    PointType point = displacementField->ElementAt( pointId );
 
     this->ProjectPointToSphereSurface( point );
 
@@ -1011,20 +1101,15 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
 
     this->ProjectPointToSphereSurface( destinationPoint );
 
-    newDestinationPointItr.Value() = destinationPoint;
-
-    ++newDestinationPointItr;
-    ++displacementItr;
+    newDestinationPoints->ElementAt( pointId ) = destinationPoint;
     }
-
-  this->SwapOldAndNewDestinationPointContainers();
 }
 
 template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
 typename QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputMesh>::PointType
 QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
                                                TOutputMesh>::InterpolateDestinationFieldAtPoint(
-  const DestinationPointContainerType * destinationField,
+  const DestinationPointArrayType * destinationField,
   const PointType & point )
 {
   PointType interpolatedDestinationPoint;
@@ -1059,7 +1144,7 @@ void
 QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
                                                TOutputMesh>::SwapOldAndNewDisplacementFieldContainers()
 {
-  DestinationPointContainerPointer temp = this->m_DisplacementField;
+  DestinationPointArrayPointer temp = this->m_DisplacementField;
 
   this->m_DisplacementField = this->m_DisplacementFieldSwap;
   this->m_DisplacementFieldSwap = temp;
@@ -1070,7 +1155,7 @@ void
 QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
                                                TOutputMesh>::SwapOldAndNewDestinationPointContainers()
 {
-  DestinationPointContainerPointer temp = this->m_DestinationPoints;
+  DestinationPointArrayPointer temp = this->m_DestinationPoints;
 
   this->m_DestinationPoints = this->m_DestinationPointsSwap;
   this->m_DestinationPointsSwap = temp;
@@ -1101,32 +1186,31 @@ void
 QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
                                                TOutputMesh>::ConvertDeformationFieldToTangentVectorField()
 {
-  DestinationPointIterator dstPointItr = this->m_DestinationPoints->Begin();
-  DestinationPointIterator dstPointEnd = this->m_DestinationPoints->End();
-
-  const FixedPointsContainer * points = this->m_FixedMeshAtInitialDestinationPoints->GetPoints();
+  this->ThreadedExecute( ConvertDeformationToTangentStep );
+}
 
-  FixedPointsConstIterator pointItr = points->Begin();
+template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
+void
+QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
+                                               TOutputMesh>::ThreadedConvertDeformationFieldToTangentVectorField(
+  PointIdentifier first, PointIdentifier last )
+{
+  const DestinationPointArrayType * destinationPoints = this->m_DestinationPoints;
 
-  TangentVectorIterator tangentItr = this->m_TangentVectorField->Begin();
+  TangentVectorContainer * tangentField = this->m_TangentVectorField;
 
   const double factor = -1.0 / this->m_SphereRadius;
 
-  while( dstPointItr != dstPointEnd )
+  for( PointIdentifier pointId = first; pointId < last; pointId++ )
     {
-    VectorType vectorToCenter = pointItr.Value() - this->m_SphereCenter;
+    const VectorType & vectorToCenter = this->m_NodeRadialDirections[pointId];
 
-    vectorToCenter.Normalize();
+    TangentVectorType & tangent = tangentField->ElementAt( pointId );
 
-    tangentItr.Value() =
-      CrossProduct( vectorToCenter,
-                    CrossProduct( vectorToCenter, dstPointItr.Value().GetVectorFromOrigin() ) );
+    tangent = CrossProduct( vectorToCenter,
+                            CrossProduct( vectorToCenter, destinationPoints->ElementAt( pointId ).GetVectorFromOrigin() ) );
 
-    tangentItr.Value() *= factor;
-
-    ++dstPointItr;
-    ++tangentItr;
-    ++pointItr;
+    tangent *= factor;
     }
 }
 
@@ -1134,85 +1218,66 @@ template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
 void
 QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputMesh>::SmoothTangentVectorField()
 {
-  const double weightFactor = vcl_exp( -1.0 / ( 2.0 * this->m_Lambda ) );
-
-  const FixedPointsContainer * points = this->m_FixedMeshAtInitialDestinationPoints->GetPoints();
-
-  TangentVectorType smoothedVector;
-  TangentVectorType transportedTangentVector;
-
   for( unsigned int iter = 0; iter < this->m_MaximumNumberOfSmoothingIterations; ++iter )
     {
-    typedef typename OutputMeshType::QEPrimal EdgeType;
+    this->ThreadedExecute( SmoothTangentStep );
+    this->SwapOldAndNewTangetFieldContainers();
+    }
+}
+
+template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
+void
+QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
+                                               TOutputMesh>::ThreadedSmoothTangentVectorField(
+  PointIdentifier first, PointIdentifier last )
+{
+  const double weightFactor = vcl_exp( -1.0 / ( 2.0 * this->m_Lambda ) );
 
-    TangentVectorIterator tangentItr = this->m_TangentVectorField->Begin();
-    TangentVectorIterator tangentEnd = this->m_TangentVectorField->End();
+  const TangentVectorContainer * tangentField = this->m_TangentVectorField;
 
-    TangentVectorIterator smoothedTangentItr = this->m_TangentVectorFieldSwap->Begin();
+  TangentVectorContainer * smoothedTangentField = this->m_TangentVectorFieldSwap;
 
-    FixedPointsConstIterator pointItr = points->Begin();
+  typedef typename NumericTraits<TangentVectorType>::AccumulateType AccumulatePixelType;
 
-    typedef typename NumericTraits<TangentVectorType>::AccumulateType AccumulatePixelType;
+  for( PointIdentifier pointId = first; pointId < last; pointId++ )
+    {
+    const TangentVectorType & centralTangentVector = tangentField->ElementAt( pointId );
 
-    while( tangentItr != tangentEnd )
+    AccumulatePixelType tangentVectorSum;
+    for( unsigned int k = 0; k < PointDimension; k++ )
       {
-      const TangentVectorType & centralTangentVector = tangentItr.Value();
+      tangentVectorSum[k] = centralTangentVector[k];
+      }
 
-      const EdgeType * edgeToFirstNeighborPoint =
-        this->m_FixedMeshAtInitialDestinationPoints->FindEdge( tangentItr.Index() );
-      const EdgeType * edgeToNeighborPoint = edgeToFirstNeighborPoint;
+    const unsigned long firstNeighbor = this->m_NeighborOffsets[pointId];
+    const unsigned long lastNeighbor = this->m_NeighborOffsets[pointId + 1];
 
-      AccumulatePixelType tangentVectorSum;
+    for( unsigned long n = firstNeighbor; n < lastNeighbor; n++ )
+      {
+      const TangentVectorType transportedTangentVector =
+        this->m_NeighborTransports[n] * tangentField->ElementAt( this->m_NeighborIds[n] );
       for( unsigned int k = 0; k < PointDimension; k++ )
         {
-        tangentVectorSum[k] = centralTangentVector[k];
+        tangentVectorSum[k] += weightFactor * transportedTangentVector[k];
         }
+      }
 
-      unsigned int numberOfNeighbors = 0;
-
-      do
-        {
-        const PointIdentifier     neighborPointId = edgeToNeighborPoint->GetDestination();
-        const PointType &         neighborPoint = points->GetElement( neighborPointId );
-        const TangentVectorType & neighborTangentVector =
-          this->m_TangentVectorField->GetElement( neighborPointId );
-
-        this->ParalelTransport( neighborPoint, pointItr.Value(),
-                                neighborTangentVector, transportedTangentVector );
-        for( unsigned int k = 0; k < PointDimension; k++ )
-          {
-          tangentVectorSum[k] += weightFactor * transportedTangentVector[k];
-          }
-
-        numberOfNeighbors++;
-
-        edgeToNeighborPoint = edgeToNeighborPoint->GetOnext();
-        }
-      while( edgeToNeighborPoint != edgeToFirstNeighborPoint );
-
-      const double normalizationFactor = 1.0 / ( 1.0 + numberOfNeighbors * weightFactor );
-      for( unsigned int k = 0; k < PointDimension; k++ )
-        {
-        smoothedVector[k] = tangentVectorSum[k] * normalizationFactor;
-        }
+    const unsigned long numberOfNeighbors = lastNeighbor - firstNeighbor;
 
-      smoothedTangentItr.Value() = smoothedVector;
+    const double normalizationFactor = 1.0 / ( 1.0 + numberOfNeighbors * weightFactor );
 
-      ++tangentItr;
-      ++smoothedTangentItr;
-      ++pointItr;
+    TangentVectorType & smoothedVector = smoothedTangentField->ElementAt( pointId );
+    for( unsigned int k = 0; k < PointDimension; k++ )
+      {
+      smoothedVector[k] = tangentVectorSum[k] * normalizationFactor;
       }
-
-    this->SwapOldAndNewTangetFieldContainers();
     }
 }
 
 template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
-void
-QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputMesh>::ParalelTransport(
-  const PointType sourcePoint, const PointType destinationPoint,
-  const TangentVectorType & inputVector,
-  TangentVectorType & transportedVector ) const
+typename QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputMesh>::TransportMatrixType
+QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputMesh>::ComputeParalelTransportMatrix(
+  const PointType & sourcePoint, const PointType & destinationPoint ) const
 {
   VectorType vsrc = sourcePoint - this->m_SphereCenter;
   VectorType vdst = destinationPoint - this->m_SphereCenter;
@@ -1229,7 +1294,7 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputM
   VersorType versor;
   versor.Set( axis, angle );
 
-  transportedVector = versor.Transform( inputVector );
+  return versor.GetMatrix();
 }
 
 template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
@@ -1237,27 +1302,28 @@ void
 QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
                                                TOutputMesh>::ConvertTangentVectorFieldToDeformationField()
 {
-  TangentVectorIterator tangentItr = this->m_TangentVectorField->Begin();
-  TangentVectorIterator tangentEnd = this->m_TangentVectorField->End();
-
-  DestinationPointIterator dstPointItr = this->m_DestinationPoints->Begin();
+  this->ThreadedExecute( ConvertTangentToDeformationStep );
+}
 
-  const FixedPointsContainer * points = this->m_FixedMeshAtInitialDestinationPoints->GetPoints();
+template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
+void
+QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
+                                               TOutputMesh>::ThreadedConvertTangentVectorFieldToDeformationField(
+  PointIdentifier first, PointIdentifier last )
+{
+  const TangentVectorContainer * tangentField = this->m_TangentVectorField;
 
-  FixedPointsConstIterator pointItr = points->Begin();
+  DestinationPointArrayType * destinationPoints = this->m_DestinationPoints;
 
   typedef Versor<double> VersorType;
   VersorType versor;
 
   const double normEpsilon = itk::NumericTraits<double>::min();
 
-  while( tangentItr != tangentEnd )
+  for( PointIdentifier pointId = first; pointId < last; pointId++ )
     {
-    VectorType vectorToCenter = pointItr.Value() - this->m_SphereCenter;
-
-    vectorToCenter.Normalize();
-
-    const VectorType & tangent = tangentItr.Value();
+    const PointType &  point = this->m_NodePoints[pointId];
+    const VectorType & tangent = tangentField->ElementAt( pointId );
 
     const double sinTheta = tangent.GetNorm();
 
@@ -1265,20 +1331,16 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
       {
       const double theta = vcl_asin( sinTheta );
 
-      const VectorType axis = CrossProduct( vectorToCenter, tangent );
+      const VectorType axis = CrossProduct( this->m_NodeRadialDirections[pointId], tangent );
 
       versor.Set( axis, theta );
 
-      dstPointItr.Value() = versor.Transform( pointItr.Value() );
+      destinationPoints->ElementAt( pointId ) = versor.Transform( point );
       }
     else
       {
-      dstPointItr.Value() = pointItr.Value();
+      destinationPoints->ElementAt( pointId ) = point;
       }
-
-    ++dstPointItr;
-    ++tangentItr;
-    ++pointItr;
     }
 }
 
@@ -1347,8 +1409,8 @@ void
 QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
                                                TOutputMesh>::CopyDestinationPointsToDeformedFixedMesh()
 {
-  DestinationPointConstIterator srcPointItr = this->m_DestinationPoints->Begin();
-  DestinationPointConstIterator srcPointEnd = this->m_DestinationPoints->End();
+  DestinationPointArrayConstIterator srcPointItr = this->m_DestinationPoints->Begin();
+  DestinationPointArrayConstIterator srcPointEnd = this->m_DestinationPoints->End();
 
   FixedMeshType * deformedFixedMesh =
     dynamic_cast<FixedMeshType *>(this->ProcessObject::GetOutput(1) );
@@ -1378,7 +1440,19 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh,
     itkExceptionMacro("Problem found while composing the destination PointSet");
     }
 
-  destinationPointSet->SetPoints( this->m_DestinationPoints );
+  DestinationPointArrayConstIterator srcPointItr = this->m_DestinationPoints->Begin();
+  DestinationPointArrayConstIterator srcPointEnd = this->m_DestinationPoints->End();
+
+  DestinationPointIterator dstPointItr = this->m_OutputDestinationPoints->Begin();
+
+  while( srcPointItr != srcPointEnd )
+    {
+    dstPointItr.Value() = srcPointItr.Value();
+    ++dstPointItr;
+    ++srcPointItr;
+    }
+
+  destinationPointSet->SetPoints( this->m_OutputDestinationPoints );
 }
 
 template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
@@ -1388,8 +1462,8 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputM
 {
   os << std::endl;
   os << "Deformation Vectors at every node " <<  std::endl;
-  DestinationPointIterator dstPointItr = this->m_DestinationPoints->Begin();
-  DestinationPointIterator dstPointEnd = this->m_DestinationPoints->End();
+  DestinationPointArrayIterator dstPointItr = this->m_DestinationPoints->Begin();
+  DestinationPointArrayIterator dstPointEnd = this->m_DestinationPoints->End();
 
   const FixedPointsContainer * points = this->m_FixedMesh->GetPoints();
   FixedPointsConstIterator     srcPointItr = points->Begin();
@@ -1435,6 +1509,86 @@ QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputM
   this->m_LargestVelocityToEdgeLengthRatio = largestRatio;
 }
 
+template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
+void
+QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputMesh>::ThreadedExecute(
+  ThreadedStepType step )
+{
+  ThreadStruct str;
+  str.Filter = this;
+  str.Step = step;
+  str.ExceptionCaught = false;
+
+  this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+  this->GetMultiThreader()->SetSingleMethod( this->ThreaderCallback, &str );
+  this->GetMultiThreader()->SingleMethodExecute();
+
+  if( str.ExceptionCaught )
+    {
+    throw str.Exception;
+    }
+}
+
+template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
+ITK_THREAD_RETURN_TYPE
+QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputMesh>::ThreaderCallback( void *arg )
+{
+  const ThreadIdType threadId = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  const ThreadIdType threadCount = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+
+  ThreadStruct * str = (ThreadStruct *)( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+  Self * filter = str->Filter;
+
+  const PointIdentifier numberOfNodes = filter->m_NodePoints.size();
+  const PointIdentifier first = ( numberOfNodes * threadId ) / threadCount;
+  const PointIdentifier last = ( numberOfNodes * ( threadId + 1 ) ) / threadCount;
+
+  //
+  // Exceptions can not cross the thread boundary. The first one is kept and
+  // thrown again by ThreadedExecute() once all the threads are done.
+  //
+  try
+    {
+    switch( str->Step )
+      {
+      case MappedMovingValueStep:
+        filter->ThreadedComputeMappedMovingValues( first, last );
+        break;
+      case InitialDisplacementFieldStep:
+        filter->ThreadedComputeInitialDisplacementField( first, last );
+        break;
+      case SquaringStep:
+        filter->ThreadedSquareDisplacementField( first, last );
+        break;
+      case ComposeUpdateStep:
+        filter->ThreadedComposeDeformationUpdate( first, last );
+        break;
+      case ConvertDeformationToTangentStep:
+        filter->ThreadedConvertDeformationFieldToTangentVectorField( first, last );
+        break;
+      case SmoothTangentStep:
+        filter->ThreadedSmoothTangentVectorField( first, last );
+        break;
+      case ConvertTangentToDeformationStep:
+        filter->ThreadedConvertTangentVectorFieldToDeformationField( first, last );
+        break;
+      }
+    }
+  catch( ExceptionObject & excp )
+    {
+    str->ExceptionLock.Lock();
+    if( !str->ExceptionCaught )
+      {
+      str->ExceptionCaught = true;
+      str->Exception = excp;
+      }
+    str->ExceptionLock.Unlock();
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
 template <class TFixedMesh, class TMovingMesh, class TOutputMesh>
 void
 QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<TFixedMesh, TMovingMesh, TOutputMesh>::PrintSelf(std::ostream& os,
@@ -23,6 +23,8 @@
 #include "itkInterpolateMeshFunction.h"
 #include "itkTransform.h"
 
+#include <vector>
+
 namespace itk
 {
 /**
@@ -30,6 +32,9 @@ namespace itk
  * \brief This resamples the scalar values of one QuadEdgeMesh into another one
  * via a user-provided Transform and Interpolator.
  *
+ * The points of the reference mesh are split among threads, so the
+ * Transform and the Interpolator must support concurrent evaluation.
+ *
  * \ingroup MeshFilters
  *
  */
@@ -151,6 +156,17 @@ private:
 
   virtual void CopyReferenceMeshToOutputMeshCellData();
 
+  /** Points to evaluate and the output values they go to, shared by the
+   * threads of GenerateData(). */
+  struct ThreadStruct
+    {
+    Self *                                 Filter;
+    const std::vector<OutputPointType> *   Points;
+    const std::vector<OutputPixelType *> * Values;
+    };
+
+  static ITK_THREAD_RETURN_TYPE ThreaderCallback( void *arg );
+
   TransformPointerType    m_Transform;          // Coordinate transform to use
   InterpolatorPointerType m_Interpolator;       // Image function for
 };
@@ -85,8 +85,6 @@ ResampleQuadEdgeMeshFilter<TInputMesh, TOutputMesh>
 
   const unsigned int numberOfPoints = outputMesh->GetNumberOfPoints();
 
-  ProgressReporter progress(this, 0, numberOfPoints);
-
   OutputPointDataContainerPointer pointData = outputMesh->GetPointData();
 
   if( pointData.IsNull() )
@@ -110,25 +108,75 @@ ResampleQuadEdgeMeshFilter<TInputMesh, TOutputMesh>
   PointDataIterator pointDataItr = pointData->Begin();
   PointDataIterator pointDataEnd = pointData->End();
 
+  //
+  // Gather the points and the values to compute, then let the threads
+  // transform and interpolate them independently.
+  //
+  std::vector<OutputPointType>   pointsToEvaluate;
+  std::vector<OutputPixelType *> values;
+
+  pointsToEvaluate.reserve( numberOfPoints );
+  values.reserve( numberOfPoints );
+
+  while( pointItr != pointEnd && pointDataItr != pointDataEnd )
+    {
+    pointsToEvaluate.push_back( pointItr.Value() );
+    values.push_back( &( pointDataItr.Value() ) );
+
+    ++pointItr;
+    ++pointDataItr;
+    }
+
+  ThreadStruct str;
+  str.Filter = this;
+  str.Points = &pointsToEvaluate;
+  str.Values = &values;
+
+  this->GetMultiThreader()->SetNumberOfThreads( this->GetNumberOfThreads() );
+  this->GetMultiThreader()->SetSingleMethod( this->ThreaderCallback, &str );
+  this->GetMultiThreader()->SingleMethodExecute();
+}
+
+template <class TInputMesh, class TOutputMesh>
+ITK_THREAD_RETURN_TYPE
+ResampleQuadEdgeMeshFilter<TInputMesh, TOutputMesh>
+::ThreaderCallback( void *arg )
+{
+  const ThreadIdType threadId = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->ThreadID;
+  const ThreadIdType threadCount = ( (MultiThreader::ThreadInfoStruct *)( arg ) )->NumberOfThreads;
+
+  ThreadStruct * str = (ThreadStruct *)( ( (MultiThreader::ThreadInfoStruct *)( arg ) )->UserData );
+
+  const std::vector<OutputPointType> &   pointsToEvaluate = *( str->Points );
+  const std::vector<OutputPixelType *> & values = *( str->Values );
+
+  const size_t numberOfPoints = pointsToEvaluate.size();
+  const size_t first = ( numberOfPoints * threadId ) / threadCount;
+  const size_t last = ( numberOfPoints * ( threadId + 1 ) ) / threadCount;
+
+  const TransformType *    transform = str->Filter->m_Transform;
+  const InterpolatorType * interpolator = str->Filter->m_Interpolator;
+
+  ProgressReporter progress( str->Filter, threadId, last - first );
+
   typedef typename TransformType::OutputPointType MappedPointType;
 
   OutputPointType inputPoint;
   OutputPointType pointToEvaluate;
 
-  while( pointItr != pointEnd && pointDataItr != pointDataEnd )
+  for( size_t i = first; i < last; ++i )
     {
-    inputPoint.CastFrom( pointItr.Value() );
+    inputPoint.CastFrom( pointsToEvaluate[i] );
 
-    MappedPointType transformedPoint = this->m_Transform->TransformPoint( inputPoint );
+    MappedPointType transformedPoint = transform->TransformPoint( inputPoint );
 
     pointToEvaluate.CastFrom( transformedPoint );
-    pointDataItr.Value() = this->m_Interpolator->Evaluate( pointToEvaluate );
+    *( values[i] ) = interpolator->Evaluate( pointToEvaluate );
 
     progress.CompletedPixel();
-
-    ++pointItr;
-    ++pointDataItr;
     }
+
+  return ITK_THREAD_RETURN_VALUE;
 }
 
 // ---------------------------------------------------------------------
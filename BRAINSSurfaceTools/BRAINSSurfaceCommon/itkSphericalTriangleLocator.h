@@ -0,0 +1,130 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSphericalTriangleLocator_h
+#define __itkSphericalTriangleLocator_h
+
+#include "itkObject.h"
+#include "itkPoint.h"
+
+#include <vector>
+
+namespace itk
+{
+/** \class SphericalTriangleLocator
+ * \brief Accelerate the search of the triangle of a spherical mesh that
+ * contains a point.
+ *
+ * The triangles of the mesh are binned by their direction as seen from the
+ * sphere center. Directions are normalized and dropped into a regular grid
+ * covering [-1,1]^3, and each triangle is registered in every bin touched by
+ * the bounding box of its (normalized) vertexes, enlarged to cover the
+ * spherical cap over the flat triangle. A point can then only be contained,
+ * in the sense of the central projection used by
+ * LinearInterpolateMeshFunction, by the triangles of the bin of its own
+ * direction.
+ *
+ * The structure is built once by Initialize() and is read-only afterwards,
+ * so GetCandidateTriangles() can be called from several threads at once.
+ *
+ * \sa PointLocator2
+ */
+template <class TMesh>
+class SphericalTriangleLocator : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef SphericalTriangleLocator Self;
+  typedef Object                   Superclass;
+  typedef SmartPointer<Self>       Pointer;
+  typedef SmartPointer<const Self> ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Standard part of every itk Object. */
+  itkTypeMacro(SphericalTriangleLocator, Object);
+
+  typedef TMesh                              MeshType;
+  typedef typename MeshType::ConstPointer    MeshConstPointer;
+  typedef typename MeshType::CellType        CellType;
+  typedef typename MeshType::PointType       PointType;
+  typedef typename MeshType::PointIdentifier PointIdentifier;
+  typedef typename MeshType::CellsContainer  CellsContainer;
+  typedef typename MeshType::PointsContainer PointsContainer;
+  typedef typename PointType::VectorType     VectorType;
+
+  /** Index of a triangle in the list kept by the locator. */
+  typedef unsigned int TriangleIdentifier;
+
+  /** Set/Get the mesh whose triangles will be located. */
+  itkSetConstObjectMacro( Mesh, MeshType );
+  itkGetConstObjectMacro( Mesh, MeshType );
+
+  /** Set/Get the center of the sphere represented by the mesh. */
+  itkSetMacro( SphereCenter, PointType );
+  itkGetConstMacro( SphereCenter, PointType );
+
+  /** Build the bins. Must be called again when the mesh or the sphere center
+   * change. */
+  void Initialize();
+
+  /** Return the number of triangles that may contain the point, and make
+   * candidates point to their identifiers. */
+  unsigned int GetCandidateTriangles( const PointType & point, const TriangleIdentifier * & candidates ) const;
+
+  /** Return the three point identifiers of a triangle. */
+  const PointIdentifier * GetTrianglePointIds( TriangleIdentifier triangle ) const
+  {
+    return &( this->m_TrianglePointIds[3 * triangle] );
+  }
+
+  /** Number of triangles registered in the locator. */
+  TriangleIdentifier GetNumberOfTriangles() const
+  {
+    return static_cast<TriangleIdentifier>( this->m_TrianglePointIds.size() / 3 );
+  }
+
+protected:
+  SphericalTriangleLocator();
+  ~SphericalTriangleLocator();
+  virtual void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
+
+private:
+  SphericalTriangleLocator(const Self &); // purposely not implemented
+  void operator=(const Self &);           // purposely not implemented
+
+  /** Bin coordinate of a normalized direction component. */
+  unsigned int GetBinCoordinate( double value ) const;
+
+  MeshConstPointer m_Mesh;
+  PointType        m_SphereCenter;
+
+  unsigned int m_NumberOfBinsPerAxis;
+
+  std::vector<PointIdentifier>    m_TrianglePointIds;
+  std::vector<unsigned int>       m_BinOffsets;
+  std::vector<TriangleIdentifier> m_BinTriangles;
+};
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSphericalTriangleLocator.hxx"
+#endif
+
+#endif
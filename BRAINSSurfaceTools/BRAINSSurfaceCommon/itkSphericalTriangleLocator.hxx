@@ -0,0 +1,294 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSphericalTriangleLocator_hxx
+#define __itkSphericalTriangleLocator_hxx
+
+#include "itkSphericalTriangleLocator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+template <class TMesh>
+SphericalTriangleLocator<TMesh>
+::SphericalTriangleLocator()
+{
+  this->m_Mesh = ITK_NULLPTR;
+  this->m_SphereCenter.Fill( 0.0 );
+  this->m_NumberOfBinsPerAxis = 0;
+}
+
+template <class TMesh>
+SphericalTriangleLocator<TMesh>
+::~SphericalTriangleLocator()
+{
+}
+
+template <class TMesh>
+unsigned int
+SphericalTriangleLocator<TMesh>
+::GetBinCoordinate( double value ) const
+{
+  const double scaled = ( value + 1.0 ) * 0.5 * this->m_NumberOfBinsPerAxis;
+
+  if( !( scaled > 0.0 ) )
+    {
+    return 0;
+    }
+
+  const unsigned int coordinate = static_cast<unsigned int>( scaled );
+
+  return std::min( coordinate, this->m_NumberOfBinsPerAxis - 1 );
+}
+
+template <class TMesh>
+void
+SphericalTriangleLocator<TMesh>
+::Initialize()
+{
+  if( this->m_Mesh.IsNull() )
+    {
+    itkExceptionMacro(<< "SphericalTriangleLocator Initialize  m_Mesh is NULL.");
+    }
+
+  const PointsContainer * points = this->m_Mesh->GetPoints();
+  const CellsContainer *  cells = this->m_Mesh->GetCells();
+
+  this->m_TrianglePointIds.clear();
+  this->m_BinOffsets.clear();
+  this->m_BinTriangles.clear();
+  this->m_NumberOfBinsPerAxis = 0;
+
+  if( points == ITK_NULLPTR || cells == ITK_NULLPTR )
+    {
+    return;
+    }
+
+  //
+  // Collect the triangles, together with the directions of their vertexes
+  // as seen from the sphere center. Triangles with a vertex at the center
+  // can never contain a point and are left out.
+  //
+  std::vector<VectorType> directions;
+  double                  sumOfEdgeLengths = 0.0;
+
+  typename CellsContainer::ConstIterator cellIterator = cells->Begin();
+  typename CellsContainer::ConstIterator cellEnd = cells->End();
+
+  while( cellIterator != cellEnd )
+    {
+    const CellType * cell = cellIterator.Value();
+
+    if( cell->GetNumberOfPoints() == 3 )
+      {
+      const PointIdentifier * pointIds = cell->GetPointIds();
+
+      VectorType vertexDirections[3];
+      bool       degenerate = false;
+
+      for( unsigned int k = 0; k < 3; k++ )
+        {
+        vertexDirections[k] = points->GetElement( pointIds[k] ) - this->m_SphereCenter;
+
+        const double norm = vertexDirections[k].GetNorm();
+        if( norm > 0.0 )
+          {
+          vertexDirections[k] /= norm;
+          }
+        else
+          {
+          degenerate = true;
+          }
+        }
+
+      if( !degenerate )
+        {
+        for( unsigned int k = 0; k < 3; k++ )
+          {
+          this->m_TrianglePointIds.push_back( pointIds[k] );
+          directions.push_back( vertexDirections[k] );
+          }
+        sumOfEdgeLengths += ( vertexDirections[0] - vertexDirections[1] ).GetNorm();
+        }
+      }
+    ++cellIterator;
+    }
+
+  const TriangleIdentifier numberOfTriangles = this->GetNumberOfTriangles();
+
+  if( numberOfTriangles == 0 )
+    {
+    return;
+    }
+
+  //
+  // Bins about twice as wide as the average edge, so that a triangle touches
+  // a handful of bins and a bin holds a handful of triangles.
+  //
+  const double       averageEdgeLength = sumOfEdgeLengths / numberOfTriangles;
+  const unsigned int maximumNumberOfBinsPerAxis = 128;
+  const unsigned int minimumNumberOfBinsPerAxis = 4;
+
+  double numberOfBinsPerAxis = maximumNumberOfBinsPerAxis;
+  if( averageEdgeLength > 0.0 )
+    {
+    numberOfBinsPerAxis = std::ceil( 1.0 / averageEdgeLength );
+    }
+  numberOfBinsPerAxis = std::max( numberOfBinsPerAxis, static_cast<double>( minimumNumberOfBinsPerAxis ) );
+  numberOfBinsPerAxis = std::min( numberOfBinsPerAxis, static_cast<double>( maximumNumberOfBinsPerAxis ) );
+
+  this->m_NumberOfBinsPerAxis = static_cast<unsigned int>( numberOfBinsPerAxis );
+
+  const unsigned int binsPerAxis = this->m_NumberOfBinsPerAxis;
+  const unsigned int numberOfBins = binsPerAxis * binsPerAxis * binsPerAxis;
+
+  //
+  // Range of bins of every triangle. A direction that crosses the flat
+  // triangle lies at most maxEdge^2/3 outside of it, once normalized. The
+  // extra 1% of the edge covers the tolerance of the inside test.
+  //
+  std::vector<unsigned int> binRanges( 6 * numberOfTriangles );
+
+  for( TriangleIdentifier t = 0; t < numberOfTriangles; t++ )
+    {
+    const VectorType & a = directions[3 * t];
+    const VectorType & b = directions[3 * t + 1];
+    const VectorType & c = directions[3 * t + 2];
+
+    const double maximumSquaredEdge =
+      std::max( ( a - b ).GetSquaredNorm(), std::max( ( b - c ).GetSquaredNorm(), ( c - a ).GetSquaredNorm() ) );
+
+    const double margin = maximumSquaredEdge / 3.0 + 0.01 * std::sqrt( maximumSquaredEdge ) + 1e-9;
+
+    for( unsigned int d = 0; d < 3; d++ )
+      {
+      const double lower = std::min( a[d], std::min( b[d], c[d] ) ) - margin;
+      const double upper = std::max( a[d], std::max( b[d], c[d] ) ) + margin;
+
+      binRanges[6 * t + 2 * d] = this->GetBinCoordinate( lower );
+      binRanges[6 * t + 2 * d + 1] = this->GetBinCoordinate( upper );
+      }
+    }
+
+  //
+  // Two passes, counting and then filling, into a compressed list of
+  // triangles per bin.
+  //
+  this->m_BinOffsets.assign( numberOfBins + 1, 0 );
+
+  for( TriangleIdentifier t = 0; t < numberOfTriangles; t++ )
+    {
+    const unsigned int * range = &binRanges[6 * t];
+    for( unsigned int z = range[4]; z <= range[5]; z++ )
+      {
+      for( unsigned int y = range[2]; y <= range[3]; y++ )
+        {
+        for( unsigned int x = range[0]; x <= range[1]; x++ )
+          {
+          this->m_BinOffsets[( z * binsPerAxis + y ) * binsPerAxis + x + 1]++;
+          }
+        }
+      }
+    }
+
+  for( unsigned int bin = 0; bin < numberOfBins; bin++ )
+    {
+    this->m_BinOffsets[bin + 1] += this->m_BinOffsets[bin];
+    }
+
+  this->m_BinTriangles.resize( this->m_BinOffsets[numberOfBins] );
+
+  std::vector<unsigned int> fillPosition( this->m_BinOffsets.begin(), this->m_BinOffsets.end() - 1 );
+
+  for( TriangleIdentifier t = 0; t < numberOfTriangles; t++ )
+    {
+    const unsigned int * range = &binRanges[6 * t];
+    for( unsigned int z = range[4]; z <= range[5]; z++ )
+      {
+      for( unsigned int y = range[2]; y <= range[3]; y++ )
+        {
+        for( unsigned int x = range[0]; x <= range[1]; x++ )
+          {
+          this->m_BinTriangles[fillPosition[( z * binsPerAxis + y ) * binsPerAxis + x]++] = t;
+          }
+        }
+      }
+    }
+}
+
+template <class TMesh>
+unsigned int
+SphericalTriangleLocator<TMesh>
+::GetCandidateTriangles( const PointType & point, const TriangleIdentifier * & candidates ) const
+{
+  candidates = ITK_NULLPTR;
+
+  if( this->m_NumberOfBinsPerAxis == 0 )
+    {
+    return 0;
+    }
+
+  VectorType direction = point - this->m_SphereCenter;
+
+  const double norm = direction.GetNorm();
+
+  if( !( norm > 0.0 ) )
+    {
+    return 0;
+    }
+
+  direction /= norm;
+
+  const unsigned int binsPerAxis = this->m_NumberOfBinsPerAxis;
+
+  const unsigned int bin =
+    ( this->GetBinCoordinate( direction[2] ) * binsPerAxis
+      + this->GetBinCoordinate( direction[1] ) ) * binsPerAxis
+    + this->GetBinCoordinate( direction[0] );
+
+  const unsigned int begin = this->m_BinOffsets[bin];
+  const unsigned int end = this->m_BinOffsets[bin + 1];
+
+  if( begin == end )
+    {
+    return 0;
+    }
+
+  candidates = &( this->m_BinTriangles[begin] );
+
+  return end - begin;
+}
+
+/**
+ * Print out internals
+ */
+template <class TMesh>
+void
+SphericalTriangleLocator<TMesh>
+::PrintSelf(std::ostream& os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Sphere Center: " << this->m_SphereCenter << std::endl;
+  os << indent << "Number Of Triangles: " << this->GetNumberOfTriangles() << std::endl;
+  os << indent << "Number Of Bins Per Axis: " << this->m_NumberOfBinsPerAxis << std::endl;
+}
+} // end namespace itk
+
+#endif
@@ -0,0 +1,152 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+/*=========================================================================
+
+This is a test for the threaded resampling of a quad edge mesh. A linear
+function sampled on an icosahedral sphere is resampled on a rotated sphere
+of another resolution, with one and with several threads.
+
+ =========================================================================*/
+
+#include "itkQuadEdgeMesh.h"
+#include "itkVersorTransform.h"
+#include "itkLinearInterpolateMeshFunction.h"
+#include "itkResampleQuadEdgeMeshFilter.h"
+
+#include "SphereMeshTestHelper.h"
+
+typedef double PixelType;
+const unsigned int Dimension = 3;
+
+typedef itk::QuadEdgeMesh<PixelType, Dimension>             MeshType;
+typedef itk::VersorTransform<double>                        TransformType;
+typedef itk::LinearInterpolateMeshFunction<MeshType>        InterpolatorType;
+typedef itk::ResampleQuadEdgeMeshFilter<MeshType, MeshType> ResamplingFilterType;
+
+template <class TPoint>
+static double LinearFunction( const TPoint & point )
+{
+  return point[0] + 2.0 * point[1] - point[2];
+}
+
+static MeshType::Pointer Resample( const MeshType * inputMesh, const MeshType * referenceMesh,
+                                   const TransformType * transform, unsigned int numberOfThreads )
+{
+  InterpolatorType::Pointer interpolator = InterpolatorType::New();
+  interpolator->SetUseNearestNeighborInterpolationAsBackup(true);
+
+  ResamplingFilterType::Pointer resampler = ResamplingFilterType::New();
+  resampler->SetTransform( transform );
+  resampler->SetInterpolator( interpolator );
+  resampler->SetReferenceMesh( referenceMesh );
+  resampler->SetInput( inputMesh );
+  resampler->SetNumberOfThreads( numberOfThreads );
+  resampler->Update();
+
+  MeshType::Pointer output = resampler->GetOutput();
+  output->DisconnectPipeline();
+
+  return output;
+}
+
+int main( int argc, char * argv [] )
+{
+  if( argc < 3 )
+    {
+    std::cerr << "Missing arguments" << std::endl;
+    std::cerr << "Usage: " << std::endl;
+    std::cerr << argv[0] << std::endl;
+    std::cerr << "inputResolution referenceResolution";
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const double radius = 100.0;
+
+  MeshType::Pointer inputMesh = CreateSphere<MeshType>( atoi( argv[1] ), radius );
+  MeshType::Pointer referenceMesh = CreateSphere<MeshType>( atoi( argv[2] ), radius );
+
+  MeshType::PointsContainer::ConstIterator pointItr = inputMesh->GetPoints()->Begin();
+  MeshType::PointsContainer::ConstIterator pointEnd = inputMesh->GetPoints()->End();
+
+  while( pointItr != pointEnd )
+    {
+    inputMesh->SetPointData( pointItr.Index(), LinearFunction( pointItr.Value() ) );
+    ++pointItr;
+    }
+
+  // rotate, so that the reference points fall inside the input triangles
+  TransformType::Pointer transform = TransformType::New();
+
+  TransformType::AxisType axis;
+  axis[0] = 1.0;
+  axis[1] = 1.0;
+  axis[2] = 1.0;
+  transform->SetRotation( axis, 0.3 );
+
+  MeshType::Pointer serialOutput = Resample( inputMesh, referenceMesh, transform, 1 );
+  MeshType::Pointer threadedOutput = Resample( inputMesh, referenceMesh, transform, 4 );
+
+  // the input triangles lie inside the sphere, which bounds the error of the
+  // linear interpolation of the function
+  const double tolerance = 2.0;
+
+  unsigned int numberOfMismatches = 0;
+  unsigned int numberOfInaccurateValues = 0;
+
+  MeshType::PointsContainer::ConstIterator referenceItr = referenceMesh->GetPoints()->Begin();
+  MeshType::PointsContainer::ConstIterator referenceEnd = referenceMesh->GetPoints()->End();
+
+  while( referenceItr != referenceEnd )
+    {
+    PixelType serialValue = 0.0;
+    PixelType threadedValue = 0.0;
+
+    serialOutput->GetPointData( referenceItr.Index(), &serialValue );
+    threadedOutput->GetPointData( referenceItr.Index(), &threadedValue );
+
+    if( serialValue != threadedValue )
+      {
+      ++numberOfMismatches;
+      }
+
+    TransformType::InputPointType referencePoint;
+    referencePoint.CastFrom( referenceItr.Value() );
+
+    const double expectedValue = LinearFunction( transform->TransformPoint( referencePoint ) );
+
+    if( fabs( serialValue - expectedValue ) > tolerance )
+      {
+      ++numberOfInaccurateValues;
+      }
+
+    ++referenceItr;
+    }
+
+  if( numberOfMismatches > 0 || numberOfInaccurateValues > 0 )
+    {
+    std::cout << "Points: " << referenceMesh->GetNumberOfPoints() << std::endl;
+    std::cout << "Threaded values different from serial ones: " << numberOfMismatches << std::endl;
+    std::cout << "Values further than " << tolerance << " from the linear function: "
+              << numberOfInaccurateValues << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
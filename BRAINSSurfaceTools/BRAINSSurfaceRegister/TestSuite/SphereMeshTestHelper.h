@@ -0,0 +1,50 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __SphereMeshTestHelper_h
+#define __SphereMeshTestHelper_h
+
+#include "itkIcosahedralRegularSphereMeshSource.h"
+
+/** An icosahedral sphere of the given resolution and radius, centered on
+ * the origin, for the parallel mesh tests of this directory. */
+template <class TMesh>
+typename TMesh::Pointer CreateSphere( unsigned int resolution, double radius )
+{
+  typedef itk::IcosahedralRegularSphereMeshSource<TMesh> SphereMeshSourceType;
+
+  typename SphereMeshSourceType::Pointer sphereMeshSource = SphereMeshSourceType::New();
+
+  typename SphereMeshSourceType::PointType center;
+  center.Fill( 0.0 );
+
+  typename SphereMeshSourceType::VectorType scaleVector;
+  scaleVector.Fill( radius );
+
+  sphereMeshSource->SetCenter( center );
+  sphereMeshSource->SetScale( scaleVector );
+  sphereMeshSource->SetResolution( resolution );
+  sphereMeshSource->Update();
+
+  typename TMesh::Pointer sphere = sphereMeshSource->GetOutput();
+  sphere->DisconnectPipeline();
+
+  return sphere;
+}
+
+#endif
@@ -0,0 +1,221 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+/*=========================================================================
+
+This is a test for the threaded iteration steps of the spherical demons
+filter. A smooth function on an icosahedral sphere is registered to a
+rotated copy of itself with one and with several threads, and the
+destination points and the output mesh of both runs are compared. A fixed
+mesh whose point identifiers are not contiguous must be rejected.
+
+ =========================================================================*/
+
+#include "itkQuadEdgeMesh.h"
+#include "itkVersorTransform.h"
+#include "itkQuadEdgeMeshSphericalDiffeomorphicDemonsFilter.h"
+
+#include "SphereMeshTestHelper.h"
+
+typedef float PixelType;
+const unsigned int Dimension = 3;
+
+typedef itk::QuadEdgeMesh<PixelType, Dimension>                                         MeshType;
+typedef itk::VersorTransform<double>                                                    TransformType;
+typedef itk::QuadEdgeMeshSphericalDiffeomorphicDemonsFilter<MeshType, MeshType, MeshType> DemonsFilterType;
+typedef DemonsFilterType::DestinationPointSetType                                       DestinationPointSetType;
+
+template <class TPoint>
+static PixelType SmoothFunction( const TPoint & point, double radius )
+{
+  return static_cast<PixelType>( 10.0 * ( point[0] / radius ) * ( point[1] / radius ) + 5.0 * point[2] / radius );
+}
+
+static DemonsFilterType::Pointer Register( const MeshType * fixedMesh, const MeshType * movingMesh,
+                                           double radius, unsigned int numberOfThreads )
+{
+  DemonsFilterType::Pointer demonsFilter = DemonsFilterType::New();
+
+  DemonsFilterType::PointType center;
+  center.Fill( 0.0 );
+
+  demonsFilter->SetFixedMesh( fixedMesh );
+  demonsFilter->SetMovingMesh( movingMesh );
+  demonsFilter->SetSphereCenter( center );
+  demonsFilter->SetSphereRadius( radius );
+  demonsFilter->SetMaximumNumberOfIterations( 5 );
+  demonsFilter->SetMaximumNumberOfSmoothingIterations( 2 );
+  demonsFilter->SetEpsilon( 0.016 );
+  demonsFilter->SetSigmaX( 8.0 );
+  demonsFilter->SetLambda( 1.0 );
+  demonsFilter->SelfRegulatedModeOff();
+  demonsFilter->SelfStopModeOff();
+  demonsFilter->SetNumberOfThreads( numberOfThreads );
+  demonsFilter->Update();
+
+  return demonsFilter;
+}
+
+int main( int argc, char * argv [] )
+{
+  if( argc < 3 )
+    {
+    std::cerr << "Missing arguments" << std::endl;
+    std::cerr << "Usage: " << std::endl;
+    std::cerr << argv[0] << std::endl;
+    std::cerr << "resolution numberOfThreads";
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const double       radius = 100.0;
+  const unsigned int numberOfThreads = atoi( argv[2] );
+
+  MeshType::Pointer fixedMesh = CreateSphere<MeshType>( atoi( argv[1] ), radius );
+  MeshType::Pointer movingMesh = CreateSphere<MeshType>( atoi( argv[1] ), radius );
+
+  // the moving values are the fixed ones, rotated by a few degrees
+  TransformType::Pointer transform = TransformType::New();
+
+  TransformType::AxisType axis;
+  axis[0] = 0.0;
+  axis[1] = 1.0;
+  axis[2] = 1.0;
+  transform->SetRotation( axis, 0.1 );
+
+  MeshType::PointsContainer::ConstIterator pointItr = fixedMesh->GetPoints()->Begin();
+  MeshType::PointsContainer::ConstIterator pointEnd = fixedMesh->GetPoints()->End();
+
+  while( pointItr != pointEnd )
+    {
+    TransformType::InputPointType point;
+    point.CastFrom( pointItr.Value() );
+
+    fixedMesh->SetPointData( pointItr.Index(), SmoothFunction( point, radius ) );
+    movingMesh->SetPointData( pointItr.Index(), SmoothFunction( transform->TransformPoint( point ), radius ) );
+    ++pointItr;
+    }
+
+  DemonsFilterType::Pointer serialFilter = Register( fixedMesh, movingMesh, radius, 1 );
+  DemonsFilterType::Pointer threadedFilter = Register( fixedMesh, movingMesh, radius, numberOfThreads );
+
+  const double tolerance = 1e-9;
+
+  unsigned int numberOfPointMismatches = 0;
+  unsigned int numberOfOutputMismatches = 0;
+
+  const DestinationPointSetType::PointsContainer * serialPoints =
+    serialFilter->GetFinalDestinationPoints()->GetPoints();
+  const DestinationPointSetType::PointsContainer * threadedPoints =
+    threadedFilter->GetFinalDestinationPoints()->GetPoints();
+
+  if( serialPoints->Size() != fixedMesh->GetNumberOfPoints()
+      || threadedPoints->Size() != fixedMesh->GetNumberOfPoints() )
+    {
+    std::cout << "Unexpected number of destination points" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const MeshType * serialOutput = serialFilter->GetOutput();
+  const MeshType * threadedOutput = threadedFilter->GetOutput();
+
+  pointItr = fixedMesh->GetPoints()->Begin();
+
+  while( pointItr != pointEnd )
+    {
+    const MeshType::PointIdentifier pointId = pointItr.Index();
+
+    if( serialPoints->GetElement( pointId ).EuclideanDistanceTo( threadedPoints->GetElement( pointId ) ) > tolerance )
+      {
+      ++numberOfPointMismatches;
+      }
+
+    PixelType serialValue = 0.0;
+    PixelType threadedValue = 0.0;
+
+    serialOutput->GetPointData( pointId, &serialValue );
+    threadedOutput->GetPointData( pointId, &threadedValue );
+
+    if( serialValue != threadedValue
+        || serialOutput->GetPoint( pointId ).EuclideanDistanceTo( threadedOutput->GetPoint( pointId ) ) > tolerance )
+      {
+      ++numberOfOutputMismatches;
+      }
+
+    ++pointItr;
+    }
+
+  if( numberOfPointMismatches > 0 || numberOfOutputMismatches > 0 )
+    {
+    std::cout << "Points: " << fixedMesh->GetNumberOfPoints() << std::endl;
+    std::cout << "Threaded destination points different from serial ones: " << numberOfPointMismatches << std::endl;
+    std::cout << "Threaded output points or values different from serial ones: " << numberOfOutputMismatches
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //
+  // Same sphere, with every point identifier shifted by one
+  //
+  MeshType::Pointer shiftedMesh = MeshType::New();
+
+  pointItr = fixedMesh->GetPoints()->Begin();
+
+  while( pointItr != pointEnd )
+    {
+    shiftedMesh->SetPoint( pointItr.Index() + 1, pointItr.Value() );
+    shiftedMesh->SetPointData( pointItr.Index() + 1, 0.0 );
+    ++pointItr;
+    }
+
+  MeshType::CellsContainer::ConstIterator cellItr = fixedMesh->GetCells()->Begin();
+  MeshType::CellsContainer::ConstIterator cellEnd = fixedMesh->GetCells()->End();
+
+  while( cellItr != cellEnd )
+    {
+    const MeshType::CellType * cell = cellItr.Value();
+    if( cell->GetNumberOfPoints() == 3 )
+      {
+      MeshType::CellType::PointIdConstIterator pointIdItr = cell->PointIdsBegin();
+      const MeshType::PointIdentifier          id0 = *pointIdItr++;
+      const MeshType::PointIdentifier          id1 = *pointIdItr++;
+      const MeshType::PointIdentifier          id2 = *pointIdItr;
+      shiftedMesh->AddFaceTriangle( id0 + 1, id1 + 1, id2 + 1 );
+      }
+    ++cellItr;
+    }
+
+  bool exceptionCaught = false;
+  try
+    {
+    Register( shiftedMesh, movingMesh, radius, numberOfThreads );
+    }
+  catch( itk::ExceptionObject & excp )
+    {
+    std::cout << "Expected exception caught: " << excp.GetDescription() << std::endl;
+    exceptionCaught = true;
+    }
+
+  if( !exceptionCaught )
+    {
+    std::cout << "A fixed mesh with non contiguous point identifiers was accepted" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
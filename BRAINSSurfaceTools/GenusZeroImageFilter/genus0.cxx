@@ -1,24 +1,93 @@
 #include "genus0.h"
 #include <iostream>
+#include <string.h>
+#include <vector>
 
 #include "itkMacro.h" //Needed for ITK_NULLPTR
 
-static int    verbose, invconnectivity, connectivity, autocrop[3][2];
-static int    img_horiz, img_vert, img_depth; /*,paddeddims[3];*/
-static size_t paddeddims[3];                  /* CHANGE MN */
-static int    nbrs[6], offs[27], nbrs18[18], nbrs26[26], pass[27];
-static int    elist18[27][19], elist[27][7], elist26[27][27];
-static int *  status, *cm, cm_size, que_size, *que, que_len, que_pos;
-static int    maxlevels, comp_count = 10, cut_loops;
-static int    calloced = 0, max_calloced = 32;
-static int *  persist = ITK_NULLPTR;
+namespace
+{
+/* All the working state of one genus0() call.  Nothing is shared between
+   calls, so several labels can be processed at once from different
+   threads. */
+class genus0context
+{
+public:
+  genus0context();
+  ~genus0context();
+
+  int run(genus0parameters *g0);
+
+private:
+  /* Working memory is carved out of large zeroed chunks and handed back all
+     at once when the context goes away.  Blocks too big to share a chunk
+     (the per voxel arrays) get their own allocation, so that Gfree() can
+     still release them early.  Persistent blocks belong to the caller once
+     genus0() succeeds, and are released with free() by genus0destruct(). */
+  void * Gcalloc(size_t nelem, size_t elsize, int make_persist);
+
+  void Gfree(void *ptr);
+
+  void release_persistent(genus0parameters *g0);
+
+  void error_msg(const char *msg, int line);
+
+  void calc_elist(void);
+
+  void process_row(int axis, float *start);
+
+  void recursive_add_dist_squared(int axis, float *start);
+
+  int dist_squared(int rank, size_t *axis_len, float *deltax, char *inimage, char inobject,
+                   float *outdist_squared);
+
+  int get_cc(unsigned char *_zpic, int *_que, int *_status, size_t *dims, int *ac, int _connectivity);
+
+  int set_up(genus0parameters *g0);
+
+  int truecm(int st);
+
+  int truecmvx(int vx);
+
+  int test18(int qqp, int *nc);
+
+  int test6(int qqp, int *nc);
+
+  int cmtostat(void);
+
+  void find_component(int level);
 
-static void * *       calloc_list = ITK_NULLPTR;
-static unsigned char *zpic;
-static float          voxelsize[3], *fzpic, fzpicmax;
+  int GetSurf(unsigned char *J, unsigned char val, int *dims, int _connectivity,
+              int * *Tris, float * *Verts, int *Tri_count, int *Vert_count, genus0parameters *g0);
 
-static size_t *g_axis_len, *g_stride;
-static float * g_deltax, *g_tmp, *g_tmp_row, * *g_j, *g_x, * *g_recip, * *g_square;
+  int big_component(int *Tris, float *Verts, int *Vert_count, int *Tri_count);
+
+  int save_image(genus0parameters *g0);
+
+  static const size_t arena_chunk_size = 1 << 20;
+  static const size_t arena_large_block = arena_chunk_size >> 4;
+
+  std::vector<char *> arena_chunks;
+  size_t              arena_used;
+  std::vector<void *> large_blocks;
+  std::vector<void *> persistent_blocks;
+  int                 failed;
+
+  int    verbose, invconnectivity, connectivity, autocrop[3][2];
+  int    img_horiz, img_vert, img_depth; /*,paddeddims[3];*/
+  size_t paddeddims[3];                  /* CHANGE MN */
+  int    nbrs[6], offs[27], nbrs18[18], nbrs26[26], pass[27];
+  int    elist18[27][19], elist[27][7], elist26[27][27];
+  int *  status, *cm, cm_size, que_size, *que, que_len, que_pos;
+  int    maxlevels, comp_count, cut_loops;
+
+  unsigned char *zpic;
+  float          voxelsize[3], *fzpic, fzpicmax;
+
+  size_t *g_axis_len, *g_stride;
+  float * g_deltax, *g_tmp, *g_tmp_row, * *g_j, *g_x, * *g_recip, * *g_square;
+};
+} // end anonymous namespace
 
 static void print_msg(const char *msg)
 {
@@ -38,120 +107,145 @@ static void basic_free(void *ptr)
     }
 }
 
-static void Gfree(void *ptr)
+genus0context::genus0context() :
+  arena_used(0),
+  failed(0),
+  status(ITK_NULLPTR),
+  cm(ITK_NULLPTR),
+  cm_size(0),
+  que_size(0),
+  que(ITK_NULLPTR),
+  que_len(0),
+  que_pos(0),
+  maxlevels(0),
+  comp_count(10),
+  cut_loops(0),
+  zpic(ITK_NULLPTR),
+  fzpic(ITK_NULLPTR),
+  fzpicmax(0.0)
 {
-  int i, j;
+}
 
-  /* free something in the calloc_list */
-  for( i = 0; i < calloced; i++ )
+genus0context::~genus0context()
+{
+  size_t i;
+
+  for( i = 0; i < arena_chunks.size(); i++ )
     {
-    if( calloc_list[i] == ptr )
-      {
-      basic_free(ptr);
-      for( j = i + 1; j < calloced; j++ )
-        {
-        calloc_list[j - 1] = calloc_list[j];
-        persist[j - 1] = persist[j];
-        }
-      calloced--;
-      break;
-      }
+    basic_free(arena_chunks[i]);
+    }
+  for( i = 0; i < large_blocks.size(); i++ )
+    {
+    basic_free(large_blocks[i]);
     }
 }
 
-static void Gfree_all(int keep_persist)
+void genus0context::Gfree(void *ptr)
 {
-  int i;
+  size_t i;
 
-  if( calloc_list == ITK_NULLPTR )
+  if( ptr == ITK_NULLPTR )
     {
-    return;                      /* already done freeing all */
+    return;
     }
-  for( i = 0; i < calloced; i++ )
+  /* blocks inside a chunk are given back with the context */
+  for( i = large_blocks.size(); i-- > 0; )
     {
-    if( ( !keep_persist ) || ( persist[i] == 0 ) )
+    if( large_blocks[i] == ptr )
       {
-      Gfree(calloc_list[i]);
-      i--; /* don't advance i, since we compressed the list */
+      basic_free(ptr);
+      large_blocks.erase(large_blocks.begin() + i);
+      return;
       }
     }
-  if( calloc_list != ITK_NULLPTR )
+  for( i = persistent_blocks.size(); i-- > 0; )
     {
-    basic_free(calloc_list);
+    if( persistent_blocks[i] == ptr )
+      {
+      basic_free(ptr);
+      persistent_blocks.erase(persistent_blocks.begin() + i);
+      return;
+      }
     }
-  calloc_list = ITK_NULLPTR;
-  if( persist != ITK_NULLPTR )
+}
+
+void genus0context::release_persistent(genus0parameters *g0)
+{
+  size_t i;
+
+  /* after a failure nothing is handed to the caller */
+  for( i = 0; i < persistent_blocks.size(); i++ )
     {
-    basic_free(persist);
+    basic_free(persistent_blocks[i]);
+    }
+  persistent_blocks.clear();
+  g0->vertices = ITK_NULLPTR;
+  g0->triangles = ITK_NULLPTR;
+  g0->vert_count = g0->tri_count = 0;
+  if( g0->calloced_output )
+    {
+    g0->output = ITK_NULLPTR;
+    g0->calloced_output = 0;
     }
-  persist = ITK_NULLPTR;
 }
 
-static void error_msg(const char *msg, int line)
+void genus0context::error_msg(const char *msg, int line)
 {
   char line_msg[100];
 
-  if( calloc_list == ITK_NULLPTR )
+  if( failed )
     {
     return;                      /* must have been an error already */
     }
+  failed = 1;
   print_msg(msg);
   sprintf(line_msg, "Line: %d.\n", line);
   print_msg(line_msg);
-  Gfree_all(0);
 }
 
-static void * Gcalloc(size_t nelem, size_t elsize, int make_persist)
+void * genus0context::Gcalloc(size_t nelem, size_t elsize, int make_persist)
 {
-  void * *cl;
-  int *   p, j;
+  const size_t len = nelem * elsize;
+  const size_t aligned_len = ( len + 15 ) & ~static_cast<size_t>( 15 );
+  void *       ptr;
+  char *       chunk;
 
-  if( calloced == max_calloced )  /* we need more room */
+  if( make_persist || ( len >= arena_large_block ) )
     {
-    cl = calloc_list;
-    calloc_list = (void * *)basic_calloc( max_calloced * 2, sizeof( void * ) );
-    if( calloc_list == ITK_NULLPTR )
+    ptr = basic_calloc(nelem, elsize);
+    if( ptr == ITK_NULLPTR )
       {
-      calloc_list = cl;
       error_msg("Memory error.\n", __LINE__);
       return ITK_NULLPTR;
       }
-    for( j = 0; j < calloced; j++ )
+    if( make_persist )
       {
-      calloc_list[j] = cl[j];
+      persistent_blocks.push_back(ptr);
       }
-    basic_free(cl);
-
-    p = persist;
-    persist = (int *)basic_calloc( max_calloced * 2, sizeof( int ) );
-    if( persist == ITK_NULLPTR )
+    else
       {
-      persist = p;
-      error_msg("Memory error.\n", __LINE__);
-      return ITK_NULLPTR;
+      large_blocks.push_back(ptr);
       }
-    for( j = 0; j < calloced; j++ )
-      {
-      persist[j] = p[j];
-      }
-    basic_free(p);
-    max_calloced *= 2;
+    return ptr;
     }
 
-  calloc_list[calloced] = basic_calloc(nelem, elsize);
-  if( calloc_list[calloced] == ITK_NULLPTR )
-    {
-    error_msg("Memory error.\n", __LINE__);
-    return ITK_NULLPTR;
-    }
-  else
+  if( arena_chunks.empty() || ( arena_used + aligned_len > arena_chunk_size ) )
     {
-    persist[calloced] = make_persist;
+    chunk = (char *)basic_calloc(arena_chunk_size, 1);
+    if( chunk == ITK_NULLPTR )
+      {
+      error_msg("Memory error.\n", __LINE__);
+      return ITK_NULLPTR;
+      }
+    arena_chunks.push_back(chunk);
+    arena_used = 0;
     }
-  return calloc_list[calloced++];
+  ptr = arena_chunks.back() + arena_used;
+  arena_used += aligned_len;
+  return ptr;
 }
 
-static void calc_elist(void)
+void genus0context::calc_elist(void)
 {
   int vv, i, j, k, h, i1, j1, k1, count, thecase;
   int cases[6][3] = {{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
@@ -281,7 +375,7 @@ static void calc_elist(void)
     }
 }
 
-static void process_row(int axis, float *start)
+void genus0context::process_row(int axis, float *start)
 {
   register size_t len;
   register float *p, *p2, *p3, *p_end, pv, p2v, * *jp, * *j2p, * *j_end, *x2p;
@@ -372,7 +466,7 @@ static void process_row(int axis, float *start)
   return;
 }
 
-static void recursive_add_dist_squared(int axis, float *start)
+void genus0context::recursive_add_dist_squared(int axis, float *start)
 {
   size_t len;
   float *p, *p_end, *p2, *p2_end, *p3;
@@ -418,7 +512,7 @@ static void recursive_add_dist_squared(int axis, float *start)
   return;
 }
 
-static int dist_squared(
+int genus0context::dist_squared(
   int rank,
   size_t *axis_len,
   float *deltax,
@@ -644,7 +738,7 @@ static int sub2ind(int horiz, int vert, int depth, int _img_horiz, int _img_vert
 
 // static int get_cc(unsigned char * zpic, int *que, int * status, int *dims,
 // int *ac, int connectivity)
-static int get_cc(unsigned char *_zpic, int *_que, int *_status, size_t *dims, int *ac, int _connectivity)
+int genus0context::get_cc(unsigned char *_zpic, int *_que, int *_status, size_t *dims, int *ac, int _connectivity)
 {
   int i, *_offs, nbrs6[6], _nbrs18[18], *g_counts;
   int j, k, h, vox, c, w, groups, _que_pos, _que_len;
@@ -803,7 +897,7 @@ static int get_cc(unsigned char *_zpic, int *_que, int *_status, size_t *dims, i
   return 0;
 }
 
-static int set_up(genus0parameters *g0)
+int genus0context::set_up(genus0parameters *g0)
 {
   int            i, j, h, k, totlen, hz, *pad, ac[6];
   unsigned short value, *input;
@@ -826,18 +920,6 @@ static int set_up(genus0parameters *g0)
     error_msg("Bad input volume dimensions.\n", __LINE__); return 1;
     }
 
-  calloc_list = (void * *)basic_calloc( max_calloced, sizeof( void * ) );
-  if( calloc_list == ITK_NULLPTR )
-    {
-    error_msg("Memory error.\n", __LINE__); return 1;
-    }
-
-  persist = (int *)basic_calloc( max_calloced, sizeof( int ) );
-  if( persist == ITK_NULLPTR )
-    {
-    error_msg("Memory error.\n", __LINE__); return 1;
-    }
-
   if( ( g0->connectivity != 6 ) && ( g0->connectivity != 18 ) )
     {
     g0->connectivity = 6;
@@ -1199,7 +1281,7 @@ static int set_up(genus0parameters *g0)
   return 0;    /* no error */
 }
 
-static int truecm(int st) /* return true component, set cm[st] to true comp */
+int genus0context::truecm(int st) /* return true component, set cm[st] to true comp */
 {
   int s0, s1;
 
@@ -1225,16 +1307,16 @@ static int truecm(int st) /* return true component, set cm[st] to true comp */
   return st;
 }
 
-static int truecmvx(int vx) /* return true component of voxel */
+int genus0context::truecmvx(int vx) /* return true component of voxel */
 {
   return status[vx] = truecm(status[vx]);
 }
 
-static int test18(int qqp, int *nc)
+int genus0context::test18(int qqp, int *nc)
 {
   int        elQqpj, stqqpn, i, j, ec_count = 0, ec[27], found_another = 1;
   int        st[19], Que_len, Que_pos, Que[27], Qqp;
-  static int idx[18] = {1, 3, 4, 5, 7, 9, 10, 11, 12, 14, 15, 16, 17, 19, 21, 22, 23, 25};
+  static const int idx[18] = {1, 3, 4, 5, 7, 9, 10, 11, 12, 14, 15, 16, 17, 19, 21, 22, 23, 25};
 
   for( i = 0; i < 27; i++ )
     {
@@ -1287,11 +1369,11 @@ static int test18(int qqp, int *nc)
   return found_another;
 }
 
-static int test6(int qqp, int *nc)
+int genus0context::test6(int qqp, int *nc)
 {
   int        elQqpj, stqqpn, i, j, ec_count = 0, ec[27], found_another = 1;
   int        st[7], Que_len, Que_pos, Que[27], Qqp;
-  static int idx[6] = {12, 14, 10, 16, 4, 22};
+  static const int idx[6] = {12, 14, 10, 16, 4, 22};
 
   for( i = 0; i < 27; i++ )
     {
@@ -1372,7 +1454,7 @@ static int test6(int qqp, int *nc)
   return found_another;
 }
 
-static int cmtostat(void)
+int genus0context::cmtostat(void)
 {
   int  j, i, *cmremap = ITK_NULLPTR, *ccount = ITK_NULLPTR, totlen;
   char msg[200];
@@ -1432,12 +1514,12 @@ static int cmtostat(void)
   return 0;
 }
 
-static void find_component(int level)
+void genus0context::find_component(int level)
 {
   int i, qqp, qqpni, vox, nc;
   int found_another, *nbrs0, totlen;
 
-  int   ( *test )(int, int *);
+  int   ( genus0context::*test )(int, int *);
   float flevel;
   int   theconnectivity;
 
@@ -1452,14 +1534,14 @@ static void find_component(int level)
     }
 
   totlen = img_horiz * img_vert * img_depth;
-  nbrs0 = nbrs; test = test6;
+  nbrs0 = nbrs; test = &genus0context::test6;
 
   // std::cout << "totlen: " << totlen << std::endl;
   // std::cout << "theconnectivity: " << theconnectivity << std::endl;
 
   if( theconnectivity == 18 )
     {
-    nbrs0 = nbrs18; test = test18;
+    nbrs0 = nbrs18; test = &genus0context::test18;
     }
 
   flevel = ( level - 1.0 ) / ( maxlevels - 1.0 ) * fzpicmax;
@@ -1481,7 +1563,7 @@ static void find_component(int level)
         qqp = que[que_pos];
         /* check if can add */
         nc = 0;
-        found_another = test(qqp, &nc);
+        found_another = ( this->*test )(qqp, &nc);
         /* if you can, add it, and combine components if needed */
         if( found_another )
           {
@@ -1542,7 +1624,7 @@ static void find_component(int level)
     }   /* end for vox */
 }       /* end find_component */
 
-static int GetSurf(unsigned char *J, unsigned char val, int *dims, int _connectivity,
+int genus0context::GetSurf(unsigned char *J, unsigned char val, int *dims, int _connectivity,
                    int * *Tris, float * *Verts, int *Tri_count, int *Vert_count, genus0parameters *g0)
 {
   unsigned char *_status, *cidx, *pidx;
@@ -1821,7 +1903,7 @@ static int GetSurf(unsigned char *J, unsigned char val, int *dims, int _connecti
   return 0;    /* return with success _status */
 } /*end!*/
 
-static int big_component(int *Tris, float *Verts, int *Vert_count, int *Tri_count)
+int genus0context::big_component(int *Tris, float *Verts, int *Vert_count, int *Tri_count)
 {
   int    ov, ot, tri_count, vert_count, *v_count, *tp, *v_ran, *v_idx, u0, v0, i, j, *tris, w;
   int *  _que, _que_pos, _que_len, *component, _comp_count, *c_count, tc[3], k, qqp, vt, *tr;
@@ -2014,7 +2096,7 @@ static int big_component(int *Tris, float *Verts, int *Vert_count, int *Tri_coun
   return 0;
 }
 
-static int save_image(genus0parameters *g0)
+int genus0context::save_image(genus0parameters *g0)
 {
   int             i, j, k, totlen, h, h1, sti;
   int *           pad, dims[3], origlen, vo[3], v2[3], pos[3];
@@ -2228,13 +2310,13 @@ extern void genus0init(genus0parameters *g0)
   g0->calloced_output = 0; /* private */
 }
 
-extern int genus0(genus0parameters *g0)
+int genus0context::run(genus0parameters *g0)
 {
   int thistenth, lasttenth, level;
 
   if( set_up(g0) )
     {
-    Gfree_all(0); return 1;
+    release_persistent(g0); return 1;
     }
   if( !( g0->any_genus ) )
     {
@@ -2258,22 +2340,29 @@ extern int genus0(genus0parameters *g0)
           {
           if( cmtostat() )
             {
-            Gfree_all(0); return 1;
+            release_persistent(g0); return 1;
             }
           }
         }
       }
     if( cmtostat() )
       {
-      Gfree_all(0); return 1;
+      release_persistent(g0); return 1;
       }
     }
   if( save_image(g0) )
     {
-    Gfree_all(0); return 1;
+    release_persistent(g0); return 1;
     }
-  Gfree_all(1); /* isn't really be needed, if we've freed our calloc's */
-  return 0;     /* normal, error free return */
+  persistent_blocks.clear(); /* the caller owns them now */
+  return 0;                  /* normal, error free return */
+}
+
+extern int genus0(genus0parameters *g0)
+{
+  genus0context context;
+
+  return context.run(g0);
 }
 
 extern void genus0destruct(genus0parameters *g0)
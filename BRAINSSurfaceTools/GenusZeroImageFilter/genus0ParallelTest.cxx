@@ -0,0 +1,192 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+// Runs genus0() for several labels (and both loop handling modes) one after
+// the other, then concurrently from several threads, and checks that every
+// surface and adjusted label map is identical.
+#include "genus0.h"
+#include "itkMultiThreader.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+const int ImageSize = 40;
+
+struct Genus0Result
+  {
+  int                         returnValue;
+  std::vector<float>          vertices;
+  std::vector<int>            triangles;
+  std::vector<unsigned short> output;
+  };
+
+struct Genus0Job
+  {
+  unsigned short label;
+  int            cutLoops;
+  Genus0Result   result;
+  };
+
+struct Genus0ThreadStruct
+  {
+  const std::vector<unsigned short> *Labels;
+  std::vector<Genus0Job> *           Jobs;
+  };
+
+/* a ball, a torus (genus one), a hollow ball and a box with a tunnel */
+std::vector<unsigned short>
+MakeLabelMap()
+{
+  std::vector<unsigned short> labels(ImageSize * ImageSize * ImageSize, 0);
+
+  for( int k = 0; k < ImageSize; ++k )
+    {
+    for( int j = 0; j < ImageSize; ++j )
+      {
+      for( int i = 0; i < ImageSize; ++i )
+        {
+        unsigned short label = 0;
+        double         x = i - 12, y = j - 12, z = k - 12;
+        if( x * x + y * y + z * z < 36 )
+          {
+          label = 1;
+          }
+        x = i - 27; y = j - 27; z = k - 12;
+        const double ring = sqrt(x * x + y * y) - 7;
+        if( ring * ring + z * z < 6 )
+          {
+          label = 2;
+          }
+        x = i - 12; y = j - 27; z = k - 28;
+        const double r2 = x * x + y * y + z * z;
+        if( r2 < 49 && r2 > 9 )
+          {
+          label = 3;
+          }
+        if( i > 22 && i < 34 && j > 22 && j < 34 && k > 22 && k < 34
+            && !( ( i == 28 || j == 28 ) && k > 24 && k < 32 ) )
+          {
+          label = 4;
+          }
+        labels[i + ImageSize * ( j + ImageSize * k )] = label;
+        }
+      }
+    }
+  return labels;
+}
+
+void
+RunGenus0(const std::vector<unsigned short> & labels, Genus0Job & job)
+{
+  genus0parameters g0[1];
+
+  genus0init(g0);
+  g0->input = const_cast<unsigned short *>( &labels[0] );
+  g0->dims[0] = g0->dims[1] = g0->dims[2] = ImageSize;
+  g0->value = job.label;
+  g0->alt_value = job.label;
+  g0->cut_loops = job.cutLoops;
+
+  job.result.returnValue = genus0(g0);
+  if( job.result.returnValue == 0 )
+    {
+    job.result.vertices.assign(g0->vertices, g0->vertices + 3 * g0->vert_count);
+    job.result.triangles.assign(g0->triangles, g0->triangles + 3 * g0->tri_count);
+    job.result.output.assign(g0->output, g0->output + labels.size() );
+    }
+  genus0destruct(g0);
+}
+
+ITK_THREAD_RETURN_TYPE
+Genus0ThreaderCallback(void *arg)
+{
+  itk::MultiThreader::ThreadInfoStruct *info = static_cast<itk::MultiThreader::ThreadInfoStruct *>( arg );
+  Genus0ThreadStruct *                  str = static_cast<Genus0ThreadStruct *>( info->UserData );
+
+  for( size_t j = info->ThreadID; j < str->Jobs->size(); j += info->NumberOfThreads )
+    {
+    RunGenus0(*str->Labels, ( *str->Jobs )[j]);
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+bool
+SameResult(const Genus0Result & a, const Genus0Result & b)
+{
+  return a.returnValue == b.returnValue
+         && a.vertices == b.vertices
+         && a.triangles == b.triangles
+         && a.output == b.output;
+}
+} // end anonymous namespace
+
+int main(int, char * *)
+{
+  const std::vector<unsigned short> labels = MakeLabelMap();
+
+  std::vector<Genus0Job> serialJobs;
+  for( int cutLoops = 0; cutLoops <= 1; ++cutLoops )
+    {
+    for( unsigned short label = 1; label <= 4; ++label )
+      {
+      Genus0Job job;
+      job.label = label;
+      job.cutLoops = cutLoops;
+      serialJobs.push_back(job);
+      }
+    }
+  std::vector<Genus0Job> parallelJobs = serialJobs;
+
+  for( size_t j = 0; j < serialJobs.size(); ++j )
+    {
+    RunGenus0(labels, serialJobs[j]);
+    }
+
+  Genus0ThreadStruct str;
+  str.Labels = &labels;
+  str.Jobs = &parallelJobs;
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads( parallelJobs.size() );
+  threader->SetSingleMethod(Genus0ThreaderCallback, &str);
+  threader->SingleMethodExecute();
+
+  bool ok = true;
+  for( size_t j = 0; j < serialJobs.size(); ++j )
+    {
+    const Genus0Result & serial = serialJobs[j].result;
+    std::cout << "label " << serialJobs[j].label << ( serialJobs[j].cutLoops ? " (cut loops)" : "" )
+              << ": " << serial.vertices.size() / 3 << " vertices, "
+              << serial.triangles.size() / 3 << " triangles" << std::endl;
+    if( serial.returnValue != 0 || serial.triangles.empty() )
+      {
+      std::cerr << "genus0 failed for label " << serialJobs[j].label << std::endl;
+      ok = false;
+      }
+    else if( !SameResult(serial, parallelJobs[j].result) )
+      {
+      std::cerr << "Concurrent genus0 result differs for label " << serialJobs[j].label << std::endl;
+      ok = false;
+      }
+    }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
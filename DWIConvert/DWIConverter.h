@@ -26,8 +26,11 @@
 #include "itkImage.h"
 #include "itkDCMTKFileReader.h"
 #include "itkDCMTKImageIO.h"
+#include "itkMultiThreader.h"
 #include "StringContains.h"
 #include <algorithm>
+#include <cstring>
+#include <string>
 /** the DWIConverter is a base class for all scanner-specific
  *  converters.  It handles the tasks that are required for all
  *  scanners. In particular it loads the DICOM directory, and fills
@@ -96,12 +99,9 @@ public:
       itk::DCMTKImageIO::Pointer dcmtkIO = itk::DCMTKImageIO::New();
       if( this->m_InputFileNames.size() > 1 )
         {
-        ReaderType::Pointer reader = ReaderType::New();
-        reader->SetImageIO( dcmtkIO );
-        reader->SetFileNames( this->m_InputFileNames );
         try
           {
-          reader->Update();
+          this->ReadSliceFiles( dcmtkIO );
           }
         catch( itk::ExceptionObject & excp )
           {
@@ -110,7 +110,6 @@ public:
           std::cerr << excp << std::endl;
           throw;
           }
-        m_Volume = reader->GetOutput();
         m_MultiSliceVolume = false;
         }
       else
@@ -353,43 +352,137 @@ protected:
   void
   DeInterleaveVolume()
     {
-      size_t NVolumes = this->m_NSlice / this->m_SlicesPerVolume;
+      const size_t NVolumes = this->m_NSlice / this->m_SlicesPerVolume;
+
+      VolumeType::SizeType size = this->m_Volume->GetLargestPossibleRegion().GetSize();
+      const size_t sliceSize = size[0] * size[1];
+      const size_t sliceBytes = sliceSize * sizeof(VolumeType::PixelType);
+      VolumeType::PixelType *buffer = this->m_Volume->GetBufferPointer();
+
+      // slice m of volume k is stored as slice (m * NVolumes) + k and
+      // belongs at slice (k * this->m_SlicesPerVolume) + m. Move whole
+      // slices along the cycles of that permutation, so only one
+      // slice needs to be held aside.
+      std::vector<VolumeType::PixelType> held(sliceSize);
+      std::vector<bool>                  done(this->m_NSlice, false);
+      for( size_t start = 0; start < this->m_NSlice; ++start )
+        {
+        if( done[start] )
+          {
+          continue;
+          }
+        std::memcpy( &held[0], buffer + start * sliceSize, sliceBytes );
+        size_t target = start;
+        for( ; ; )
+          {
+          done[target] = true;
+          const size_t k = target / this->m_SlicesPerVolume;
+          const size_t m = target % this->m_SlicesPerVolume;
+          const size_t source = (m * NVolumes) + k;
+          if( source == start )
+            {
+            std::memcpy( buffer + target * sliceSize, &held[0], sliceBytes );
+            break;
+            }
+          std::memcpy( buffer + target * sliceSize, buffer + source * sliceSize, sliceBytes );
+          target = source;
+          }
+        }
+    }
+  /** read the files of m_InputFileNames into m_Volume. The geometry
+   *  is the one itk::ImageSeriesReader gives from the headers; the
+   *  files are then decoded concurrently, each straight into its
+   *  part of the buffer.
+   */
+  void
+  ReadSliceFiles(itk::DCMTKImageIO *dcmtkIO)
+    {
+      ReaderType::Pointer reader = ReaderType::New();
+      reader->SetImageIO( dcmtkIO );
+      reader->SetFileNames( this->m_InputFileNames );
+      reader->UpdateOutputInformation();
+
+      this->m_Volume = VolumeType::New();
+      this->m_Volume->CopyInformation( reader->GetOutput() );
+      this->m_Volume->SetRegions( reader->GetOutput()->GetLargestPossibleRegion() );
+      this->m_Volume->Allocate();
+
+      const size_t numberOfFiles = this->m_InputFileNames.size();
+      const itk::ThreadIdType numberOfThreads =
+        std::min( itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),
+                  static_cast<itk::ThreadIdType>( numberOfFiles ) );
+
+      SliceReadStruct str;
+      str.FileNames = &this->m_InputFileNames;
+      str.Buffer = this->m_Volume->GetBufferPointer();
+      str.PixelsPerFile = this->m_Volume->GetBufferedRegion().GetNumberOfPixels() / numberOfFiles;
+      str.Errors.resize( numberOfFiles );
+      // DCMTKImageIO registers the DCMTK decoders when it is created, so
+      // create one per thread here rather than in the threads
+      for( itk::ThreadIdType t = 0; t < numberOfThreads; ++t )
+        {
+        str.ImageIOs.push_back( itk::DCMTKImageIO::New() );
+        }
 
-      VolumeType::RegionType R = this->m_Volume->GetLargestPossibleRegion();
+      itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+      threader->SetNumberOfThreads( numberOfThreads );
+      threader->SetSingleMethod( SliceReadThreaderCallback, &str );
+      threader->SingleMethodExecute();
 
-      R.SetSize(2, 1);
-      std::vector<VolumeType::PixelType> v(this->m_NSlice);
-      std::vector<VolumeType::PixelType> w(this->m_NSlice);
+      for( size_t i = 0; i < numberOfFiles; ++i )
+        {
+        if( !str.Errors[i].empty() )
+          {
+          itkGenericExceptionMacro(<< "Error reading " << this->m_InputFileNames[i] << ": " << str.Errors[i]);
+          }
+        }
+    }
 
-      itk::ImageRegionIteratorWithIndex<VolumeType> I(this->m_Volume, R );
-      // permute the slices by extracting the 1D array of voxels for
-      // a particular {x,y} position, then re-ordering the voxels such
-      // that all the voxels for a particular volume are adjacent
-      for( I.GoToBegin(); !I.IsAtEnd(); ++I )
+  struct SliceReadStruct
+  {
+    const FileNamesContainer                *FileNames;
+    PixelValueType                          *Buffer;
+    size_t                                   PixelsPerFile;
+    std::vector<itk::DCMTKImageIO::Pointer>  ImageIOs;
+    std::vector<std::string>                 Errors;
+  };
+
+  /** decode a contiguous run of files into the volume buffer */
+  static ITK_THREAD_RETURN_TYPE SliceReadThreaderCallback(void *arg)
+    {
+      itk::MultiThreader::ThreadInfoStruct *info =
+        static_cast<itk::MultiThreader::ThreadInfoStruct *>(arg);
+      SliceReadStruct *str = static_cast<SliceReadStruct *>(info->UserData);
+
+      const size_t numberOfFiles = str->FileNames->size();
+      const size_t perThread = (numberOfFiles + info->NumberOfThreads - 1) / info->NumberOfThreads;
+      const size_t first = std::min(info->ThreadID * perThread, numberOfFiles);
+      const size_t last = std::min(first + perThread, numberOfFiles);
+      for( size_t i = first; i < last; ++i )
         {
-        VolumeType::IndexType idx = I.GetIndex();
-        // extract all values in one "column"
-        for( unsigned int k = 0; k < this->m_NSlice; ++k )
+        SingleFileReaderType::Pointer reader = SingleFileReaderType::New();
+        reader->SetImageIO( str->ImageIOs[info->ThreadID] );
+        reader->SetFileName( (*str->FileNames)[i] );
+        try
           {
-          idx[2] = k;
-          v[k] = this->m_Volume->GetPixel( idx );
+          reader->Update();
           }
-        // permute
-        for( unsigned int k = 0; k < NVolumes; ++k )
+        catch( itk::ExceptionObject & excp )
           {
-          for( unsigned int m = 0; m < this->m_SlicesPerVolume; ++m )
-            {
-            w[(k * this->m_SlicesPerVolume) + m] = v[(m * NVolumes) + k];
-            }
+          str->Errors[i] = excp.GetDescription();
+          continue;
           }
-        // put things back in order
-        for( unsigned int k = 0; k < this->m_NSlice; ++k )
+        if( reader->GetOutput()->GetBufferedRegion().GetNumberOfPixels() != str->PixelsPerFile )
           {
-          idx[2] = k;
-          this->m_Volume->SetPixel( idx, w[k] );
+          str->Errors[i] = "image size differs from the rest of the series";
+          continue;
           }
+        std::memcpy( str->Buffer + i * str->PixelsPerFile, reader->GetOutput()->GetBufferPointer(),
+                     str->PixelsPerFile * sizeof(PixelValueType) );
         }
+      return ITK_THREAD_RETURN_VALUE;
     }
+
   /** add vendor-specific flags; */
   virtual void AddFlagsToDictionary() = 0;
   /** one file reader per DICOM file in dataset */
@@ -21,6 +21,7 @@
 
 #include "itkImageSeriesReader.h"
 #include "itkDCMTKFileReader.h"
+#include "itkMultiThreader.h"
 #include "itksys/SystemTools.hxx"
 #include "DWIConverter.h"
 #include "PhilipsDWIConverter.h"
@@ -76,34 +77,32 @@ public:
         return ITK_NULLPTR;
         }
 
-      m_Headers.resize(m_InputFileNames.size());
-      int                                 headerCount = 0;
-      for( unsigned i = 0; i < m_Headers.size(); ++i )
+      // parse all the headers concurrently, then keep the ones with
+      // pixel data in file name order.
+      std::vector<itk::DCMTKFileReader *> headers(m_InputFileNames.size());
+      std::vector<char>                   readFailed(m_InputFileNames.size(), 0);
+      HeaderLoadStruct                    str;
+      str.FileNames = &m_InputFileNames;
+      str.Headers = &headers;
+      str.ReadFailed = &readFailed;
+
+      itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+      threader->SetNumberOfThreads( std::min( itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),
+                                              static_cast<itk::ThreadIdType>( m_InputFileNames.size() ) ) );
+      threader->SetSingleMethod( HeaderLoadThreaderCallback, &str );
+      threader->SingleMethodExecute();
+
+      int headerCount = 0;
+      for( unsigned i = 0; i < headers.size(); ++i )
         {
-        itk::DCMTKFileReader *curReader = new itk::DCMTKFileReader;
-        curReader->SetFileName(m_InputFileNames[i]);
-        try
-          {
-          curReader->LoadFile();
-          }
-        catch( ... )
+        if( readFailed[i] )
           {
           std::cerr << "Error reading slice" << m_InputFileNames[i] << std::endl;
-          delete curReader;
-          curReader = ITK_NULLPTR;
           }
-        // check for pixel data.
-        if(curReader)
+        else if( headers[i] )
           {
-          if(!curReader->HasPixelData() )
-            {
-            delete curReader;
-            }
-          else
-            {
-            this->m_Headers[headerCount] = curReader;
-            headerCount++;
-            }
+          this->m_Headers.push_back(headers[i]);
+          headerCount++;
           }
         }
       // no headers found, nothing to do.
@@ -163,6 +162,53 @@ public:
     }
   std::string GetVendor() { return m_Vendor; }
 private:
+  struct HeaderLoadStruct
+  {
+    const DWIConverter::FileNamesContainer *FileNames;
+    std::vector<itk::DCMTKFileReader *>    *Headers;
+    std::vector<char>                      *ReadFailed;
+  };
+
+  /** load the headers of a contiguous run of files; files that fail
+   *  to load or have no pixel data leave a null header.
+   */
+  static ITK_THREAD_RETURN_TYPE HeaderLoadThreaderCallback(void *arg)
+    {
+      itk::MultiThreader::ThreadInfoStruct *info =
+        static_cast<itk::MultiThreader::ThreadInfoStruct *>(arg);
+      HeaderLoadStruct *str = static_cast<HeaderLoadStruct *>(info->UserData);
+
+      const size_t numberOfFiles = str->FileNames->size();
+      const size_t perThread = (numberOfFiles + info->NumberOfThreads - 1) / info->NumberOfThreads;
+      const size_t first = std::min(info->ThreadID * perThread, numberOfFiles);
+      const size_t last = std::min(first + perThread, numberOfFiles);
+      for( size_t i = first; i < last; ++i )
+        {
+        itk::DCMTKFileReader *curReader = new itk::DCMTKFileReader;
+        curReader->SetFileName((*str->FileNames)[i]);
+        try
+          {
+          curReader->LoadFile();
+          }
+        catch( ... )
+          {
+          (*str->ReadFailed)[i] = 1;
+          delete curReader;
+          continue;
+          }
+        // check for pixel data.
+        if(!curReader->HasPixelData() )
+          {
+          delete curReader;
+          }
+        else
+          {
+          (*str->Headers)[i] = curReader;
+          }
+        }
+      return ITK_THREAD_RETURN_VALUE;
+    }
+
   std::string m_DicomDirectory;
   std::string m_Vendor;
   bool        m_UseBMatrixGradientDirections;
@@ -0,0 +1,94 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "DtiFiberLoopDetector.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// Same check as the former DtiTrackingFilterBase::IsLoop, over all points
+static bool
+BruteForceIsNearAnyPoint(const std::vector<double> & points, const double p1[3], const double tolerance)
+{
+  const double tol2 = tolerance * tolerance;
+
+  for( size_t i = 0; i < points.size(); i += 3 )
+    {
+    const double *p2 = &( points[i] );
+    const double  distance
+      = ( p1[0]
+          - p2[0] ) * ( p1[0] - p2[0] ) + ( p1[1] - p2[1] ) * ( p1[1] - p2[1] ) + ( p1[2] - p2[2] ) * ( p1[2] - p2[2] );
+    if( distance < tol2 )
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+// Random walks with small steps revisit their neighbourhood often; every
+// step must give the same answer as checking all previous points.
+int main(int, char * *)
+{
+  std::srand(7919);
+  const double tolerances[3] = { 0.001, 0.25, 1.0 };
+
+  int                  status = EXIT_SUCCESS;
+  DtiFiberLoopDetector detector;
+  for( unsigned int t = 0; t < 3; ++t )
+    {
+    const double tolerance = tolerances[t];
+    for( unsigned int walk = 0; walk < 20; ++walk )
+      {
+      detector.Reset(tolerance);
+      std::vector<double> points;
+      double              p[3] = { -12.5, 3.0, 40.25 };
+      unsigned int        loops = 0;
+      for( unsigned int step = 0; step < 2000; ++step )
+        {
+        for( unsigned int i = 0; i < 3; ++i )
+          {
+          // steps on a grid of half the largest tolerance, so that exact
+          // revisits and points right at the tolerance both happen
+          p[i] += 0.5 * ( std::rand() % 5 - 2 );
+          }
+        const bool expected = BruteForceIsNearAnyPoint(points, p, tolerance);
+        if( detector.IsNearAnyPoint(p) != expected )
+          {
+          std::cerr << "Tolerance " << tolerance << " walk " << walk << " step " << step
+                    << ": loop detection differs from the exhaustive search" << std::endl;
+          status = EXIT_FAILURE;
+          break;
+          }
+        loops += expected ? 1 : 0;
+        detector.AddPoint(p);
+        points.push_back(p[0]);
+        points.push_back(p[1]);
+        points.push_back(p[2]);
+        }
+      if( loops == 0 )
+        {
+        std::cerr << "Tolerance " << tolerance << " walk " << walk << " never looped" << std::endl;
+        status = EXIT_FAILURE;
+        }
+      }
+    }
+  return status;
+}
@@ -0,0 +1,232 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkDtiFreeTrackingFilter.h"
+#include "itkDtiStreamlineTrackingFilter.h"
+#include "itkImageRegionIteratorWithIndex.h"
+
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+typedef itk::DiffusionTensor3D<double> TensorPixelType;
+typedef itk::Image<TensorPixelType, 3> TensorImageType;
+typedef itk::Image<float, 3>           AnisotropyImageType;
+typedef itk::Image<signed short, 3>    MaskImageType;
+
+typedef itk::DtiFreeTrackingFilter<TensorImageType, AnisotropyImageType, MaskImageType>       FreeTrackingType;
+typedef itk::DtiStreamlineTrackingFilter<TensorImageType, AnisotropyImageType, MaskImageType> StreamlineTrackingType;
+
+static const unsigned int ImageSize = 24;
+
+template <class TImage>
+static typename TImage::Pointer
+CreateImage()
+{
+  typename TImage::Pointer image = TImage::New();
+  typename TImage::SizeType size;
+  size.Fill(ImageSize);
+  image->SetRegions(size);
+  image->Allocate();
+  return image;
+}
+
+// The principal direction turns around z from slice to slice, and the
+// anisotropy drops outside a ball, so the fibers differ in length.
+static void
+CreateInputs(TensorImageType::Pointer & tensorImage, AnisotropyImageType::Pointer & anisotropyImage,
+             MaskImageType::Pointer & startingRegion, MaskImageType::Pointer & endingRegion)
+{
+  tensorImage = CreateImage<TensorImageType>();
+  anisotropyImage = CreateImage<AnisotropyImageType>();
+  startingRegion = CreateImage<MaskImageType>();
+  endingRegion = CreateImage<MaskImageType>();
+
+  const double center = 0.5 * ( ImageSize - 1 );
+  itk::ImageRegionIteratorWithIndex<TensorImageType> it( tensorImage, tensorImage->GetLargestPossibleRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+    const TensorImageType::IndexType index = it.GetIndex();
+    const double                     angle = 0.08 * index[2];
+    const double                     e[3] = { std::cos(angle), std::sin(angle), 0.0 };
+    TensorPixelType                  tensor;
+    unsigned int                     k = 0;
+    for( unsigned int i = 0; i < 3; ++i )
+      {
+      for( unsigned int j = i; j < 3; ++j, ++k )
+        {
+        tensor[k] = 9e-4 * e[i] * e[j] + ( i == j ? 1e-4 : 0.0 );
+        }
+      }
+    it.Set(tensor);
+
+    double radius2 = 0.0;
+    for( unsigned int i = 0; i < 3; ++i )
+      {
+      radius2 += ( index[i] - center ) * ( index[i] - center );
+      }
+    anisotropyImage->SetPixel( index, radius2 < 100.0 ? 0.8 : 0.1 );
+    const bool inStart = std::abs( index[0] - center ) < 2 && std::abs( index[1] - center ) < 2
+      && std::abs( index[2] - center ) < 5;
+    startingRegion->SetPixel( index, inStart ? 1 : 0 );
+    endingRegion->SetPixel( index, index[0] > center + 5 ? 1 : 0 );
+    }
+}
+
+static bool
+SameFibers(vtkPolyData *a, vtkPolyData *b)
+{
+  if( a->GetNumberOfPoints() != b->GetNumberOfPoints() || a->GetNumberOfLines() != b->GetNumberOfLines() )
+    {
+    std::cout << "Point or line counts differ: " << a->GetNumberOfPoints() << " / " << a->GetNumberOfLines()
+              << " against " << b->GetNumberOfPoints() << " / " << b->GetNumberOfLines() << std::endl;
+    return false;
+    }
+  vtkDataArray *tensorsA = a->GetPointData()->GetTensors();
+  vtkDataArray *tensorsB = b->GetPointData()->GetTensors();
+  for( vtkIdType i = 0; i < a->GetNumberOfPoints(); ++i )
+    {
+    double pa[3];
+    double pb[3];
+    a->GetPoint(i, pa);
+    b->GetPoint(i, pb);
+    for( unsigned int j = 0; j < 3; ++j )
+      {
+      if( pa[j] != pb[j] )
+        {
+        std::cout << "Point " << i << " differs" << std::endl;
+        return false;
+        }
+      }
+    for( int j = 0; j < 9; ++j )
+      {
+      if( tensorsA->GetComponent(i, j) != tensorsB->GetComponent(i, j) )
+        {
+        std::cout << "Tensor of point " << i << " differs" << std::endl;
+        return false;
+        }
+      }
+    }
+
+  vtkIdType  npA, npB;
+  vtkIdType *ptsA, *ptsB;
+  a->GetLines()->InitTraversal();
+  b->GetLines()->InitTraversal();
+  while( a->GetLines()->GetNextCell(npA, ptsA) )
+    {
+    b->GetLines()->GetNextCell(npB, ptsB);
+    if( npA != npB )
+      {
+      std::cout << "Fiber lengths differ" << std::endl;
+      return false;
+      }
+    for( vtkIdType i = 0; i < npA; ++i )
+      {
+      if( ptsA[i] != ptsB[i] )
+        {
+        std::cout << "Fiber point ids differ" << std::endl;
+        return false;
+        }
+      }
+    }
+  return true;
+}
+
+template <class TFilter>
+static vtkPolyData *
+Track(const unsigned int numberOfThreads, TensorImageType::Pointer tensorImage,
+      AnisotropyImageType::Pointer anisotropyImage, MaskImageType::Pointer startingRegion,
+      MaskImageType::Pointer endingRegion)
+{
+  typename TFilter::Pointer filter = TFilter::New();
+  filter->SetTensorImage( tensorImage );
+  filter->SetAnisotropyImage( anisotropyImage );
+  filter->SetStartingRegion( startingRegion );
+  filter->SetEndingRegion( endingRegion );
+  filter->SetCurvatureThreshold( 30.0 );
+  filter->SetStepSize( 0.5 );
+  filter->SetMinimumLength( 1.0 );
+  filter->SetMaximumLength( 40.0 );
+  filter->SetSeedThreshold( 0.5 );
+  filter->SetAnisotropyThreshold( 0.3 );
+  filter->SetNumberOfThreads( numberOfThreads );
+  filter->Update();
+  return filter->GetOutput();
+}
+
+// The fibers must not depend on the number of tracking threads.
+int main(int, char * *)
+{
+  TensorImageType::Pointer     tensorImage;
+  AnisotropyImageType::Pointer anisotropyImage;
+  MaskImageType::Pointer       startingRegion;
+  MaskImageType::Pointer       endingRegion;
+
+  CreateInputs(tensorImage, anisotropyImage, startingRegion, endingRegion);
+
+  int status = EXIT_SUCCESS;
+
+  vtkPolyData *freeSerial = Track<FreeTrackingType>(1, tensorImage, anisotropyImage, startingRegion, endingRegion);
+  if( freeSerial->GetNumberOfLines() == 0 )
+    {
+    std::cout << "Free tracking found no fibers" << std::endl;
+    status = EXIT_FAILURE;
+    }
+  const unsigned int threads[2] = { 2, 7 };
+  for( unsigned int t = 0; t < 2; ++t )
+    {
+    vtkPolyData *freeThreaded =
+      Track<FreeTrackingType>(threads[t], tensorImage, anisotropyImage, startingRegion, endingRegion);
+    if( !SameFibers(freeSerial, freeThreaded) )
+      {
+      std::cout << "Free tracking differs on " << threads[t] << " threads" << std::endl;
+      status = EXIT_FAILURE;
+      }
+    freeThreaded->Delete();
+    }
+
+  vtkPolyData *streamlineSerial =
+    Track<StreamlineTrackingType>(1, tensorImage, anisotropyImage, startingRegion, endingRegion);
+  if( streamlineSerial->GetNumberOfLines() == 0
+      || streamlineSerial->GetNumberOfLines() >= freeSerial->GetNumberOfLines() )
+    {
+    std::cout << "Streamline tracking should keep some, but not all, fibers" << std::endl;
+    status = EXIT_FAILURE;
+    }
+  for( unsigned int t = 0; t < 2; ++t )
+    {
+    vtkPolyData *streamlineThreaded =
+      Track<StreamlineTrackingType>(threads[t], tensorImage, anisotropyImage, startingRegion, endingRegion);
+    if( !SameFibers(streamlineSerial, streamlineThreaded) )
+      {
+      std::cout << "Streamline tracking differs on " << threads[t] << " threads" << std::endl;
+      status = EXIT_FAILURE;
+      }
+    streamlineThreaded->Delete();
+    }
+
+  freeSerial->Delete();
+  streamlineSerial->Delete();
+  return status;
+}
@@ -0,0 +1,187 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkTensorToEigenFieldImageFilter.h"
+#include "itkEigenFieldLinearInterpolateImageFunction.h"
+#include "itkDiffusionTensor3D.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+typedef itk::DiffusionTensor3D<double>                      TensorPixelType;
+typedef itk::Image<TensorPixelType, 3>                      TensorImageType;
+typedef itk::TensorToEigenFieldImageFilter<TensorImageType> EigenFieldFilterType;
+typedef EigenFieldFilterType::EigenFieldImageType           EigenFieldImageType;
+typedef itk::EigenFieldLinearInterpolateImageFunction<EigenFieldImageType, double> InterpolatorType;
+
+// Every eigen field pixel must match the eigen analysis of its tensor,
+// whatever the number of threads.
+static int
+TestEigenField()
+{
+  TensorImageType::Pointer  tensorImage = TensorImageType::New();
+  TensorImageType::SizeType size;
+  size.Fill(7);
+  tensorImage->SetRegions(size);
+  tensorImage->Allocate();
+
+  std::srand(65537);
+  itk::ImageRegionIteratorWithIndex<TensorImageType> it( tensorImage, tensorImage->GetLargestPossibleRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+    TensorPixelType tensor;
+    tensor.Fill(0.0);
+    if( it.GetIndex()[0] != 3 )
+      {
+      // diagonally dominant, so positive definite
+      for( unsigned int k = 0; k < 6; ++k )
+        {
+        tensor[k] = 1e-4 * std::rand() / RAND_MAX;
+        }
+      tensor(0, 0) += 1e-3;
+      tensor(1, 1) += 5e-4;
+      tensor(2, 2) += 5e-4;
+      }
+    it.Set(tensor);
+    }
+
+  int status = EXIT_SUCCESS;
+  for( unsigned int threads = 1; threads <= 3; threads += 2 )
+    {
+    EigenFieldFilterType::Pointer filter = EigenFieldFilterType::New();
+    filter->SetInput( tensorImage );
+    filter->SetNumberOfThreads( threads );
+    filter->Update();
+
+    itk::ImageRegionConstIterator<EigenFieldImageType> eigenIt( filter->GetOutput(),
+                                                               filter->GetOutput()->GetLargestPossibleRegion() );
+    for( it.GoToBegin(), eigenIt.GoToBegin(); !it.IsAtEnd(); ++it, ++eigenIt )
+      {
+      const EigenFieldImageType::PixelType expected = EigenFieldFilterType::ComputeEigenFieldPixel( it.Get() );
+      const EigenFieldImageType::PixelType pixel = eigenIt.Get();
+
+      TensorPixelType::EigenValuesArrayType   eigenValues;
+      TensorPixelType::EigenVectorsMatrixType eigenVectors;
+      it.Get().ComputeEigenAnalysis(eigenValues, eigenVectors);
+      for( unsigned int k = 0; k < 7; ++k )
+        {
+        bool same = ( pixel[k] == expected[k] );
+        if( it.GetIndex()[0] == 3 )
+          {
+          same = same && ( pixel[k] == 0.0f );
+          }
+        else if( k < 3 )
+          {
+          same = same && ( pixel[k] == static_cast<float>( eigenVectors[2][k] ) );
+          }
+        else if( k < 6 )
+          {
+          same = same && ( pixel[k] == static_cast<float>( eigenValues[k - 3] ) );
+          }
+        else
+          {
+          same = same && ( pixel[k] == static_cast<float>( it.Get().GetFractionalAnisotropy() ) );
+          }
+        if( !same )
+          {
+          std::cout << "Eigen field component " << k << " at " << it.GetIndex() << " is wrong on " << threads
+                    << " threads" << std::endl;
+          status = EXIT_FAILURE;
+          }
+        }
+      }
+    }
+  return status;
+}
+
+// Neighbours with opposite signs of the same eigenvector must not cancel.
+static int
+TestInterpolator()
+{
+  EigenFieldImageType::Pointer  eigenField = EigenFieldImageType::New();
+  EigenFieldImageType::SizeType size;
+  size[0] = 2; size[1] = 1; size[2] = 1;
+  eigenField->SetRegions(size);
+  eigenField->Allocate();
+
+  EigenFieldImageType::IndexType index;
+  index.Fill(0);
+  EigenFieldImageType::PixelType pixel;
+  pixel.Fill(0.0);
+  pixel[0] = 0.8f; pixel[1] = 0.6f;
+  pixel[3] = 1.0f; pixel[4] = 2.0f; pixel[5] = 3.0f; pixel[6] = 0.5f;
+  eigenField->SetPixel(index, pixel);
+  index[0] = 1;
+  pixel[0] = -0.6f; pixel[1] = -0.8f;
+  pixel[3] = 3.0f; pixel[4] = 4.0f; pixel[5] = 5.0f; pixel[6] = 0.7f;
+  eigenField->SetPixel(index, pixel);
+
+  InterpolatorType::Pointer interpolator = InterpolatorType::New();
+  interpolator->SetInputImage( eigenField );
+
+  int status = EXIT_SUCCESS;
+
+  InterpolatorType::ContinuousIndexType position;
+  position.Fill(0.0);
+  position[0] = 0.25;
+  const InterpolatorType::OutputType value = interpolator->EvaluateAtContinuousIndex(position);
+
+  // 0.75 * (0.8, 0.6) + 0.25 * (0.6, 0.8), normalized
+  const double x = 0.75 * 0.8 + 0.25 * 0.6;
+  const double y = 0.75 * 0.6 + 0.25 * 0.8;
+  const double norm = std::sqrt( x * x + y * y );
+  if( std::fabs( value[0] - x / norm ) > 1e-6 || std::fabs( value[1] - y / norm ) > 1e-6 || value[2] != 0.0 )
+    {
+    std::cout << "Interpolated eigenvector " << value << " is wrong" << std::endl;
+    status = EXIT_FAILURE;
+    }
+  if( std::fabs( value[3] - 1.5 ) > 1e-6 || std::fabs( value[5] - 3.5 ) > 1e-6 || std::fabs( value[6] - 0.55 ) > 1e-6 )
+    {
+    std::cout << "Interpolated eigenvalues " << value << " are wrong" << std::endl;
+    status = EXIT_FAILURE;
+    }
+
+  // Neighbours outside the image are left out
+  position[0] = 1.4;
+  const InterpolatorType::OutputType edge = interpolator->EvaluateAtContinuousIndex(position);
+  if( std::fabs( edge[0] + 0.6 ) > 1e-6 || std::fabs( edge[3] - 3.0 ) > 1e-6 )
+    {
+    std::cout << "Interpolation at the edge " << edge << " is wrong" << std::endl;
+    status = EXIT_FAILURE;
+    }
+  return status;
+}
+
+int main(int, char * *)
+{
+  int status = EXIT_SUCCESS;
+
+  if( TestEigenField() != EXIT_SUCCESS )
+    {
+    status = EXIT_FAILURE;
+    }
+  if( TestInterpolator() != EXIT_SUCCESS )
+    {
+    status = EXIT_FAILURE;
+    }
+  return status;
+}
@@ -0,0 +1,125 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkInvertBSplineFilter.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+
+#include <iostream>
+
+typedef itk::InvertBSplineFilter InvertFilterType;
+
+static InvertFilterType::DisplacementFieldType::ConstPointer
+InvertAsDisplacementField(InvertFilterType::BsplineTransformType *bspline, InvertFilterType::ImageType *image,
+                          const unsigned int numberOfThreads, double & maximumError,
+                          itk::SizeValueType & numberOfUnconvergedPoints)
+{
+  itk::MultiThreader::SetGlobalDefaultNumberOfThreads( numberOfThreads );
+
+  InvertFilterType::Pointer inverter = InvertFilterType::New();
+  inverter->SetInput( bspline );
+  inverter->SetExampleImage( image );
+  inverter->SetInversionMethod( InvertFilterType::DisplacementFieldInversion );
+  inverter->SetErrorTolerance( 1e-3 );
+  inverter->SetMaximumNumberOfIterations( 100 );
+  inverter->Update();
+  maximumError = inverter->GetMaximumInversionError();
+  numberOfUnconvergedPoints = inverter->GetNumberOfUnconvergedPoints();
+  return inverter->GetInverseDisplacementFieldTransform()->GetDisplacementField();
+}
+
+// Inverts a random smooth B-Spline at every voxel, checks the forward
+// transform brings each inverted point back on its voxel, and that the field
+// does not depend on the number of threads.
+int main(int, char * *)
+{
+  typedef InvertFilterType::ImageType            ImageType;
+  typedef InvertFilterType::BsplineTransformType BsplineTransformType;
+
+  ImageType::SizeType size;
+  size.Fill( 24 );
+  ImageType::SpacingType spacing;
+  spacing.Fill( 2.0 );
+  ImageType::PointType origin;
+  origin.Fill( -23.0 );
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( size );
+  image->SetSpacing( spacing );
+  image->SetOrigin( origin );
+  image->Allocate();
+  image->FillBuffer( 0 );
+
+  BsplineTransformType::Pointer                bspline = BsplineTransformType::New();
+  BsplineTransformType::PhysicalDimensionsType dimensions;
+  BsplineTransformType::MeshSizeType           meshSize;
+  dimensions.Fill( 48.0 );
+  meshSize.Fill( 6 );
+  bspline->SetTransformDomainOrigin( origin );
+  bspline->SetTransformDomainPhysicalDimensions( dimensions );
+  bspline->SetTransformDomainMeshSize( meshSize );
+  bspline->SetTransformDomainDirection( image->GetDirection() );
+
+  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomType;
+  RandomType::Pointer random = RandomType::New();
+  random->SetSeed( 1729 );
+  BsplineTransformType::ParametersType parameters( bspline->GetNumberOfParameters() );
+  for( unsigned int p = 0; p < parameters.size(); ++p )
+    {
+    // displacements of up to 2 mm over 8 mm knot spacing
+    parameters[p] = random->GetUniformVariate( -2.0, 2.0 );
+    }
+  bspline->SetParametersByValue( parameters );
+
+  typedef InvertFilterType::DisplacementFieldType::ConstPointer FieldConstPointer;
+  double                  singleError;
+  itk::SizeValueType      singleUnconverged;
+  const FieldConstPointer single = InvertAsDisplacementField( bspline, image, 1, singleError, singleUnconverged );
+  double                  multiError;
+  itk::SizeValueType      multiUnconverged;
+  const FieldConstPointer multi = InvertAsDisplacementField( bspline, image, 5, multiError, multiUnconverged );
+
+  int status = EXIT_SUCCESS;
+  if( singleUnconverged != 0 || singleError > 1e-3 )
+    {
+    std::cerr << singleUnconverged << " voxels did not converge, maximum error " << singleError << std::endl;
+    status = EXIT_FAILURE;
+    }
+
+  itk::ImageRegionConstIteratorWithIndex<InvertFilterType::DisplacementFieldType> it(
+    single, single->GetLargestPossibleRegion() );
+  for( ; !it.IsAtEnd(); ++it )
+    {
+    if( it.Get() != multi->GetPixel( it.GetIndex() ) )
+      {
+      std::cerr << "Threading changed the inverse at " << it.GetIndex() << std::endl;
+      status = EXIT_FAILURE;
+      break;
+      }
+    InvertFilterType::PointType point;
+    single->TransformIndexToPhysicalPoint( it.GetIndex(), point );
+    const double error = ( bspline->TransformPoint( point + it.Get() ) - point ).GetNorm();
+    if( error > 1e-3 )
+      {
+      std::cerr << "Inverse at " << it.GetIndex() << " is off by " << error << " mm" << std::endl;
+      status = EXIT_FAILURE;
+      break;
+      }
+    }
+  return status;
+}
@@ -147,6 +147,26 @@ int main(int argc, char *argv[])
 
   AnisotropyImageType::Pointer anisotropyImage = anisotropyImageReader->GetOutput();
 
+  // Read the eigen field of the tensors, if it was saved before
+  typedef FloatFMType::EigenFieldImageType EigenFieldImageType;
+  EigenFieldImageType::Pointer eigenFieldImage;
+  if( inputEigenFieldVolume != "" )
+    {
+    typedef itk::ImageFileReader<EigenFieldImageType> EigenFieldImageReaderType;
+    EigenFieldImageReaderType::Pointer eigenFieldImageReader = EigenFieldImageReaderType::New();
+    eigenFieldImageReader->SetFileName( inputEigenFieldVolume );
+    try
+      {
+      eigenFieldImageReader->Update();
+      }
+    catch( itk::ExceptionObject & ex )
+      {
+      std::cout << ex << std::endl;
+      throw;
+      }
+    eigenFieldImage = eigenFieldImageReader->GetOutput();
+    }
+
   typedef signed short                        MaskPixelType;
   typedef itk::Image<MaskPixelType, 3>        MaskImageType;
   typedef itk::ImageFileReader<MaskImageType> MaskImageReaderType;
@@ -233,6 +253,7 @@ int main(int argc, char *argv[])
 #endif
     marcher->SetInput( tensorImage );
     marcher->SetAnisotropyImage( anisotropyImage );
+    marcher->SetEigenFieldImage( eigenFieldImage );
     marcher->SetAnisotropyWeight( anisotropyWeight );
     marcher->SetStoppingValue( stoppingValue );
     marcher->SetNormalizationFactor( 1 );
@@ -50,6 +50,7 @@
 #include "itkDtiFreeTrackingFilter.h"
 #include "itkDtiGraphSearchTrackingFilter.h"
 #include "itkDtiStreamlineTrackingFilter.h"
+#include "itkTensorToEigenFieldImageFilter.h"
 
 #include "gtractFiberTrackingCLP.h"
 #include "BRAINSThreadControl.h"
@@ -206,6 +207,29 @@ int main(int argc, char *argv[])
   AdaptOriginAndDirection<AnisotropyImageType>( anisotropyImage );
   // std::cout << "Anisotropy Image Updated: " << anisotropyImage << std::endl;
 
+  // An eigen field saves decomposing the tensors while tracking
+  typedef itk::TensorToEigenFieldImageFilter<TensorImageType>::EigenFieldImageType EigenFieldImageType;
+  EigenFieldImageType::Pointer eigenFieldImage;
+  if( inputEigenFieldVolume != "" )
+    {
+    typedef itk::ImageFileReader<EigenFieldImageType> EigenFieldImageReaderType;
+    EigenFieldImageReaderType::Pointer eigenFieldImageReader = EigenFieldImageReaderType::New();
+    eigenFieldImageReader->SetFileName( inputEigenFieldVolume );
+
+    try
+      {
+      eigenFieldImageReader->Update();
+      }
+    catch( itk::ExceptionObject & ex )
+      {
+      std::cout << ex << std::endl;
+      throw;
+      }
+
+    eigenFieldImage = eigenFieldImageReader->GetOutput();
+    AdaptOriginAndDirection<EigenFieldImageType>( eigenFieldImage );
+    }
+
   if( inputStartingSeedsLabelMapVolume == "" )
     {
     std::cerr << "Missing filename for input Starting Seeds Label Map Volume (--inputStartingSeedsLabelMapVolume)"
@@ -325,6 +349,7 @@ int main(int argc, char *argv[])
     // Fix this once support for multiple Region tracking is added
     acturalTrackingFilter->SetAnisotropyImage( anisotropyImage );
     acturalTrackingFilter->SetTensorImage( tensorImage );
+    acturalTrackingFilter->SetEigenFieldImage( eigenFieldImage );
     acturalTrackingFilter->SetStartingRegion( startingSeedMask );
     acturalTrackingFilter->SetMaximumLength( maximumLength );
     acturalTrackingFilter->SetMinimumLength( minimumLength );
@@ -347,6 +372,7 @@ int main(int argc, char *argv[])
     acturalTrackingFilter->SetCurvatureThreshold( curvatureThreshold );
     acturalTrackingFilter->SetAnisotropyImage( anisotropyImage );
     acturalTrackingFilter->SetTensorImage( tensorImage );
+    acturalTrackingFilter->SetEigenFieldImage( eigenFieldImage );
     acturalTrackingFilter->SetStartingRegion( startingSeedMask );
     acturalTrackingFilter->SetMaximumLength( maximumLength );
     acturalTrackingFilter->SetMinimumLength( minimumLength );
@@ -374,6 +400,7 @@ int main(int argc, char *argv[])
                                                                           */
     acturalTrackingFilter->SetAnisotropyImage( anisotropyImage );
     acturalTrackingFilter->SetTensorImage( tensorImage );
+    acturalTrackingFilter->SetEigenFieldImage( eigenFieldImage );
     acturalTrackingFilter->SetStartingRegion( startingSeedMask );
     acturalTrackingFilter->SetMaximumLength( maximumLength );
     acturalTrackingFilter->SetMinimumLength( minimumLength );
@@ -401,6 +428,7 @@ int main(int argc, char *argv[])
     acturalTrackingFilter->SetRandomSeed( randomSeed );
     acturalTrackingFilter->SetAnisotropyImage( anisotropyImage );
     acturalTrackingFilter->SetTensorImage( tensorImage );
+    acturalTrackingFilter->SetEigenFieldImage( eigenFieldImage );
     acturalTrackingFilter->SetStartingRegion( startingSeedMask );
     acturalTrackingFilter->SetMaximumLength( maximumLength );
     acturalTrackingFilter->SetMinimumLength( minimumLength );
@@ -66,6 +66,7 @@ int main(int argc, char *argv[])
     std::cout << "Input Transform: " <<  inputTransform << std::endl;
     std::cout << "Output Transform: " <<  outputTransform << std::endl;
     std::cout << "Reference Image: " <<  inputReferenceVolume << std::endl;
+    std::cout << "Inversion Method: " << inversionMethod << std::endl;
     std::cout << "Density: " << xSize << " " << ySize << " " << zSize << std::endl;
     std::cout << "==============================================================" << std::endl;
     }
@@ -96,20 +97,31 @@ int main(int argc, char *argv[])
   GenericTransformType::Pointer baseTransform = itk::ReadTransformFromDisk(inputTransform);
 
   typedef itk::InvertBSplineFilter InvertFilterType;
-  std::cout << "Running Inversion using TPS" << std::endl;
+  std::cout << "Running Inversion using " << inversionMethod << std::endl;
   InvertFilterType::Pointer invertTransformFilter = InvertFilterType::New();
     {
     InvertFilterType::BsplineTransformTypePointer myBSpline
       = dynamic_cast<InvertFilterType::BsplineTransformType *>( baseTransform.GetPointer() );
+    if( myBSpline.IsNull() )
+      {
+      std::cerr << "Input transform " << inputTransform << " is not a B-Spline transform" << std::endl;
+      return EXIT_FAILURE;
+      }
     invertTransformFilter->SetInput( myBSpline );
     }
+  if( inversionMethod == "DisplacementField" )
+    {
+    invertTransformFilter->SetInversionMethod( InvertFilterType::DisplacementFieldInversion );
+    }
+  invertTransformFilter->SetErrorTolerance( inversionTolerance );
+  invertTransformFilter->SetMaximumNumberOfIterations( maximumNumberOfIterations );
   invertTransformFilter->SetXgridSize( xSize );
   invertTransformFilter->SetYgridSize( ySize );
   invertTransformFilter->SetZgridSize( zSize );
   invertTransformFilter->SetExampleImage( ExampleImage );
   invertTransformFilter->Update();
-  std::cout << "TPS Inversion Complete" << std::endl;
+  std::cout << inversionMethod << " Inversion Complete" << std::endl;
 
-  itk::WriteTransformToDisk<double>(invertTransformFilter->GetOutput(), outputTransform);
+  itk::WriteTransformToDisk<double>(invertTransformFilter->GetOutputTransform(), outputTransform);
   return EXIT_SUCCESS;
 }
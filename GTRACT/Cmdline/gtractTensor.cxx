@@ -322,7 +322,18 @@ int main(int argc, char *argv[])
   tensorFilter->SetGradientImage( gradientDirectionContainer, indexImageToVectorImageFilter->GetOutput() );
   tensorFilter->SetThreshold( backgroundSuppressingThreshold );
   tensorFilter->SetBValue(BValue);     /* Required */
-  tensorFilter->SetNumberOfThreads(1); /* Required */
+  if( tensorEstimationMethod == "SVD" )
+    {
+    tensorFilter->SetEstimationMethod(TensorFilterType::PerVoxelSVD);
+    }
+  else if( tensorEstimationMethod == "WLS" )
+    {
+    tensorFilter->SetEstimationMethod(TensorFilterType::WeightedLeastSquares);
+    }
+  else
+    {
+    tensorFilter->SetEstimationMethod(TensorFilterType::LinearLeastSquares);
+    }
   if( maskImage.IsNotNull() )
     {
     tensorFilter->SetMaskImage(maskImage);
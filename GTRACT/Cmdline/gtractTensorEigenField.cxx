@@ -0,0 +1,87 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include <iostream>
+
+#include <itkImage.h>
+#include <itkImageFileWriter.h>
+#include <itkImageFileReader.h>
+#include <itkDiffusionTensor3D.h>
+
+#include "itkTensorToEigenFieldImageFilter.h"
+#include "gtractTensorEigenFieldCLP.h"
+#include "BRAINSThreadControl.h"
+#include <BRAINSCommonLib.h>
+
+int main(int argc, char *argv[])
+{
+  typedef double                                              TensorComponentType;
+  typedef itk::DiffusionTensor3D<TensorComponentType>         TensorPixelType;
+  typedef itk::Image<TensorPixelType, 3>                      TensorImageType;
+  typedef itk::TensorToEigenFieldImageFilter<TensorImageType> EigenFieldFilterType;
+
+  PARSE_ARGS;
+  BRAINSRegisterAlternateIO();
+  const BRAINSUtils::StackPushITKDefaultNumberOfThreads TempDefaultNumberOfThreadsHolder(numberOfThreads);
+
+  bool debug = true;
+  if( debug )
+    {
+    std::cout << "=====================================================" << std::endl;
+    std::cout << "Input Tensor Image: " <<  inputTensorVolume << std::endl;
+    std::cout << "Output Eigen Field Image: " <<  outputVolume << std::endl;
+    std::cout << "=====================================================" << std::endl;
+    }
+
+  bool violated = false;
+  if( inputTensorVolume.size() == 0 )
+    {
+    violated = true; std::cout << "  --inputTensorVolume Required! "  << std::endl;
+    }
+  if( outputVolume.size() == 0 )
+    {
+    violated = true; std::cout << "  --outputVolume Required! "  << std::endl;
+    }
+  if( violated )
+    {
+    return EXIT_FAILURE;
+    }
+
+  typedef itk::ImageFileReader<TensorImageType> TensorImageReaderType;
+  TensorImageReaderType::Pointer tensorImageReader = TensorImageReaderType::New();
+  tensorImageReader->SetFileName( inputTensorVolume );
+
+  EigenFieldFilterType::Pointer eigenFieldFilter = EigenFieldFilterType::New();
+  eigenFieldFilter->SetInput( tensorImageReader->GetOutput() );
+
+  typedef itk::ImageFileWriter<EigenFieldFilterType::EigenFieldImageType> WriterType;
+  WriterType::Pointer eigenFieldWriter = WriterType::New();
+  eigenFieldWriter->UseCompressionOn();
+  eigenFieldWriter->SetInput( eigenFieldFilter->GetOutput() );
+  eigenFieldWriter->SetFileName( outputVolume );
+  try
+    {
+    eigenFieldWriter->Update();
+    }
+  catch( itk::ExceptionObject & e )
+    {
+    std::cout << e << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "DtiFiberLoopDetector.h"
+
+#include <cmath>
+
+namespace
+{
+const size_t InitialTableSize = 64;
+}
+
+DtiFiberLoopDetector::DtiFiberLoopDetector()
+{
+  this->Reset(0.001);
+}
+
+void DtiFiberLoopDetector::Reset(const double tolerance)
+{
+  m_Tolerance = tolerance;
+  m_SquaredTolerance = tolerance * tolerance;
+  // Cells are a hair larger than the tolerance, so that rounding can never
+  // put two points closer than the tolerance two cells apart.
+  const double cellSize = std::fabs(tolerance) * ( 1.0 + 1e-6 );
+  m_InverseCellSize = ( cellSize > 0.0 ) ? 1.0 / cellSize : 0.0;
+
+  m_Points.clear();
+  m_NextInCell.clear();
+  m_CellKeys.assign(InitialTableSize, CellKey() );
+  m_CellFirstPoint.assign(InitialTableSize, -1);
+  m_NumberOfCells = 0;
+}
+
+DtiFiberLoopDetector::CellKey DtiFiberLoopDetector::GetCellKey(const double p[3]) const
+{
+  CellKey key;
+
+  key.x = static_cast<long long>( std::floor(p[0] * m_InverseCellSize) );
+  key.y = static_cast<long long>( std::floor(p[1] * m_InverseCellSize) );
+  key.z = static_cast<long long>( std::floor(p[2] * m_InverseCellSize) );
+  return key;
+}
+
+size_t DtiFiberLoopDetector::GetSlot(const CellKey & key) const
+{
+  // Slot of the cell, or the empty slot where it would go
+  const unsigned long long hash = static_cast<unsigned long long>( key.x ) * 73856093ULL
+    ^ static_cast<unsigned long long>( key.y ) * 19349663ULL
+    ^ static_cast<unsigned long long>( key.z ) * 83492791ULL;
+  const size_t mask = m_CellKeys.size() - 1;
+  size_t       slot = static_cast<size_t>( hash ) & mask;
+
+  while( m_CellFirstPoint[slot] >= 0
+         && ( m_CellKeys[slot].x != key.x || m_CellKeys[slot].y != key.y || m_CellKeys[slot].z != key.z ) )
+    {
+    slot = ( slot + 1 ) & mask;
+    }
+  return slot;
+}
+
+void DtiFiberLoopDetector::GrowTable()
+{
+  const std::vector<CellKey> oldKeys(m_CellKeys);
+  const std::vector<long>    oldFirstPoints(m_CellFirstPoint);
+
+  m_CellKeys.assign(2 * oldKeys.size(), CellKey() );
+  m_CellFirstPoint.assign(2 * oldKeys.size(), -1);
+  for( size_t i = 0; i < oldKeys.size(); ++i )
+    {
+    if( oldFirstPoints[i] >= 0 )
+      {
+      const size_t slot = this->GetSlot(oldKeys[i]);
+      m_CellKeys[slot] = oldKeys[i];
+      m_CellFirstPoint[slot] = oldFirstPoints[i];
+      }
+    }
+}
+
+void DtiFiberLoopDetector::AddPoint(const double p[3])
+{
+  const long index = static_cast<long>( this->GetNumberOfPoints() );
+
+  m_Points.push_back(p[0]);
+  m_Points.push_back(p[1]);
+  m_Points.push_back(p[2]);
+
+  if( 2 * ( m_NumberOfCells + 1 ) > m_CellKeys.size() )
+    {
+    this->GrowTable();
+    }
+  const CellKey key = this->GetCellKey(p);
+  const size_t  slot = this->GetSlot(key);
+  if( m_CellFirstPoint[slot] < 0 )
+    {
+    m_CellKeys[slot] = key;
+    ++m_NumberOfCells;
+    }
+  m_NextInCell.push_back(m_CellFirstPoint[slot]);
+  m_CellFirstPoint[slot] = index;
+}
+
+bool DtiFiberLoopDetector::IsNearAnyPoint(const double p1[3]) const
+{
+  if( !( m_SquaredTolerance > 0.0 ) )
+    {
+    return false;
+    }
+  const CellKey center = this->GetCellKey(p1);
+  for( long long dz = -1; dz <= 1; ++dz )
+    {
+    for( long long dy = -1; dy <= 1; ++dy )
+      {
+      for( long long dx = -1; dx <= 1; ++dx )
+        {
+        CellKey key;
+        key.x = center.x + dx;
+        key.y = center.y + dy;
+        key.z = center.z + dz;
+        for( long i = m_CellFirstPoint[this->GetSlot(key)]; i >= 0; i = m_NextInCell[i] )
+          {
+          const double *p2 = this->GetPoint(i);
+          const double  distance
+            = ( p1[0]
+                - p2[0] ) * ( p1[0] - p2[0] ) + ( p1[1] - p2[1] ) * ( p1[1] - p2[1] ) + ( p1[2] - p2[2] ) * ( p1[2] - p2[2] );
+          if( distance < m_SquaredTolerance )
+            {
+            return true;
+            }
+          }
+        }
+      }
+    }
+  return false;
+}
@@ -0,0 +1,92 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __DtiFiberLoopDetector_h
+#define __DtiFiberLoopDetector_h
+
+#include "gtractCommonWin32.h"
+
+#include <cstddef>
+#include <vector>
+
+/** \class DtiFiberLoopDetector
+ *  \brief Points of one fiber hashed on a grid of tolerance sized cells.
+ *
+ *  A point closer than the tolerance to a stored point can only lie in the
+ *  same cell or in one of its 26 neighbours, so checking a new point against
+ *  the whole fiber costs a constant number of distance tests instead of one
+ *  per fiber point. The test itself is the one of
+ *  DtiTrackingFilterBase::IsLoop: squared distance below squared tolerance.
+ */
+class GTRACT_COMMON_EXPORT DtiFiberLoopDetector
+{
+public:
+  DtiFiberLoopDetector();
+
+  /** Forget all points and use a new tolerance */
+  void Reset(const double tolerance);
+
+  double GetTolerance() const
+  {
+    return m_Tolerance;
+  }
+
+  size_t GetNumberOfPoints() const
+  {
+    return m_Points.size() / 3;
+  }
+
+  const double * GetPoint(const size_t i) const
+  {
+    return &( m_Points[3 * i] );
+  }
+
+  void AddPoint(const double p[3]);
+
+  /** Is p closer than the tolerance to any point added so far */
+  bool IsNearAnyPoint(const double p[3]) const;
+
+private:
+  struct CellKey
+    {
+    long long x;
+    long long y;
+    long long z;
+    };
+
+  CellKey GetCellKey(const double p[3]) const;
+
+  size_t GetSlot(const CellKey & key) const;
+
+  void GrowTable();
+
+  double m_Tolerance;
+  double m_SquaredTolerance;
+  double m_InverseCellSize;
+
+  /* flat x,y,z coordinates, and for every point the next one in its cell */
+  std::vector<double> m_Points;
+  std::vector<long>   m_NextInCell;
+
+  /* open addressing table of the occupied cells, size a power of two */
+  std::vector<CellKey> m_CellKeys;
+  std::vector<long>    m_CellFirstPoint;
+  size_t               m_NumberOfCells;
+};
+
+#endif
@@ -48,6 +48,7 @@
 #include <itkConstNeighborhoodIterator.h>
 
 #include "GtractTypes.h"
+#include "itkTensorToEigenFieldImageFilter.h"
 #include <map>
 #include <string>
 
@@ -175,6 +176,9 @@ private:
   typedef typename EigenvectorImageType::Pointer               EigenvectorImagePointer;
   typedef itk::ConstNeighborhoodIterator<EigenvectorImageType> ConstNeighborhoodIteratorType;
 
+  typedef TensorToEigenFieldImageFilter<TensorImageType>     EigenFieldFilterType;
+  typedef typename EigenFieldFilterType::EigenFieldImageType EigenFieldImageType;
+
   /** Set the container of Alive Points representing the initial front.
    * Alive points are represented as a VectorContainer of LevelSetNodes. */
   void SetAlivePoints( NodeContainer *points )
@@ -228,6 +232,10 @@ private:
   itkSetObjectMacro(AnisotropyImage,  AnisotropyImageType);
   itkGetConstObjectMacro(AnisotropyImage,  AnisotropyImageType);
 
+  /** Optional eigen field of the input tensors, from
+   *  TensorToEigenFieldImageFilter. It is computed when not set. */
+  itkSetObjectMacro(EigenFieldImage,  EigenFieldImageType);
+
   /** Set/Get the Normalization Factor for the Speed Image.
       The values in the Speed Image is divided by this
       factor. This allows the use of images with
@@ -358,6 +366,8 @@ private:
   TensorImagePointer     m_TensorImage;
   AnisotropyImagePointer m_AnisotropyImage;
 
+  typename EigenFieldImageType::Pointer m_EigenFieldImage;
+
   LabelImagePointer       m_LabelImage;
   OutputSpeedImagePointer m_OutputSpeedImage;
   EigenvectorImagePointer m_EigenvectorImage;
@@ -222,7 +222,21 @@ void DtiFastMarchingCostFilter<TLevelSet, TTensorImage>
   m_OutputSpeedImage->SetMetaDataDictionary( output->GetMetaDataDictionary() );
   m_OutputSpeedImage->Allocate();
 
-  /*Read Tensor Image and set principal eigenvector image*/
+  /*Set principal eigenvector image from the eigen field of the tensors*/
+  typename EigenFieldImageType::Pointer eigenField = m_EigenFieldImage;
+  if( eigenField.IsNull() )
+    {
+    typename EigenFieldFilterType::Pointer eigenFieldFilter = EigenFieldFilterType::New();
+    eigenFieldFilter->SetInput( tensorImage );
+    eigenFieldFilter->SetNumberOfThreads( this->GetNumberOfThreads() );
+    eigenFieldFilter->Update();
+    eigenField = eigenFieldFilter->GetOutput();
+    }
+  else if( eigenField->GetLargestPossibleRegion() != tensorImage->GetLargestPossibleRegion() )
+    {
+    itkExceptionMacro(<< "The eigen field and the tensor image must have the same region");
+    }
+
   m_EigenvectorImage->SetRegions( tensorImage->GetLargestPossibleRegion() );
   m_EigenvectorImage->SetSpacing( tensorImage->GetSpacing() );
   m_EigenvectorImage->SetOrigin( tensorImage->GetOrigin() );
@@ -232,43 +246,15 @@ void DtiFastMarchingCostFilter<TLevelSet, TTensorImage>
   typedef itk::ImageRegionIterator<EigenvectorImageType> EigIteratorType;
   EigIteratorType eigIt( m_EigenvectorImage, m_EigenvectorImage->GetRequestedRegion() );
 
-  typedef itk::ImageRegionConstIterator<TensorImageType> TensorImageIteratorType;
-  TensorImageIteratorType tensorIt( tensorImage, tensorImage->GetRequestedRegion() );
-  for( eigIt.GoToBegin(), tensorIt.GoToBegin(); !eigIt.IsAtEnd() && !tensorIt.IsAtEnd(); ++eigIt, ++tensorIt )
+  typedef itk::ImageRegionConstIterator<EigenFieldImageType> EigenFieldIteratorType;
+  EigenFieldIteratorType eigenFieldIt( eigenField, m_EigenvectorImage->GetRequestedRegion() );
+  for( eigIt.GoToBegin(), eigenFieldIt.GoToBegin(); !eigIt.IsAtEnd(); ++eigIt, ++eigenFieldIt )
     {
     EigenvectorPixelType principalEigenvector;
-    TensorImageIndexType tensorIndex = tensorIt.GetIndex();
-
-    // Define type of tensor pixel
-    const unsigned int tensElements = 6;
-    typedef itk::Vector<float, tensElements> VectorTensorPixelType;
-    VectorTensorPixelType tensor;
-
-    TensorImagePixelType tensorPixel =  tensorImage->GetPixel(tensorIndex);
-    for( unsigned int i = 0; i < tensElements; i++ )
-      {
-      tensor[i] = tensorPixel[i];
-      }
-
-    if( tensor.GetNorm() != 0 )
+    for( unsigned int i = 0; i < dimension; i++ )
       {
-      typename TensorImagePixelType::EigenValuesArrayType   eigenValues;
-      typename TensorImagePixelType::EigenVectorsMatrixType eigenVectors;
-      tensorPixel.ComputeEigenAnalysis(eigenValues, eigenVectors);
-      for( unsigned int i = 0; i < dimension; i++ )
-        {
-        principalEigenvector[i] = eigenVectors[( dimension - 1 )][i];
-        }
-      }
-
-    else
-      {
-      for( unsigned int i = 0; i < dimension; i++ )
-        {
-        principalEigenvector[i] = 0.0;
-        }
+      principalEigenvector[i] = eigenFieldIt.Get()[EigenFieldFilterType::PrincipalEigenvectorOffset + i];
       }
-
     eigIt.Set( principalEigenvector );
     }
 
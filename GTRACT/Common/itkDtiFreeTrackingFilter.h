@@ -87,11 +87,20 @@ public:
   void Update();
 
 protected:
+  typedef typename Superclass::ContinuousIndexType   ContinuousIndexType;
+  typedef typename Superclass::TrackingInterpolators TrackingInterpolators;
+  typedef typename Superclass::FiberBuffer           FiberBuffer;
+
   DtiFreeTrackingFilter();
   ~DtiFreeTrackingFilter()
   {
   }
 
+  /** Follow the principal eigenvector until the anisotropy or the curvature
+   *  stops the fiber. Fibers of at least the minimum length are kept. */
+  virtual bool TrackFiber(const ContinuousIndexType & seed, const TVector & direction, TrackingInterpolators & ip,
+                          FiberBuffer & fiber, float & pathLength) ITK_OVERRIDE;
+
 private:
   DtiFreeTrackingFilter(const Self &); // purposely not implemented
   void operator=(const Self &);        // purposely not implemented
@@ -86,18 +86,6 @@ void
 DtiFreeTrackingFilter<TTensorImageType, TAnisotropyImageType, TMaskImageType>
 ::Update()
 {
-  typedef typename Self::TensorImageType::PixelType::EigenValuesArrayType   EigenValuesArrayType;
-  typedef typename Self::TensorImageType::PixelType::EigenVectorsMatrixType EigenVectorsMatrixType;
-
-  float anisotropy(0), anisotropySum(0);
-
-  TVector vin(3), vout(3);
-
-  typename Self::ContinuousIndexType index, tmpIndex;
-  bool stop;
-
-  const float inRadians = this->pi / 180.0;
-  float       curvatureThreshold = vcl_cos( this->m_CurvatureThreshold * inRadians );
   /** Initialize Fiber Tracking **/
   this->m_Output = vtkPolyData::New();
   this->m_TrackingDirections.clear();
@@ -105,140 +93,116 @@ DtiFreeTrackingFilter<TTensorImageType, TAnisotropyImageType, TMaskImageType>
 
   this->m_ScalarIP->SetInputImage(this->m_AnisotropyImage);
   this->m_VectorIP->SetInputImage(this->m_TensorImage);
-  typename Self::AnisotropyImageRegionType ImageRegion = this->m_AnisotropyImage->GetLargestPossibleRegion();
 
   this->m_StartIP->SetInputImage(this->m_StartingRegion);
   Self::InitializeSeeds();
 
   /*** May want to add loop detection and Max length conditional checking ***/
+  this->TrackSeeds();
+}
+
+template <class TTensorImageType, class TAnisotropyImageType, class TMaskImageType>
+bool
+DtiFreeTrackingFilter<TTensorImageType, TAnisotropyImageType, TMaskImageType>
+::TrackFiber(const ContinuousIndexType & seed, const TVector & direction, TrackingInterpolators & ip,
+             FiberBuffer & fiber, float & pathLength)
+{
+  float anisotropy(0);
 
-  while( !this->m_Seeds.empty() )
+  TVector vin(3), vout(3);
+
+  ContinuousIndexType index, tmpIndex;
+  bool                stop = false;
+
+  const float inRadians = this->pi / 180.0;
+  float       curvatureThreshold = vcl_cos( this->m_CurvatureThreshold * inRadians );
+  typename Self::AnisotropyImageRegionType ImageRegion = this->m_AnisotropyImage->GetLargestPossibleRegion();
+
+  index = seed;
+  vin = vout = direction;
+  pathLength = 0.0;
+
+  // ////////////////////////////////////////////////////////////////////////
+  // Tracking start from given 'index' and 'vout'
+  while( !stop )
     {
-    index = this->m_Seeds.back();
-    this->m_Seeds.pop_back();
-    vin = vout  = this->m_TrackingDirections.back();
-    this->m_TrackingDirections.pop_back();
-    // std::cerr << "Next seed: " << index << " ";
-    stop = false;
-    vtkPoints *    fiber = vtkPoints::New();
-    vtkFloatArray *fiberTensors = vtkFloatArray::New();
-    fiberTensors->SetName("Tensors");
-    fiberTensors->SetNumberOfComponents(9);
-    vtkFloatArray *fiberAnisotropy = vtkFloatArray::New();
-    fiberAnisotropy->SetName("Anisotropy");
-    vtkFloatArray *fiberAnisotropySum = vtkFloatArray::New();
-    fiberAnisotropySum->SetName("Anisotropy-Sum");
-    int   currentPointId = 0;
-    float pathLength = 0.0;
+    if( ImageRegion.IsInside(index) )
+      {
+      anisotropy = ip.ScalarIP->EvaluateAtContinuousIndex(index);
+      }
+    else
+      {
+      anisotropy = -1;
+      }
 
+    //
     // ////////////////////////////////////////////////////////////////////////
-    // Tracking start from given 'index' and 'vout'
-    while( !stop )
+    // evaluate the stopping criteria
+    if( anisotropy >= this->m_AnisotropyThreshold )
       {
-      if( ImageRegion.IsInside(index) )
+      if( pathLength > this->m_MaximumLength )
         {
-        anisotropy = this->m_ScalarIP->EvaluateAtContinuousIndex(index);
+        stop = true;
         }
-      else
+
+      //
+      // ////////////////////////////////////////////////////////////////////////
+      // forward propagating
+      typename Self::TensorImagePixelType tensorPixel = ip.VectorIP->EvaluateAtContinuousIndex(index);
+
+      TMatrix fullTensorPixel(3, 3); fullTensorPixel = Tensor2Matrix( tensorPixel );
+      this->AddPointToFiber( index, fullTensorPixel, fiber );
+
+      //
+      // ////////////////////////////////////////////////////////////////////////
+      // Get major vector
+      TVector e2(3);
+      this->GetPrincipalEigenvector( ip.EigenIP.GetPointer(), index, tensorPixel, e2 );
+      if( dot_product(vin, e2) < 0 )
         {
-        anisotropy = -1;
+        e2 *= -1;
         }
 
       //
       // ////////////////////////////////////////////////////////////////////////
-      // evaluate the stopping criteria
-      // std::cerr << "Test anisotropy " << anisotropy << " >= " <<
-      // this->m_AnisotropyThreshold << std::endl;
-      if( anisotropy >= this->m_AnisotropyThreshold )
+      // Choose an outgoing direction
+      float vin_dot_e2 = dot_product(vin, e2);
+      if( vin_dot_e2 > curvatureThreshold )
         {
-        if( pathLength > this->m_MaximumLength )
-          {
-          stop = true;
-          }
-
         //
         // ////////////////////////////////////////////////////////////////////////
-        // forward propagating
-        if( currentPointId == 0 )
+        // With TEND
+        if( this->m_UseTend )
           {
-          anisotropySum = anisotropy;
+          this->ApplyTensorDeflection(vin, fullTensorPixel, e2, vout);
           }
         else
           {
-          anisotropySum += anisotropy;
+          vout = e2;
           }
 
-        typename Self::PointType p;
-        this->ContinuousIndexToMM(index, p);
-        currentPointId = fiber->InsertNextPoint( p.GetDataPointer() );
-        fiberAnisotropy->InsertNextValue( anisotropy );
-        fiberAnisotropySum->InsertNextValue( anisotropySum );
-
-        EigenValuesArrayType   eigenValues;
-        EigenVectorsMatrixType eigenVectors;
-        typename Self::TensorImagePixelType tensorPixel = this->m_VectorIP->EvaluateAtContinuousIndex(index);
-
-        TMatrix fullTensorPixel(3, 3); fullTensorPixel = Tensor2Matrix( tensorPixel );
-        fiberTensors->InsertNextTupleValue( fullTensorPixel.data_block() );
-
-        tensorPixel.ComputeEigenAnalysis(eigenValues, eigenVectors);
+        // Calculate the new index
+        this->StepIndex(tmpIndex, index, vout);
+        pathLength += this->m_StepSize;
 
-        //
-        // ////////////////////////////////////////////////////////////////////////
-        // Get major vector
-        TVector e2(3); e2[0] = eigenVectors[2][0]; e2[1] = eigenVectors[2][1]; e2[2] = eigenVectors[2][2];
-        if( dot_product(vin, e2) < 0 )
-          {
-          e2 *= -1;
-          }
-
-        //
-        // ////////////////////////////////////////////////////////////////////////
-        // Choose an outgoing direction
-        float vin_dot_e2 = dot_product(vin, e2);
-        // std::cerr << "Compare " << vin_dot_e2 << " > " << curvatureThreshold
-        // << std::endl;
-        if( vin_dot_e2 > curvatureThreshold )
-          {
-          //
-          // ////////////////////////////////////////////////////////////////////////
-          // With TEND
-          if( this->m_UseTend )
-            {
-            this->ApplyTensorDeflection(vin, fullTensorPixel, e2, vout);
-            }
-          else
-            {
-            vout = e2;
-            }
-
-          // Calculate the new index
-          this->StepIndex(tmpIndex, index, vout);
-          pathLength += this->m_StepSize;
-
-          // Update the current index
-          index = tmpIndex;
-          vin = vout;
-          }
-        else  // Curvature Threshold
-          {
-          stop = true;
-          }
+        // Update the current index
+        index = tmpIndex;
+        vin = vout;
         }
-      else // Anisotropy Threshold
+      else  // Curvature Threshold
         {
         stop = true;
         }
       }
-
-    // Free Tracking Adds all Fibers to the Result as lonmg as they
-    // meet the minimum length criteria
-    if( pathLength >= this->m_MinimumLength )
+    else // Anisotropy Threshold
       {
-      std::cerr << "Fiber (" << pathLength << "); ";
-      this->AddFiberToOutput( fiber, fiberTensors );
+      stop = true;
       }
     }
+
+  // Free Tracking Adds all Fibers to the Result as lonmg as they
+  // meet the minimum length criteria
+  return pathLength >= this->m_MinimumLength;
 }
 } // end namespace itk
 #endif
@@ -79,9 +79,6 @@ void
 DtiGuidedTrackingFilter<TTensorImageType, TAnisotropyImageType, TMaskImageType>
 ::Update()
 {
-  typedef typename Self::TensorImageType::PixelType::EigenValuesArrayType   EigenValuesArrayType;
-  typedef typename Self::TensorImageType::PixelType::EigenVectorsMatrixType EigenVectorsMatrixType;
-
   // std::cout << this->m_AnisotropyImage;
 
   this->m_Output = vtkPolyData::New();
@@ -190,16 +187,13 @@ DtiGuidedTrackingFilter<TTensorImageType, TAnisotropyImageType, TMaskImageType>
         // Seeking guidance
         bool isGuided = GuideDirection(index, this->m_GuideFiber, MaxDist, vguide);
 
-        EigenValuesArrayType   eigenValues;
-        EigenVectorsMatrixType eigenVectors;
         typename Self::TensorImagePixelType tensorPixel = this->m_VectorIP->EvaluateAtContinuousIndex(index);
 
         TMatrix fullTensorPixel(3, 3); fullTensorPixel = Tensor2Matrix( tensorPixel );
         fiberTensors->InsertNextTupleValue( fullTensorPixel.data_block() );
 
-        tensorPixel.ComputeEigenAnalysis(eigenValues, eigenVectors);
-
-        TVector e2(3); e2[0] = eigenVectors[2][0]; e2[1] = eigenVectors[2][1]; e2[2] = eigenVectors[2][2];
+        TVector e2(3);
+        this->GetPrincipalEigenvector( this->GetEigenFieldInterpolator(), index, tensorPixel, e2 );
         // std::cout << "\tEigen Vector " << e2 << " Guide Direction " << vguide
         // << std::endl;
         if( isGuided )
@@ -87,11 +87,21 @@ public:
   void Update();
 
 protected:
+  typedef typename Superclass::ContinuousIndexType   ContinuousIndexType;
+  typedef typename Superclass::TrackingInterpolators TrackingInterpolators;
+  typedef typename Superclass::FiberBuffer           FiberBuffer;
+
   DtiStreamlineTrackingFilter();
   ~DtiStreamlineTrackingFilter()
   {
   }
 
+  /** Follow the principal eigenvector until the anisotropy, the curvature or
+   *  the maximum length stops the fiber. Fibers of at least the minimum
+   *  length that reach the ending region are kept. */
+  virtual bool TrackFiber(const ContinuousIndexType & seed, const TVector & direction, TrackingInterpolators & ip,
+                          FiberBuffer & fiber, float & pathLength) ITK_OVERRIDE;
+
 private:
   DtiStreamlineTrackingFilter(const Self &); // purposely not implemented
   void operator=(const Self &);              // purposely not implemented
@@ -71,174 +71,127 @@ void
 DtiStreamlineTrackingFilter<TTensorImageType, TAnisotropyImageType, TMaskImageType>
 ::Update()
 {
-  typedef typename Self::TensorImageType::PixelType::EigenValuesArrayType   EigenValuesArrayType;
-  typedef typename Self::TensorImageType::PixelType::EigenVectorsMatrixType EigenVectorsMatrixType;
-
-  float   anisotropy, anisotropySum(0);
-  TVector vin(3), vout(3);
-
-  typename Self::ContinuousIndexType index, tmpIndex;
-  bool stop;
-  bool addFiber;
-
-  const double inRadians = this->pi / 180.0;
-  double       curvatureThreshold = vcl_cos( this->m_CurvatureThreshold * inRadians );
-
   this->m_Output = vtkPolyData::New();
   this->m_TrackingDirections.clear();
   this->m_Seeds.clear();
   this->m_ScalarIP->SetInputImage(this->m_AnisotropyImage);
   this->m_VectorIP->SetInputImage(this->m_TensorImage);
   this->m_EndIP->SetInputImage(this->m_EndingRegion);
-  typename Self::AnisotropyImageRegionType ImageRegion = this->m_AnisotropyImage->GetLargestPossibleRegion();
 
   this->m_StartIP->SetInputImage(this->m_StartingRegion);
   Self::InitializeSeeds();
 
-  // std::cout << "Image Region for Tracking: " << ImageRegion << std::endl;
   /*** Add length and Loop Detection ***/
-  while( !this->m_Seeds.empty() )
+  this->TrackSeeds();
+}
+
+template <class TTensorImageType, class TAnisotropyImageType, class TMaskImageType>
+bool
+DtiStreamlineTrackingFilter<TTensorImageType, TAnisotropyImageType, TMaskImageType>
+::TrackFiber(const ContinuousIndexType & seed, const TVector & direction, TrackingInterpolators & ip,
+             FiberBuffer & fiber, float & pathLength)
+{
+  float   anisotropy;
+  TVector vin(3), vout(3);
+
+  ContinuousIndexType index, tmpIndex;
+  bool                stop = false;
+  bool                addFiber = false;
+
+  const double inRadians = this->pi / 180.0;
+  double       curvatureThreshold = vcl_cos( this->m_CurvatureThreshold * inRadians );
+  typename Self::AnisotropyImageRegionType ImageRegion = this->m_AnisotropyImage->GetLargestPossibleRegion();
+
+  index = seed;
+  vin = vout = direction;
+  pathLength = 0.0;
+
+  // ////////////////////////////////////////////////////////////////////////
+  // Tracking start from given 'index' and 'vout'
+  while( !stop )
     {
-    index = this->m_Seeds.back();              this->m_Seeds.pop_back();
-    vin = vout  = this->m_TrackingDirections.back();  this->m_TrackingDirections.pop_back();
-
-    stop = false;
-    addFiber = false;
-    vtkPoints *    fiber = vtkPoints::New();
-    vtkFloatArray *fiberTensors = vtkFloatArray::New();
-    fiberTensors->SetName("Tensors");
-    fiberTensors->SetNumberOfComponents(9);
-    vtkFloatArray *fiberAnisotropy = vtkFloatArray::New();
-    fiberAnisotropy->SetName("Anisotropy");
-    vtkFloatArray *fiberAnisotropySum = vtkFloatArray::New();
-    fiberAnisotropySum->SetName("Anisotropy-Sum");
-    int   currentPointId = 0;
-    float pathLength = 0.0;
+    if( ImageRegion.IsInside(index) )
+      {
+      anisotropy = ip.ScalarIP->EvaluateAtContinuousIndex(index);
+      }
+    else
+      {
+      anisotropy = -1;
+      }
 
+    //
     // ////////////////////////////////////////////////////////////////////////
-    // Tracking start from given 'index' and 'vout'
-    while( !stop )
+    // evaluate the stopping criteria
+    if( anisotropy >= this->m_AnisotropyThreshold )
       {
-      if( ImageRegion.IsInside(index) )
+      if( ip.EndIP->EvaluateAtContinuousIndex(index) >= 0.5 )
         {
-        anisotropy = this->m_ScalarIP->EvaluateAtContinuousIndex(index);
+        stop = true;
+        addFiber = true;
         }
-      else
+
+      if( pathLength > this->m_MaximumLength )
         {
-        anisotropy = -1;
+        stop = true;
         }
 
       //
       // ////////////////////////////////////////////////////////////////////////
+      // forward propagating
+      typename Self::TensorImagePixelType tensorPixel = ip.VectorIP->EvaluateAtContinuousIndex(index);
+
+      TMatrix fullTensorPixel(3, 3); fullTensorPixel = Tensor2Matrix( tensorPixel );
+      this->AddPointToFiber( index, fullTensorPixel, fiber );
 
       //
       // ////////////////////////////////////////////////////////////////////////
-      // evaluate the stopping criteria
-      // std::cerr << "Test anisotropy " << anisotropy << " >= " <<
-      // this->m_AnisotropyThreshold << std::endl;
-      if( anisotropy >= this->m_AnisotropyThreshold )
+      // Get major vector
+      TVector e2(3);
+      this->GetPrincipalEigenvector( ip.EigenIP.GetPointer(), index, tensorPixel, e2 );
+      if( dot_product(vin, e2) < 0 )
         {
-        if( this->m_EndIP->EvaluateAtContinuousIndex(index) >= 0.5 )
-          {
-          stop = true;
-          addFiber = true;
-          // std::cerr << "Stop - Found End" << std::endl;
-          }
-        // std::cerr << "Test Pathlength " << pathLength << " > " <<
-        // this->m_MaximumLength << std::endl;
-
-        if( pathLength > this->m_MaximumLength )
-          {
-          stop = true;
-          // std::cerr << "Stop Max Length" << std::endl;
-          }
+        e2 *= -1;
+        }
 
-        //
-        // ////////////////////////////////////////////////////////////////////////
-        // forward propagating
-        if( currentPointId )
+      //
+      // ////////////////////////////////////////////////////////////////////////
+      // Choose an outgoing direction
+      double vin_dot_e2 = dot_product(vin, e2);
+      if( vin_dot_e2 > curvatureThreshold )
+        {
+        // Use TEND ???
+        if( this->m_UseTend )
           {
-          anisotropySum = anisotropySum + anisotropy;
+          this->ApplyTensorDeflection(vin, fullTensorPixel, e2, vout);
           }
         else
           {
-          anisotropySum = anisotropy;
+          vout = e2;
           }
-        fiberAnisotropy->InsertNextValue( anisotropy );
-        fiberAnisotropySum->InsertNextValue( anisotropySum );
-
-        typename Self::PointType p;
-        this->ContinuousIndexToMM(index, p);
-        fiber->InsertNextPoint( p.GetDataPointer() );
-        currentPointId++;
-
-        EigenValuesArrayType   eigenValues;
-        EigenVectorsMatrixType eigenVectors;
-        typename Self::TensorImagePixelType tensorPixel = this->m_VectorIP->EvaluateAtContinuousIndex(index);
-
-        TMatrix fullTensorPixel(3, 3); fullTensorPixel = Tensor2Matrix( tensorPixel );
-        fiberTensors->InsertNextTupleValue( fullTensorPixel.data_block() );
-
-        tensorPixel.ComputeEigenAnalysis(eigenValues, eigenVectors);
-
         //
         // ////////////////////////////////////////////////////////////////////////
-        // Get major vector
-        TVector e2(3); e2[0] = eigenVectors[2][0]; e2[1] = eigenVectors[2][1]; e2[2] = eigenVectors[2][2];
-        if( dot_product(vin, e2) < 0 )
-          {
-          e2 *= -1;
-          }
+        // Calculate the new index
+        this->StepIndex(tmpIndex, index, vout);
+        pathLength += this->m_StepSize;
 
         //
         // ////////////////////////////////////////////////////////////////////////
-        // Choose an outgoing direction
-        double vin_dot_e2 = dot_product(vin, e2);
-        // std::cerr << "Compare " << vin_dot_e2 << " > " <<
-        // this->m_CurvatureThreshold << std::endl;
-        // std::cerr << "Vin " << vin << " E2 " << e2 << std::endl;
-        if( vin_dot_e2 > curvatureThreshold )
-          {
-          // Use TEND ???
-          if( this->m_UseTend )
-            {
-            this->ApplyTensorDeflection(vin, fullTensorPixel, e2, vout);
-            }
-          else
-            {
-            vout = e2;
-            }
-          //
-          // ////////////////////////////////////////////////////////////////////////
-          // Calculate the new index
-          this->StepIndex(tmpIndex, index, vout);
-          pathLength += this->m_StepSize;
-
-          //
-          // ////////////////////////////////////////////////////////////////////////
-          // Update the current index
-          index = tmpIndex;
-          vin = vout;
-          }
-        else  // Curvature Threshold
-          {
-          stop = true;
-          // std::cerr << "Stop Curvature" << std::endl;
-          }
+        // Update the current index
+        index = tmpIndex;
+        vin = vout;
         }
-      else   // Anisotropy Threshold
+      else  // Curvature Threshold
         {
         stop = true;
-        // std::cerr << "Stop Anisotropy" << std::endl;
         }
       }
-
-    if( addFiber && ( pathLength >= this->m_MinimumLength ) )
+    else   // Anisotropy Threshold
       {
-      std::cerr << "Fiber (" << pathLength << "); ";
-      this->AddFiberToOutput( fiber, fiberTensors );
+      stop = true;
       }
     }
+
+  return addFiber && ( pathLength >= this->m_MinimumLength );
 }
 } // end namespace itk
 #endif
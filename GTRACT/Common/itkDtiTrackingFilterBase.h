@@ -53,6 +53,8 @@
 #include "itkObject.h"
 #include "itkImage.h"
 #include "itkImage.h"
+#include "itkMultiThreader.h"
+#include "itkSimpleFastMutexLock.h"
 #include "itkImageToImageFilter.h"
 // #include "itkIOCommon.h"
 #include "itkLinearInterpolateImageFunction.h"
@@ -75,9 +77,13 @@
 #include "algo.h"
 #include "GtractTypes.h"
 #include "itkTensorLinearInterpolateImageFunction.h"
+#include "itkTensorToEigenFieldImageFilter.h"
+#include "itkEigenFieldLinearInterpolateImageFunction.h"
+#include "DtiFiberLoopDetector.h"
 
 #include <map>
 #include <string>
+#include <vector>
 
 // ////////////////////////////////////////////////////////////////////////
 
@@ -149,6 +155,9 @@ public:
   typedef itk::LinearInterpolateImageFunction<AnisotropyImageType, double>   ScalarIPType;
   typedef itk::TensorLinearInterpolateImageFunction<TensorImageType, double> VectorIPType;
 
+  typedef typename TensorToEigenFieldImageFilter<TensorImageType>::EigenFieldImageType EigenFieldImageType;
+  typedef itk::EigenFieldLinearInterpolateImageFunction<EigenFieldImageType, double>  EigenFieldIPType;
+
   typedef typename itk::ContinuousIndex<double, 3> ContinuousIndexType;
 
   typedef itk::Point<double, 3>          PointType;
@@ -185,6 +194,11 @@ public:
   itkSetObjectMacro(StartingRegion, MaskImageType);
   itkSetObjectMacro(EndingRegion, MaskImageType);
 
+  /** Optional eigen field of the tensor image, from
+   *  TensorToEigenFieldImageFilter. When set, the principal eigenvectors
+   *  are interpolated from it instead of decomposing the tensors. */
+  itkSetObjectMacro(EigenFieldImage, EigenFieldImageType);
+
   itkSetMacro(SeedThreshold, float);
   itkSetMacro(AnisotropyThreshold, float);
   itkSetMacro(MaximumLength, float);
@@ -195,6 +209,11 @@ public:
   itkSetMacro(TendG, float);
   itkSetMacro(TendF, float);
 
+  /** Number of threads tracing fibers from the seeds. The output does not
+   *  depend on it. Defaults to the global default number of threads. */
+  itkSetMacro(NumberOfThreads, unsigned int);
+  itkGetConstMacro(NumberOfThreads, unsigned int);
+
   DtiFiberType GetOutput();
 
   // void Update();
@@ -209,6 +228,9 @@ private:
   void operator=(const Self &);        // purposely not implemented
 
 protected:
+  /** Is the last point of fiber closer than tolerance to any of its other
+   *  points. The points are hashed as the fiber grows, so each call only
+   *  looks at the new points and the neighbourhood of the last one. */
   bool IsLoop(vtkPoints *fiber, double tolerance = 0.001);
 
   void InitializeSeeds();
@@ -227,6 +249,50 @@ protected:
 
   void AddFiberToOutput( vtkPoints *currentFiber, vtkFloatArray *fiberTensors );
 
+  /** Interpolators owned by one tracking thread */
+  struct TrackingInterpolators
+    {
+    typename ScalarIPType::Pointer ScalarIP;
+    typename VectorIPType::Pointer VectorIP;
+    typename MaskIPType::Pointer EndIP;
+    typename EigenFieldIPType::Pointer EigenIP;
+    };
+
+  /** Fibers traced from a run of consecutive seeds, stored flat */
+  struct FiberBuffer
+    {
+    std::vector<float>     Points;          // x, y, z of each point
+    std::vector<float>     Tensors;         // 9 tensor values of each point
+    std::vector<vtkIdType> NumberOfPoints;  // of each kept fiber
+    std::vector<float>     PathLengths;     // of each kept fiber
+    };
+
+  /** m_EigenIP if an eigen field is set, null otherwise */
+  const EigenFieldIPType * GetEigenFieldInterpolator() const
+  {
+    return m_EigenFieldImage.IsNotNull() ? m_EigenIP.GetPointer() : ITK_NULLPTR;
+  }
+
+  /** Principal eigenvector at index, from eigenIP when an eigen field is
+   *  set and from the eigen analysis of tensorPixel otherwise */
+  void GetPrincipalEigenvector(const EigenFieldIPType *eigenIP, const ContinuousIndexType & index,
+                               const TensorImagePixelType & tensorPixel, TVector & e2) const;
+
+  /** Append the point at index and its tensor to fiber */
+  void AddPointToFiber(ContinuousIndexType & index, const TMatrix & fullTensorPixel, FiberBuffer & fiber);
+
+  /** Trace one fiber from seed along direction, appending its points to
+   *  fiber, and tell whether it goes to the output. Called concurrently by
+   *  the tracking threads, so it may only change ip and fiber. */
+  virtual bool TrackFiber(const ContinuousIndexType & seed, const TVector & direction, TrackingInterpolators & ip,
+                          FiberBuffer & fiber, float & pathLength);
+
+  /** Trace fibers from all of m_Seeds on m_NumberOfThreads threads and
+   *  write them to m_Output. Threads take batches of seeds from a shared
+   *  counter; the fibers are merged once, in the order the seeds were
+   *  popped from the back of m_Seeds. */
+  void TrackSeeds();
+
   DirectionListType m_TrackingDirections;
 
   // Input and Output Image
@@ -237,12 +303,15 @@ protected:
   MaskImagePointer       m_StartingRegion;
   MaskImagePointer       m_EndingRegion;
 
+  typename EigenFieldImageType::Pointer m_EigenFieldImage;
+
   // Interpolation data:  The Vector is the Tensor image, the Scalar is the
   // Anisotropy image.
   typename ScalarIPType::Pointer m_ScalarIP;
   typename VectorIPType::Pointer m_VectorIP;
   typename MaskIPType::Pointer m_StartIP;
   typename MaskIPType::Pointer m_EndIP;
+  typename EigenFieldIPType::Pointer m_EigenIP;
 
   float m_SeedThreshold;
   float m_AnisotropyThreshold;
@@ -254,7 +323,29 @@ protected:
   float m_TendG;
   float m_TendF;
 
+  unsigned int m_NumberOfThreads;
+
   float pi;
+
+private:
+  /** Seeds a tracking thread takes from the shared counter at once */
+  itkStaticConstMacro(SeedsPerBatch, unsigned int, 64);
+
+  struct TrackingThreadStruct
+    {
+    Self *                                   Filter;
+    const std::vector<ContinuousIndexType> * Seeds;
+    const std::vector<TVector> *             Directions;
+    std::vector<FiberBuffer> *               Batches;
+    size_t                                   NextBatch;
+    SimpleFastMutexLock                      NextBatchLock;
+    };
+
+  static ITK_THREAD_RETURN_TYPE TrackingThreaderCallback( void *arg );
+
+  /* points of m_LoopDetectorFiber, all but its last one, for IsLoop */
+  DtiFiberLoopDetector m_LoopDetector;
+  vtkPoints *          m_LoopDetectorFiber;
 };  // end of class
 } // end namespace itk
 
@@ -55,6 +55,7 @@
 // #include "algo.h"
 
 
+#include <algorithm>
 #include <iostream>
 
 namespace itk
@@ -76,7 +77,10 @@ DtiTrackingFilterBase<TTensorImageType, TAnisotropyImageType, TMaskImageType>
   m_VectorIP    = VectorIPType::New();
   m_StartIP             = Self::MaskIPType::New();
   m_EndIP               = Self::MaskIPType::New();
+  m_EigenIP             = EigenFieldIPType::New();
   pi = 3.14159265358979323846;
+  m_LoopDetectorFiber = ITK_NULLPTR;
+  m_NumberOfThreads = MultiThreader::GetGlobalDefaultNumberOfThreads();
 }
 
 template <class TTensorImageType, class TAnisotropyImageType, class TMaskImageType>
@@ -167,24 +171,45 @@ bool
 DtiTrackingFilterBase<TTensorImageType, TAnisotropyImageType, TMaskImageType>
 ::IsLoop(vtkPoints *fiber, double tolerance)
 {
-  double p1[3], p2[3];
+  const vtkIdType numPts = fiber->GetNumberOfPoints();
 
-  const double tol2 = tolerance * tolerance;
-  const int    numPts = fiber->GetNumberOfPoints();
+  if( numPts < 2 )
+    {
+    return false;
+    }
 
-  fiber->GetPoint(numPts - 1, p1);
-  for( int i = numPts - 2; i >= 0; i-- )
+  // Start over for another fiber, another tolerance, or when points already
+  // hashed were removed or changed, as when backing up to a branch point.
+  const vtkIdType hashedPoints = static_cast<vtkIdType>( m_LoopDetector.GetNumberOfPoints() );
+  bool            restart = ( fiber != m_LoopDetectorFiber ) || ( tolerance != m_LoopDetector.GetTolerance() )
+    || ( hashedPoints > numPts - 1 );
+  if( !restart && hashedPoints > 0 )
     {
-    fiber->GetPoint(i, p2);
-    const double distance
-      = ( p1[0]
-          - p2[0] ) * ( p1[0] - p2[0] ) + ( p1[1] - p2[1] ) * ( p1[1] - p2[1] ) + ( p1[2] - p2[2] ) * ( p1[2] - p2[2] );
-    if( distance < tol2 )
+    double first[3];
+    double last[3];
+    fiber->GetPoint(0, first);
+    fiber->GetPoint(hashedPoints - 1, last);
+    const double *hashedFirst = m_LoopDetector.GetPoint(0);
+    const double *hashedLast = m_LoopDetector.GetPoint(hashedPoints - 1);
+    for( unsigned int i = 0; i < 3; ++i )
       {
-      return true;
+      restart = restart || ( first[i] != hashedFirst[i] ) || ( last[i] != hashedLast[i] );
       }
     }
-  return false;
+  if( restart )
+    {
+    m_LoopDetector.Reset(tolerance);
+    m_LoopDetectorFiber = fiber;
+    }
+
+  double p[3];
+  for( vtkIdType i = static_cast<vtkIdType>( m_LoopDetector.GetNumberOfPoints() ); i < numPts - 1; ++i )
+    {
+    fiber->GetPoint(i, p);
+    m_LoopDetector.AddPoint(p);
+    }
+  fiber->GetPoint(numPts - 1, p);
+  return m_LoopDetector.IsNearAnyPoint(p);
 }
 
 template <class TTensorImageType, class TAnisotropyImageType, class TMaskImageType>
@@ -195,8 +220,14 @@ DtiTrackingFilterBase<TTensorImageType, TAnisotropyImageType, TMaskImageType>
   // ////////////////////////////////////////////////////////////////////////
   // Initialize the seed points
 
-  typedef typename Self::TensorImageType::PixelType::EigenValuesArrayType   EigenValuesArrayType;
-  typedef typename Self::TensorImageType::PixelType::EigenVectorsMatrixType EigenVectorsMatrixType;
+  if( m_EigenFieldImage.IsNotNull() )
+    {
+    if( m_EigenFieldImage->GetLargestPossibleRegion() != m_TensorImage->GetLargestPossibleRegion() )
+      {
+      itkExceptionMacro(<< "The eigen field and the tensor image must have the same region");
+      }
+    m_EigenIP->SetInputImage( m_EigenFieldImage );
+    }
 
   typedef itk::ImageRegionConstIterator<MaskImageType> ConstMaskIteratorType;
   ConstMaskIteratorType maskIt( m_StartingRegion, m_StartingRegion->GetLargestPossibleRegion() );
@@ -215,12 +246,9 @@ DtiTrackingFilterBase<TTensorImageType, TAnisotropyImageType, TMaskImageType>
       maskcount++;
       if( ai >= m_SeedThreshold )
         {
-        EigenValuesArrayType   eigenValues;
-        EigenVectorsMatrixType eigenVectors;
         typename Self::TensorImagePixelType tensorPixel = this->m_VectorIP->EvaluateAtContinuousIndex(seed);
-        tensorPixel.ComputeEigenAnalysis(eigenValues, eigenVectors);
-        TVector direction(3); direction[0] = eigenVectors[2][0]; direction[1] = eigenVectors[2][1]; direction[2]
-          = eigenVectors[2][2];
+        TVector direction(3);
+        this->GetPrincipalEigenvector( this->GetEigenFieldInterpolator(), seed, tensorPixel, direction );
         m_Seeds.push_back(seed);
         m_TrackingDirections.push_back(direction);
         direction *= -1;
@@ -272,5 +300,189 @@ DtiTrackingFilterBase<TTensorImageType, TAnisotropyImageType, TMaskImageType>
   //  data->Delete();
   //  line->Delete();
 }
+
+template <class TTensorImageType, class TAnisotropyImageType, class TMaskImageType>
+void
+DtiTrackingFilterBase<TTensorImageType, TAnisotropyImageType, TMaskImageType>
+::GetPrincipalEigenvector(const EigenFieldIPType *eigenIP, const typename Self::ContinuousIndexType & index,
+                          const TensorImagePixelType & tensorPixel, TVector & e2) const
+{
+  if( eigenIP )
+    {
+    const typename EigenFieldIPType::OutputType eigen = eigenIP->EvaluateAtContinuousIndex(index);
+    for( unsigned int i = 0; i < 3; i++ )
+      {
+      e2[i] = eigen[TensorToEigenFieldImageFilter<TensorImageType>::PrincipalEigenvectorOffset + i];
+      }
+    return;
+    }
+
+  typename TensorImagePixelType::EigenValuesArrayType   eigenValues;
+  typename TensorImagePixelType::EigenVectorsMatrixType eigenVectors;
+  tensorPixel.ComputeEigenAnalysis(eigenValues, eigenVectors);
+  e2[0] = eigenVectors[2][0]; e2[1] = eigenVectors[2][1]; e2[2] = eigenVectors[2][2];
+}
+
+template <class TTensorImageType, class TAnisotropyImageType, class TMaskImageType>
+void
+DtiTrackingFilterBase<TTensorImageType, TAnisotropyImageType, TMaskImageType>
+::AddPointToFiber(typename Self::ContinuousIndexType & index, const TMatrix & fullTensorPixel, FiberBuffer & fiber)
+{
+  PointType p;
+
+  this->ContinuousIndexToMM(index, p);
+  for( unsigned int i = 0; i < 3; i++ )
+    {
+    fiber.Points.push_back( static_cast<float>( p[i] ) );
+    }
+  fiber.Tensors.insert( fiber.Tensors.end(), fullTensorPixel.data_block(), fullTensorPixel.data_block() + 9 );
+}
+
+template <class TTensorImageType, class TAnisotropyImageType, class TMaskImageType>
+bool
+DtiTrackingFilterBase<TTensorImageType, TAnisotropyImageType, TMaskImageType>
+::TrackFiber(const typename Self::ContinuousIndexType &, const TVector &, TrackingInterpolators &,
+             FiberBuffer &, float & pathLength)
+{
+  pathLength = 0.0;
+  return false;
+}
+
+template <class TTensorImageType, class TAnisotropyImageType, class TMaskImageType>
+ITK_THREAD_RETURN_TYPE
+DtiTrackingFilterBase<TTensorImageType, TAnisotropyImageType, TMaskImageType>
+::TrackingThreaderCallback( void *arg )
+{
+  MultiThreader::ThreadInfoStruct *info = static_cast<MultiThreader::ThreadInfoStruct *>( arg );
+  TrackingThreadStruct *           str = static_cast<TrackingThreadStruct *>( info->UserData );
+  Self *                           filter = str->Filter;
+
+  // The interpolators are not shared between threads
+  TrackingInterpolators ip;
+  ip.ScalarIP = ScalarIPType::New();
+  ip.ScalarIP->SetInputImage( filter->m_AnisotropyImage );
+  ip.VectorIP = VectorIPType::New();
+  ip.VectorIP->SetInputImage( filter->m_TensorImage );
+  ip.EndIP = MaskIPType::New();
+  if( filter->m_EndingRegion.IsNotNull() )
+    {
+    ip.EndIP->SetInputImage( filter->m_EndingRegion );
+    }
+  if( filter->m_EigenFieldImage.IsNotNull() )
+    {
+    ip.EigenIP = EigenFieldIPType::New();
+    ip.EigenIP->SetInputImage( filter->m_EigenFieldImage );
+    }
+
+  const size_t numberOfSeeds = str->Seeds->size();
+  const size_t numberOfBatches = str->Batches->size();
+  for( ;; )
+    {
+    str->NextBatchLock.Lock();
+    const size_t batch = str->NextBatch++;
+    str->NextBatchLock.Unlock();
+    if( batch >= numberOfBatches )
+      {
+      break;
+      }
+
+    FiberBuffer & fibers = ( *str->Batches )[batch];
+    const size_t  first = batch * SeedsPerBatch;
+    const size_t  last = std::min( first + SeedsPerBatch, numberOfSeeds );
+    for( size_t s = first; s < last; ++s )
+      {
+      const size_t numberOfValues = fibers.Points.size();
+      float        pathLength = 0.0;
+      if( filter->TrackFiber( ( *str->Seeds )[s], ( *str->Directions )[s], ip, fibers, pathLength )
+          && fibers.Points.size() > numberOfValues )
+        {
+        fibers.NumberOfPoints.push_back( static_cast<vtkIdType>( ( fibers.Points.size() - numberOfValues ) / 3 ) );
+        fibers.PathLengths.push_back( pathLength );
+        }
+      else
+        {
+        fibers.Points.resize( numberOfValues );
+        fibers.Tensors.resize( numberOfValues * 3 );
+        }
+      }
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TTensorImageType, class TAnisotropyImageType, class TMaskImageType>
+void
+DtiTrackingFilterBase<TTensorImageType, TAnisotropyImageType, TMaskImageType>
+::TrackSeeds()
+{
+  // The serial trackers popped their seeds from the back of the lists
+  const std::vector<ContinuousIndexType> seeds( m_Seeds.rbegin(), m_Seeds.rend() );
+  const std::vector<TVector>             directions( m_TrackingDirections.rbegin(), m_TrackingDirections.rend() );
+  m_Seeds.clear();
+  m_TrackingDirections.clear();
+
+  std::vector<FiberBuffer> batches( ( seeds.size() + SeedsPerBatch - 1 ) / SeedsPerBatch );
+
+  TrackingThreadStruct str;
+  str.Filter = this;
+  str.Seeds = &seeds;
+  str.Directions = &directions;
+  str.Batches = &batches;
+  str.NextBatch = 0;
+
+  const unsigned int numberOfThreads =
+    std::max( 1u, std::min( m_NumberOfThreads, static_cast<unsigned int>( batches.size() ) ) );
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( numberOfThreads );
+  threader->SetSingleMethod( TrackingThreaderCallback, &str );
+  threader->SingleMethodExecute();
+
+  vtkIdType numberOfFibers = 0;
+  vtkIdType numberOfPoints = 0;
+  for( size_t b = 0; b < batches.size(); ++b )
+    {
+    numberOfFibers += static_cast<vtkIdType>( batches[b].NumberOfPoints.size() );
+    numberOfPoints += static_cast<vtkIdType>( batches[b].Points.size() / 3 );
+    }
+  if( numberOfFibers == 0 )
+    {
+    return;
+    }
+
+  // Merge all fibers into the output at once, in seed order
+  vtkPoints *points = vtkPoints::New();
+  points->SetNumberOfPoints( numberOfPoints );
+  vtkFloatArray *tensors = vtkFloatArray::New();
+  tensors->SetName("Tensors");
+  tensors->SetNumberOfComponents(9);
+  tensors->SetNumberOfTuples( numberOfPoints );
+  vtkCellArray *lines = vtkCellArray::New();
+  lines->Allocate( numberOfFibers + numberOfPoints );
+
+  vtkIdType pointId = 0;
+  for( size_t b = 0; b < batches.size(); ++b )
+    {
+    const FiberBuffer & fibers = batches[b];
+    std::copy( fibers.Tensors.begin(), fibers.Tensors.end(), tensors->GetPointer( 9 * pointId ) );
+    vtkIdType batchPointId = 0;
+    for( size_t f = 0; f < fibers.NumberOfPoints.size(); ++f )
+      {
+      std::cerr << "Fiber (" << fibers.PathLengths[f] << "); ";
+      lines->InsertNextCell( fibers.NumberOfPoints[f] );
+      for( vtkIdType i = 0; i < fibers.NumberOfPoints[f]; ++i, ++batchPointId )
+        {
+        points->SetPoint( pointId + batchPointId, &fibers.Points[3 * batchPointId] );
+        lines->InsertCellPoint( pointId + batchPointId );
+        }
+      }
+    pointId += batchPointId;
+    }
+
+  m_Output->SetPoints( points );
+  m_Output->SetLines( lines );
+  m_Output->GetPointData()->SetTensors( tensors );
+  points->Delete();
+  tensors->Delete();
+  lines->Delete();
+}
 } // end namespace itk
 #endif
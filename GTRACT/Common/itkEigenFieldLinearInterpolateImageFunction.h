@@ -0,0 +1,94 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkEigenFieldLinearInterpolateImageFunction_h
+#define __itkEigenFieldLinearInterpolateImageFunction_h
+
+#include "itkImageFunction.h"
+#include "itkVector.h"
+
+namespace itk
+{
+/** \class EigenFieldLinearInterpolateImageFunction
+ * \brief Linear interpolation of an eigen field image.
+ *
+ * Works on the output of TensorToEigenFieldImageFilter. An eigenvector and
+ * its opposite describe the same direction, so before the principal
+ * eigenvectors of the neighbours are averaged each one is flipped to point
+ * the way of the neighbour with the largest weight. The result is then
+ * normalized. Eigenvalues and anisotropy are interpolated as they are.
+ * Neighbours outside the buffered region are left out.
+ */
+template <class TInputImage, class TCoordRep = double>
+class EigenFieldLinearInterpolateImageFunction :
+  public ImageFunction<TInputImage, Vector<double, 7>, TCoordRep>
+{
+public:
+  /** Standard class typedefs. */
+  typedef EigenFieldLinearInterpolateImageFunction                 Self;
+  typedef ImageFunction<TInputImage, Vector<double, 7>, TCoordRep> Superclass;
+  typedef SmartPointer<Self>                                       Pointer;
+  typedef SmartPointer<const Self>                                 ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(EigenFieldLinearInterpolateImageFunction, ImageFunction);
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TInputImage::ImageDimension);
+
+  typedef typename Superclass::InputImageType      InputImageType;
+  typedef typename InputImageType::PixelType       PixelType;
+  typedef typename Superclass::PointType           PointType;
+  typedef typename Superclass::IndexType           IndexType;
+  typedef typename Superclass::ContinuousIndexType ContinuousIndexType;
+  typedef typename Superclass::OutputType          OutputType;
+
+  virtual OutputType Evaluate( const PointType & point ) const ITK_OVERRIDE
+  {
+    ContinuousIndexType index;
+
+    this->GetInputImage()->TransformPhysicalPointToContinuousIndex( point, index );
+    return this->EvaluateAtContinuousIndex( index );
+  }
+
+  virtual OutputType EvaluateAtIndex( const IndexType & index ) const ITK_OVERRIDE;
+
+  virtual OutputType EvaluateAtContinuousIndex( const ContinuousIndexType & index ) const ITK_OVERRIDE;
+
+protected:
+  EigenFieldLinearInterpolateImageFunction()
+  {
+  }
+
+  ~EigenFieldLinearInterpolateImageFunction()
+  {
+  }
+
+private:
+  EigenFieldLinearInterpolateImageFunction(const Self &); // purposely not implemented
+  void operator=(const Self &);                           // purposely not implemented
+};
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkEigenFieldLinearInterpolateImageFunction.hxx"
+#endif
+
+#endif
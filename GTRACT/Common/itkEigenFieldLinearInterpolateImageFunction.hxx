@@ -0,0 +1,142 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkEigenFieldLinearInterpolateImageFunction_hxx
+#define __itkEigenFieldLinearInterpolateImageFunction_hxx
+
+#include "itkEigenFieldLinearInterpolateImageFunction.h"
+
+#include <cmath>
+
+namespace itk
+{
+template <class TInputImage, class TCoordRep>
+typename EigenFieldLinearInterpolateImageFunction<TInputImage, TCoordRep>::OutputType
+EigenFieldLinearInterpolateImageFunction<TInputImage, TCoordRep>
+::EvaluateAtIndex( const IndexType & index ) const
+{
+  const PixelType input = this->GetInputImage()->GetPixel( index );
+  OutputType      output;
+
+  for( unsigned int k = 0; k < 7; k++ )
+    {
+    output[k] = input[k];
+    }
+  return output;
+}
+
+template <class TInputImage, class TCoordRep>
+typename EigenFieldLinearInterpolateImageFunction<TInputImage, TCoordRep>::OutputType
+EigenFieldLinearInterpolateImageFunction<TInputImage, TCoordRep>
+::EvaluateAtContinuousIndex( const ContinuousIndexType & index ) const
+{
+  const unsigned int neighbors = 1 << ImageDimension;
+
+  const typename InputImageType::RegionType & region = this->GetInputImage()->GetBufferedRegion();
+
+  long   baseIndex[ImageDimension];
+  double distance[ImageDimension];
+  for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+    {
+    baseIndex[dim] = static_cast<long>( std::floor( index[dim] ) );
+    distance[dim] = index[dim] - static_cast<double>( baseIndex[dim] );
+    }
+
+  // Weights and values of the neighbours inside the image
+  double       overlaps[neighbors];
+  PixelType    values[neighbors];
+  unsigned int count = 0;
+  unsigned int reference = 0;
+  double       totalOverlap = 0.0;
+  for( unsigned int counter = 0; counter < neighbors; counter++ )
+    {
+    double       overlap = 1.0;
+    unsigned int upper = counter;
+    IndexType    neighIndex;
+    for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+      {
+      if( upper & 1 )
+        {
+        neighIndex[dim] = baseIndex[dim] + 1;
+        overlap *= distance[dim];
+        }
+      else
+        {
+        neighIndex[dim] = baseIndex[dim];
+        overlap *= 1.0 - distance[dim];
+        }
+      upper >>= 1;
+      }
+    if( overlap > 0.0 && region.IsInside( neighIndex ) )
+      {
+      overlaps[count] = overlap;
+      values[count] = this->GetInputImage()->GetPixel( neighIndex );
+      if( count == 0 || overlap > overlaps[reference] )
+        {
+        reference = count;
+        }
+      totalOverlap += overlap;
+      ++count;
+      }
+    }
+
+  OutputType output;
+  output.Fill( 0.0 );
+  if( count == 0 )
+    {
+    return output;
+    }
+
+  const PixelType & referenceValue = values[reference];
+  for( unsigned int n = 0; n < count; n++ )
+    {
+    const double weight = overlaps[n] / totalOverlap;
+    double       dot = 0.0;
+    for( unsigned int k = 0; k < 3; k++ )
+      {
+      dot += values[n][k] * referenceValue[k];
+      }
+    const double sign = ( dot < 0.0 ) ? -1.0 : 1.0;
+    for( unsigned int k = 0; k < 3; k++ )
+      {
+      output[k] += sign * weight * values[n][k];
+      }
+    for( unsigned int k = 3; k < 7; k++ )
+      {
+      output[k] += weight * values[n][k];
+      }
+    }
+
+  double norm = 0.0;
+  for( unsigned int k = 0; k < 3; k++ )
+    {
+    norm += output[k] * output[k];
+    }
+  if( norm > 0.0 )
+    {
+    norm = std::sqrt( norm );
+    for( unsigned int k = 0; k < 3; k++ )
+      {
+      output[k] /= norm;
+      }
+    }
+  return output;
+}
+} // end namespace itk
+
+#endif
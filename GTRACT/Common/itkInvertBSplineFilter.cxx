@@ -45,6 +45,7 @@
 #include "itkProgressAccumulator.h"
 
 #include <iostream>
+#include <algorithm>
 
 namespace itk
 {
@@ -53,12 +54,39 @@ InvertBSplineFilter::InvertBSplineFilter()
   m_XgridSize = 2;
   m_YgridSize = 2;
   m_ZgridSize = 2;
+  m_InversionMethod = ThinPlateSplineApproximation;
+  m_ErrorTolerance = 0.01;
+  m_MaximumNumberOfIterations = 50;
+  m_MaximumInversionError = 0.0;
+  m_NumberOfUnconvergedPoints = 0;
+}
+
+const InvertBSplineFilter::GenericTransformType *
+InvertBSplineFilter::GetOutputTransform() const
+{
+  if( m_InversionMethod == DisplacementFieldInversion )
+    {
+    return m_InverseDisplacementFieldTransform.GetPointer();
+    }
+  return m_Output.GetPointer();
 }
 
 void InvertBSplineFilter::Update()
 {
   std::cout << "InvertBSplineFilter()...." << std::endl;
 
+  if( m_InversionMethod == DisplacementFieldInversion )
+    {
+    this->ComputeDisplacementFieldInverse();
+    }
+  else
+    {
+    this->ComputeThinPlateSplineInverse();
+    }
+}
+
+void InvertBSplineFilter::ComputeThinPlateSplineInverse()
+{
   ImageType::SizeType   imageSize = m_ExampleImage->GetLargestPossibleRegion().GetSize();
   PointSetType::Pointer sourceLandMarks = PointSetType::New();
   PointSetType::Pointer targetLandMarks = PointSetType::New();
@@ -110,4 +138,149 @@ void InvertBSplineFilter::Update()
 
   std::cout << m_Output << std::endl;
 }
+
+void InvertBSplineFilter::ComputeDisplacementFieldInverse()
+{
+  const ImageRegionType region = m_ExampleImage->GetLargestPossibleRegion();
+
+  DisplacementFieldType::Pointer field = DisplacementFieldType::New();
+  field->CopyInformation( m_ExampleImage );
+  field->SetRegions( region );
+  field->Allocate();
+
+  // Every slice is inverted by one thread, each voxel being seeded from an
+  // already inverted neighbour of the same slice, so the field does not
+  // depend on the number of threads.
+  const unsigned int     numberOfSlices = region.GetSize()[2];
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( std::max( 1U, std::min( static_cast<unsigned int>( threader->GetNumberOfThreads() ),
+                                                        numberOfSlices ) ) );
+
+  InversionThreadStruct str;
+  str.Filter = this;
+  str.Field = field.GetPointer();
+  str.MaximumError.assign( threader->GetNumberOfThreads(), 0.0 );
+  str.NumberOfUnconvergedPoints.assign( threader->GetNumberOfThreads(), 0 );
+
+  std::cout << "Inverting at " << region.GetNumberOfPixels() << " voxels with "
+            << threader->GetNumberOfThreads() << " threads" << std::endl;
+  threader->SetSingleMethod( InversionThreaderCallback, &str );
+  threader->SingleMethodExecute();
+
+  m_MaximumInversionError = *std::max_element( str.MaximumError.begin(), str.MaximumError.end() );
+  m_NumberOfUnconvergedPoints = 0;
+  for( size_t t = 0; t < str.NumberOfUnconvergedPoints.size(); ++t )
+    {
+    m_NumberOfUnconvergedPoints += str.NumberOfUnconvergedPoints[t];
+    }
+
+  m_InverseDisplacementFieldTransform = DisplacementFieldTransformType::New();
+  m_InverseDisplacementFieldTransform->SetDisplacementField( field );
+
+  std::cout << "Computed displacement field inverse transform, maximum error " << m_MaximumInversionError
+            << " mm, " << m_NumberOfUnconvergedPoints << " voxels above " << m_ErrorTolerance << " mm" << std::endl;
+}
+
+ITK_THREAD_RETURN_TYPE
+InvertBSplineFilter::InversionThreaderCallback(void *arg)
+{
+  MultiThreader::ThreadInfoStruct *info = static_cast<MultiThreader::ThreadInfoStruct *>( arg );
+  InversionThreadStruct *          str = static_cast<InversionThreadStruct *>( info->UserData );
+  const unsigned int               threadId = info->ThreadID;
+  const unsigned int               threadCount = info->NumberOfThreads;
+
+  const unsigned int numberOfSlices = str->Field->GetLargestPossibleRegion().GetSize()[2];
+  const unsigned int slicesPerThread = ( numberOfSlices + threadCount - 1 ) / threadCount;
+  const unsigned int firstSlice = std::min( threadId * slicesPerThread, numberOfSlices );
+  const unsigned int lastSlice = std::min( firstSlice + slicesPerThread, numberOfSlices );
+
+  str->Filter->ThreadedInversion( str->Field, firstSlice, lastSlice,
+                                  str->MaximumError[threadId], str->NumberOfUnconvergedPoints[threadId] );
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+void InvertBSplineFilter::ThreadedInversion(DisplacementFieldType *field,
+                                            const unsigned int firstSlice, const unsigned int lastSlice,
+                                            double & maximumError, SizeValueType & numberOfUnconvergedPoints) const
+{
+  const ImageRegionType region = field->GetLargestPossibleRegion();
+  const ImageIndexType  start = region.GetIndex();
+  const ImageSizeType   size = region.GetSize();
+
+  for( unsigned int z = firstSlice; z < lastSlice; ++z )
+    {
+    for( unsigned int y = 0; y < size[1]; ++y )
+      {
+      for( unsigned int x = 0; x < size[0]; ++x )
+        {
+        ImageIndexType index;
+        index[0] = start[0] + x;
+        index[1] = start[1] + y;
+        index[2] = start[2] + z;
+        PointType point;
+        field->TransformIndexToPhysicalPoint( index, point );
+
+        // Start from the previous voxel of the row, or of the column for the
+        // first voxel of a row; the very first voxel of the slice starts
+        // from the opposite of the forward displacement.
+        DisplacementType displacement;
+        if( x > 0 )
+          {
+          ImageIndexType neighbor = index;
+          --neighbor[0];
+          displacement = field->GetPixel( neighbor );
+          }
+        else if( y > 0 )
+          {
+          ImageIndexType neighbor = index;
+          --neighbor[1];
+          displacement = field->GetPixel( neighbor );
+          }
+        else
+          {
+          displacement = point - m_Input->TransformPoint( point );
+          }
+
+        const double error = this->InvertPoint( point, displacement );
+        field->SetPixel( index, displacement );
+        maximumError = std::max( maximumError, error );
+        if( error > m_ErrorTolerance )
+          {
+          ++numberOfUnconvergedPoints;
+          }
+        }
+      }
+    }
+}
+
+double InvertBSplineFilter::InvertPoint(const PointType & point, DisplacementType & displacement) const
+{
+  // Fixed-point iteration y <- y + (point - T(y)), which converges where the
+  // BSpline displacement is contracting; the step is halved whenever it
+  // does not reduce the error.
+  PointType        estimate = point + displacement;
+  DisplacementType residual = point - m_Input->TransformPoint( estimate );
+  double           error = residual.GetNorm();
+  double           stepScale = 1.0;
+
+  for( unsigned int iteration = 0; iteration < m_MaximumNumberOfIterations && error > m_ErrorTolerance; ++iteration )
+    {
+    const PointType        candidate = estimate + residual * stepScale;
+    const DisplacementType candidateResidual = point - m_Input->TransformPoint( candidate );
+    const double           candidateError = candidateResidual.GetNorm();
+    if( candidateError < error )
+      {
+      estimate = candidate;
+      residual = candidateResidual;
+      error = candidateError;
+      stepScale = std::min( 1.0, 2.0 * stepScale );
+      }
+    else
+      {
+      stepScale *= 0.5;
+      }
+    }
+  displacement = estimate - point;
+  return error;
+}
 } // end namespace itk
@@ -49,6 +49,8 @@
 #include <itkLinearInterpolateImageFunction.h>
 #include <itkBSplineTransform.h>
 #include <itkThinPlateR2LogRSplineKernelTransform.h>
+#include <itkDisplacementFieldTransform.h>
+#include <itkMultiThreader.h>
 #include <itkLBFGSBOptimizer.h>
 #include <itkCenteredTransformInitializer.h>
 #include <itkTimeProbesCollectorBase.h>
@@ -57,6 +59,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 namespace itk
 {
@@ -113,6 +116,24 @@ public:
   typedef TransformType::PointSetType                                  PointSetType;
   typedef PointSetType::PointIdentifier                                PointIdType;
 
+  /** Dense inverse typedefs. */
+  typedef itk::DisplacementFieldTransform<CoordinateRepresentationType,
+                                          transformDimension>                 DisplacementFieldTransformType;
+  typedef DisplacementFieldTransformType::Pointer                             DisplacementFieldTransformPointer;
+  typedef DisplacementFieldTransformType::DisplacementFieldType               DisplacementFieldType;
+  typedef DisplacementFieldType::PixelType                                    DisplacementType;
+  typedef itk::Transform<CoordinateRepresentationType, transformDimension,
+                         transformDimension>                                  GenericTransformType;
+
+  /** ThinPlateSplineApproximation fits a TPS to the forward transform sampled on
+   *  the landmark grid. DisplacementFieldInversion inverts the transform at every
+   *  voxel of the example image by fixed-point iteration. */
+  typedef enum
+    {
+    ThinPlateSplineApproximation,
+    DisplacementFieldInversion
+    } InversionMethodType;
+
   /** Standard New method. */
   itkNewMacro(Self);
 
@@ -132,6 +153,28 @@ public:
   itkGetMacro(YgridSize, int);
   itkGetMacro(ZgridSize, int);
 
+  itkSetMacro(InversionMethod, InversionMethodType);
+  itkGetConstMacro(InversionMethod, InversionMethodType);
+
+  /** Distance in mm between the forward transform of an inverted point and
+   *  the voxel it was inverted for, below which the iteration stops. */
+  itkSetMacro(ErrorTolerance, double);
+  itkGetConstMacro(ErrorTolerance, double);
+
+  itkSetMacro(MaximumNumberOfIterations, unsigned int);
+  itkGetConstMacro(MaximumNumberOfIterations, unsigned int);
+
+  /** Output of the DisplacementFieldInversion method */
+  itkGetConstObjectMacro(InverseDisplacementFieldTransform, DisplacementFieldTransformType);
+
+  /** Largest remaining error and number of voxels that did not reach the
+   *  tolerance in the last DisplacementFieldInversion */
+  itkGetConstMacro(MaximumInversionError, double);
+  itkGetConstMacro(NumberOfUnconvergedPoints, SizeValueType);
+
+  /** Output of the selected inversion method */
+  const GenericTransformType * GetOutputTransform() const;
+
   void Update();
 
 protected:
@@ -144,6 +187,28 @@ private:
   InvertBSplineFilter(const Self &); // purposely not implemented
   void operator=(const Self &);      // purposely not implemented
 
+  void ComputeThinPlateSplineInverse();
+
+  void ComputeDisplacementFieldInverse();
+
+  /* Inverts the transform at physical point, starting from the displacement
+   * seed. Returns the remaining error in mm. */
+  double InvertPoint(const PointType & point, DisplacementType & displacement) const;
+
+  struct InversionThreadStruct
+    {
+    InvertBSplineFilter *      Filter;
+    DisplacementFieldType *    Field;
+    std::vector<double>        MaximumError;
+    std::vector<SizeValueType> NumberOfUnconvergedPoints;
+    };
+
+  static ITK_THREAD_RETURN_TYPE InversionThreaderCallback(void *arg);
+
+  /* inverts the voxels of slices [firstSlice, lastSlice) of field */
+  void ThreadedInversion(DisplacementFieldType *field, const unsigned int firstSlice, const unsigned int lastSlice,
+                         double & maximumError, SizeValueType & numberOfUnconvergedPoints) const;
+
   /*** Input and Output Objects ***/
   BsplineTransformTypePointer m_Input;
   TransformTypePointer        m_Output;
@@ -152,6 +217,13 @@ private:
   int m_XgridSize;
   int m_YgridSize;
   int m_ZgridSize;
+
+  InversionMethodType               m_InversionMethod;
+  double                            m_ErrorTolerance;
+  unsigned int                      m_MaximumNumberOfIterations;
+  DisplacementFieldTransformPointer m_InverseDisplacementFieldTransform;
+  double                            m_MaximumInversionError;
+  SizeValueType                     m_NumberOfUnconvergedPoints;
 };      // end of class
 } // end namespace itk
 
@@ -0,0 +1,84 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkTensorToEigenFieldImageFilter_h
+#define __itkTensorToEigenFieldImageFilter_h
+
+#include "itkImageToImageFilter.h"
+#include "itkVector.h"
+
+namespace itk
+{
+/** \class TensorToEigenFieldImageFilter
+ * \brief Eigen decomposition of every tensor of a diffusion tensor image.
+ *
+ * Each output pixel holds the principal eigenvector, the three eigenvalues
+ * in ascending order and the fractional anisotropy of the tensor. Tensors
+ * with a zero norm give a zero pixel. The eigen field is computed once
+ * and can be written to disk, so the tracking and fast marching filters
+ * need not decompose the same tensors again.
+ */
+template <class TTensorImage>
+class TensorToEigenFieldImageFilter :
+  public ImageToImageFilter<TTensorImage, Image<Vector<float, 7>, 3> >
+{
+public:
+  /** Layout of the output pixel */
+  enum { PrincipalEigenvectorOffset = 0, EigenValuesOffset = 3, FractionalAnisotropyOffset = 6 };
+
+  typedef Vector<float, 7>              EigenFieldPixelType;
+  typedef Image<EigenFieldPixelType, 3> EigenFieldImageType;
+
+  /** Standard class typedefs. */
+  typedef TensorToEigenFieldImageFilter                         Self;
+  typedef ImageToImageFilter<TTensorImage, EigenFieldImageType> Superclass;
+  typedef SmartPointer<Self>                                    Pointer;
+  typedef SmartPointer<const Self>                              ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(TensorToEigenFieldImageFilter, ImageToImageFilter);
+
+  typedef TTensorImage                               TensorImageType;
+  typedef typename TensorImageType::PixelType        TensorPixelType;
+  typedef typename Superclass::OutputImageRegionType OutputImageRegionType;
+
+  /** Eigen field pixel of a single tensor */
+  static EigenFieldPixelType ComputeEigenFieldPixel(const TensorPixelType & tensor);
+
+protected:
+  TensorToEigenFieldImageFilter();
+  ~TensorToEigenFieldImageFilter()
+  {
+  }
+
+  void ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread, ThreadIdType threadId) ITK_OVERRIDE;
+
+private:
+  TensorToEigenFieldImageFilter(const Self &); // purposely not implemented
+  void operator=(const Self &);                // purposely not implemented
+};
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkTensorToEigenFieldImageFilter.hxx"
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkTensorToEigenFieldImageFilter_hxx
+#define __itkTensorToEigenFieldImageFilter_hxx
+
+#include "itkTensorToEigenFieldImageFilter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
+
+namespace itk
+{
+template <class TTensorImage>
+TensorToEigenFieldImageFilter<TTensorImage>
+::TensorToEigenFieldImageFilter()
+{
+}
+
+template <class TTensorImage>
+typename TensorToEigenFieldImageFilter<TTensorImage>::EigenFieldPixelType
+TensorToEigenFieldImageFilter<TTensorImage>
+::ComputeEigenFieldPixel(const TensorPixelType & tensor)
+{
+  EigenFieldPixelType pixel;
+
+  pixel.Fill( 0.0 );
+
+  double norm = 0.0;
+  for( unsigned int i = 0; i < 6; i++ )
+    {
+    norm += static_cast<double>( tensor[i] ) * static_cast<double>( tensor[i] );
+    }
+  if( norm == 0.0 )
+    {
+    return pixel;
+    }
+
+  typename TensorPixelType::EigenValuesArrayType   eigenValues;
+  typename TensorPixelType::EigenVectorsMatrixType eigenVectors;
+  tensor.ComputeEigenAnalysis(eigenValues, eigenVectors);
+  for( unsigned int i = 0; i < 3; i++ )
+    {
+    pixel[PrincipalEigenvectorOffset + i] = static_cast<float>( eigenVectors[2][i] );
+    pixel[EigenValuesOffset + i] = static_cast<float>( eigenValues[i] );
+    }
+  pixel[FractionalAnisotropyOffset] = static_cast<float>( tensor.GetFractionalAnisotropy() );
+  return pixel;
+}
+
+template <class TTensorImage>
+void
+TensorToEigenFieldImageFilter<TTensorImage>
+::ThreadedGenerateData(const OutputImageRegionType & outputRegionForThread, ThreadIdType)
+{
+  ImageRegionConstIterator<TensorImageType> tensorIt( this->GetInput(), outputRegionForThread );
+  ImageRegionIterator<EigenFieldImageType>  eigenIt( this->GetOutput(), outputRegionForThread );
+  for( tensorIt.GoToBegin(), eigenIt.GoToBegin(); !eigenIt.IsAtEnd(); ++tensorIt, ++eigenIt )
+    {
+    eigenIt.Set( ComputeEigenFieldPixel( tensorIt.Get() ) );
+    }
+}
+} // end namespace itk
+
+#endif
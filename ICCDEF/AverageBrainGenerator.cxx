@@ -30,20 +30,182 @@ Zhao,Yongqiang
 #include "itksys/SystemTools.hxx"
 #include "AverageBrainGeneratorCLP.h"
 #include "itksys/Directory.hxx"
-#include "itkAddImageFilter.h"
-#include "itkMultiplyImageFilter.h"
 #include "itkWarpImageFilter.h"
 #include "itkImageFileWriter.h"
 #include "itkImageRegionIterator.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkMultiThreader.h"
+#include "itkSimpleFastMutexLock.h"
 #include "itkIO.h"
 #include "itkICCIterativeInverseDisplacementFieldImageFilter.h"
 #include "itkVectorIndexSelectionCastImageFilter.h"
 #include "BRAINSCommonLib.h"
+#include "BRAINSThreadControl.h"
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+const unsigned int Dimension = 3;
+typedef float                                       PixelType;
+typedef itk::Image<PixelType, Dimension>            ImageType;
+typedef itk::Vector<PixelType, Dimension>           VectorPixelType;
+typedef itk::Image<VectorPixelType,  Dimension>     DisplacementFieldType;
+typedef itk::ImageFileReader<DisplacementFieldType> DFReaderType;
+
+/* The sum of all displacement fields is kept in one double precision
+ * accumulator over the template grid, split into slabs along the last axis.
+ * Each thread reads whole fields (or, when the file format allows it, one
+ * slab at a time) and adds them to the accumulator slab by slab, so decoding
+ * one file overlaps with accumulating others.  A slab is only ever locked by
+ * the thread adding to it, and different fields start on different slabs. */
+struct FieldSumThreadStruct
+  {
+  const std::vector<std::string> *FileNames;
+  ImageType::ConstPointer         Template;
+  unsigned int                    NumberOfSlabs;
+  unsigned int                    SlicesPerSlab;
+  std::vector<double> *           Sum;
+  std::vector<double> *           SumOfSquaredNorms; // null when no variance is wanted
+  itk::SimpleFastMutexLock *      SlabLocks;
+  unsigned int                    NextField;
+  itk::SimpleFastMutexLock        NextFieldLock;
+  std::vector<std::string>        Errors;            // one per file, written by its reader thread only
+  };
+
+bool
+FieldMatchesTemplate(const DisplacementFieldType *field, const ImageType *templateImage)
+{
+  if( field->GetLargestPossibleRegion().GetSize() != templateImage->GetLargestPossibleRegion().GetSize() )
+    {
+    return false;
+    }
+  const double tolerance = 1.0e-6;
+  for( unsigned int i = 0; i < Dimension; ++i )
+    {
+    const double spacing = templateImage->GetSpacing()[i];
+    if( vnl_math_abs( field->GetSpacing()[i] - spacing ) > tolerance * spacing
+        || vnl_math_abs( field->GetOrigin()[i] - templateImage->GetOrigin()[i] ) > tolerance * spacing )
+      {
+      return false;
+      }
+    for( unsigned int j = 0; j < Dimension; ++j )
+      {
+      if( vnl_math_abs( field->GetDirection()[i][j] - templateImage->GetDirection()[i][j] ) > tolerance )
+        {
+        return false;
+        }
+      }
+    }
+  return true;
+}
+
+void
+AccumulateField(FieldSumThreadStruct & str, const unsigned int fieldNumber)
+{
+  const std::string & fileName = ( *str.FileNames )[fieldNumber];
+
+  DFReaderType::Pointer reader = DFReaderType::New();
+
+  reader->SetFileName(fileName);
+  reader->UpdateOutputInformation();
+  DisplacementFieldType *field = reader->GetOutput();
+  if( !FieldMatchesTemplate(field, str.Template) )
+    {
+    itkGenericExceptionMacro(<< fileName << " does not lie on the template grid");
+    }
+
+  const bool streamSlabs = reader->GetImageIO()->CanStreamRead();
+  if( !streamSlabs )
+    {
+    reader->Update();
+    }
+
+  const DisplacementFieldType::RegionType fieldRegion = field->GetLargestPossibleRegion();
+  const DisplacementFieldType::SizeType   fieldSize = fieldRegion.GetSize();
+  const size_t                            sliceSize = fieldSize[0] * fieldSize[1];
+  for( unsigned int k = 0; k < str.NumberOfSlabs; ++k )
+    {
+    const unsigned int slab = ( k + fieldNumber ) % str.NumberOfSlabs;
+    const unsigned int firstSlice = slab * str.SlicesPerSlab;
+    const unsigned int lastSlice =
+      std::min<unsigned int>( firstSlice + str.SlicesPerSlab, fieldSize[Dimension - 1] );
+
+    DisplacementFieldType::RegionType slabRegion = fieldRegion;
+    slabRegion.SetIndex(Dimension - 1, fieldRegion.GetIndex(Dimension - 1) + firstSlice);
+    slabRegion.SetSize(Dimension - 1, lastSlice - firstSlice);
+    if( streamSlabs )
+      {
+      field->SetRequestedRegion(slabRegion);
+      reader->Update();
+      }
+
+    const size_t firstVoxel = firstSlice * sliceSize;
+    double *     sum = &( *str.Sum )[firstVoxel * Dimension];
+    double *     sumOfSquaredNorms = str.SumOfSquaredNorms ? &( *str.SumOfSquaredNorms )[firstVoxel] : ITK_NULLPTR;
+
+    itk::ImageRegionConstIterator<DisplacementFieldType> it(field, slabRegion);
+    str.SlabLocks[slab].Lock();
+    for( ; !it.IsAtEnd(); ++it, sum += Dimension )
+      {
+      const VectorPixelType & displacement = it.Get();
+      double                  squaredNorm = 0.0;
+      for( unsigned int d = 0; d < Dimension; ++d )
+        {
+        sum[d] += displacement[d];
+        squaredNorm += static_cast<double>( displacement[d] ) * displacement[d];
+        }
+      if( sumOfSquaredNorms )
+        {
+        *sumOfSquaredNorms++ += squaredNorm;
+        }
+      }
+    str.SlabLocks[slab].Unlock();
+    }
+}
+
+ITK_THREAD_RETURN_TYPE
+FieldSumThreaderCallback(void *arg)
+{
+  itk::MultiThreader::ThreadInfoStruct *info = static_cast<itk::MultiThreader::ThreadInfoStruct *>( arg );
+  FieldSumThreadStruct *                str = static_cast<FieldSumThreadStruct *>( info->UserData );
+
+  for( ;; )
+    {
+    str->NextFieldLock.Lock();
+    const unsigned int fieldNumber = str->NextField++;
+    str->NextFieldLock.Unlock();
+    if( fieldNumber >= str->FileNames->size() )
+      {
+      break;
+      }
+    try
+      {
+      AccumulateField(*str, fieldNumber);
+      }
+    catch( itk::ExceptionObject & e )
+      {
+      std::ostringstream msg;
+      msg << e;
+      str->Errors[fieldNumber] = msg.str();
+      }
+    catch( std::exception & e )
+      {
+      str->Errors[fieldNumber] = e.what();
+      }
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+} // end anonymous namespace
 
 int AverageBrainGenerator(int argc, char *argv[])
 {
   PARSE_ARGS;
   BRAINSRegisterAlternateIO();
+  const BRAINSUtils::StackPushITKDefaultNumberOfThreads TempDefaultNumberOfThreadsHolder(numberOfThreads);
 
   const bool debug = true;
 
@@ -56,6 +218,8 @@ int AverageBrainGenerator(int argc, char *argv[])
     std::cout << "Iteration:           " <<  iteration << std::endl;
     std::cout << "Output Pixel Type:   " <<  pixelType << std::endl;
     std::cout << "Output Volume:       " <<  outputVolume << std::endl;
+    std::cout << "Average Field:       " <<  outputAverageDisplacementFieldVolume << std::endl;
+    std::cout << "Variance Volume:     " <<  outputVarianceVolume << std::endl;
     std::cout << "=====================================================" << std::endl;
     }
 
@@ -86,38 +250,12 @@ int AverageBrainGenerator(int argc, char *argv[])
     exit(-1);
     }
 
-  const unsigned int Dimension = 3;
-  typedef float                                   PixelType;
-  typedef itk::Image<PixelType, Dimension>        ImageType;
-  typedef itk::Vector<PixelType, Dimension>       VectorPixelType;
-  typedef itk::Image<VectorPixelType,  Dimension> DisplacementFieldType;
-  DisplacementFieldType::Pointer DisplacementField = DisplacementFieldType::New();
-
   ImageType::Pointer templateImage;
   templateImage = itkUtil::ReadImage<ImageType>(templateVolume);
   templateImage = itkUtil::OrientImage<ImageType>(templateImage,
                                                   itk::SpatialOrientation::ITK_COORDINATE_ORIENTATION_RAI);
   // Read Directory
-
-  unsigned int numberOfFields = 0;
-
-  DisplacementField->CopyInformation(templateImage);
-  DisplacementField->SetRegions(templateImage->GetLargestPossibleRegion() );
-  DisplacementField->Allocate();
-
-  DisplacementFieldType::PixelType zeros;
-  for( unsigned int j = 0; j < Dimension; j++ )
-    {
-    zeros[j] = 0.0;
-    }
-
-  itk::ImageRegionIterator<DisplacementFieldType> it(DisplacementField, DisplacementField->GetRequestedRegion() );
-
-  while( !it.IsAtEnd() )
-    {
-    it.Value() =  zeros;
-    ++it;
-    }
+  std::vector<std::string> fieldFileNames;
 
   std::cout << "Start..." << std::endl;
   itksys::Directory * dir = new itksys::Directory;
@@ -138,25 +276,12 @@ int AverageBrainGenerator(int argc, char *argv[])
             {
             if( itksys::SystemTools::StringEndsWith(subDir->GetFile(j), subName.c_str() ) )
               {
-              // Compute the average displacement
               std::cout << subDir->GetFile(j) << std::endl;
-              typedef itk::ImageFileReader<DisplacementFieldType> DFReaderType;
-              DFReaderType::Pointer df_Reader = DFReaderType::New();
-              std::string           fileName = path + "/" + subDir->GetFile(j);
-              df_Reader->SetFileName(fileName);
-              df_Reader->Update();
-
-              typedef itk::AddImageFilter<DisplacementFieldType, DisplacementFieldType,
-                                          DisplacementFieldType> AddImageType;
-              AddImageType::Pointer adder = AddImageType::New();
-              adder->SetInput1(DisplacementField);
-              adder->SetInput2(df_Reader->GetOutput() );
-              adder->Update();
-              DisplacementField = adder->GetOutput();
-              numberOfFields++;
+              fieldFileNames.push_back(path + "/" + subDir->GetFile(j) );
               }
             }
           }
+        delete subDir;
         }
       }
     }
@@ -165,23 +290,115 @@ int AverageBrainGenerator(int argc, char *argv[])
     std::cout << "Can not open the directory!!!!" << std::endl;
     exit(-1);
     }
+  delete dir;
 
+  const unsigned int numberOfFields = fieldFileNames.size();
   if( numberOfFields < 3 )
     {
     std::cout << "NEED at least 3 data sets to make an average!" << std::endl;
     }
 
-  typedef itk::MultiplyImageFilter<DisplacementFieldType, itk::Image<float,Dimension> , DisplacementFieldType> MultiplyImageType;
-  MultiplyImageType::Pointer multi = MultiplyImageType::New();
-  multi->SetInput(DisplacementField);
-  multi->SetConstant(1.0 / static_cast<float>(numberOfFields + 1) );
-  multi->Update();
+  // Compute the average displacement
+  const ImageType::RegionType templateRegion = templateImage->GetLargestPossibleRegion();
+  const ImageType::SizeType   templateSize = templateRegion.GetSize();
+  const size_t                numberOfVoxels = templateRegion.GetNumberOfPixels();
+  std::vector<double>         sum(numberOfVoxels * Dimension, 0.0);
+  std::vector<double>         sumOfSquaredNorms;
+  if( outputVarianceVolume.size() != 0 )
+    {
+    sumOfSquaredNorms.resize(numberOfVoxels, 0.0);
+    }
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  const unsigned int          numberOfThreads =
+    std::max(1u, std::min<unsigned int>( threader->GetNumberOfThreads(), numberOfFields ) );
+
+  FieldSumThreadStruct str;
+  str.FileNames = &fieldFileNames;
+  str.Template = templateImage.GetPointer();
+  // a few slabs per thread keep the readers from queueing on the same slab.
+  // The number of slabs is recomputed from the rounded up slab thickness, so
+  // that no slab starts past the last slice.
+  const unsigned int numberOfSlices = templateSize[Dimension - 1];
+  const unsigned int requestedNumberOfSlabs =
+    std::max(1u, std::min<unsigned int>( 4 * numberOfThreads, numberOfSlices ) );
+  str.SlicesPerSlab = ( numberOfSlices + requestedNumberOfSlabs - 1 ) / requestedNumberOfSlabs;
+  str.NumberOfSlabs = ( numberOfSlices + str.SlicesPerSlab - 1 ) / str.SlicesPerSlab;
+  str.Sum = &sum;
+  str.SumOfSquaredNorms = sumOfSquaredNorms.empty() ? ITK_NULLPTR : &sumOfSquaredNorms;
+  str.SlabLocks = new itk::SimpleFastMutexLock[str.NumberOfSlabs];
+  str.NextField = 0;
+  str.Errors.resize(numberOfFields);
+
+  threader->SetNumberOfThreads(numberOfThreads);
+  threader->SetSingleMethod(FieldSumThreaderCallback, &str);
+  threader->SingleMethodExecute();
+  delete[] str.SlabLocks;
+
+  bool readFailed = false;
+  for( unsigned int f = 0; f < numberOfFields; ++f )
+    {
+    if( !str.Errors[f].empty() )
+      {
+      std::cout << "Can not add " << fieldFileNames[f] << ": " << str.Errors[f] << std::endl;
+      readFailed = true;
+      }
+    }
+  if( readFailed )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // The template itself counts as one zero displacement field.
+  const double                   normalizer = 1.0 / static_cast<double>( numberOfFields + 1 );
+  DisplacementFieldType::Pointer DisplacementField = DisplacementFieldType::New();
+  DisplacementField->CopyInformation(templateImage);
+  DisplacementField->SetRegions(templateRegion);
+  DisplacementField->Allocate();
+
+  ImageType::Pointer variance;
+  if( !sumOfSquaredNorms.empty() )
+    {
+    variance = ImageType::New();
+    variance->CopyInformation(templateImage);
+    variance->SetRegions(templateRegion);
+    variance->Allocate();
+    }
+
+  VectorPixelType *averageBuffer = DisplacementField->GetBufferPointer();
+  for( size_t v = 0; v < numberOfVoxels; ++v )
+    {
+    double squaredNormOfAverage = 0.0;
+    for( unsigned int d = 0; d < Dimension; ++d )
+      {
+      const double average = sum[v * Dimension + d] * normalizer;
+      averageBuffer[v][d] = static_cast<PixelType>( average );
+      squaredNormOfAverage += average * average;
+      }
+    if( variance.IsNotNull() )
+      {
+      // mean squared distance of the fields to their average
+      variance->GetBufferPointer()[v] =
+        static_cast<PixelType>( std::max(0.0, sumOfSquaredNorms[v] * normalizer - squaredNormOfAverage) );
+      }
+    }
+  std::vector<double>().swap(sum);
+  std::vector<double>().swap(sumOfSquaredNorms);
+
+  if( outputAverageDisplacementFieldVolume.size() != 0 )
+    {
+    itkUtil::WriteImage<DisplacementFieldType>(DisplacementField, outputAverageDisplacementFieldVolume);
+    }
+  if( variance.IsNotNull() )
+    {
+    itkUtil::WriteImage<ImageType>(variance, outputVarianceVolume);
+    }
 
   // Compute the inverse of the average deformation field
   typedef itk::ICCIterativeInverseDisplacementFieldImageFilter<DisplacementFieldType,
                                                                DisplacementFieldType> InverseDisplacementFieldImageType;
   InverseDisplacementFieldImageType::Pointer inverse = InverseDisplacementFieldImageType::New();
-  inverse->SetInput(multi->GetOutput() );
+  inverse->SetInput(DisplacementField);
   inverse->SetStopValue(1.0e-6);
   inverse->SetNumberOfIterations(100);
   inverse->Update();
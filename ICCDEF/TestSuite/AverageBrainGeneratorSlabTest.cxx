@@ -0,0 +1,267 @@
+/*=========================================================================
+ *
+ *  Copyright SINAPSE: Scalable Informatics for Neuroscience, Processing and Software Engineering
+ *            The University of Iowa
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+//
+// Averages a few small displacement fields whose number of slices (181)
+// does not split evenly into the slabs of the threaded accumulator, with one
+// and with eight threads, and checks the average field and the variance
+// against a serial reference computed here, and the warped template of both
+// runs against each other.
+//
+
+#include "itkImage.h"
+#include "itkVector.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
+#include "itksys/SystemTools.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <sstream>
+
+#ifdef WIN32
+#define MODULE_IMPORT __declspec(dllimport)
+#else
+#define MODULE_IMPORT
+#endif
+
+extern "C" MODULE_IMPORT int ModuleEntryPoint(int, char * []);
+
+namespace
+{
+const unsigned int Dimension = 3;
+typedef itk::Image<float, Dimension>                      ImageType;
+typedef itk::Vector<float, Dimension>                     VectorPixelType;
+typedef itk::Image<VectorPixelType, Dimension>            DisplacementFieldType;
+
+const unsigned int NumberOfFields = 8;
+
+ImageType::RegionType
+TestRegion()
+{
+  ImageType::SizeType size;
+  size[0] = 10;
+  size[1] = 8;
+  size[2] = 181;
+  ImageType::RegionType region;
+  region.SetSize(size);
+  return region;
+}
+
+/* A smooth displacement, different for every field. */
+VectorPixelType
+Displacement(const unsigned int field, const ImageType::IndexType & index)
+{
+  VectorPixelType displacement;
+  for( unsigned int d = 0; d < Dimension; ++d )
+    {
+    displacement[d] = 0.5F * static_cast<float>( std::sin( 0.1 * ( field + 1 ) * index[d]
+                                                           + 0.3 * index[( d + 1 ) % Dimension]
+                                                           + 0.7 * field ) );
+    }
+  return displacement;
+}
+
+int
+RunAverageBrainGenerator(const std::string & workDirectory, const std::string & threads,
+                         const std::string & suffix)
+{
+  std::vector<std::string> args;
+  args.push_back("AverageBrainGenerator");
+  args.push_back("--inputDirectory");
+  args.push_back(workDirectory + "/subjects");
+  args.push_back("--templateVolume");
+  args.push_back(workDirectory + "/template.nii.gz");
+  args.push_back("--resolusion");
+  args.push_back("1");
+  args.push_back("--iteration");
+  args.push_back("1");
+  args.push_back("--pixelType");
+  args.push_back("float");
+  args.push_back("--outputVolume");
+  args.push_back(workDirectory + "/average" + suffix + ".nii.gz");
+  args.push_back("--outputAverageDisplacementFieldVolume");
+  args.push_back(workDirectory + "/averageField" + suffix + ".nii.gz");
+  args.push_back("--outputVarianceVolume");
+  args.push_back(workDirectory + "/variance" + suffix + ".nii.gz");
+  args.push_back("--numberOfThreads");
+  args.push_back(threads);
+
+  std::vector<char *> argv;
+  for( size_t i = 0; i < args.size(); ++i )
+    {
+    argv.push_back(const_cast<char *>( args[i].c_str() ) );
+    }
+  argv.push_back(ITK_NULLPTR);
+  return ModuleEntryPoint(static_cast<int>( args.size() ), &argv[0]);
+}
+
+template <class TImage>
+typename TImage::Pointer
+ReadImage(const std::string & fileName)
+{
+  typedef itk::ImageFileReader<TImage> ReaderType;
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(fileName);
+  reader->Update();
+  return reader->GetOutput();
+}
+
+template <class TImage>
+void
+WriteImage(const TImage *image, const std::string & fileName)
+{
+  typedef itk::ImageFileWriter<TImage> WriterType;
+  typename WriterType::Pointer writer = WriterType::New();
+  writer->SetInput(image);
+  writer->SetFileName(fileName);
+  writer->Update();
+}
+} // end anonymous namespace
+
+int AverageBrainGeneratorSlabTest(int argc, char *argv[])
+{
+  if( argc < 2 )
+    {
+    std::cerr << "Usage: " << argv[0] << " workDirectory" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::string workDirectory(argv[1]);
+  const ImageType::RegionType region = TestRegion();
+
+  //
+  // Template, fields, and the serial reference of their average and variance
+  //
+  ImageType::Pointer templateImage = ImageType::New();
+  templateImage->SetRegions(region);
+  templateImage->Allocate();
+  for( itk::ImageRegionIterator<ImageType> it(templateImage, region); !it.IsAtEnd(); ++it )
+    {
+    const ImageType::IndexType index = it.GetIndex();
+    it.Set( static_cast<float>( 10 * index[0] + 5 * index[1] + index[2] % 17 ) );
+    }
+  itksys::SystemTools::MakeDirectory( workDirectory.c_str() );
+  WriteImage<ImageType>(templateImage, workDirectory + "/template.nii.gz");
+
+  const size_t        numberOfVoxels = region.GetNumberOfPixels();
+  std::vector<double> sum(numberOfVoxels * Dimension, 0.0);
+  std::vector<double> sumOfSquaredNorms(numberOfVoxels, 0.0);
+  for( unsigned int f = 0; f < NumberOfFields; ++f )
+    {
+    DisplacementFieldType::Pointer field = DisplacementFieldType::New();
+    field->SetRegions(region);
+    field->Allocate();
+
+    size_t v = 0;
+    for( itk::ImageRegionIterator<DisplacementFieldType> it(field, region); !it.IsAtEnd(); ++it, ++v )
+      {
+      const VectorPixelType displacement = Displacement(f, it.GetIndex() );
+      it.Set(displacement);
+      for( unsigned int d = 0; d < Dimension; ++d )
+        {
+        sum[v * Dimension + d] += displacement[d];
+        sumOfSquaredNorms[v] += static_cast<double>( displacement[d] ) * displacement[d];
+        }
+      }
+
+    std::ostringstream subject;
+    subject << workDirectory << "/subjects/subject" << f << "/forward";
+    itksys::SystemTools::MakeDirectory( subject.str().c_str() );
+    WriteImage<DisplacementFieldType>(field, subject.str() + "/subject_iteration1resolution1_forward.nii.gz");
+    }
+
+  //
+  // One and eight threads; eight threads ask for 32 slabs of 6 slices,
+  // more than the 181 slices need.
+  //
+  if( RunAverageBrainGenerator(workDirectory, "1", "_serial") != EXIT_SUCCESS
+      || RunAverageBrainGenerator(workDirectory, "8", "_threaded") != EXIT_SUCCESS )
+    {
+    std::cerr << "AverageBrainGenerator failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const double normalizer = 1.0 / ( NumberOfFields + 1 );
+  const double tolerance = 1.0e-5;
+  int          failures = 0;
+
+  const char *suffixes[2] = { "_serial", "_threaded" };
+  for( unsigned int run = 0; run < 2; ++run )
+    {
+    DisplacementFieldType::Pointer average =
+      ReadImage<DisplacementFieldType>(workDirectory + "/averageField" + suffixes[run] + ".nii.gz");
+    ImageType::Pointer variance = ReadImage<ImageType>(workDirectory + "/variance" + suffixes[run] + ".nii.gz");
+
+    if( average->GetLargestPossibleRegion().GetSize() != region.GetSize()
+        || variance->GetLargestPossibleRegion().GetSize() != region.GetSize() )
+      {
+      std::cerr << suffixes[run] << ": output size differs from the template size" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    const VectorPixelType *averageBuffer = average->GetBufferPointer();
+    const float *          varianceBuffer = variance->GetBufferPointer();
+    for( size_t v = 0; v < numberOfVoxels; ++v )
+      {
+      double squaredNormOfAverage = 0.0;
+      for( unsigned int d = 0; d < Dimension; ++d )
+        {
+        const double expected = sum[v * Dimension + d] * normalizer;
+        squaredNormOfAverage += expected * expected;
+        if( std::fabs( averageBuffer[v][d] - expected ) > tolerance )
+          {
+          ++failures;
+          }
+        }
+      const double expectedVariance = std::max(0.0, sumOfSquaredNorms[v] * normalizer - squaredNormOfAverage);
+      if( std::fabs( varianceBuffer[v] - expectedVariance ) > tolerance )
+        {
+        ++failures;
+        }
+      }
+    if( failures != 0 )
+      {
+      std::cerr << suffixes[run] << ": " << failures << " values differ from the serial reference" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  ImageType::Pointer serialAverage = ReadImage<ImageType>(workDirectory + "/average_serial.nii.gz");
+  ImageType::Pointer threadedAverage = ReadImage<ImageType>(workDirectory + "/average_threaded.nii.gz");
+  itk::ImageRegionConstIterator<ImageType> serialIt(serialAverage, region);
+  itk::ImageRegionConstIterator<ImageType> threadedIt(threadedAverage, region);
+  for( ; !serialIt.IsAtEnd(); ++serialIt, ++threadedIt )
+    {
+    if( std::fabs( serialIt.Get() - threadedIt.Get() ) > 1.0e-3 )
+      {
+      ++failures;
+      }
+    }
+  if( failures != 0 )
+    {
+    std::cerr << failures << " voxels of the warped template differ between 1 and 8 threads" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "Test PASSED" << std::endl;
+  return EXIT_SUCCESS;
+}
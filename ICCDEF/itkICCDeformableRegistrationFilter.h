@@ -36,6 +36,7 @@
 #include "itkWarpVectorImageFilter.h"
 #include "itkVectorLinearInterpolateNearestNeighborExtrapolateImageFunction.h"
 #include "itkAddImageFilter.h"
+#include "itkSymmetricSecondRankTensor.h"
 #include <vector>
 #include <complex>
 
@@ -117,6 +118,13 @@ public:
   typedef typename DisplacementFieldFFTType::Pointer DisplacementFieldFFTPointer;
   typedef typename ComplexImageType::Pointer         ComplexImagePointer;
 
+  /** The squared regularization operator is a real symmetric 3x3 matrix at
+   * every frequency, so only its six distinct components are stored, and
+   * only over the half spectrum produced by the real to complex FFT. */
+  typedef SymmetricSecondRankTensor<float, 3>  OperatorPixelType;
+  typedef Image<OperatorPixelType, 3>          OperatorImageType;
+  typedef typename OperatorImageType::Pointer  OperatorImagePointer;
+
   /** FiniteDifferenceFunction type. */
   typedef typename
     Superclass::FiniteDifferenceFunctionType               FiniteDifferenceFunctionType;
@@ -278,6 +286,13 @@ protected:
 
   double ComputeMinJac(DisplacementFieldPointer & );
 
+  /** Forward and inverse transforms of a displacement field. The same FFT
+   * filters are used for every call, so that FFTW plans and work buffers are
+   * only computed again when the image size changes. */
+  DisplacementFieldFFTPointer ComputeForwardFFT(DisplacementFieldType * field);
+
+  DisplacementFieldPointer ComputeInverseFFT(DisplacementFieldFFTType * coefficients);
+
   /** This method returns a pointer to a FiniteDifferenceFunction object that
  * will be used by the filter to calculate updates at image pixels.
  * \returns A FiniteDifferenceObject pointer. */
@@ -367,7 +382,9 @@ private:
   std::vector<AdderPointer>                  m_Adders;
   std::vector<MultiplyByConstantPointer>     m_Multipliers;
   std::vector<FFTWComplexToRealImagePointer> m_FFTc2rs;
-  ComplexImagePointer                        m_sqr11, m_sqr12, m_sqr13, m_sqr22, m_sqr23, m_sqr33;
+  FFTWRealToComplexImagePointer              m_ForwardFFT;
+  FFTWComplexToRealImagePointer              m_InverseFFT;
+  OperatorImagePointer                       m_Operator;
   ComplexImagePointer                        m_SmoothFilter;
 
   float m_Alpha, m_Gamma, m_Beta;
@@ -77,12 +77,10 @@ ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>
     m_Coefficients.push_back(co);
     }
 
-  m_sqr11 = ComplexImageType::New();
-  m_sqr12 = ComplexImageType::New();
-  m_sqr13 = ComplexImageType::New();
-  m_sqr22 = ComplexImageType::New();
-  m_sqr23 = ComplexImageType::New();
-  m_sqr33 = ComplexImageType::New();
+  m_ForwardFFT = FFTWRealToComplexImageType::New();
+  m_InverseFFT = FFTWComplexToRealImageType::New();
+
+  m_Operator = OperatorImageType::New();
   m_SmoothFilter = ComplexImageType::New();
 
 //  m_FixedLandmark = LandmarkType::New();
@@ -331,41 +329,21 @@ ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>
     }
 
   // Compute D[k], Initialize harmonic
-  m_sqr11->CopyInformation(this->GetOutput(0) );
-  m_sqr11->SetRegions(this->GetOutput(0)->GetLargestPossibleRegion() );
-  m_sqr11->Allocate();
-
-  m_sqr12->CopyInformation(this->GetOutput(0) );
-  m_sqr12->SetRegions(this->GetOutput(0)->GetLargestPossibleRegion() );
-  m_sqr12->Allocate();
-
-  m_sqr13->CopyInformation(this->GetOutput(0) );
-  m_sqr13->SetRegions(this->GetOutput(0)->GetLargestPossibleRegion() );
-  m_sqr13->Allocate();
-
-  m_sqr22->CopyInformation(this->GetOutput(0) );
-  m_sqr22->SetRegions(this->GetOutput(0)->GetLargestPossibleRegion() );
-  m_sqr22->Allocate();
+  // The operator only needs the half spectrum kept by the real to complex
+  // FFT, i.e. the region of the coefficients.
+  typename OperatorImageType::RegionType operatorRegion = this->GetOutput(0)->GetLargestPossibleRegion();
+  typename OperatorImageType::SizeType   operatorSize = operatorRegion.GetSize();
+  operatorSize[0] = operatorSize[0] / 2 + 1;
+  operatorRegion.SetSize(operatorSize);
 
-  m_sqr23->CopyInformation(this->GetOutput(0) );
-  m_sqr23->SetRegions(this->GetOutput(0)->GetLargestPossibleRegion() );
-  m_sqr23->Allocate();
-
-  m_sqr33->CopyInformation(this->GetOutput(0) );
-  m_sqr33->SetRegions(this->GetOutput(0)->GetLargestPossibleRegion() );
-  m_sqr33->Allocate();
+  m_Operator->CopyInformation(this->GetOutput(0) );
+  m_Operator->SetRegions(operatorRegion);
+  m_Operator->Allocate();
 
   m_SmoothFilter->CopyInformation(this->GetOutput(0) );
   m_SmoothFilter->SetRegions(this->GetOutput(0)->GetLargestPossibleRegion() );
   m_SmoothFilter->Allocate();
 
-  this->m_sqr11->FillBuffer(0.0);
-  this->m_sqr12->FillBuffer(0.0);
-  this->m_sqr13->FillBuffer(0.0);
-  this->m_sqr22->FillBuffer(0.0);
-  this->m_sqr23->FillBuffer(0.0);
-  this->m_sqr33->FillBuffer(0.0);
-
   const float fnx = static_cast<float>(this->GetFixedImage()->GetLargestPossibleRegion().GetSize()[0]);
   const float fny = static_cast<float>(this->GetFixedImage()->GetLargestPossibleRegion().GetSize()[1]);
   const float fnz = static_cast<float>(this->GetFixedImage()->GetLargestPossibleRegion().GetSize()[2]);
@@ -374,9 +352,7 @@ ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>
   const float spy = static_cast<float>(this->GetFixedImage()->GetSpacing()[1]);
   const float spz = static_cast<float>(this->GetFixedImage()->GetSpacing()[2]);
 
-  const float delta1 = 1.0F / fnx;
-  const float delta2 = 1.0F / fny;
-  const float delta3 = 1.0F / fnz;
+  const float delta[3] = { 1.0F / fnx, 1.0F / fny, 1.0F / fnz };
 
   const float fnx2 = fnx * fnx;
   const float fny2 = fny * fny;
@@ -384,47 +360,62 @@ ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>
 
   const float sumsqdims2alpha = 2.0F * (fnx2 + fny2 + fnz2) * m_Alpha;
 
-  ImageRegionConstIterator<ComplexImageType>
-  MyIterator(this->m_sqr11, this->m_sqr11->GetRequestedRegion() );
-  for( MyIterator.GoToBegin(); !MyIterator.IsAtEnd(); ++MyIterator )
+  // The frequency along each axis only depends on the index along that
+  // axis, so the trigonometric terms are tabulated once per axis.
+  std::vector<float> cosOmega[3];
+  std::vector<float> sinOmega[3];
+  for( unsigned int d = 0; d < 3; d++ )
+    {
+    const typename OperatorImageType::IndexValueType start = operatorRegion.GetIndex()[d];
+    cosOmega[d].resize(operatorSize[d]);
+    sinOmega[d].resize(operatorSize[d]);
+    for( unsigned int i = 0; i < operatorSize[d]; i++ )
+      {
+      const float omega =
+        2.0F * static_cast<float>(vnl_math::pi * static_cast<float>(start + i) ) * delta[d];
+      cosOmega[d][i] = vcl_cos(omega);
+      sinOmega[d][i] = vcl_sin(omega);
+      }
+    }
+
+  ImageRegionIteratorWithIndex<OperatorImageType> operatorIterator(m_Operator, operatorRegion);
+  for( operatorIterator.GoToBegin(); !operatorIterator.IsAtEnd(); ++operatorIterator )
     {
-    const ComplexImageType::IndexType HI = MyIterator.GetIndex();
-    const float                       omega1 =
-      2.0F * static_cast<float>(vnl_math::pi * static_cast<float>(HI[0]) ) * delta1;
-    const float omega2 =
-      2.0F * static_cast<float>(vnl_math::pi * static_cast<float>(HI[1]) ) * delta2;
-    const float omega3 =
-      2.0F * static_cast<float>(vnl_math::pi * static_cast<float>(HI[2]) ) * delta3;
+    const typename OperatorImageType::IndexType HI = operatorIterator.GetIndex();
+    const unsigned int i1 = HI[0] - operatorRegion.GetIndex()[0];
+    const unsigned int i2 = HI[1] - operatorRegion.GetIndex()[1];
+    const unsigned int i3 = HI[2] - operatorRegion.GetIndex()[2];
+
+    const float cosOmega1 = cosOmega[0][i1];
+    const float cosOmega2 = cosOmega[1][i2];
+    const float cosOmega3 = cosOmega[2][i3];
+    const float sinOmega1 = sinOmega[0][i1];
+    const float sinOmega2 = sinOmega[1][i2];
 
     const float alphaCosOmega2 =
-      2.0F * m_Alpha * (fnx2 * vcl_cos(omega1) + fny2 * vcl_cos(omega2)
-                        + fnz2 * vcl_cos(omega3) );
+      2.0F * m_Alpha * (fnx2 * cosOmega1 + fny2 * cosOmega2 + fnz2 * cosOmega3);
     const float b11 =
       ( sumsqdims2alpha + 2.0F * fnx2 * m_Beta + m_Gamma - alphaCosOmega2
-        - 2.0F * fnx2 * m_Beta * vcl_cos(omega1) ) / (spx * spx);
+        - 2.0F * fnx2 * m_Beta * cosOmega1 ) / (spx * spx);
     const float b22 =
       (sumsqdims2alpha + 2.0F * fny2 * m_Beta + m_Gamma - alphaCosOmega2
-       - 2.0F * fny2 * m_Beta * vcl_cos(omega2) ) / (spy * spy);
+       - 2.0F * fny2 * m_Beta * cosOmega2 ) / (spy * spy);
     const float b33 =
       (sumsqdims2alpha + 2.0F * fnz2 * m_Beta + m_Gamma - alphaCosOmega2
-       - 2.0F * fnz2 * m_Beta * vcl_cos(omega3) ) / (spz * spz);
-    const float b12 = (fnx * fny * m_Beta * vcl_sin(omega1) * vcl_sin(omega2) ) / (spx * spy);
-    const float b13 = (fnx * fnz * m_Beta * vcl_sin(omega1) * vcl_sin(omega3) ) / (spx * spz);
-    const float b23 = (fny * fnz * m_Beta * vcl_sin(omega2) * vcl_cos(omega3) ) / (spy * spz);
+       - 2.0F * fnz2 * m_Beta * cosOmega3 ) / (spz * spz);
+    const float b12 = (fnx * fny * m_Beta * sinOmega1 * sinOmega2 ) / (spx * spy);
+    const float b13 = (fnx * fnz * m_Beta * sinOmega1 * sinOmega[2][i3] ) / (spx * spz);
+    const float b23 = (fny * fnz * m_Beta * sinOmega2 * cosOmega3 ) / (spy * spz);
 
     // Square the matrix A=BB (i.e., B'B=BB because B'=B)
-    this->m_sqr11->SetPixel(HI,
-                            std::complex<float>(b11 * b11 + b12 * b12 + b13 * b13, 0) );
-    this->m_sqr12->SetPixel(HI,
-                            std::complex<float>(b11 * b12 + b12 * b22 + b13 * b23, 0) );
-    this->m_sqr13->SetPixel(HI,
-                            std::complex<float>(b11 * b13 + b12 * b23 + b13 * b33, 0) );
-    this->m_sqr22->SetPixel(HI,
-                            std::complex<float>(b12 * b12 + b22 * b22 + b23 * b23, 0) );
-    this->m_sqr23->SetPixel(HI,
-                            std::complex<float>(b12 * b13 + b22 * b23 + b23 * b33, 0) );
-    this->m_sqr33->SetPixel(HI,
-                            std::complex<float>(b13 * b13 + b23 * b23 + b33 * b33, 0) );
+    OperatorPixelType sqr;
+    sqr(0, 0) = b11 * b11 + b12 * b12 + b13 * b13;
+    sqr(0, 1) = b11 * b12 + b12 * b22 + b13 * b23;
+    sqr(0, 2) = b11 * b13 + b12 * b23 + b13 * b33;
+    sqr(1, 1) = b12 * b12 + b22 * b22 + b23 * b23;
+    sqr(1, 2) = b12 * b13 + b22 * b23 + b23 * b33;
+    sqr(2, 2) = b13 * b13 + b23 * b23 + b33 * b33;
+    operatorIterator.Set(sqr);
     }
 
   // Compute smooth filter
@@ -465,17 +456,8 @@ ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>
     myIterator.Set(cmpxtemp);
     }
 
-  typename FFTWRealToComplexImageType::Pointer invFFT12 = FFTWRealToComplexImageType::New();
-  invFFT12->SetInput(this->GetOutput(0) );
-  invFFT12->Update();
-  m_Coefficients[0] = invFFT12->GetOutput();
-  m_Coefficients[0]->DisconnectPipeline();
-
-  typename FFTWRealToComplexImageType::Pointer invFFT21 = FFTWRealToComplexImageType::New();
-  invFFT21->SetInput(this->GetOutput(1) );
-  invFFT21->Update();
-  m_Coefficients[1] = invFFT21->GetOutput();
-  m_Coefficients[1]->DisconnectPipeline();
+  m_Coefficients[0] = this->ComputeForwardFFT(this->GetOutput(0) );
+  m_Coefficients[1] = this->ComputeForwardFFT(this->GetOutput(1) );
 
   f->SetSmoothFilter(m_SmoothFilter);
   b->SetSmoothFilter(m_SmoothFilter);
@@ -801,19 +783,8 @@ ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>
   normalizer_Regularization = 4.0F * m_RegularizationWeight * m_MaximumUpdateStepLength  / (fnx * fny * fnz);
   normalizer_InverseConsistency = 4.0 * m_InverseWeight * m_MaximumUpdateStepLength;
 
-  typename FFTWRealToComplexImageType::Pointer invfftIC12 = FFTWRealToComplexImageType::New();
-  invfftIC12->SetInput(sub12->GetOutput() );
-  invfftIC12->Update();
-
-  typename FFTWRealToComplexImageType::Pointer invfftIC21 = FFTWRealToComplexImageType::New();
-  invfftIC21->SetInput(sub21->GetOutput() );
-  invfftIC21->Update();
-
-  DisplacementFieldFFTPointer invfft0 = invfftIC12->GetOutput();
-  invfft0->DisconnectPipeline();
-
-  DisplacementFieldFFTPointer invfft1 = invfftIC21->GetOutput();
-  invfft1->DisconnectPipeline();
+  DisplacementFieldFFTPointer invfft0 = this->ComputeForwardFFT(sub12->GetOutput() );
+  DisplacementFieldFFTPointer invfft1 = this->ComputeForwardFFT(sub21->GetOutput() );
 
   if( m_InverseWeight > 0.0 )
     {
@@ -828,11 +799,7 @@ ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>
     float for_MinJac, back_MinJac;
     for( unsigned int i = 0; i < this->GetNumberOfOutputs(); i++ )
       {
-      typename FFTWComplexToRealImageType::Pointer invFFTtemp = FFTWComplexToRealImageType::New();
-      invFFTtemp->SetInput(m_Coefficients[i]);
-      invFFTtemp->Update();
-      m_UpdateBuffers[i] = invFFTtemp->GetOutput();
-      m_UpdateBuffers[i]->DisconnectPipeline();
+      m_UpdateBuffers[i] = this->ComputeInverseFFT(m_Coefficients[i]);
       }
 
     for_MinJac = ComputeMinJac(m_UpdateBuffers[0]);
@@ -843,11 +810,7 @@ ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>
       do
         {
         this->ComputeLinearElastic(m_Coefficients[0], normalizer_Regularization);
-        typename FFTWComplexToRealImageType::Pointer temp = FFTWComplexToRealImageType::New();
-        temp->SetInput(m_Coefficients[0]);
-        temp->Update();
-        m_UpdateBuffers[0] = temp->GetOutput();
-        m_UpdateBuffers[0]->DisconnectPipeline();
+        m_UpdateBuffers[0] = this->ComputeInverseFFT(m_Coefficients[0]);
         for_MinJac = ComputeMinJac(m_UpdateBuffers[0]);
         std::cout << "for_MinJac:" << for_MinJac << std::endl;
         }
@@ -863,11 +826,7 @@ ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>
       do
         {
         this->ComputeLinearElastic(m_Coefficients[1], normalizer_Regularization);
-        typename FFTWComplexToRealImageType::Pointer temp = FFTWComplexToRealImageType::New();
-        temp->SetInput(m_Coefficients[1]);
-        temp->Update();
-        m_UpdateBuffers[1] = temp->GetOutput();
-        m_UpdateBuffers[1]->DisconnectPipeline();
+        m_UpdateBuffers[1] = this->ComputeInverseFFT(m_Coefficients[1]);
         back_MinJac = ComputeMinJac(m_UpdateBuffers[1]);
         std::cout << "back_MinJac:" << back_MinJac << std::endl;
         }
@@ -982,19 +941,19 @@ ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>
                                int)
 {
   ImageRegionIterator<DisplacementFieldFFTType> CoeffsIterator(coeff, regionToProcess);
-  for( CoeffsIterator.GoToBegin();
+  ImageRegionConstIterator<OperatorImageType>   OperatorIterator(m_Operator, regionToProcess);
+  for( CoeffsIterator.GoToBegin(), OperatorIterator.GoToBegin();
        !CoeffsIterator.IsAtEnd(); // && !Coeffs2Iterator.IsAtEnd() && !Coeffs3Iterator.IsAtEnd();
-       ++CoeffsIterator )
+       ++CoeffsIterator, ++OperatorIterator )
     {
-    const DisplacementFieldFFTType::IndexType HI = CoeffsIterator.GetIndex();
-
     // a Gauss-Seidel modification of gradient decent.
-    const float dsqr11 = m_sqr11->GetPixel(HI).real();
-    const float dsqr12 = m_sqr12->GetPixel(HI).real();
-    const float dsqr13 = m_sqr13->GetPixel(HI).real();
-    const float dsqr22 = m_sqr22->GetPixel(HI).real();
-    const float dsqr23 = m_sqr23->GetPixel(HI).real();
-    const float dsqr33 = m_sqr33->GetPixel(HI).real();
+    const OperatorPixelType & sqr = OperatorIterator.Get();
+    const float               dsqr11 = sqr(0, 0);
+    const float               dsqr12 = sqr(0, 1);
+    const float               dsqr13 = sqr(0, 2);
+    const float               dsqr22 = sqr(1, 1);
+    const float               dsqr23 = sqr(1, 2);
+    const float               dsqr33 = sqr(2, 2);
 
     DisplacementFieldFFTType::PixelType pixel = CoeffsIterator.Get();
 
@@ -1201,6 +1160,36 @@ ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>
   return maxThreadIdUsed + 1;
 }
 
+template <class TFixedImage, class TMovingImage, class TDisplacementField>
+typename ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>::DisplacementFieldFFTPointer
+ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>
+::ComputeForwardFFT(DisplacementFieldType * field)
+{
+  // The input is often modified in place between calls, so force the
+  // transform to run again.
+  m_ForwardFFT->SetInput(field);
+  m_ForwardFFT->Modified();
+  m_ForwardFFT->Update();
+
+  DisplacementFieldFFTPointer coefficients = m_ForwardFFT->GetOutput();
+  coefficients->DisconnectPipeline();
+  return coefficients;
+}
+
+template <class TFixedImage, class TMovingImage, class TDisplacementField>
+typename ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>::DisplacementFieldPointer
+ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>
+::ComputeInverseFFT(DisplacementFieldFFTType * coefficients)
+{
+  m_InverseFFT->SetInput(coefficients);
+  m_InverseFFT->Modified();
+  m_InverseFFT->Update();
+
+  DisplacementFieldPointer field = m_InverseFFT->GetOutput();
+  field->DisconnectPipeline();
+  return field;
+}
+
 template <class TFixedImage, class TMovingImage, class TDisplacementField>
 double
 ICCDeformableRegistrationFilter<TFixedImage, TMovingImage, TDisplacementField>